@@ -0,0 +1,743 @@
+﻿#include <fuse.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <stdint.h>
+#include <limits.h>
+#include <sys/resource.h>
+#include <sys/statvfs.h>
+#include "ofs_ioctl.h"
+
+/*
+ * OFS 벤치마크
+ * ofs.c를 OFS_BENCH로 빌드하여 마운트 없이 ofs_oper 핸들러를 직접 호출한다.
+ * /dev/fuse가 없는 환경에서도 node.c 등 핵심 경로의 성능 변화를 확인할 수 있다.
+ *
+ * 사용법 : ofs_bench [-n FILES] [-d DEPTH] [-s MB] [-b BLOCK] [-w WORKLOAD,...] [-o OFS_OPTIONS] [-S] [-v]
+ */
+
+/* ofs.c(OFS_BENCH)가 main 대신 제공한다 */
+const struct fuse_operations *ofs_bench_setup(int, char *[]);
+
+static const struct fuse_operations *oper;
+static struct fuse_context bench_ctx;
+
+/* 마운트가 없으므로 요청자는 항상 벤치마크 프로세스 자신이다 */
+struct fuse_context *fuse_get_context(void)
+{
+	return &bench_ctx;
+}
+
+/* 단계별 측정 결과 */
+typedef struct _BSTAT {
+	const char	*name;
+	uint64_t		*lat;					// 연산별 지연(ns)
+	size_t		cnt, cap;
+	size_t		errors;
+	uint64_t		start;
+} BSTAT;
+
+static size_t		nfiles = 10000;			// 생성할 파일 수
+static int		depth = 64;				// 깊은 트리의 깊이
+static size_t		io_mb = 64;				// I/O 파일 크기(MB)
+static size_t		block = 4096;			// I/O 블록 크기
+static const char	*workloads = "create,stat,readdir,deep,seq,prealloc,append,large,rand,export,rename,unlink,rmtree,move,batch,tag";
+static char		*iobuf;
+
+static uint64_t bench_now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void bench_begin(BSTAT *st, const char *name, size_t cap)
+{
+	memset(st, 0, sizeof(BSTAT));
+	st->name = name;
+	st->cap = (cap > 0)? cap : 1;
+	st->lat = (uint64_t*)malloc(sizeof(uint64_t) * st->cap);
+	st->start = bench_now();
+}
+
+static void bench_add(BSTAT *st, uint64_t ns, int ret)
+{
+	if(ret < 0) st->errors++;
+	if(st->cnt == st->cap) {
+		st->cap *= 2;
+		st->lat = (uint64_t*)realloc(st->lat, sizeof(uint64_t) * st->cap);
+	}
+	st->lat[st->cnt++] = ns;
+}
+
+/* 연산 하나의 지연을 잰다 */
+#define BENCH_OP(st, expr) do { \
+		uint64_t _t = bench_now(); \
+		int _r = (int)(expr); \
+		bench_add(st, bench_now() - _t, _r); \
+	} while(0)
+
+static int bench_cmp(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+	return (x > y) - (x < y);
+}
+
+static double bench_pct(BSTAT *st, double p)
+{
+	size_t i = (size_t)(p / 100.0 * (st->cnt - 1) + 0.5);
+	return st->lat[i] / 1000.0;
+}
+
+static long bench_rss(void)
+{
+	struct rusage ru;
+	getrusage(RUSAGE_SELF, &ru);
+	return ru.ru_maxrss;						// KB
+}
+
+/* 처리량, 지연 백분위(us), 최대 RSS 출력 */
+static void bench_end(BSTAT *st)
+{
+	double sec = (bench_now() - st->start) / 1e9;
+
+	if(st->cnt > 0) {
+		qsort(st->lat, st->cnt, sizeof(uint64_t), bench_cmp);
+		printf("%-16s %9zu %12.0f %9.2f %9.2f %9.2f %9.2f %10.2f %8zu %9.1f\n",
+			st->name, st->cnt, st->cnt / sec,
+			bench_pct(st, 50), bench_pct(st, 90), bench_pct(st, 99), bench_pct(st, 99.9),
+			st->lat[st->cnt - 1] / 1000.0, st->errors, bench_rss() / 1024.0);
+	}
+	free(st->lat);
+}
+
+static int bench_filler(void *buf, const char *name, const struct stat *stbuf, off_t off, enum fuse_fill_dir_flags flags)
+{
+	(*(size_t*)buf)++;
+	return 0;
+}
+
+/* 조직화 on은 확장자가 있어 타입 링크가 만들어지는 이름, off는 확장자가 없는 이름 */
+static void bench_name(char *buf, const char *dir, size_t i, int org, const char *ext)
+{
+	if(org)
+		sprintf(buf, "%s/f%zu.%s", dir, i, ext);
+	else
+		sprintf(buf, "%s/f%zu", dir, i);
+}
+
+static int bench_selected(const char *name)
+{
+	size_t len = strlen(name);
+	const char *p = workloads;
+
+	while((p = strstr(p, name)) != NULL) {
+		if((p == workloads || p[-1] == ',') && (p[len] == ',' || p[len] == '\0'))
+			return 1;
+		p += len;
+	}
+	return 0;
+}
+
+static void bench_create(int org)
+{
+	BSTAT st;
+	char dir[32], path[PATH_MAX];
+	size_t i;
+
+	sprintf(dir, "/wide_%s", org? "org" : "plain");
+	oper->mkdir(dir, 0755);
+	bench_begin(&st, org? "create/org" : "create/plain", nfiles);
+	for(i = 0; i < nfiles; i++) {
+		bench_name(path, dir, i, org, "txt");
+		BENCH_OP(&st, oper->mknod(path, S_IFREG | 0644, 0));
+	}
+	bench_end(&st);
+}
+
+static void bench_stat(int org)
+{
+	BSTAT st;
+	struct stat stbuf;
+	char dir[32], path[PATH_MAX];
+	size_t i;
+
+	sprintf(dir, "/wide_%s", org? "org" : "plain");
+	bench_begin(&st, org? "stat/org" : "stat/plain", nfiles);
+	for(i = 0; i < nfiles; i++) {
+		bench_name(path, dir, (size_t)rand() % nfiles, org, "txt");
+		BENCH_OP(&st, oper->getattr(path, &stbuf, NULL));
+	}
+	bench_end(&st);
+}
+
+static void bench_readdir(int org)
+{
+	BSTAT st;
+	char dir[32];
+	size_t i, n;
+
+	sprintf(dir, "/wide_%s", org? "org" : "plain");
+	bench_begin(&st, org? "readdir/org" : "readdir/plain", 100);
+	for(i = 0; i < 100; i++) {
+		n = 0;
+		BENCH_OP(&st, oper->readdir(dir, &n, bench_filler, 0, NULL, 0));
+	}
+	bench_end(&st);
+}
+
+static void bench_deep(void)
+{
+	BSTAT st;
+	struct stat stbuf;
+	char path[PATH_MAX], file[PATH_MAX + 32];
+	size_t len = 0;
+	int i;
+
+	bench_begin(&st, "mkdir/deep", depth);
+	for(i = 0; i < depth && len + 16 < PATH_MAX; i++) {
+		len += sprintf(path + len, "/d%d", i);
+		BENCH_OP(&st, oper->mkdir(path, 0755));
+	}
+	bench_end(&st);
+
+	bench_begin(&st, "create/deep", nfiles);
+	for(i = 0; i < (int)nfiles; i++) {
+		snprintf(file, sizeof(file), "%s/f%d.txt", path, i);
+		BENCH_OP(&st, oper->mknod(file, S_IFREG | 0644, 0));
+	}
+	bench_end(&st);
+
+	bench_begin(&st, "stat/deep", nfiles);
+	for(i = 0; i < (int)nfiles; i++) {
+		snprintf(file, sizeof(file), "%s/f%d.txt", path, rand() % (int)nfiles);
+		BENCH_OP(&st, oper->getattr(file, &stbuf, NULL));
+	}
+	bench_end(&st);
+}
+
+static void bench_io(int seq)
+{
+	BSTAT st;
+	const char *path = seq? "/seq.dat" : "/rand.dat";
+	size_t i, n = (io_mb << 20) / block;
+	off_t off;
+
+	oper->mknod(path, S_IFREG | 0644, 0);
+	if(!seq) {											// 랜덤 I/O는 미리 채운 파일에 한다
+		for(i = 0; i < n; i++)
+			oper->write(path, iobuf, block, (off_t)i * block, NULL);
+	}
+
+	bench_begin(&st, seq? "write/seq" : "write/rand", n);
+	for(i = 0; i < n; i++) {
+		off = seq? (off_t)i * block : (off_t)((size_t)rand() % n) * block;
+		BENCH_OP(&st, oper->write(path, iobuf, block, off, NULL));
+	}
+	bench_end(&st);
+
+	bench_begin(&st, seq? "read/seq" : "read/rand", n);
+	for(i = 0; i < n; i++) {
+		off = seq? (off_t)i * block : (off_t)((size_t)rand() % n) * block;
+		BENCH_OP(&st, oper->read(path, iobuf, block, off, NULL));
+	}
+	bench_end(&st);
+	oper->unlink(path);
+}
+
+/* 최종 크기를 fallocate로 미리 할당한 뒤 순차 쓰기 - write/seq와 비교한다 */
+static void bench_prealloc(void)
+{
+	BSTAT st;
+	const char *path = "/prealloc.dat";
+	size_t i, n = (io_mb << 20) / block;
+
+	oper->mknod(path, S_IFREG | 0644, 0);
+	bench_begin(&st, "fallocate", 1);
+	BENCH_OP(&st, oper->fallocate(path, 0, 0, (off_t)n * block, NULL));
+	bench_end(&st);
+
+	bench_begin(&st, "write/prealloc", n);
+	for(i = 0; i < n; i++)
+		BENCH_OP(&st, oper->write(path, iobuf, block, (off_t)i * block, NULL));
+	bench_end(&st);
+	oper->unlink(path);
+}
+
+static long bench_minflt(void)
+{
+	struct rusage ru;
+	getrusage(RUSAGE_SELF, &ru);
+	return ru.ru_minflt;
+}
+
+/* io_mb 크기의 큰 파일을 1MB씩 순차로 쓰고 읽는다 - 처리량과 페이지 폴트를 -o huge_file=MB와 비교한다 */
+static void bench_large(void)
+{
+	BSTAT st;
+	const char *path = "/large.dat", *names[2] = { "write/large", "read/large" };
+	size_t i, n = io_mb, bs = 1 << 20;
+	char *buf = (char*)malloc(bs);
+	long flt;
+	int rd;
+
+	memset(buf, 'o', bs);
+	oper->mknod(path, S_IFREG | 0644, 0);
+	for(rd = 0; rd < 2; rd++) {
+		flt = bench_minflt();
+		bench_begin(&st, names[rd], n);
+		for(i = 0; i < n; i++) {
+			if(rd)
+				BENCH_OP(&st, oper->read(path, buf, bs, (off_t)i * bs, NULL));
+			else
+				BENCH_OP(&st, oper->write(path, buf, bs, (off_t)i * bs, NULL));
+		}
+		printf("%-16s %9.1f MB/s, %ld minor faults\n", names[rd],
+			n / ((bench_now() - st.start) / 1e9), bench_minflt() - flt);
+		bench_end(&st);
+	}
+	oper->unlink(path);
+	free(buf);
+}
+
+/* 버퍼 없는 로거처럼 연 핸들로 512바이트씩 이어 쓴다 (-o wbuf=KB와 비교) */
+static void bench_append(void)
+{
+	BSTAT st;
+	struct fuse_file_info fi;
+	const char *path = "/append.log";
+	size_t i, n = (io_mb << 20) / 512;
+
+	oper->mknod(path, S_IFREG | 0644, 0);
+	memset(&fi, 0, sizeof(fi));
+	fi.flags = O_WRONLY | O_APPEND;
+	if(oper->open(path, &fi) != 0)
+		return;
+	bench_begin(&st, "write/append", n);
+	for(i = 0; i < n; i++)
+		BENCH_OP(&st, oper->write(path, iobuf, 512, (off_t)i * 512, &fi));
+	BENCH_OP(&st, oper->flush(path, &fi));
+	bench_end(&st);
+	oper->release(path, &fi);
+	oper->unlink(path);
+}
+
+/* 내보내기가 진행 중인지 /.ofs/export에서 읽는다 */
+static int bench_export_running(void)
+{
+	struct fuse_file_info fi;
+	char buf[1024];
+	int n;
+
+	memset(&fi, 0, sizeof(fi));
+	fi.flags = O_RDONLY;
+	if(oper->open("/.ofs/export", &fi) != 0)
+		return 0;
+	n = oper->read("/.ofs/export", buf, sizeof(buf) - 1, 0, &fi);
+	oper->release("/.ofs/export", &fi);
+	buf[(n > 0)? n : 0] = '\0';
+	return strstr(buf, "running") != NULL;
+}
+
+/* 1MB 파일 io_mb개를 /dev/null로 tar 내보내기 - 마운트를 거치는 tar와 비교한다 */
+static void bench_export(void)
+{
+	BSTAT st;
+	struct timespec ts = { 0, 100000 };
+	const char *cmd = "/export /dev/null\n";
+	char path[PATH_MAX];
+	size_t i, j;
+	uint64_t t;
+	int ret;
+
+	oper->mkdir("/export", 0755);
+	for(i = 0; i < io_mb; i++) {
+		sprintf(path, "/export/f%zu.dat", i);
+		oper->mknod(path, S_IFREG | 0644, 0);
+		for(j = 0; j * block < (1 << 20); j++)
+			oper->write(path, iobuf, block, (off_t)j * block, NULL);
+	}
+
+	bench_begin(&st, "export", 1);
+	t = bench_now();
+	ret = oper->write("/.ofs/export", cmd, strlen(cmd), 0, NULL);
+	while(ret > 0 && bench_export_running())
+		nanosleep(&ts, NULL);
+	bench_add(&st, bench_now() - t, ret);
+	printf("%-16s %9zu MB %9.0f MB/s\n", "export/tar", io_mb, io_mb / ((bench_now() - t) / 1e9));
+	bench_end(&st);
+
+	for(i = 0; i < io_mb; i++) {
+		sprintf(path, "/export/f%zu.dat", i);
+		oper->unlink(path);
+	}
+	oper->rmdir("/export");
+}
+
+/* 이름 바꾸기 반복 - 조직화 on이면 확장자가 바뀌어 타입 링크가 옮겨진다 */
+static void bench_rename(int org)
+{
+	BSTAT st;
+	char dir[32], from[PATH_MAX], to[PATH_MAX];
+	size_t i;
+
+	sprintf(dir, "/wide_%s", org? "org" : "plain");
+	bench_begin(&st, org? "rename/org" : "rename/plain", nfiles * 2);
+	for(i = 0; i < nfiles; i++) {
+		bench_name(from, dir, i, org, "txt");
+		if(org)
+			bench_name(to, dir, i, org, "dat");
+		else
+			sprintf(to, "%s/g%zu", dir, i);
+		BENCH_OP(&st, oper->rename(from, to, 0));
+		BENCH_OP(&st, oper->rename(to, from, 0));
+	}
+	bench_end(&st);
+}
+
+static void bench_unlink(int org)
+{
+	BSTAT st;
+	char dir[32], path[PATH_MAX];
+	size_t i;
+
+	sprintf(dir, "/wide_%s", org? "org" : "plain");
+	bench_begin(&st, org? "unlink/org" : "unlink/plain", nfiles);
+	for(i = 0; i < nfiles; i++) {
+		bench_name(path, dir, i, org, "txt");
+		BENCH_OP(&st, oper->unlink(path));
+	}
+	bench_end(&st);
+}
+
+/* 하위 디렉토리마다 1000개씩 파일 nfiles개가 들어 있는 트리 */
+static void bench_tree(const char *top)
+{
+	char path[PATH_MAX];
+	size_t i;
+
+	oper->mkdir(top, 0755);
+	for(i = 0; i < nfiles; i++) {
+		if(i % 1000 == 0) {
+			sprintf(path, "%s/d%zu", top, i / 1000);
+			oper->mkdir(path, 0755);
+		}
+		sprintf(path, "%s/d%zu/f%zu.txt", top, i / 1000, i);
+		oper->mknod(path, S_IFREG | 0644, 0);
+		oper->write(path, iobuf, (block < 4096)? block : 4096, 0, NULL);
+	}
+}
+
+static uint64_t bench_inodes(void)
+{
+	struct statvfs sv;
+
+	if(oper->statfs("/", &sv) != 0)
+		return 0;
+	return sv.f_files - sv.f_ffree;
+}
+
+/* 재귀 unlink/rmdir와 OFS_IOC_RMTREE 비교, 정리 스레드가 노드 수를 되돌릴 때까지도 잰다 */
+static void bench_rmtree(void)
+{
+	BSTAT st;
+	struct fuse_file_info fi;
+	struct timespec ts = { 0, 100000 };
+	char path[PATH_MAX];
+	size_t i, d;
+	uint64_t base = bench_inodes(), t;
+	int ret;
+
+	bench_tree("/rm_posix");
+	bench_begin(&st, "rmtree/posix", nfiles + nfiles / 1000 + 2);
+	for(d = 0; d * 1000 < nfiles; d++) {
+		for(i = d * 1000; i < nfiles && i < (d + 1) * 1000; i++) {
+			sprintf(path, "/rm_posix/d%zu/f%zu.txt", d, i);
+			BENCH_OP(&st, oper->unlink(path));
+		}
+		sprintf(path, "/rm_posix/d%zu", d);
+		BENCH_OP(&st, oper->rmdir(path));
+	}
+	BENCH_OP(&st, oper->rmdir("/rm_posix"));
+	bench_end(&st);
+
+	bench_tree("/rm_ioctl");
+	memset(&fi, 0, sizeof(fi));
+	bench_begin(&st, "rmtree/ioctl", 1);
+	t = bench_now();
+	BENCH_OP(&st, oper->ioctl("/rm_ioctl", OFS_IOC_RMTREE, NULL, &fi, 0, NULL));
+	bench_end(&st);
+	bench_begin(&st, "rmtree/reap", 1);
+	ret = 0;
+	while(bench_inodes() > base && bench_now() - t < 60000000000ULL)
+		nanosleep(&ts, NULL);
+	if(bench_inodes() > base)
+		ret = -1;
+	bench_add(&st, bench_now() - t, ret);
+	bench_end(&st);
+}
+
+/* 파일마다 rename과 OFS_IOC_MOVE 비교 */
+static void bench_move(void)
+{
+	BSTAT st;
+	struct fuse_file_info fi;
+	struct ofs_move_arg arg;
+	char from[PATH_MAX], to[PATH_MAX];
+	size_t i;
+
+	oper->mkdir("/mv_src", 0755);
+	oper->mkdir("/mv_dst", 0755);
+	for(i = 0; i < nfiles; i++) {
+		sprintf(from, "/mv_src/f%zu.txt", i);
+		oper->mknod(from, S_IFREG | 0644, 0);
+	}
+	bench_begin(&st, "move/rename", nfiles);
+	for(i = 0; i < nfiles; i++) {
+		sprintf(from, "/mv_src/f%zu.txt", i);
+		sprintf(to, "/mv_dst/f%zu.txt", i);
+		BENCH_OP(&st, oper->rename(from, to, 0));
+	}
+	bench_end(&st);
+
+	memset(&fi, 0, sizeof(fi));
+	strcpy(arg.dst, "/mv_src");
+	bench_begin(&st, "move/ioctl", 1);
+	BENCH_OP(&st, oper->ioctl("/mv_dst", OFS_IOC_MOVE, NULL, &fi, 0, &arg));
+	bench_end(&st);
+
+	/* 루트로 옮기면 타입 링크는 루트의 타입 디렉토리("/_txt")로 간다 */
+	strcpy(arg.dst, "/");
+	bench_begin(&st, "move/root", 1);
+	BENCH_OP(&st, oper->ioctl("/mv_src", OFS_IOC_MOVE, NULL, &fi, 0, &arg));
+	bench_end(&st);
+	for(i = 0; i < nfiles; i++) {
+		sprintf(from, "/f%zu.txt", i);
+		oper->unlink(from);
+	}
+
+	oper->rmdir("/mv_src");
+	oper->rmdir("/mv_dst");
+}
+
+/* 작은 파일 만들기 - 파일마다 mknod+write와 OFS_IOC_BATCH 비교, 둘 다 타입 링크가 생기는 이름 */
+#define BENCH_BATCH_DATA	100
+
+static int bench_mkwrite(const char *path, size_t size)
+{
+	int ret;
+
+	if((ret = oper->mknod(path, S_IFREG | 0644, 0)) != 0)
+		return ret;
+	return oper->write(path, iobuf, size, 0, NULL);
+}
+
+static void bench_batch(void)
+{
+	BSTAT st;
+	struct fuse_file_info fi;
+	struct ofs_batch_arg *arg = (struct ofs_batch_arg*)malloc(sizeof(struct ofs_batch_arg));
+	struct ofs_batch_ent ent;
+	char path[PATH_MAX], name[32];
+	size_t i, size = (block < BENCH_BATCH_DATA)? block : BENCH_BATCH_DATA;
+	uint64_t t;
+
+	oper->mkdir("/batch_posix", 0755);
+	bench_begin(&st, "batch/posix", nfiles);
+	for(i = 0; i < nfiles; i++) {
+		sprintf(path, "/batch_posix/f%zu.txt", i);
+		BENCH_OP(&st, bench_mkwrite(path, size));
+	}
+	bench_end(&st);
+
+	/* 인자가 가득 찰 때마다 한번 호출한다 */
+	oper->mkdir("/batch_ioctl", 0755);
+	memset(&fi, 0, sizeof(fi));
+	arg->count = arg->len = 0;
+	bench_begin(&st, "batch/ioctl", nfiles / 100 + 1);
+	t = bench_now();
+	for(i = 0; i <= nfiles; i++) {
+		if(i < nfiles)
+			sprintf(name, "f%zu.txt", i);
+		if(arg->count > 0 && (i == nfiles || arg->len + sizeof(ent) + strlen(name) + size > OFS_BATCH_SIZE)) {
+			BENCH_OP(&st, oper->ioctl("/batch_ioctl", OFS_IOC_BATCH, NULL, &fi, 0, arg));
+			arg->count = arg->len = 0;
+		}
+		if(i == nfiles)
+			break;
+		ent.mode = 0644;
+		ent.size = size;
+		ent.namelen = strlen(name);
+		memcpy(arg->buf + arg->len, &ent, sizeof(ent));
+		memcpy(arg->buf + arg->len + sizeof(ent), name, ent.namelen);
+		memcpy(arg->buf + arg->len + sizeof(ent) + ent.namelen, iobuf, size);
+		arg->len += sizeof(ent) + ent.namelen + size;
+		arg->count++;
+	}
+	t = bench_now() - t;
+	bench_end(&st);
+	printf("%-16s %9zu %12.0f\n", "batch/files", nfiles, nfiles / (t / 1e9));
+
+	oper->ioctl("/batch_posix", OFS_IOC_RMTREE, NULL, &fi, 0, NULL);
+	oper->ioctl("/batch_ioctl", OFS_IOC_RMTREE, NULL, &fi, 0, NULL);
+	free(arg);
+}
+
+/* 태그로 찾기 - /_tag/<값> 읽기와 getxattr로 모든 파일을 훑는 것 비교 (-o tags) */
+static void bench_tag(void)
+{
+	BSTAT st;
+	struct stat stbuf;
+	char path[PATH_MAX], value[32];
+	size_t i, found;
+	uint64_t t;
+
+	if(oper->getattr("/_tag", &stbuf, NULL) != 0) {
+		printf("%-16s needs -o tags\n", "tag");
+		return;
+	}
+	oper->mkdir("/tagged", 0755);
+	bench_begin(&st, "tag/set", nfiles);
+	for(i = 0; i < nfiles; i++) {
+		sprintf(path, "/tagged/f%zu", i);
+		oper->mknod(path, S_IFREG | 0644, 0);
+		sprintf(value, "v%zu", i % 100);
+		BENCH_OP(&st, oper->setxattr(path, "user.tag.project", value, strlen(value), 0));
+	}
+	bench_end(&st);
+
+	bench_begin(&st, "tag/scan", 1);				// 한번의 측정이 전체 훑기
+	found = 0;
+	t = bench_now();
+	for(i = 0; i < nfiles; i++) {
+		sprintf(path, "/tagged/f%zu", i);
+		if(oper->getxattr(path, "user.tag.project", value, sizeof(value)) == 2 && memcmp(value, "v7", 2) == 0)
+			found++;
+	}
+	bench_add(&st, bench_now() - t, (found == (nfiles + 92) / 100)? 0 : -1);
+	bench_end(&st);
+
+	bench_begin(&st, "tag/view", 100);
+	for(i = 0; i < 100; i++) {
+		found = 0;
+		BENCH_OP(&st, oper->readdir("/_tag/v7", &found, bench_filler, 0, NULL, 0));
+	}
+	bench_end(&st);
+	printf("%-16s %9zu entries\n", "tag/view", found - 2);
+
+	for(i = 0; i < nfiles; i++) {
+		sprintf(path, "/tagged/f%zu", i);
+		oper->unlink(path);
+	}
+	oper->rmdir("/tagged");
+}
+
+/* 연산별 통계를 가상 파일(/.ofs/stats)에서 읽어 출력한다 */
+static void bench_stats(void)
+{
+	struct fuse_file_info fi;
+	char buf[4096];
+	off_t off = 0;
+	int n;
+
+	memset(&fi, 0, sizeof(fi));
+	fi.flags = O_RDONLY;
+	if(oper->open("/.ofs/stats", &fi) != 0)
+		return;
+	while((n = oper->read("/.ofs/stats", buf, sizeof(buf), off, &fi)) > 0) {
+		fwrite(buf, 1, n, stdout);
+		off += n;
+	}
+	oper->release("/.ofs/stats", &fi);
+}
+
+static void bench_usage(const char *prog)
+{
+	fprintf(stderr, "usage: %s [-n files] [-d depth] [-s io_mb] [-b block] [-w workload,...] [-o ofs_options] [-S] [-v]\n"
+		"  workloads: create,stat,readdir,deep,seq,prealloc,append,large,rand,export,rename,unlink,rmtree,move,batch,tag\n", prog);
+}
+
+int main(int argc, char *argv[])
+{
+	char **ofs_argv = (char**)calloc(argc + 3, sizeof(char*));
+	int ofs_argc = 1, opt, verbose = 0, stats = 0, org;
+
+	while((opt = getopt(argc, argv, "n:d:s:b:w:o:Svh")) != -1) {
+		switch(opt) {
+		case 'n': nfiles = strtoul(optarg, NULL, 0); break;
+		case 'd': depth = atoi(optarg); break;
+		case 's': io_mb = strtoul(optarg, NULL, 0); break;
+		case 'b': block = strtoul(optarg, NULL, 0); break;
+		case 'w': workloads = optarg; break;
+		case 'o':
+			ofs_argv[ofs_argc++] = "-o";
+			ofs_argv[ofs_argc++] = optarg;
+			break;
+		case 'S':
+			stats = 1;
+			ofs_argv[ofs_argc++] = "-o";
+			ofs_argv[ofs_argc++] = "stats";
+			break;
+		case 'v': verbose = 1; break;
+		default:
+			bench_usage(argv[0]);
+			return 1;
+		}
+	}
+	if(nfiles == 0 || block == 0) {
+		bench_usage(argv[0]);
+		return 1;
+	}
+	ofs_argv[0] = argv[0];
+	ofs_argv[ofs_argc] = NULL;
+
+	bench_ctx.uid = getuid();
+	bench_ctx.gid = getgid();
+	bench_ctx.pid = getpid();
+	bench_ctx.umask = 022;
+
+	/* 핸들러의 디버그 출력이 측정을 흐리지 않도록 버린다 */
+	if(!verbose && freopen("/dev/null", "w", stderr) != NULL)
+		setvbuf(stderr, NULL, _IOFBF, 1 << 16);
+
+	if((oper = ofs_bench_setup(ofs_argc, ofs_argv)) == NULL) {
+		printf("ofs setup failed\n");
+		return 1;
+	}
+	if(oper->init != NULL) oper->init(NULL, NULL);
+	iobuf = (char*)malloc(block);
+	memset(iobuf, 'o', block);
+	srand(1);
+
+	printf("files %zu, depth %d, io %zu MB in %zu byte blocks\n", nfiles, depth, io_mb, block);
+	printf("%-16s %9s %12s %9s %9s %9s %9s %10s %8s %9s\n",
+		"workload", "ops", "ops/s", "p50_us", "p90_us", "p99_us", "p999_us", "max_us", "errors", "rss_mb");
+	for(org = 1; org >= 0; org--) {
+		if(bench_selected("create")) bench_create(org);
+		if(bench_selected("stat")) bench_stat(org);
+		if(bench_selected("readdir")) bench_readdir(org);
+		if(bench_selected("rename")) bench_rename(org);
+		if(bench_selected("unlink")) bench_unlink(org);
+	}
+	if(bench_selected("deep")) bench_deep();
+	if(bench_selected("seq")) bench_io(1);
+	if(bench_selected("prealloc")) bench_prealloc();
+	if(bench_selected("append") && block >= 512) bench_append();
+	if(bench_selected("large")) bench_large();
+	if(bench_selected("rand")) bench_io(0);
+	if(bench_selected("export")) bench_export();
+	if(bench_selected("rmtree")) bench_rmtree();
+	if(bench_selected("move")) bench_move();
+	if(bench_selected("batch")) bench_batch();
+	if(bench_selected("tag")) bench_tag();
+	printf("peak rss %.1f MB\n", bench_rss() / 1024.0);
+	if(stats) bench_stats();
+
+	if(oper->destroy != NULL) oper->destroy(NULL);
+	free(iobuf);
+	free(ofs_argv);
+	return 0;
+}
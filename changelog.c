@@ -0,0 +1,192 @@
+﻿#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+#include <pthread.h>
+#include "changelog.h"
+#include "journal.h"
+
+/* 변경 레코드, 종류와 인자는 저널 레코드(OJ_*)와 같다 */
+typedef struct _OCREC {
+	uint64_t		seq;
+	struct timespec	time;
+	int			type;
+	uint64_t		arg[3];
+	size_t		len;					// 쓰기 길이
+	char			*path;
+	char			*path2;
+} OCREC;
+
+static OCREC 			*ring;
+static size_t 			cap;
+static uint64_t 		first = 1, last;			// 남아 있는 레코드의 일련 번호 범위, first > last면 비어 있음
+static pthread_mutex_t	cllock = PTHREAD_MUTEX_INITIALIZER;
+
+static const char *type_names[] = {
+	"-", "mknod", "mkdir", "unlink", "rmdir", "symlink", "link", "rename", "write",
+	"truncate", "chmod", "chown", "utime", "clone", "fallocate", "rmtree", "move",
+	"setxattr", "removexattr", "batch"
+};
+#define OC_NTYPES	(sizeof(type_names) / sizeof(type_names[0]))
+
+void ofs_changelog_init(size_t records)
+{
+	struct timespec now;
+
+	cap = records;
+	if(cap == 0)
+		return;
+	ring = (OCREC*)calloc(cap, sizeof(OCREC));
+	/* 다시 마운트해도 번호가 줄지 않도록 현재 시각(ns)에서 시작한다, 이전 커서는 lost를 받는다 */
+	clock_gettime(CLOCK_REALTIME, &now);
+	last = (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+	first = last + 1;
+}
+
+int ofs_changelog_enabled(void)
+{
+	return cap > 0;
+}
+
+uint64_t ofs_changelog_add(int type, const char *path, const char *path2,
+	uint64_t arg0, uint64_t arg1, uint64_t arg2, size_t len)
+{
+	OCREC *r;
+	uint64_t seq;
+
+	if(cap == 0)
+		return 0;
+	pthread_mutex_lock(&cllock);
+	seq = ++last;
+	r = &ring[seq % cap];
+	if(r->seq != 0) {								// 가장 오래된 레코드를 덮어쓴다
+		free(r->path);
+		free(r->path2);
+	}
+	if(seq - first >= cap)
+		first = seq - cap + 1;
+	r->seq = seq;
+	clock_gettime(CLOCK_REALTIME, &r->time);
+	r->type = type;
+	r->arg[0] = arg0;
+	r->arg[1] = arg1;
+	r->arg[2] = arg2;
+	r->len = len;
+	r->path = strdup(path);
+	r->path2 = (path2 != NULL)? strdup(path2) : NULL;
+	pthread_mutex_unlock(&cllock);
+	return seq;
+}
+
+/* 경로의 탭, 줄바꿈, '\'를 이스케이프해서 붙인다 */
+static size_t oc_escape(char *out, const char *path)
+{
+	size_t n = 0;
+
+	for(; *path != '\0'; path++) {
+		if(*path == '\t' || *path == '\n' || *path == '\\') {
+			out[n++] = '\\';
+			out[n++] = (*path == '\t')? 't' : (*path == '\n')? 'n' : '\\';
+		} else {
+			out[n++] = *path;
+		}
+	}
+	out[n] = '\0';
+	return n;
+}
+
+/* 레코드 한 줄 : 번호, 시각, 연산, 경로, 두번째 경로(없으면 -), 인자 */
+static size_t oc_format(char *line, size_t size, const OCREC *r)
+{
+	char path[PATH_MAX * 2 + 1], path2[PATH_MAX * 2 + 1], info[96];
+	unsigned long long a0 = r->arg[0], a1 = r->arg[1], a2 = r->arg[2];
+
+	oc_escape(path, r->path);
+	if(r->path2 != NULL)
+		oc_escape(path2, r->path2);
+	else
+		strcpy(path2, "-");
+	switch(r->type) {
+	case OJ_MKNOD:
+	case OJ_MKDIR:
+	case OJ_CHMOD:		snprintf(info, sizeof(info), "mode=%llo", a0); break;
+	case OJ_WRITE:		snprintf(info, sizeof(info), "off=%llu len=%zu", a0, r->len); break;
+	case OJ_TRUNCATE:	snprintf(info, sizeof(info), "size=%llu", a0); break;
+	case OJ_CHOWN:		snprintf(info, sizeof(info), "uid=%llu gid=%llu", a0, a1); break;
+	case OJ_UTIME:		snprintf(info, sizeof(info), "atime=%llu.%09llu mtime=%llu.%09llu", a0, a2 >> 32, a1, a2 & 0xffffffffULL); break;
+	case OJ_CLONE:		snprintf(info, sizeof(info), "off=%llu dst_off=%llu len=%lld", a0, a1, (long long)a2); break;
+	case OJ_FALLOCATE:	snprintf(info, sizeof(info), "mode=%llu off=%llu len=%llu", a0, a1, a2); break;
+	case OJ_SETXATTR:	snprintf(info, sizeof(info), "flags=%llu len=%zu", a0, r->len); break;
+	case OJ_BATCH:		snprintf(info, sizeof(info), "count=%llu len=%zu", a0, r->len); break;
+	default:			strcpy(info, "-"); break;
+	}
+	return snprintf(line, size, "%llu\t%lld.%09ld\t%s\t%s\t%s\t%s\n", (unsigned long long)r->seq,
+		(long long)r->time.tv_sec, r->time.tv_nsec,
+		((size_t)r->type < OC_NTYPES)? type_names[r->type] : "-", path, path2, info);
+}
+
+size_t ofs_changelog_read(uint64_t *cursor, char *buf, size_t size)
+{
+	char *line;
+	struct timespec now;
+	size_t done = 0, n, lsize = PATH_MAX * 4 + 256;
+	uint64_t seq;
+
+	if(cap == 0 || size == 0 || (line = (char*)malloc(lsize)) == NULL)
+		return 0;
+	pthread_mutex_lock(&cllock);
+	if(*cursor + 1 < first) {						// 커서 이후의 레코드가 일부 버려졌다, 다시 훑어야 한다
+		clock_gettime(CLOCK_REALTIME, &now);
+		n = snprintf(line, lsize, "%llu\t%lld.%09ld\tlost\t/\t-\tfrom=%llu to=%llu\n",
+			(unsigned long long)(first - 1), (long long)now.tv_sec, now.tv_nsec,
+			(unsigned long long)(*cursor + 1), (unsigned long long)(first - 1));
+		if(n > size) n = size;
+		memcpy(buf, line, n);
+		done = n;
+		*cursor = first - 1;
+	}
+	for(seq = *cursor + 1; seq <= last && done < size; seq++) {
+		n = oc_format(line, lsize, &ring[seq % cap]);
+		if(n >= lsize) n = lsize - 1;
+		if(done + n > size) {
+			if(done > 0)							// 다음 읽기에서 이어서
+				break;
+			n = size;								// 한 줄도 들어가지 않으면 잘라서 넘긴다
+			line[n - 1] = '\n';
+		}
+		memcpy(buf + done, line, n);
+		done += n;
+		*cursor = seq;
+	}
+	pthread_mutex_unlock(&cllock);
+	free(line);
+	return done;
+}
+
+int ofs_changelog_ready(uint64_t cursor)
+{
+	int ret;
+
+	pthread_mutex_lock(&cllock);
+	ret = (cap > 0 && cursor < last);
+	pthread_mutex_unlock(&cllock);
+	return ret;
+}
+
+uint64_t ofs_changelog_last(void)
+{
+	uint64_t seq;
+
+	pthread_mutex_lock(&cllock);
+	seq = last;
+	pthread_mutex_unlock(&cllock);
+	return seq;
+}
+
+void ofs_changelog_reset(void)
+{
+	pthread_mutex_lock(&cllock);
+	first = last + 1;
+	pthread_mutex_unlock(&cllock);
+}
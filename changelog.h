@@ -0,0 +1,63 @@
+﻿#ifndef __CHANGELOG_H
+#define __CHANGELOG_H
+#include <sys/types.h>
+#include <stdint.h>
+
+/*######################################
+ 이름 : ofs_changelog_init
+ 요약 : 변경 기록을 남길 레코드 수 설정, 0이면 남기지 않는다
+ 매개변수 : size_t [RECORDS]
+ 반환값 : 없음
+ #######################################*/
+void 		ofs_changelog_init	(size_t);
+
+/*######################################
+ 이름 : ofs_changelog_enabled
+ 요약 : 변경 기록 사용 여부
+ 매개변수 : 없음
+ 반환값 : 사용중이면 1, 아니면 0
+ #######################################*/
+int 		ofs_changelog_enabled	(void);
+
+/*######################################
+ 이름 : ofs_changelog_add
+ 요약 : 성공한 변경 연산 하나를 기록, 가득 차면 가장 오래된 레코드를 버린다
+ 매개변수 : int [TYPE(OJ_*)], const char* [PATH], const char* [PATH2], uint64_t [ARG0], uint64_t [ARG1], uint64_t [ARG2], size_t [LEN]
+ 반환값 : 부여된 일련 번호, 사용하지 않으면 0
+ #######################################*/
+uint64_t	ofs_changelog_add	(int, const char*, const char*, uint64_t, uint64_t, uint64_t, size_t);
+
+/*######################################
+ 이름 : ofs_changelog_read
+ 요약 : CURSOR 이후의 레코드를 한 줄씩 글로 만들고 CURSOR를 마지막 줄의 번호로 옮긴다
+ 		버려진 레코드가 있으면 먼저 lost 줄을 넣는다, 줄 중간에서 자르지 않는다
+ 매개변수 : uint64_t* [CURSOR], char* [BUF], size_t [SIZE]
+ 반환값 : 채운 바이트 수
+ #######################################*/
+size_t 	ofs_changelog_read	(uint64_t*, char*, size_t);
+
+/*######################################
+ 이름 : ofs_changelog_ready
+ 요약 : CURSOR 이후에 읽을 레코드가 있는지 (poll)
+ 매개변수 : uint64_t [CURSOR]
+ 반환값 : 있으면 1, 없으면 0
+ #######################################*/
+int 		ofs_changelog_ready	(uint64_t);
+
+/*######################################
+ 이름 : ofs_changelog_last
+ 요약 : 마지막으로 부여한 일련 번호
+ 매개변수 : 없음
+ 반환값 : 일련 번호, 기록이 없으면 0
+ #######################################*/
+uint64_t	ofs_changelog_last	(void);
+
+/*######################################
+ 이름 : ofs_changelog_reset
+ 요약 : 남아 있는 레코드를 버린다, 일련 번호는 이어서 부여한다
+ 매개변수 : 없음
+ 반환값 : 없음
+ #######################################*/
+void 		ofs_changelog_reset	(void);
+
+#endif
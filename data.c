@@ -0,0 +1,1546 @@
+﻿#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include <zlib.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#include <wmmintrin.h>
+#endif
+#include "data.h"
+#include "stats.h"
+#include "trace.h"
+
+#define OFS_RA_CHUNKS		8						// 순차 읽기시 미리 읽을 청크 수
+#define OFS_RA_QUEUE		256
+#define OFS_ZIP_MIN		4096						// 이보다 작은 청크는 압축하지 않는다
+#define OFS_ZIP_BATCH		256						// 한번의 검사에서 압축할 최대 청크 수
+#define OFS_CRC_POLY		0x82f63b78u				// CRC32C (Castagnoli), 비트 반전 표현
+#define OFS_CRC_LANE		512						// SSE4.2 경로에서 세 갈래로 나눠 계산하는 길이
+#define OFS_SCRUB_TICK		100						// 스크러버가 깨어나는 주기(ms)
+#define OFS_HUGE_PAGE		(2UL << 20)				// 투명 큰 페이지 크기, 매핑을 이 경계에 맞춘다
+#define OFS_HUGE_SLOTS		512						// 매핑 하나에 들어가는 청크 수 (32MB)
+#define OFS_HUGE_LEN		((size_t)OFS_HUGE_SLOTS << OFS_CHUNK_SHIFT)
+
+/* 큰 파일의 청크 버퍼를 담는 익명 매핑, 파일 위치 순서대로 청크 자리가 정해진다 */
+typedef struct _OHUGE {
+	char				*base;
+	ODATA			*owner;		// 매핑을 늘려가는 파일, 파일이 해제되면 NULL
+	size_t			idx;			// owner->hmap에서의 위치
+	uint32_t			live;		// 매핑 안에 버퍼가 있는 청크 수, 0이 되면 해제
+	uint64_t			used[OFS_HUGE_SLOTS / 64];	// 사용중인 청크 자리
+} OHUGE;
+
+static int 			spill_fd = -1;					// 보조 파일, -1이면 내보내지 않는다
+static int 			managed;						// 내보내기나 압축을 위해 청크를 추적
+static int 			zlevel;							// 압축 레벨, 0이면 압축하지 않는다
+static int 			zage;							// 압축할 때까지 참조되지 않아야 하는 검사 횟수(초)
+static size_t 		cache_max, cache_bytes;			// 풀린 사본 캐시 한도와 사용량
+static OCHUNK 		*chead, *ctail;					// 풀린 사본 LRU (앞쪽이 최근)
+static int 			dedup;							// 중복 제거 사용 여부
+static OCHUNK 		**htab;							// 내용 해시 -> 청크 색인
+static size_t 		hsize, hcount;
+static uint64_t 		dd_hits, dd_saved, dd_hashed, dd_ns;	// 중복 제거 통계
+static uint64_t 		cl_shared, cl_copied;				// 파일 복제에서 공유/복사한 바이트
+static int 			csum;							// 청크 체크섬 사용 여부
+static uint32_t 		csum_every;						// 청크 읽기 몇 번에 한번 검사할지, 0이면 검사 안함
+static uint32_t 		csum_tick;						// 읽기 표본 카운터 (잠금 없이 더한다)
+static uint64_t 		cs_verified, cs_vbad, cs_scrubbed, cs_sbad, cs_passes;	// 체크섬 통계
+static size_t 		scrub_rate;						// 스크러버가 초당 검사할 바이트, 0이면 쓰지 않음
+static ODATA 		*dhead;							// 전체 데이터 목록 (스크러버용)
+static ODATA 		*scrub_d;						// 스크러버가 검사 중인 데이터와 청크 위치
+static size_t 		scrub_i;
+static pthread_t 		scrub_thread;
+static int 			scrub_running, scrub_stop;
+static pthread_cond_t	scrub_wake = PTHREAD_COND_INITIALIZER;
+static size_t 		huge_min;						// 이 크기를 넘는 파일은 큰 페이지 매핑에 둔다, 0이면 쓰지 않는다
+static size_t 		budget;							// 메모리에 둘 청크 바이트 한도
+static size_t 		resident;						// 메모리에 있는 청크 바이트
+static size_t 		nresident;						// CLOCK 목록의 청크 수
+static OCHUNK 		*hand;							// CLOCK 바늘
+static off_t 			spill_end;						// 보조 파일에서 사용한 끝 위치
+static off_t 			*free_slot;						// 해제된 보조 파일 위치
+static size_t 		nfree, free_cap;
+static OCHUNK 		*raq[OFS_RA_QUEUE];				// 미리 읽기 요청 큐
+static size_t 		ra_head, ra_cnt;
+static pthread_t 		io_thread;
+static int 			io_running, io_stop;
+static pthread_mutex_t	dlock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t	dwait = PTHREAD_COND_INITIALIZER;		// 청크 상태 변화 알림
+static pthread_cond_t	dwork = PTHREAD_COND_INITIALIZER;		// 비동기 스레드 깨우기
+
+/* CLOCK 목록 관리 (dlock 안에서 호출) */
+static void oc_list_add(OCHUNK *c)
+{
+	if(hand == NULL) {
+		c->prev = c->next = c;
+		hand = c;
+	} else {										// 바늘 바로 앞(가장 늦게 검사될 위치)에 넣는다
+		c->next = hand;
+		c->prev = hand->prev;
+		hand->prev->next = c;
+		hand->prev = c;
+	}
+	nresident++;
+}
+
+static void oc_list_del(OCHUNK *c)
+{
+	if(c->next == c) {
+		hand = NULL;
+	} else {
+		if(hand == c) hand = c->next;
+		c->prev->next = c->next;
+		c->next->prev = c->prev;
+	}
+	c->prev = c->next = NULL;
+	nresident--;
+}
+
+static off_t oc_slot_alloc(void)
+{
+	off_t slot;
+	if(nfree > 0) return free_slot[--nfree];
+	slot = spill_end;
+	spill_end += OFS_CHUNK_SIZE;
+	return slot;
+}
+
+static void oc_slot_free(off_t slot)
+{
+	if(nfree == free_cap) {
+		free_cap = (free_cap == 0)? 64 : free_cap * 2;
+		free_slot = (off_t*)realloc(free_slot, sizeof(off_t) * free_cap);
+	}
+	free_slot[nfree++] = slot;
+}
+
+/* 64비트 내용 해시 (XXH64) */
+#define XP1	11400714785074694791ULL
+#define XP2	14029467366897019727ULL
+#define XP3	1609587929392839161ULL
+#define XP4	9650029242287828579ULL
+#define XP5	2870177450012600261ULL
+#define XROTL(x, r)	(((x) << (r)) | ((x) >> (64 - (r))))
+
+static uint64_t oc_xround(uint64_t acc, uint64_t in)
+{
+	acc += in * XP2;
+	acc = XROTL(acc, 31);
+	return acc * XP1;
+}
+
+static uint64_t oc_xmerge(uint64_t acc, uint64_t val)
+{
+	acc ^= oc_xround(0, val);
+	return acc * XP1 + XP4;
+}
+
+static uint64_t oc_hash(const char *p, size_t len)
+{
+	const char *end = p + len;
+	uint64_t h, v1, v2, v3, v4, k;
+	uint32_t k32;
+
+	if(len >= 32) {
+		v1 = XP1 + XP2;
+		v2 = XP2;
+		v3 = 0;
+		v4 = -XP1;
+		do {
+			memcpy(&k, p, 8); v1 = oc_xround(v1, k);
+			memcpy(&k, p + 8, 8); v2 = oc_xround(v2, k);
+			memcpy(&k, p + 16, 8); v3 = oc_xround(v3, k);
+			memcpy(&k, p + 24, 8); v4 = oc_xround(v4, k);
+			p += 32;
+		} while(p + 32 <= end);
+		h = XROTL(v1, 1) + XROTL(v2, 7) + XROTL(v3, 12) + XROTL(v4, 18);
+		h = oc_xmerge(h, v1);
+		h = oc_xmerge(h, v2);
+		h = oc_xmerge(h, v3);
+		h = oc_xmerge(h, v4);
+	} else {
+		h = XP5;
+	}
+	h += len;
+	for(; p + 8 <= end; p += 8) {
+		memcpy(&k, p, 8);
+		h ^= oc_xround(0, k);
+		h = XROTL(h, 27) * XP1 + XP4;
+	}
+	if(p + 4 <= end) {
+		memcpy(&k32, p, 4);
+		h ^= (uint64_t)k32 * XP1;
+		h = XROTL(h, 23) * XP2 + XP3;
+		p += 4;
+	}
+	for(; p < end; p++) {
+		h ^= (uint64_t)(unsigned char)*p * XP5;
+		h = XROTL(h, 11) * XP1;
+	}
+	h ^= h >> 33;
+	h *= XP2;
+	h ^= h >> 29;
+	h *= XP3;
+	h ^= h >> 32;
+	return h;
+}
+
+/*
+ * CRC32C
+ * 값은 표준 CRC32C와 같고 이어서 계산할 수 있다: oc_crc(oc_crc(0, A), B) == oc_crc(0, A+B)
+ * SSE4.2가 있으면 crc32 명령으로 세 갈래를 동시에 계산하고 PCLMUL로 합친다.
+ */
+static uint32_t crc_tab[8][256];						// 한번에 8바이트씩 계산하는 표
+static uint32_t crc_k1, crc_k2;							// 레인 하나, 둘만큼 미는 상수 (PCLMUL용)
+
+static uint32_t oc_crc_sw(uint32_t crc, const char *p, size_t n)
+{
+	const unsigned char *s = (const unsigned char*)p;
+	uint32_t r = ~crc;
+
+	for(; n >= 8; n -= 8, s += 8) {
+		r ^= (uint32_t)s[0] | (uint32_t)s[1] << 8 | (uint32_t)s[2] << 16 | (uint32_t)s[3] << 24;
+		r = crc_tab[7][r & 0xff] ^ crc_tab[6][(r >> 8) & 0xff] ^ crc_tab[5][(r >> 16) & 0xff] ^ crc_tab[4][r >> 24]
+			^ crc_tab[3][s[4]] ^ crc_tab[2][s[5]] ^ crc_tab[1][s[6]] ^ crc_tab[0][s[7]];
+	}
+	for(; n > 0; n--, s++)
+		r = crc_tab[0][(r ^ *s) & 0xff] ^ (r >> 8);
+	return ~r;
+}
+
+static uint32_t (*oc_crc)(uint32_t, const char*, size_t) = oc_crc_sw;
+
+/* 비트 반전 표현의 다항식 곱 (mod CRC 다항식) */
+static uint32_t oc_crc_mul(uint32_t a, uint32_t b)
+{
+	uint32_t m = 1u << 31, p = 0;
+
+	for(;;) {
+		if(a & m) {
+			p ^= b;
+			if((a & (m - 1)) == 0) break;
+		}
+		m >>= 1;
+		b = (b & 1)? (b >> 1) ^ OFS_CRC_POLY : b >> 1;
+	}
+	return p;
+}
+
+/* x^N (mod CRC 다항식) */
+static uint32_t oc_crc_xpow(size_t n)
+{
+	uint32_t p = 1u << 31, x = 1u << 30;				// 1과 x
+
+	for(; n > 0; n >>= 1) {
+		if(n & 1) p = oc_crc_mul(x, p);
+		x = oc_crc_mul(x, x);
+	}
+	return p;
+}
+
+#if defined(__x86_64__)
+/* 레지스터 값 R을 상수 K만큼 민다, K = x^(8*바이트-33) */
+__attribute__((target("sse4.2,pclmul")))
+static uint64_t oc_crc_shift(uint64_t r, uint32_t k)
+{
+	__m128i v = _mm_clmulepi64_si128(_mm_cvtsi64_si128((long long)r), _mm_cvtsi32_si128((int)k), 0);
+	return _mm_crc32_u64(0, (uint64_t)_mm_cvtsi128_si64(v));
+}
+
+__attribute__((target("sse4.2,pclmul")))
+static uint32_t oc_crc_hw(uint32_t crc, const char *p, size_t n)
+{
+	uint64_t a = ~crc, b, c, v;
+	size_t i;
+
+	/* crc32 명령은 지연이 3사이클이므로 이어진 세 구간을 따로 계산한 뒤 합친다 */
+	for(; n >= OFS_CRC_LANE * 3; p += OFS_CRC_LANE * 3, n -= OFS_CRC_LANE * 3) {
+		b = c = 0;
+		for(i = 0; i < OFS_CRC_LANE; i += 8) {
+			memcpy(&v, p + i, 8);
+			a = _mm_crc32_u64(a, v);
+			memcpy(&v, p + OFS_CRC_LANE + i, 8);
+			b = _mm_crc32_u64(b, v);
+			memcpy(&v, p + OFS_CRC_LANE * 2 + i, 8);
+			c = _mm_crc32_u64(c, v);
+		}
+		a = oc_crc_shift(a, crc_k2) ^ oc_crc_shift(b, crc_k1) ^ c;
+	}
+	for(; n >= 8; n -= 8, p += 8) {
+		memcpy(&v, p, 8);
+		a = _mm_crc32_u64(a, v);
+	}
+	for(; n > 0; n--, p++)
+		a = _mm_crc32_u8((uint32_t)a, (unsigned char)*p);
+	return ~(uint32_t)a;
+}
+#endif
+
+static void oc_crc_init(void)
+{
+	uint32_t r;
+	int i, j;
+
+	for(i = 0; i < 256; i++) {
+		r = i;
+		for(j = 0; j < 8; j++)
+			r = (r & 1)? (r >> 1) ^ OFS_CRC_POLY : r >> 1;
+		crc_tab[0][i] = r;
+	}
+	for(i = 0; i < 256; i++)
+		for(j = 1; j < 8; j++)
+			crc_tab[j][i] = (crc_tab[j - 1][i] >> 8) ^ crc_tab[0][crc_tab[j - 1][i] & 0xff];
+	crc_k1 = oc_crc_xpow(OFS_CRC_LANE * 8 - 33);
+	crc_k2 = oc_crc_xpow(OFS_CRC_LANE * 16 - 33);
+#if defined(__x86_64__)
+	if(__builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("pclmul"))
+		oc_crc = oc_crc_hw;
+#endif
+}
+
+/* 중복 제거 색인 관리 (dlock 안에서 호출) */
+static void oc_index(OCHUNK *c)
+{
+	OCHUNK **ntab, *e, *next;
+	size_t i, nsize;
+
+	if(hcount + 1 > hsize / 4 * 3) {					// 적재율 3/4를 넘으면 두배로
+		nsize = (hsize == 0)? 1024 : hsize * 2;
+		ntab = (OCHUNK**)calloc(nsize, sizeof(OCHUNK*));
+		for(i = 0; i < hsize; i++) {
+			for(e = htab[i]; e != NULL; e = next) {
+				next = e->hnext;
+				e->hnext = ntab[e->hash & (nsize - 1)];
+				ntab[e->hash & (nsize - 1)] = e;
+			}
+		}
+		free(htab);
+		htab = ntab;
+		hsize = nsize;
+	}
+	c->hnext = htab[c->hash & (hsize - 1)];
+	htab[c->hash & (hsize - 1)] = c;
+	c->indexed = 1;
+	hcount++;
+}
+
+static void oc_unindex(OCHUNK *c)
+{
+	OCHUNK **pp;
+
+	if(!c->indexed) return;
+	for(pp = &htab[c->hash & (hsize - 1)]; *pp != NULL; pp = &(*pp)->hnext) {
+		if(*pp == c) {
+			*pp = c->hnext;
+			break;
+		}
+	}
+	c->hnext = NULL;
+	c->indexed = 0;
+	hcount--;
+}
+
+/* 풀린 사본 캐시 관리 (dlock 안에서 호출) */
+static void oc_cache_del(OCHUNK *c)
+{
+	if(c->cprev != NULL) c->cprev->cnext = c->cnext; else chead = c->cnext;
+	if(c->cnext != NULL) c->cnext->cprev = c->cprev; else ctail = c->cprev;
+	c->cprev = c->cnext = NULL;
+}
+
+static void oc_cache_drop(OCHUNK *c)
+{
+	if(c->plain == NULL) return;
+	oc_cache_del(c);
+	free(c->plain);
+	c->plain = NULL;
+	cache_bytes -= c->plen;
+}
+
+static void oc_cache_add(OCHUNK *c)
+{
+	OCHUNK *v, *prev;
+
+	c->cprev = NULL;
+	c->cnext = chead;
+	if(chead != NULL) chead->cprev = c; else ctail = c;
+	chead = c;
+	cache_bytes += c->plen;
+
+	for(v = ctail; v != NULL && cache_bytes > cache_max; v = prev) {
+		prev = v->cprev;
+		if(v->pin == 0) oc_cache_drop(v);				// 읽는 중인 사본은 남긴다
+	}
+}
+
+/* 청크가 매핑의 자리를 돌려준다, 빈 매핑은 통째로 해제해 메모리를 OS에 돌려준다 (dlock 안에서 호출) */
+static void oh_put(OCHUNK *c)
+{
+	OHUGE *h = c->hmap;
+	size_t s = (size_t)(c->buf - h->base) >> OFS_CHUNK_SHIFT;
+
+	h->used[s / 64] &= ~(1ULL << (s % 64));
+	c->hmap = NULL;
+	if(--h->live > 0) {
+		madvise(c->buf, OFS_CHUNK_SIZE, MADV_DONTNEED);	// 다시 쓰면 0으로 채워진 페이지가 온다
+		return;
+	}
+	munmap(h->base, OFS_HUGE_LEN);
+	if(h->owner != NULL) h->owner->hmap[h->idx] = NULL;
+	free(h);
+}
+
+/* 청크 버퍼 해제, 매핑 안의 버퍼는 자리만 돌려준다 */
+static void oc_buf_free(OCHUNK *c)
+{
+	if(c->hmap != NULL)
+		oh_put(c);
+	else
+		free(c->buf);
+}
+
+/* 청크 해제 (사용자가 없을 때만) */
+static void oc_release(OCHUNK *c)
+{
+	oc_unindex(c);
+	oc_cache_drop(c);
+	if(c->buf != NULL) {
+		if(c->prev != NULL) oc_list_del(c);
+		oc_buf_free(c);
+		resident -= c->cap;
+	}
+	if(c->slot >= 0) oc_slot_free(c->slot);
+	free(c);
+}
+
+static void oc_put(OCHUNK *c)
+{
+	c->pin--;
+	if(c->dead && c->pin == 0)
+		oc_release(c);
+	else
+		pthread_cond_broadcast(&dwait);
+}
+
+/* 메모리에 있는 청크의 CRC를 계산해 저장된 값과 비교하거나, 덮어써서 비어 있으면 채운다 (dlock 안에서 호출)
+   쓰이고 있는 청크는 건너뛰고 계산하는 동안 바뀌면 결과를 버린다
+   반환값 : 검사했으면 1, 건너뛰었으면 0, 불일치면 -EIO */
+static int oc_sum(OCHUNK *c)
+{
+	uint32_t gen = c->gen, len = c->len, crc;
+	int ok = c->crcok, ret = 0;
+
+	if(c->pin != 0 || c->state != OC_RESIDENT || c->zipped || c->buf == NULL)
+		return 0;
+	c->pin++;
+	pthread_mutex_unlock(&dlock);
+	crc = oc_crc(0, c->buf, len);
+	pthread_mutex_lock(&dlock);
+	if(c->gen == gen && c->pin == 1 && !c->dead && c->len == len) {
+		if(!ok) {
+			c->crc = crc;
+			c->crcok = 1;
+		}
+		ret = (ok && crc != c->crc)? -EIO : 1;
+	}
+	oc_put(c);
+	return ret;
+}
+
+/* 읽는 청크의 체크섬 검사 (pin한 채 dlock 밖에서 호출) */
+static int oc_verify(OCHUNK *c)
+{
+	uint64_t begin = ofs_stats_begin();
+	uint32_t gen, len, want, crc;
+	int ret = 0;
+
+	pthread_mutex_lock(&dlock);
+	gen = c->gen;
+	len = c->len;
+	want = c->crc;
+	if(!c->crcok) {
+		pthread_mutex_unlock(&dlock);
+		return 0;
+	}
+	pthread_mutex_unlock(&dlock);
+	crc = oc_crc(0, c->zipped? c->plain : c->buf, len);
+	pthread_mutex_lock(&dlock);
+	if(c->gen == gen && c->crcok && crc != want) {
+		cs_vbad++;
+		ret = -EIO;
+	}
+	cs_verified++;
+	pthread_mutex_unlock(&dlock);
+	if(ret != 0)
+		OFS_TRACE(OT_ERR, OP_VERIFY, NULL, 0, begin, ret);
+	return ofs_stats_end(OP_VERIFY, begin, ret);
+}
+
+/* dirty 청크를 보조 파일에 기록, 호출자가 pin을 잡고 있어야 한다 */
+static int oc_writeback(OCHUNK *c)
+{
+	ssize_t n;
+	uint32_t len = c->zipped? c->zlen : c->len, gen = c->gen, crc = 0;
+	int sum = csum && !c->crcok && !c->zipped;			// 내보내면 스크러버가 볼 수 없으므로 체크섬을 채운다
+
+	if(c->slot < 0) c->slot = oc_slot_alloc();
+	c->dirty = 0;									// 기록 중 다시 쓰이면 다시 dirty가 된다
+	pthread_mutex_unlock(&dlock);
+	if(sum) crc = oc_crc(0, c->buf, len);
+	n = pwrite(spill_fd, c->buf, len, c->slot);
+	pthread_mutex_lock(&dlock);
+	if(sum && c->gen == gen && c->pin == 1 && c->len == len) {
+		c->crc = crc;
+		c->crcok = 1;
+	}
+	if(n != (ssize_t)len) {
+		c->dirty = 1;
+		return -EIO;
+	}
+	return 0;
+}
+
+/* 한도를 넘지 않도록 차가운 청크를 내보낸다 */
+static void oc_reclaim(size_t need)
+{
+	OCHUNK *c;
+	size_t scans = 0, limit;
+
+	if(spill_fd < 0) return;
+	limit = nresident * 2 + 2;							// 참조 비트를 한번 지우고 다시 도는 만큼
+	while(resident + need > budget && hand != NULL && scans++ < limit) {
+		c = hand;
+		hand = hand->next;
+		if(c->pin != 0 || c->state != OC_RESIDENT) continue;
+		if(c->ref) {
+			c->ref = 0;
+			continue;
+		}
+		if(c->dirty) {
+			c->pin++;
+			oc_writeback(c);
+			if(c->dirty || c->pin > 1 || c->dead) {	// 기록 중 다시 쓰였거나 해제됨
+				oc_put(c);
+				continue;
+			}
+			c->pin--;
+		}
+		oc_list_del(c);
+		oc_cache_drop(c);
+		oc_buf_free(c);								// 다시 읽어올 때는 힙에 둔다
+		c->buf = NULL;
+		resident -= c->cap;
+		c->state = OC_SPILLED;
+	}
+}
+
+/* 청크 사용 시작, 보조 파일에 있으면 읽어온다 (dlock 안에서 호출) */
+static int oc_get(OCHUNK *c)
+{
+	char *buf;
+	ssize_t n;
+	uint32_t len;
+
+	while(c->state == OC_LOADING)
+		pthread_cond_wait(&dwait, &dlock);
+	c->pin++;
+	c->ref = 1;
+	if(c->state != OC_SPILLED) return 0;
+
+	c->state = OC_LOADING;
+	oc_reclaim(c->cap);
+	len = c->zipped? c->zlen : c->len;
+	pthread_mutex_unlock(&dlock);
+	buf = (char*)malloc(c->cap);
+	n = (buf == NULL)? -1 : pread(spill_fd, buf, len, c->slot);
+	pthread_mutex_lock(&dlock);
+	if(n != (ssize_t)len) {
+		free(buf);
+		c->state = OC_SPILLED;
+		oc_put(c);
+		return -EIO;
+	}
+	c->buf = buf;
+	c->state = OC_RESIDENT;
+	resident += c->cap;
+	oc_list_add(c);
+	pthread_cond_broadcast(&dwait);
+	return 0;
+}
+
+/* 압축된 청크의 풀린 사본을 만든다 (dlock 안에서 호출, pin 필요) */
+static int oc_inflate(OCHUNK *c, ODATA *d)
+{
+	struct timespec t0, t1;
+	uLongf dlen = OFS_CHUNK_SIZE;
+	char *p;
+	int ret;
+
+	if(c->plain != NULL) {							// 캐시 적중, 가장 앞으로 옮긴다
+		oc_cache_del(c);
+		c->cprev = NULL;
+		c->cnext = chead;
+		if(chead != NULL) chead->cprev = c; else ctail = c;
+		chead = c;
+		return 0;
+	}
+
+	pthread_mutex_unlock(&dlock);
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	if((p = (char*)malloc(OFS_CHUNK_SIZE)) == NULL) {
+		pthread_mutex_lock(&dlock);
+		return -ENOMEM;
+	}
+	ret = uncompress((Bytef*)p, &dlen, (const Bytef*)c->buf, c->zlen);
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	pthread_mutex_lock(&dlock);
+
+	if(ret != Z_OK) {
+		free(p);
+		return -EIO;
+	}
+	if(d != NULL) {
+		d->zreads++;
+		d->zns += (t1.tv_sec - t0.tv_sec) * 1000000000ULL + t1.tv_nsec - t0.tv_nsec;
+	}
+	if(c->plain != NULL) {							// 다른 스레드가 먼저 풀었다
+		free(p);
+		return 0;
+	}
+	c->plain = (char*)realloc(p, (dlen > 0)? dlen : 1);
+	c->plen = dlen;
+	oc_cache_add(c);
+	return 0;
+}
+
+/* 쓰기 전에 압축을 완전히 푼다 (dlock 안에서 호출, pin 필요) */
+static int oc_unzip(OCHUNK *c)
+{
+	int ret;
+
+	while(c->pin > 1)								// 다른 스레드가 압축된 버퍼를 읽는 중
+		pthread_cond_wait(&dwait, &dlock);
+	if(!c->zipped) return 0;
+	if((ret = oc_inflate(c, NULL)) != 0) return ret;
+	oc_cache_del(c);
+	cache_bytes -= c->plen;
+	oc_buf_free(c);
+	resident -= c->cap;
+	c->buf = c->plain;
+	c->cap = c->plen;
+	resident += c->cap;
+	c->plain = NULL;
+	c->zipped = 0;
+	if(spill_fd >= 0) c->dirty = 1;					// 보조 파일의 내용은 압축된 형태
+	return 0;
+}
+
+/* 청크의 유효한 부분은 복사하고 나머지는 0으로 채운다 */
+static void oc_copy(OCHUNK *c, char *buf, uint32_t coff, size_t n)
+{
+	const char *src = c->zipped? c->plain : c->buf;
+	size_t valid = (c->len > coff)? c->len - coff : 0;
+	if(valid > n) valid = n;
+	memcpy(buf, src + coff, valid);
+	memset(buf + valid, 0, n - valid);
+}
+
+/* 공유된 청크를 쓰기 전에 복사한다, 원본의 pin을 넘겨받고 복사본을 pin한 채 반환 */
+static OCHUNK* oc_cow(ODATA *d, size_t idx, OCHUNK *c)
+{
+	OCHUNK *n;
+	uint32_t cap = (c->len > 0)? c->len : 1;
+
+	if(c->zipped && oc_inflate(c, d) != 0) return NULL;
+	oc_reclaim(cap);
+	n = (OCHUNK*)calloc(1, sizeof(OCHUNK));
+	if(n == NULL || (n->buf = (char*)malloc(cap)) == NULL) {
+		free(n);
+		return NULL;
+	}
+	memcpy(n->buf, c->zipped? c->plain : c->buf, c->len);
+	n->cap = cap;
+	n->len = c->len;
+	n->crc = c->crc;
+	n->crcok = c->crcok;
+	n->slot = -1;
+	n->state = OC_RESIDENT;
+	n->pin = 1;
+	n->ref = 1;
+	n->refcnt = 1;
+	if(spill_fd >= 0) n->dirty = 1;
+	resident += cap;
+	if(managed) oc_list_add(n);
+
+	c->refcnt--;
+	dd_saved -= c->len;
+	oc_put(c);
+	d->chunk[idx] = n;
+	return n;
+}
+
+/* 같은 내용의 청크가 있으면 그것을 공유하고 없으면 색인에 넣는다 (dlock 안에서 호출, c의 pin을 넘겨받는다) */
+static void oc_dedup(ODATA *d, size_t idx, OCHUNK *c)
+{
+	struct timespec t0, t1;
+	OCHUNK *m;
+	uint64_t h;
+	uint32_t len = c->len;
+	int same;
+
+	pthread_mutex_unlock(&dlock);
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	h = oc_hash(c->buf, len);
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	pthread_mutex_lock(&dlock);
+	dd_hashed += len;
+	dd_ns += (t1.tv_sec - t0.tv_sec) * 1000000000ULL + t1.tv_nsec - t0.tv_nsec;
+	c->hash = h;
+
+	for(m = (hsize > 0)? htab[h & (hsize - 1)] : NULL; m != NULL; m = m->hnext)
+		if(m->hash == h && m->len == len && m != c && !m->dead) break;
+
+	if(m != NULL && oc_get(m) == 0) {
+		/* 해시가 같은 첫번째 후보만 내용을 비교한다 (해시 충돌은 색인하지 않음) */
+		same = (!m->zipped || oc_inflate(m, d) == 0)
+			&& memcmp(m->zipped? m->plain : m->buf, c->buf, len) == 0;
+		if(same) {
+			m->refcnt++;
+			d->chunk[idx] = m;
+			dd_hits++;
+			dd_saved += len;
+			c->pin--;
+			if(c->pin != 0)							// 비동기 스레드가 쓰는 중
+				c->dead = 1;
+			else
+				oc_release(c);
+			oc_put(m);
+			return;
+		}
+		oc_put(m);
+		oc_put(c);
+		return;
+	}
+	oc_index(c);
+	oc_put(c);
+}
+
+static void oc_readahead(ODATA *d, off_t from)
+{
+	size_t idx = from >> OFS_CHUNK_SHIFT, end = idx + OFS_RA_CHUNKS;
+	OCHUNK *c;
+
+	if(end > d->nchunk) end = d->nchunk;
+	pthread_mutex_lock(&dlock);
+	for(; idx < end && ra_cnt < OFS_RA_QUEUE; idx++) {
+		c = d->chunk[idx];
+		if(c == NULL || c->state != OC_SPILLED) continue;
+		c->pin++;									// 큐에 있는 동안 해제되지 않도록
+		raq[(ra_head + ra_cnt++) % OFS_RA_QUEUE] = c;
+	}
+	if(ra_cnt > 0) pthread_cond_signal(&dwork);
+	pthread_mutex_unlock(&dlock);
+}
+
+/* 참조되지 않은 dirty 청크를 미리 기록해 내보내기를 빠르게 한다 */
+static void oc_flush_cold(void)
+{
+	OCHUNK *c, *next;
+	size_t i, count = nresident;
+
+	for(i = 0, c = hand; i < count && c != NULL; i++) {
+		next = c->next;
+		if(c->pin == 0 && c->dirty && !c->ref && c->state == OC_RESIDENT) {
+			c->pin++;
+			oc_writeback(c);
+			next = c->next;
+			oc_put(c);
+		}
+		c = next;
+	}
+}
+
+/* 오래 참조되지 않은 청크를 압축한다 (1초마다 호출) */
+static void oc_compress_cold(void)
+{
+	OCHUNK *c, *next;
+	size_t i, count = nresident, done = 0;
+	uint32_t gen, len;
+	uLongf zl;
+	char *z;
+	int ret;
+
+	for(i = 0, c = hand; i < count && c != NULL && done < OFS_ZIP_BATCH; i++) {
+		next = c->next;
+		if(c->ref) {
+			c->ref = 0;
+			c->age = 0;
+		} else if(c->age < 255) {
+			c->age++;
+		}
+		if(c->pin == 0 && c->state == OC_RESIDENT && !c->zipped && !c->nozip
+			&& c->len >= OFS_ZIP_MIN && c->age >= zage) {
+			/* 압축하는 동안 쓰기가 일어나면 세대가 바뀌어 결과를 버린다 */
+			c->pin++;
+			gen = c->gen;
+			len = c->len;
+			pthread_mutex_unlock(&dlock);
+			zl = compressBound(len);
+			z = (char*)malloc(zl);
+			ret = (z == NULL)? Z_MEM_ERROR : compress2((Bytef*)z, &zl, (const Bytef*)c->buf, len, zlevel);
+			pthread_mutex_lock(&dlock);
+
+			if(ret == Z_OK && zl < len - len / 8 && gen == c->gen && c->pin == 1 && !c->dead) {
+				oc_buf_free(c);
+				resident -= c->cap;
+				c->buf = (char*)realloc(z, zl);
+				c->cap = c->zlen = zl;
+				resident += c->cap;
+				c->zipped = 1;
+				if(spill_fd >= 0) c->dirty = 1;			// 보조 파일도 압축된 형태로 다시 기록
+				done++;
+			} else {
+				free(z);
+				if(ret == Z_OK && gen == c->gen && zl >= len - len / 8)
+					c->nozip = 1;
+			}
+			next = c->next;
+			oc_put(c);
+		}
+		c = next;
+	}
+}
+
+static void* oc_io(void *arg)
+{
+	struct timespec ts, last = { 0, 0 }, now;
+	OCHUNK *c;
+	(void)arg;
+
+	pthread_mutex_lock(&dlock);
+	while(!io_stop) {
+		if(ra_cnt == 0) {
+			clock_gettime(CLOCK_REALTIME, &ts);
+			ts.tv_nsec += 100000000L;
+			if(ts.tv_nsec >= 1000000000L) {
+				ts.tv_sec++;
+				ts.tv_nsec -= 1000000000L;
+			}
+			pthread_cond_timedwait(&dwork, &dlock, &ts);
+		}
+		while(ra_cnt > 0) {
+			c = raq[ra_head];
+			ra_head = (ra_head + 1) % OFS_RA_QUEUE;
+			ra_cnt--;
+			if(!c->dead && c->state == OC_SPILLED && oc_get(c) == 0)
+				oc_put(c);
+			oc_put(c);
+		}
+		if(spill_fd >= 0 && resident > budget / 4 * 3)
+			oc_flush_cold();
+		if(zlevel > 0) {
+			clock_gettime(CLOCK_MONOTONIC, &now);
+			if(now.tv_sec != last.tv_sec) {
+				last = now;
+				oc_compress_cold();
+			}
+		}
+	}
+	pthread_mutex_unlock(&dlock);
+	return NULL;
+}
+
+/* 모든 데이터를 청크 단위로 돌며 체크섬을 검사한다, 낮은 우선순위로 초당 scrub_rate 바이트까지 */
+static void* oc_scrub(void *arg)
+{
+	struct timespec ts;
+	uint64_t begin;
+	size_t quota;
+	OCHUNK *c;
+	int ret;
+	(void)arg;
+
+	setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), 19);
+	pthread_mutex_lock(&dlock);
+	while(!scrub_stop) {
+		clock_gettime(CLOCK_REALTIME, &ts);
+		ts.tv_nsec += OFS_SCRUB_TICK * 1000000L;
+		if(ts.tv_nsec >= 1000000000L) {
+			ts.tv_sec++;
+			ts.tv_nsec -= 1000000000L;
+		}
+		pthread_cond_timedwait(&scrub_wake, &dlock, &ts);
+
+		for(quota = scrub_rate / (1000 / OFS_SCRUB_TICK); quota > 0 && !scrub_stop;) {
+			if(scrub_d == NULL && (scrub_d = dhead) == NULL)
+				break;
+			if(scrub_i >= scrub_d->nchunk) {			// 다음 파일, 끝까지 돌았으면 다음 주기에 처음부터
+				scrub_d = scrub_d->dnext;
+				scrub_i = 0;
+				if(scrub_d == NULL) {
+					cs_passes++;
+					break;
+				}
+				continue;
+			}
+			if((c = scrub_d->chunk[scrub_i++]) == NULL)
+				continue;
+			quota -= (c->len < quota)? c->len : quota;
+			begin = ofs_stats_begin();
+			if((ret = oc_sum(c)) == 0)				// c는 이미 해제되었을 수 있다
+				continue;
+			cs_scrubbed++;
+			if(ret < 0) {
+				cs_sbad++;
+				OFS_TRACE(OT_ERR, OP_SCRUB, NULL, 0, begin, ret);
+			}
+			ofs_stats_end(OP_SCRUB, begin, (ret < 0)? ret : 0);
+		}
+	}
+	pthread_mutex_unlock(&dlock);
+	return NULL;
+}
+
+int ofs_data_init(const char *path, size_t _budget)
+{
+	char tmpl[] = "/var/tmp/ofs-spill.XXXXXX";
+
+	if(_budget == 0) return 0;
+	if(path != NULL) {
+		spill_fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+	} else {
+		spill_fd = mkstemp(tmpl);
+		path = tmpl;
+	}
+	if(spill_fd < 0) return -errno;
+	unlink(path);									// 마운트 동안만 쓰는 임시 공간
+	budget = _budget;
+	managed = 1;
+	return 0;
+}
+
+void ofs_data_compress(int level, int age, size_t cache)
+{
+	if(level <= 0) return;
+	zlevel = (level > 9)? 9 : level;
+	zage = (age < 1)? 1 : age;
+	cache_max = cache;
+	managed = 1;
+}
+
+void ofs_data_dedup(int enable)
+{
+	dedup = enable;
+}
+
+void ofs_data_huge(size_t threshold)
+{
+	huge_min = threshold;
+}
+
+void ofs_data_checksum(uint32_t verify, size_t scrub)
+{
+	oc_crc_init();
+	csum = 1;
+	csum_every = verify;
+	scrub_rate = scrub;
+}
+
+void ofs_data_checksum_stats(uint64_t *verified, uint64_t *rbad, uint64_t *scrubbed, uint64_t *sbad, uint64_t *passes)
+{
+	pthread_mutex_lock(&dlock);
+	*verified = cs_verified;
+	*rbad = cs_vbad;
+	*scrubbed = cs_scrubbed;
+	*sbad = cs_sbad;
+	*passes = cs_passes;
+	pthread_mutex_unlock(&dlock);
+}
+
+void ofs_data_seal(ODATA *d)
+{
+	size_t i;
+	OCHUNK *c;
+
+	if(!dedup && !csum) return;
+	pthread_mutex_lock(&dlock);
+	for(i = 0; i < d->nchunk; i++) {
+		c = d->chunk[i];
+		if(csum && c != NULL && !c->crcok)
+			oc_sum(c);								// 덮어쓴 청크는 닫을 때 체크섬을 다시 계산한다
+		c = d->chunk[i];
+		if(!dedup || c == NULL || c->indexed || c->refcnt > 1 || c->len == 0 || c->zipped)
+			continue;
+		if(oc_get(c) != 0) continue;
+		if(c->zipped)								// 읽어오는 동안 상태가 바뀜
+			oc_put(c);
+		else
+			oc_dedup(d, i, c);
+	}
+	pthread_mutex_unlock(&dlock);
+}
+
+void ofs_data_dedup_stats(uint64_t *hits, uint64_t *saved, uint64_t *hashed, uint64_t *ns)
+{
+	pthread_mutex_lock(&dlock);
+	*hits = dd_hits;
+	*saved = dd_saved;
+	*hashed = dd_hashed;
+	*ns = dd_ns;
+	pthread_mutex_unlock(&dlock);
+}
+
+void ofs_data_usage(ODATA *d, uint64_t *stored, uint64_t *zreads, uint64_t *zns)
+{
+	size_t i;
+	OCHUNK *c;
+
+	*stored = 0;
+	pthread_mutex_lock(&dlock);
+	for(i = 0; i < d->nchunk; i++) {
+		if((c = d->chunk[i]) == NULL) continue;
+		*stored += c->zipped? c->zlen : c->len;
+	}
+	*zreads = d->zreads;
+	*zns = d->zns;
+	pthread_mutex_unlock(&dlock);
+}
+
+int ofs_data_start(void)
+{
+	if(scrub_rate > 0 && !scrub_running) {
+		scrub_stop = 0;
+		if(pthread_create(&scrub_thread, NULL, oc_scrub, NULL) != 0)
+			return -EAGAIN;
+		scrub_running = 1;
+	}
+	if(!managed || io_running) return 0;
+	io_stop = 0;
+	if(pthread_create(&io_thread, NULL, oc_io, NULL) != 0)
+		return -EAGAIN;
+	io_running = 1;
+	return 0;
+}
+
+void ofs_data_stop(void)
+{
+	if(scrub_running) {
+		pthread_mutex_lock(&dlock);
+		scrub_stop = 1;
+		pthread_cond_signal(&scrub_wake);
+		pthread_mutex_unlock(&dlock);
+		pthread_join(scrub_thread, NULL);
+		scrub_running = 0;
+	}
+	if(!io_running) return;
+	pthread_mutex_lock(&dlock);
+	io_stop = 1;
+	pthread_cond_signal(&dwork);
+	pthread_mutex_unlock(&dlock);
+	pthread_join(io_thread, NULL);
+	io_running = 0;
+
+	pthread_mutex_lock(&dlock);
+	while(ra_cnt > 0) {
+		oc_put(raq[ra_head]);
+		ra_head = (ra_head + 1) % OFS_RA_QUEUE;
+		ra_cnt--;
+	}
+	pthread_mutex_unlock(&dlock);
+}
+
+ODATA* ofs_data_new(void)
+{
+	ODATA *d = (ODATA*)calloc(1, sizeof(ODATA));
+
+	if(d != NULL && scrub_rate > 0) {					// 스크러버가 돌 수 있도록 목록에 넣는다
+		pthread_mutex_lock(&dlock);
+		d->dnext = dhead;
+		if(dhead != NULL) dhead->dprev = d;
+		dhead = d;
+		pthread_mutex_unlock(&dlock);
+	}
+	return d;
+}
+
+/* 청크 배열 확장 (dlock 안에서 호출), 최대 파일 크기를 넘으면 -EFBIG */
+static int oc_grow(ODATA *d, size_t idx)
+{
+	size_t nchunk, max = (size_t)(OFS_FILE_MAX >> OFS_CHUNK_SHIFT);
+	OCHUNK **nc;
+
+	if(idx < d->nchunk) return 0;
+	if(idx >= max) return -EFBIG;
+	nchunk = (d->nchunk == 0)? 1 : d->nchunk;
+	while(nchunk <= idx) nchunk *= 2;					// max가 2의 거듭제곱이므로 넘치지 않는다
+	if((nc = (OCHUNK**)realloc(d->chunk, sizeof(OCHUNK*) * nchunk)) == NULL)
+		return -ENOMEM;
+	memset(nc + d->nchunk, 0, sizeof(OCHUNK*) * (nchunk - d->nchunk));
+	d->chunk = nc;
+	d->nchunk = nchunk;
+	return 0;
+}
+
+/* 큰 페이지 경계에 맞춘 매핑을 만들어 파일의 IDX번째 매핑으로 둔다 (dlock 안에서 호출) */
+static OHUGE* oh_map(ODATA *d, size_t idx)
+{
+	char *p, *base;
+	size_t head;
+	OHUGE *h, **nh;
+
+	if(idx >= d->nhmap) {
+		if((nh = (OHUGE**)realloc(d->hmap, sizeof(OHUGE*) * (idx + 1))) == NULL)
+			return NULL;								// 힙에 그대로 둔다
+		memset(nh + d->nhmap, 0, sizeof(OHUGE*) * (idx + 1 - d->nhmap));
+		d->hmap = nh;
+		d->nhmap = idx + 1;
+	}
+	/* 넉넉히 매핑한 뒤 경계 앞뒤를 잘라낸다 */
+	p = (char*)mmap(NULL, OFS_HUGE_LEN + OFS_HUGE_PAGE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if(p == MAP_FAILED) return NULL;
+	base = (char*)(((uintptr_t)p + OFS_HUGE_PAGE - 1) & ~(uintptr_t)(OFS_HUGE_PAGE - 1));
+	head = base - p;
+	if(head > 0) munmap(p, head);
+	if(head < OFS_HUGE_PAGE) munmap(base + OFS_HUGE_LEN, OFS_HUGE_PAGE - head);
+#ifdef MADV_HUGEPAGE
+	madvise(base, OFS_HUGE_LEN, MADV_HUGEPAGE);
+#endif
+	if((h = (OHUGE*)calloc(1, sizeof(OHUGE))) == NULL) {
+		munmap(base, OFS_HUGE_LEN);
+		return NULL;
+	}
+	h->base = base;
+	h->owner = d;
+	h->idx = idx;
+	d->hmap[idx] = h;
+	return h;
+}
+
+/* 큰 파일의 IDX번째 청크를 매핑 안의 자리로 옮긴다 (dlock 안에서 호출)
+   공유된 이전 청크가 자리를 쓰고 있거나 매핑을 만들 수 없으면 힙에 그대로 둔다 */
+static void oh_place(ODATA *d, size_t idx, OCHUNK *c)
+{
+	size_t e = idx / OFS_HUGE_SLOTS, s = idx % OFS_HUGE_SLOTS;
+	OHUGE *h;
+	char *buf;
+
+	if(e < d->nhmap && (h = d->hmap[e]) != NULL) {
+		if(h->used[s / 64] & (1ULL << (s % 64))) return;
+	} else if((h = oh_map(d, e)) == NULL) {
+		return;
+	}
+	oc_reclaim(OFS_CHUNK_SIZE - c->cap);				// 새 매핑은 청크가 들어올 때까지 해제되지 않는다
+	h->used[s / 64] |= 1ULL << (s % 64);
+	h->live++;
+	buf = h->base + (s << OFS_CHUNK_SHIFT);
+	if(c->buf != NULL) {
+		memcpy(buf, c->buf, c->len);
+		free(c->buf);
+		resident -= c->cap;
+	} else if(managed) {
+		oc_list_add(c);
+	}
+	c->buf = buf;
+	c->hmap = h;
+	c->cap = OFS_CHUNK_SIZE;
+	resident += c->cap;
+}
+
+/* 파일이 큰 파일이 되었다, 지금 쓰이지 않는 청크를 매핑으로 옮긴다 (dlock 안에서 호출)
+   공유된 청크는 다른 파일이 잠금 없이 읽을 수 있으므로 옮기지 않는다 */
+static void oh_start(ODATA *d, size_t idx)
+{
+	size_t i;
+	OCHUNK *c;
+
+	if(oh_map(d, idx / OFS_HUGE_SLOTS) == NULL) return;
+	for(i = 0; i < d->nchunk; i++) {
+		c = d->chunk[i];
+		if(c != NULL && c->hmap == NULL && c->refcnt == 1 && c->pin == 0
+			&& c->state == OC_RESIDENT && !c->zipped && c->buf != NULL)
+			oh_place(d, i, c);
+	}
+}
+
+static void oc_drop(OCHUNK *c)
+{
+	if(c->refcnt > 1) {								// 다른 파일이 공유하는 청크
+		c->refcnt--;
+		dd_saved -= c->len;
+		return;
+	}
+	oc_unindex(c);
+	if(c->pin != 0)
+		c->dead = 1;
+	else
+		oc_release(c);
+}
+
+void ofs_data_free(ODATA *d)
+{
+	size_t i;
+
+	pthread_mutex_lock(&dlock);
+	for(i = 0; i < d->nchunk; i++)
+		if(d->chunk[i] != NULL) oc_drop(d->chunk[i]);
+	for(i = 0; i < d->nhmap; i++)					// 공유된 청크가 남은 매핑은 그 청크가 해제할 때까지 둔다
+		if(d->hmap[i] != NULL) d->hmap[i]->owner = NULL;
+	if(scrub_rate > 0) {
+		if(scrub_d == d) {							// 스크러버는 다음 파일부터 계속한다
+			scrub_d = d->dnext;
+			scrub_i = 0;
+		}
+		if(d->dprev != NULL) d->dprev->dnext = d->dnext; else dhead = d->dnext;
+		if(d->dnext != NULL) d->dnext->dprev = d->dprev;
+	}
+	pthread_mutex_unlock(&dlock);
+	free(d->hmap);
+	free(d->chunk);
+	free(d);
+}
+
+void ofs_data_truncate(ODATA *d, off_t length)
+{
+	size_t i, keep = (length + OFS_CHUNK_SIZE - 1) >> OFS_CHUNK_SHIFT;
+	uint32_t tail = length & (OFS_CHUNK_SIZE - 1);
+	OCHUNK *c, *n;
+
+	pthread_mutex_lock(&dlock);
+	for(i = keep; i < d->nchunk; i++) {
+		if(d->chunk[i] != NULL) {
+			d->used -= d->chunk[i]->len;
+			oc_drop(d->chunk[i]);
+		}
+		d->chunk[i] = NULL;
+	}
+	if(keep < d->nchunk) d->nchunk = keep;
+	if(tail != 0 && keep > 0 && (c = d->chunk[keep - 1]) != NULL && c->len > tail) {
+		if(c->refcnt > 1) {							// 공유된 청크는 복사한 뒤 자른다
+			if(oc_get(c) != 0) {
+				pthread_mutex_unlock(&dlock);
+				return;
+			}
+			if((n = oc_cow(d, keep - 1, c)) == NULL) {
+				oc_put(c);
+				pthread_mutex_unlock(&dlock);
+				return;
+			}
+			oc_put(c = n);
+		}
+		oc_unindex(c);
+		d->used -= c->len - tail;
+		c->len = tail;								// 잘린 뒷부분은 이후 0으로 읽힌다
+		c->gen++;
+		c->crcok = 0;
+	}
+	pthread_mutex_unlock(&dlock);
+}
+
+static int oc_read(ODATA *d, char *buf, size_t size, off_t offset)
+{
+	size_t idx, n, total = size;
+	uint32_t coff;
+	off_t start = offset;
+	OCHUNK *c;
+	int ret, verify;
+
+	while(size > 0) {
+		idx = offset >> OFS_CHUNK_SHIFT;
+		coff = offset & (OFS_CHUNK_SIZE - 1);
+		n = OFS_CHUNK_SIZE - coff;
+		if(n > size) n = size;
+
+		c = (idx < d->nchunk)? d->chunk[idx] : NULL;
+		verify = (c != NULL && csum_every > 0 && c->crcok
+			&& __atomic_add_fetch(&csum_tick, 1, __ATOMIC_RELAXED) % csum_every == 0);
+		if(c == NULL) {								// 구멍은 0으로 읽힌다
+			memset(buf, 0, n);
+		} else if(!managed && !verify) {				// 내보내기와 압축을 쓰지 않으면 잠금이 필요 없다
+			oc_copy(c, buf, coff, n);
+		} else {
+			pthread_mutex_lock(&dlock);
+			if((ret = oc_get(c)) == 0 && c->zipped && (ret = oc_inflate(c, d)) != 0)
+				oc_put(c);
+			pthread_mutex_unlock(&dlock);
+			if(ret != 0) return ret;
+			if(!verify || (ret = oc_verify(c)) == 0)	// 검사에 실패하면 내용을 넘기지 않는다
+				oc_copy(c, buf, coff, n);
+			pthread_mutex_lock(&dlock);
+			oc_put(c);
+			pthread_mutex_unlock(&dlock);
+			if(ret != 0) return ret;
+		}
+		buf += n;
+		offset += n;
+		size -= n;
+	}
+
+	/* 순차 읽기이면 다음 청크들을 미리 읽는다 */
+	if(spill_fd >= 0 && start != 0 && start == d->ra_next)
+		oc_readahead(d, offset);
+	d->ra_next = start + total;
+	return 0;
+}
+
+/* 쓸 청크를 준비한다, 없으면 만들고 공유나 압축을 풀고 버퍼를 NEED까지 늘린다 (dlock 안에서 호출, pin한 채 반환) */
+static int oc_prepare(ODATA *d, size_t idx, uint32_t need, OCHUNK **out)
+{
+	size_t newcap;
+	OCHUNK *c, *nc;
+	char *nbuf;
+	int ret;
+
+	if((ret = oc_grow(d, idx)) != 0)
+		return ret;
+	if(huge_min > 0 && d->hmap == NULL && ((uint64_t)idx + 1) << OFS_CHUNK_SHIFT > huge_min)
+		oh_start(d, idx);
+	if((c = d->chunk[idx]) == NULL) {
+		if((c = (OCHUNK*)calloc(1, sizeof(OCHUNK))) == NULL)
+			return -ENOMEM;
+		c->slot = -1;
+		c->state = OC_RESIDENT;
+		c->pin = 1;
+		c->ref = 1;
+		c->refcnt = 1;
+		c->crcok = 1;								// 빈 청크의 CRC는 0
+		d->chunk[idx] = c;
+	} else if((ret = oc_get(c)) != 0) {
+		return ret;
+	} else if(c->refcnt > 1) {						// 공유된 청크는 복사 후 쓰기
+		if((nc = oc_cow(d, idx, c)) == NULL) {
+			oc_put(c);
+			return -ENOMEM;
+		}
+		c = nc;
+	} else if(c->zipped && (ret = oc_unzip(c)) != 0) {
+		oc_put(c);
+		return ret;
+	}
+	oc_unindex(c);								// 내용이 바뀌므로 색인에서 뺀다
+	if(d->hmap != NULL && c->hmap == NULL && c->refcnt == 1 && c->pin == 1)
+		oh_place(d, idx, c);						// 큰 파일의 청크는 버퍼를 늘리지 않고 매핑에 둔다
+
+	if(need > c->cap) {							// 청크 버퍼 확장 (최대 청크 크기)
+		while(c->pin > 1)						// 비동기 기록이 버퍼를 쓰는 중
+			pthread_cond_wait(&dwait, &dlock);
+		newcap = (c->cap * 2 > need)? c->cap * 2 : need;
+		if(newcap > OFS_CHUNK_SIZE) newcap = OFS_CHUNK_SIZE;
+		oc_reclaim(newcap - c->cap);
+		if((nbuf = (char*)realloc(c->buf, newcap)) == NULL) {
+			oc_put(c);
+			return -ENOMEM;
+		}
+		if(c->buf == NULL && managed) oc_list_add(c);
+		c->buf = nbuf;
+		resident += newcap - c->cap;
+		c->cap = newcap;
+	}
+	*out = c;
+	return 0;
+}
+
+static int oc_write(ODATA *d, const char *buf, size_t size, off_t offset)
+{
+	size_t idx, n;
+	uint32_t coff, need, from = 0, crc = 0;
+	OCHUNK *c;
+	int ret;
+
+	while(size > 0) {
+		idx = offset >> OFS_CHUNK_SHIFT;
+		coff = offset & (OFS_CHUNK_SIZE - 1);
+		n = OFS_CHUNK_SIZE - coff;
+		if(n > size) n = size;
+		need = coff + n;
+
+		pthread_mutex_lock(&dlock);
+		if((ret = oc_prepare(d, idx, need, &c)) != 0) {
+			pthread_mutex_unlock(&dlock);
+			return ret;
+		}
+		if(coff > c->len)								// 청크 안의 구멍은 0으로 채운다
+			memset(c->buf + c->len, 0, coff - c->len);
+		if(csum) {
+			/* 청크를 새로 채우거나 끝에 이어 쓰면 쓴 부분만 더 계산하고, 덮어쓰면 닫을 때 다시 계산한다 */
+			from = (coff == 0 && need >= c->len)? 0 : (c->crcok && coff >= c->len)? c->len : need;
+			crc = (from == 0)? 0 : c->crc;
+		}
+		pthread_mutex_unlock(&dlock);
+
+		memcpy(c->buf + coff, buf, n);
+		if(csum && from < need)
+			crc = oc_crc(crc, c->buf + from, need - from);
+
+		pthread_mutex_lock(&dlock);
+		if(csum) {
+			c->crc = crc;
+			c->crcok = (from < need);
+		}
+		if(need > c->len) {
+			d->used += need - c->len;
+			c->len = need;
+		}
+		if(spill_fd >= 0) c->dirty = 1;				// 기록이 끝난 뒤에 dirty로 표시
+		c->gen++;
+		c->nozip = 0;
+		if(dedup && need == OFS_CHUNK_SIZE && c->len == OFS_CHUNK_SIZE)
+			oc_dedup(d, idx, c);						// 꽉 찬 청크는 바로 중복 제거
+		else
+			oc_put(c);
+		pthread_mutex_unlock(&dlock);
+
+		buf += n;
+		offset += n;
+		size -= n;
+	}
+	return 0;
+}
+
+/* 범위의 청크를 미리 할당해 0으로 채운다, 이후 쓰기는 버퍼를 늘리지 않고 채우기만 한다 */
+static int oc_reserve(ODATA *d, off_t offset, off_t length)
+{
+	off_t end = offset + length, base;
+	size_t idx;
+	uint32_t need, from, crc;
+	OCHUNK *c;
+	int ret = 0;
+
+	pthread_mutex_lock(&dlock);
+	if(length > 0)
+		ret = oc_grow(d, (end - 1) >> OFS_CHUNK_SHIFT);	// 청크 배열은 한번에 늘린다
+	for(idx = offset >> OFS_CHUNK_SHIFT; ret == 0 && (base = (off_t)idx << OFS_CHUNK_SHIFT) < end; idx++) {
+		need = (end - base >= OFS_CHUNK_SIZE)? OFS_CHUNK_SIZE : end - base;
+		if(d->chunk[idx] != NULL && d->chunk[idx]->len >= need)
+			continue;								// 이미 데이터가 있는 부분
+		if((ret = oc_prepare(d, idx, need, &c)) != 0)
+			break;
+		from = c->len;
+		crc = c->crc;
+		pthread_mutex_unlock(&dlock);
+		memset(c->buf + from, 0, need - from);
+		if(csum && c->crcok)
+			crc = oc_crc(crc, c->buf + from, need - from);
+		pthread_mutex_lock(&dlock);
+		c->crc = crc;
+		if(need > c->len) {
+			d->used += need - c->len;
+			c->len = need;
+		}
+		if(spill_fd >= 0) c->dirty = 1;
+		c->gen++;
+		oc_put(c);
+	}
+	pthread_mutex_unlock(&dlock);
+	return ret;
+}
+
+uint64_t ofs_data_growth(ODATA *d, size_t size, off_t offset)
+{
+	size_t idx, n;
+	uint32_t coff, len;
+	uint64_t grow = 0;
+
+	pthread_mutex_lock(&dlock);
+	while(size > 0) {
+		idx = offset >> OFS_CHUNK_SHIFT;
+		coff = offset & (OFS_CHUNK_SIZE - 1);
+		n = OFS_CHUNK_SIZE - coff;
+		if(n > size) n = size;
+		len = (d != NULL && idx < d->nchunk && d->chunk[idx] != NULL)? d->chunk[idx]->len : 0;
+		if(coff + n > len) grow += coff + n - len;
+		offset += n;
+		size -= n;
+	}
+	pthread_mutex_unlock(&dlock);
+	return grow;
+}
+
+int ofs_data_read(ODATA *d, char *buf, size_t size, off_t offset)
+{
+	uint64_t begin = ofs_stats_begin();
+	return ofs_stats_end(OP_DATA_READ, begin, oc_read(d, buf, size, offset));
+}
+
+int ofs_data_write(ODATA *d, const char *buf, size_t size, off_t offset)
+{
+	uint64_t begin = ofs_stats_begin();
+	return ofs_stats_end(OP_DATA_WRITE, begin, oc_write(d, buf, size, offset));
+}
+
+int ofs_data_reserve(ODATA *d, off_t offset, off_t length)
+{
+	uint64_t begin = ofs_stats_begin();
+	return ofs_stats_end(OP_DATA_WRITE, begin, oc_reserve(d, offset, length));
+}
+
+int ofs_data_clone(ODATA *dst, off_t doff, ODATA *src, off_t soff, size_t size, int tail)
+{
+	size_t idx, sidx, n;
+	OCHUNK *c;
+	char *buf = NULL;
+	int ret = 0;
+
+	while(size > 0) {
+		n = OFS_CHUNK_SIZE - (doff & (OFS_CHUNK_SIZE - 1));
+		if(n > size) n = size;
+
+		if(((doff | soff) & (OFS_CHUNK_SIZE - 1)) == 0 && (n == OFS_CHUNK_SIZE || tail)) {
+			/* 청크 전체를 덮으면 복사하지 않고 공유한다, 이후 쓰기에서 복사된다 */
+			idx = doff >> OFS_CHUNK_SHIFT;
+			sidx = soff >> OFS_CHUNK_SHIFT;
+			pthread_mutex_lock(&dlock);
+			if((ret = oc_grow(dst, idx)) != 0) {
+				pthread_mutex_unlock(&dlock);
+				break;
+			}
+			c = (sidx < src->nchunk)? src->chunk[sidx] : NULL;
+			if(dst->chunk[idx] != c) {
+				if(dst->chunk[idx] != NULL) {
+					dst->used -= dst->chunk[idx]->len;
+					oc_drop(dst->chunk[idx]);
+				}
+				if(c != NULL) {
+					c->refcnt++;
+					dd_saved += c->len;
+					dst->used += c->len;
+				}
+				dst->chunk[idx] = c;
+			}
+			cl_shared += n;
+			pthread_mutex_unlock(&dlock);
+		} else {
+			/* 청크 경계가 맞지 않는 부분은 복사한다 */
+			if(buf == NULL && (buf = (char*)malloc(OFS_CHUNK_SIZE)) == NULL) {
+				ret = -ENOMEM;
+				break;
+			}
+			if((ret = ofs_data_read(src, buf, n, soff)) != 0
+				|| (ret = ofs_data_write(dst, buf, n, doff)) != 0)
+				break;
+			pthread_mutex_lock(&dlock);
+			cl_copied += n;
+			pthread_mutex_unlock(&dlock);
+		}
+		doff += n;
+		soff += n;
+		size -= n;
+	}
+	free(buf);
+	return ret;
+}
+
+void ofs_data_clone_stats(uint64_t *shared, uint64_t *copied)
+{
+	pthread_mutex_lock(&dlock);
+	*shared = cl_shared;
+	*copied = cl_copied;
+	pthread_mutex_unlock(&dlock);
+}
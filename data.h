@@ -0,0 +1,224 @@
+﻿#ifndef __DATA_H
+#define __DATA_H
+#include <sys/types.h>
+#include <stdint.h>
+
+#define OFS_CHUNK_SHIFT		16
+#define OFS_CHUNK_SIZE		(1 << OFS_CHUNK_SHIFT)		// 데이터 청크 크기(64KB)
+#define OFS_FILE_MAX		((off_t)1 << 38)			// 파일 최대 크기(256GB), 청크 배열이 오프셋에 비례해 커지므로 제한한다
+
+/* 청크 상태 */
+enum {
+	OC_RESIDENT = 0,			// 메모리에 있음
+	OC_SPILLED,				// 보조 파일에만 있음
+	OC_LOADING				// 보조 파일에서 읽어오는 중
+};
+
+struct _OHUGE;
+
+typedef struct _OCHUNK {
+	char				*buf;		// 메모리에 있는 데이터, 내보낸 경우 NULL
+	uint32_t			cap;		// buf 할당 크기
+	uint32_t			len;		// 청크 안의 유효한 데이터 길이, 이후는 0으로 읽힌다
+	off_t			slot;		// 보조 파일 위치, 없으면 -1
+	uint16_t			pin;		// 사용중인 스레드 수, 0일때만 내보낼 수 있다
+	uint8_t			state;
+	uint8_t			dirty;		// 보조 파일보다 새로운 내용
+	uint8_t			ref;			// CLOCK 참조 비트
+	uint8_t			dead;		// 사용중에 해제된 청크, 마지막 사용자가 해제
+	uint8_t			zipped;		// buf(또는 slot)에 압축된 데이터가 있음
+	uint8_t			nozip;		// 압축 효과가 없어 다시 쓰일 때까지 압축하지 않음
+	uint8_t			age;			// 참조되지 않은 채 지난 압축 검사 횟수
+	uint32_t			zlen;		// 압축된 길이
+	uint32_t			plen;		// 풀린 사본의 길이
+	uint32_t			gen;			// 쓰기 세대, 압축 중 변경 감지용
+	uint32_t			crc;			// len까지의 CRC32C (crcok일 때)
+	uint8_t			crcok;		// crc가 내용과 맞음, 덮어쓰면 다시 계산할 때까지 0
+	uint32_t			refcnt;		// 이 청크를 가리키는 파일 위치 수 (중복 제거로 공유)
+	uint8_t			indexed;		// 중복 제거 색인에 들어 있음
+	uint64_t			hash;		// 내용 해시 (indexed일 때)
+	struct _OCHUNK	*hnext;		// 중복 제거 색인 체인
+	char				*plain;		// 압축된 청크의 풀린 사본 (핫 캐시)
+	struct _OHUGE	*hmap;		// buf가 들어 있는 큰 파일 매핑, 힙이면 NULL
+	struct _OCHUNK	*prev;		// 메모리에 있는 청크의 CLOCK 목록
+	struct _OCHUNK	*next;
+	struct _OCHUNK	*cprev;		// 핫 캐시 LRU 목록
+	struct _OCHUNK	*cnext;
+} OCHUNK;
+
+typedef struct _ODATA {
+	OCHUNK			**chunk;		// 청크 배열, NULL 청크는 0으로 읽힌다
+	size_t			nchunk;
+	off_t			ra_next;		// 순차 읽기 감지용 다음 예상 위치
+	uint64_t			used;		// 청크에 들어 있는 바이트 (구멍 제외, 공유된 청크도 파일마다 센다)
+	uint64_t			zreads;		// 압축 해제 횟수
+	uint64_t			zns;			// 압축 해제에 쓴 시간(ns)
+	struct _OHUGE	**hmap;		// 큰 파일의 청크 매핑 배열, NULL이면 힙만 쓴다
+	size_t			nhmap;
+	struct _ODATA	*dprev;		// 스크러버가 도는 전체 데이터 목록
+	struct _ODATA	*dnext;
+} ODATA;
+
+/*######################################
+ 이름 : ofs_data_init
+ 요약 : 메모리 한도와 보조 파일 설정, 한도가 0이면 내보내지 않는다
+ 매개변수 : const char* [SPILL_PATH], size_t [BUDGET]
+ 반환값 : 성공시 0, 실패시 음수
+ #######################################*/
+int 		ofs_data_init		(const char*, size_t);
+
+/*######################################
+ 이름 : ofs_data_compress
+ 요약 : 오래 쓰이지 않은 청크의 투명 압축 설정, 레벨이 0이면 압축하지 않는다
+ 매개변수 : int [LEVEL], int [AGE_SEC], size_t [CACHE_BYTES]
+ 반환값 : 없음
+ #######################################*/
+void 		ofs_data_compress	(int, int, size_t);
+
+/*######################################
+ 이름 : ofs_data_dedup
+ 요약 : 청크 단위 중복 제거 사용 설정
+ 매개변수 : int [ENABLE]
+ 반환값 : 없음
+ #######################################*/
+void 		ofs_data_dedup		(int);
+
+/*######################################
+ 이름 : ofs_data_huge
+ 요약 : 크기가 THRESHOLD를 넘는 파일의 청크를 큰 페이지로 매핑한 영역에 둔다, 0이면 쓰지 않는다
+ 매개변수 : size_t [THRESHOLD]
+ 반환값 : 없음
+ #######################################*/
+void 		ofs_data_huge		(size_t);
+
+/*######################################
+ 이름 : ofs_data_checksum
+ 요약 : 청크별 CRC32C 사용 설정, 청크 읽기 VERIFY번에 한번 검사하고 (0이면 검사 안함)
+ 		스크러버가 초당 SCRUB 바이트씩 모든 데이터를 검사한다 (0이면 쓰지 않음)
+ 매개변수 : uint32_t [VERIFY], size_t [SCRUB]
+ 반환값 : 없음
+ #######################################*/
+void 		ofs_data_checksum	(uint32_t, size_t);
+
+/*######################################
+ 이름 : ofs_data_checksum_stats
+ 요약 : 체크섬 통계, 불일치는 읽기와 스크러버에서 따로 센다
+ 매개변수 : uint64_t* [VERIFIED], uint64_t* [READ_BAD], uint64_t* [SCRUBBED], uint64_t* [SCRUB_BAD], uint64_t* [PASSES]
+ 반환값 : 없음
+ #######################################*/
+void 		ofs_data_checksum_stats	(uint64_t*, uint64_t*, uint64_t*, uint64_t*, uint64_t*);
+
+/*######################################
+ 이름 : ofs_data_seal
+ 요약 : 파일의 색인되지 않은 청크(꼬리 청크 등)를 중복 제거하고 덮어쓴 청크의 체크섬을 다시 계산 (쓰기 종료시 호출)
+ 매개변수 : ODATA* [DATA]
+ 반환값 : 없음
+ #######################################*/
+void 		ofs_data_seal		(ODATA*);
+
+/*######################################
+ 이름 : ofs_data_dedup_stats
+ 요약 : 중복 제거 통계
+ 매개변수 : uint64_t* [HITS], uint64_t* [SAVED], uint64_t* [HASHED], uint64_t* [HASH_NS]
+ 반환값 : 없음
+ #######################################*/
+void 		ofs_data_dedup_stats	(uint64_t*, uint64_t*, uint64_t*, uint64_t*);
+
+/*######################################
+ 이름 : ofs_data_usage
+ 요약 : 파일 데이터가 실제로 차지하는 메모리와 압축 해제 통계
+ 매개변수 : ODATA* [DATA], uint64_t* [STORED], uint64_t* [ZREADS], uint64_t* [ZNS]
+ 반환값 : 없음
+ #######################################*/
+void 		ofs_data_usage		(ODATA*, uint64_t*, uint64_t*, uint64_t*);
+
+/*######################################
+ 이름 : ofs_data_start
+ 요약 : 비동기 쓰기/미리 읽기 스레드 시작 (데몬화 이후에 호출)
+ 매개변수 : 없음
+ 반환값 : 성공시 0, 실패시 음수
+ #######################################*/
+int 		ofs_data_start		(void);
+
+/*######################################
+ 이름 : ofs_data_stop
+ 요약 : 비동기 스레드 정지
+ 매개변수 : 없음
+ 반환값 : 없음
+ #######################################*/
+void 		ofs_data_stop		(void);
+
+/*######################################
+ 이름 : ofs_data_new
+ 요약 : 빈 파일 데이터 생성
+ 매개변수 : 없음
+ 반환값 : 생성된 데이터
+ #######################################*/
+ODATA* 	ofs_data_new		(void);
+
+/*######################################
+ 이름 : ofs_data_free
+ 요약 : 파일 데이터와 모든 청크 해제
+ 매개변수 : ODATA* [DATA]
+ 반환값 : 없음
+ #######################################*/
+void 		ofs_data_free		(ODATA*);
+
+/*######################################
+ 이름 : ofs_data_read
+ 요약 : 데이터 읽기 (호출자가 파일 크기 안으로 범위를 제한한다)
+ 매개변수 : ODATA* [DATA], char* [BUF], size_t [SIZE], off_t [OFFSET]
+ 반환값 : 성공시 0, 실패시 음수
+ #######################################*/
+int 		ofs_data_read		(ODATA*, char*, size_t, off_t);
+
+/*######################################
+ 이름 : ofs_data_write
+ 요약 : 데이터 쓰기, 필요한 청크를 할당하거나 보조 파일에서 읽어온다
+ 매개변수 : ODATA* [DATA], const char* [BUF], size_t [SIZE], off_t [OFFSET]
+ 반환값 : 성공시 0, 실패시 음수
+ #######################################*/
+int 		ofs_data_write		(ODATA*, const char*, size_t, off_t);
+
+/*######################################
+ 이름 : ofs_data_growth
+ 요약 : 쓰기로 늘어날 사용량(used) 계산, 한도 검사용 (DATA가 NULL이면 빈 파일)
+ 매개변수 : ODATA* [DATA], size_t [SIZE], off_t [OFFSET]
+ 반환값 : 늘어날 바이트 수
+ #######################################*/
+uint64_t	ofs_data_growth		(ODATA*, size_t, off_t);
+
+/*######################################
+ 이름 : ofs_data_reserve
+ 요약 : 범위의 청크를 미리 할당하고 0으로 채운다, 이후 쓰기는 버퍼를 다시 할당하지 않는다
+ 매개변수 : ODATA* [DATA], off_t [OFFSET], off_t [LENGTH]
+ 반환값 : 성공시 0, 실패시 음수
+ #######################################*/
+int 		ofs_data_reserve	(ODATA*, off_t, off_t);
+
+/*######################################
+ 이름 : ofs_data_truncate
+ 요약 : 길이 이후의 청크를 해제
+ 매개변수 : ODATA* [DATA], off_t [LENGTH]
+ 반환값 : 없음
+ #######################################*/
+void 		ofs_data_truncate	(ODATA*, off_t);
+
+/*######################################
+ 이름 : ofs_data_clone
+ 요약 : 데이터를 복제, 청크 경계가 맞는 부분은 복사하지 않고 공유한다
+ 		TAIL이면 원본 끝의 부분 청크도 공유 (범위가 원본의 끝까지이고 대상의 끝을 덮을 때)
+ 매개변수 : ODATA* [DST], off_t [DST_OFFSET], ODATA* [SRC], off_t [SRC_OFFSET], size_t [SIZE], int [TAIL]
+ 반환값 : 성공시 0, 실패시 음수
+ #######################################*/
+int 		ofs_data_clone		(ODATA*, off_t, ODATA*, off_t, size_t, int);
+
+/*######################################
+ 이름 : ofs_data_clone_stats
+ 요약 : 파일 복제에서 청크를 공유한 바이트와 복사한 바이트
+ 매개변수 : uint64_t* [SHARED], uint64_t* [COPIED]
+ 반환값 : 없음
+ #######################################*/
+void 		ofs_data_clone_stats	(uint64_t*, uint64_t*);
+
+#endif
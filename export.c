@@ -0,0 +1,585 @@
+﻿#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include "export.h"
+#include "data.h"
+
+#define OX_BLOCK		512
+#define OX_RECORD		(OX_BLOCK * 20)				// tar 기본 레코드 크기, 끝을 이 단위로 맞춘다
+#define OX_BUFSIZE	(1 << 20)					// 한번에 write하는 크기
+
+/* 목록의 항목 하나 */
+typedef struct _OXENT {
+	char			*name;				// 아카이브 안의 이름
+	char			*link;				// 심볼릭 링크 내용이나 하드 링크 원본 이름
+	char			type;				// tar typeflag
+	mode_t		mode;
+	uid_t			uid;
+	gid_t			gid;
+	off_t			size;
+	time_t		mtime;
+	dev_t			rdev;
+	ODATA		*data;				// 일반 파일 데이터의 복제본
+	int			err;					// 스냅샷을 뜨지 못한 에러, 기록할 때 내보내기를 실패로 끝낸다
+} OXENT;
+
+struct _OEXPORT {
+	OXENT		*ent;
+	size_t		cnt, cap;
+	OSTAT		**seen;				// 하드 링크 원본 (드물기 때문에 선형 검색)
+	size_t		*seen_idx;
+	size_t		nseen;
+	uint64_t		total;				// 파일 데이터 합계
+	char			*path;				// 내보내는 서브트리
+	int			fd;
+};
+
+/* ustar 헤더 */
+typedef struct _OXHDR {
+	char		name[100];
+	char		mode[8];
+	char		uid[8];
+	char		gid[8];
+	char		size[12];
+	char		mtime[12];
+	char		chksum[8];
+	char		typeflag;
+	char		linkname[100];
+	char		magic[6];
+	char		version[2];
+	char		uname[32];
+	char		gname[32];
+	char		devmajor[8];
+	char		devminor[8];
+	char		prefix[155];
+	char		pad[12];
+} OXHDR;
+
+/* 진행 상태 (/.ofs/export) */
+static struct {
+	int			state;				// OXS_*
+	char			*path;
+	char			*dest;
+	size_t		entries, done;
+	uint64_t		total, bytes;
+	struct timespec	start, end;
+	int			err;
+	char			*failed;				// 읽지 못한 파일 (아카이브 안의 이름)
+	pthread_t		thread;
+	int			joinable;
+} ox;
+static pthread_mutex_t	oxlock = PTHREAD_MUTEX_INITIALIZER;
+
+enum { OXS_IDLE = 0, OXS_RUNNING, OXS_DONE, OXS_FAILED };
+static const char *state_names[] = { "idle", "running", "done", "failed" };
+
+/*
+ * 스냅샷
+ * 트리 잠금 안에서 서브트리를 한번 돌면서 이름과 속성을 복사하고, 파일 데이터는
+ * ofs_data_clone으로 청크를 공유하는 복제본을 만든다. 데이터를 복사하지 않으므로
+ * 잠금을 잡는 시간은 노드 수에 비례하고, 이후에 바뀌는 청크는 쓰는 쪽에서 복사된다.
+ */
+static OXENT* ox_add(OEXPORT *x, const char *name, char type, OSTAT *st)
+{
+	OXENT *e;
+
+	if(x->cnt == x->cap) {
+		x->cap = (x->cap == 0)? 256 : x->cap * 2;
+		x->ent = (OXENT*)realloc(x->ent, sizeof(OXENT) * x->cap);
+	}
+	e = &x->ent[x->cnt++];
+	memset(e, 0, sizeof(OXENT));
+	e->name = strdup(name);
+	e->type = type;
+	e->mode = st->of_mode & 07777;
+	e->uid = st->of_uid;
+	e->gid = st->of_gid;
+	e->mtime = st->of_mtime.tv_sec;
+	e->rdev = st->of_rdev;
+	return e;
+}
+
+static char* ox_join(const char *dir, const char *name)
+{
+	size_t len = strlen(dir);
+	char *path = (char*)malloc(len + strlen(name) + 2);
+
+	strcpy(path, dir);
+	if(len == 0 || dir[len - 1] != '/')
+		strcat(path, "/");
+	strcat(path, name);
+	return path;
+}
+
+static void ox_walk(OEXPORT *x, ONODE *node, const char *path, const char *name,
+	void (*sync)(ONODE*, const char*))
+{
+	OSTAT *st = node->of_stat;
+	ONODE *cur;
+	OXENT *e;
+	char *cpath, *cname;
+	size_t i;
+	int ret;
+
+	if(S_ISDIR(st->of_mode)) {
+		ox_add(x, name, '5', st);
+		for(cur = node->subhead; cur != NULL; cur = cur->nextnode) {
+			if(ofs_istypedir(cur))
+				continue;							// 타입 디렉토리는 다른 이름으로 다시 보일 뿐이다 (어느 깊이든)
+			cpath = ox_join(path, cur->name);
+			cname = ox_join(name, cur->name);
+			ox_walk(x, cur, cpath, cname, sync);
+			free(cpath);
+			free(cname);
+		}
+		return;
+	}
+
+	/* 하드 링크는 처음 넣은 이름을 가리킨다 */
+	if(st->of_nlink > 1) {
+		for(i = 0; i < x->nseen && x->seen[i] != st; i++);
+		if(i < x->nseen) {
+			e = ox_add(x, name, '1', st);
+			e->link = strdup(x->ent[x->seen_idx[i]].name);
+			return;
+		}
+		x->seen = (OSTAT**)realloc(x->seen, sizeof(OSTAT*) * (x->nseen + 1));
+		x->seen_idx = (size_t*)realloc(x->seen_idx, sizeof(size_t) * (x->nseen + 1));
+		x->seen[x->nseen] = st;
+		x->seen_idx[x->nseen] = x->cnt;
+		x->nseen++;
+	}
+
+	if(S_ISREG(st->of_mode)) {
+		if(sync != NULL)
+			sync(node, path);
+		e = ox_add(x, name, '0', st);
+		e->size = st->of_size;
+		if(node->of_data != NULL && e->size > 0) {
+			e->data = ofs_data_new();
+			if((ret = ofs_data_clone(e->data, 0, node->of_data, 0, e->size, 1)) != 0) {
+				ofs_data_free(e->data);					// 0으로 채우지 않고 이 파일에서 실패한다
+				e->data = NULL;
+				e->err = ret;
+			}
+		}
+		x->total += e->size;
+	} else if(S_ISLNK(st->of_mode)) {
+		e = ox_add(x, name, '2', st);
+		e->link = (char*)calloc(1, st->of_size + 1);
+		if(node->of_data != NULL && st->of_size > 0)
+			e->err = ofs_data_read(node->of_data, e->link, st->of_size, 0);
+	} else if(S_ISCHR(st->of_mode)) {
+		ox_add(x, name, '3', st);
+	} else if(S_ISBLK(st->of_mode)) {
+		ox_add(x, name, '4', st);
+	} else if(S_ISFIFO(st->of_mode)) {
+		ox_add(x, name, '6', st);
+	}											// 소켓은 tar에 담을 수 없다
+}
+
+OEXPORT* ofs_export_snapshot(ONODE *top, const char *path, void (*sync)(ONODE*, const char*))
+{
+	OEXPORT *x = (OEXPORT*)calloc(1, sizeof(OEXPORT));
+	const char *name = strrchr(path, '/');
+
+	/* tar -C <부모> -c <이름> 과 같은 이름, 루트는 "." */
+	name = (name == NULL || name[1] == '\0')? "." : name + 1;
+	ox_walk(x, top, path, name, sync);
+	free(x->seen);
+	free(x->seen_idx);
+	x->seen = NULL;
+	x->seen_idx = NULL;
+	x->path = strdup(path);
+	x->fd = -1;
+	return x;
+}
+
+static void ox_free(OEXPORT *x)
+{
+	size_t i;
+
+	for(i = 0; i < x->cnt; i++) {
+		free(x->ent[i].name);
+		free(x->ent[i].link);
+		if(x->ent[i].data != NULL)
+			ofs_data_free(x->ent[i].data);
+	}
+	free(x->ent);
+	free(x->path);
+	free(x);
+}
+
+/*
+ * tar 기록
+ * 1MB 버퍼에 헤더를 쓰고 파일 데이터는 청크에서 버퍼로 바로 읽어 한번만 복사한다.
+ * ustar에 들어가지 않는 이름, 링크, 크기, 소유자는 앞에 pax 확장 헤더를 둔다.
+ */
+typedef struct _OXOUT {
+	int		fd;
+	char		*buf;
+	size_t	len;
+	uint64_t	written;
+	int		err;
+	const char	*failed;					// 에러가 난 항목의 이름
+} OXOUT;
+
+static void ox_flush(OXOUT *o)
+{
+	size_t done = 0;
+	ssize_t n;
+
+	while(done < o->len && o->err == 0) {
+		if((n = write(o->fd, o->buf + done, o->len - done)) < 0) {
+			if(errno != EINTR) o->err = -errno;
+			continue;
+		}
+		done += n;
+	}
+	o->written += done;
+	o->len = 0;
+	pthread_mutex_lock(&oxlock);
+	ox.bytes = o->written;
+	pthread_mutex_unlock(&oxlock);
+}
+
+/* 버퍼에 SIZE만큼 자리를 만든다 (SIZE <= OX_BUFSIZE) */
+static char* ox_room(OXOUT *o, size_t size)
+{
+	char *p;
+
+	if(o->len + size > OX_BUFSIZE)
+		ox_flush(o);
+	p = o->buf + o->len;
+	o->len += size;
+	return p;
+}
+
+static void ox_pad(OXOUT *o, uint64_t size)
+{
+	size_t n = (OX_BLOCK - size % OX_BLOCK) % OX_BLOCK;
+
+	if(n > 0)
+		memset(ox_room(o, n), 0, n);
+}
+
+/* 8진수 숫자 필드, 들어가지 않으면 -1 */
+static int ox_octal(char *field, size_t width, uint64_t v)
+{
+	char num[24];									// 64비트 8진수 22자리와 NUL
+
+	if(width > sizeof(num) || (width < 23 && v >= (1ULL << (3 * (width - 1)))))
+		return -1;
+	snprintf(num, sizeof(num), "%0*llo", (int)width - 1, (unsigned long long)v);
+	memcpy(field, num, width);						// 자릿수를 확인했으므로 NUL까지 딱 맞다
+	return 0;
+}
+
+/* pax 레코드 "<len> key=value\n", len은 자기 자신의 자릿수를 포함한 길이 */
+static void ox_pax_record(FILE *fp, const char *key, const char *value)
+{
+	size_t len = strlen(key) + strlen(value) + 3;		// 공백, '=', '\n'
+	size_t total = len + snprintf(NULL, 0, "%zu", len);
+
+	if(snprintf(NULL, 0, "%zu", total) + len > total)		// 자릿수가 늘어나는 경계
+		total++;
+	fprintf(fp, "%zu %s=%s\n", total, key, value);
+}
+
+/* ustar 이름 필드에 들어가는지, 100자를 넘으면 '/'에서 나눌 prefix 길이를 PRE에 넣는다 */
+static int ox_split(const char *name, size_t *pre)
+{
+	size_t len = strlen(name);
+	const char *slash;
+
+	*pre = 0;
+	if(len <= 100)
+		return 1;
+	for(slash = name + len - 101; *slash != '\0' && *slash != '/'; slash++);
+	if(*slash != '/' || (size_t)(slash - name) > 155)
+		return 0;
+	*pre = slash - name;
+	return 1;
+}
+
+static void ox_header(OXOUT *o, const char *name, char type, mode_t mode, uid_t uid, gid_t gid,
+	uint64_t size, time_t mtime, const char *link, dev_t rdev)
+{
+	OXHDR *h = (OXHDR*)ox_room(o, OX_BLOCK);
+	unsigned int sum = 0;
+	size_t i, pre;
+
+	memset(h, 0, OX_BLOCK);
+	/* 들어가지 않는 이름은 pax 헤더에 있으므로 잘라서 넣는다 */
+	if(!ox_split(name, &pre)) {
+		memcpy(h->name, name, sizeof(h->name));
+	} else if(pre > 0) {
+		memcpy(h->prefix, name, pre);
+		memcpy(h->name, name + pre + 1, strlen(name) - pre - 1);
+	} else {
+		memcpy(h->name, name, strlen(name));
+	}
+	ox_octal(h->mode, sizeof(h->mode), mode);
+	if(ox_octal(h->uid, sizeof(h->uid), uid) != 0) ox_octal(h->uid, sizeof(h->uid), 0);
+	if(ox_octal(h->gid, sizeof(h->gid), gid) != 0) ox_octal(h->gid, sizeof(h->gid), 0);
+	if(ox_octal(h->size, sizeof(h->size), size) != 0) ox_octal(h->size, sizeof(h->size), 0);
+	ox_octal(h->mtime, sizeof(h->mtime), (mtime > 0)? (uint64_t)mtime : 0);
+	h->typeflag = type;
+	if(link != NULL)									// 들어가지 않는 링크 이름도 pax 헤더에 있다
+		memcpy(h->linkname, link, (strlen(link) < sizeof(h->linkname))? strlen(link) : sizeof(h->linkname));
+	memcpy(h->magic, "ustar", 6);
+	memcpy(h->version, "00", 2);
+	if(type == '3' || type == '4') {
+		ox_octal(h->devmajor, sizeof(h->devmajor), major(rdev));
+		ox_octal(h->devminor, sizeof(h->devminor), minor(rdev));
+	}
+	memset(h->chksum, ' ', sizeof(h->chksum));
+	for(i = 0; i < OX_BLOCK; i++)
+		sum += ((unsigned char*)h)[i];
+	snprintf(h->chksum, sizeof(h->chksum), "%06o", sum);		// 6자리, NUL, 공백
+	h->chksum[7] = ' ';
+}
+
+/* ustar에 들어가지 않는 값이 있으면 pax 확장 헤더를 먼저 쓴다 */
+static void ox_pax(OXOUT *o, OXENT *e, const char *name)
+{
+	char *buf = NULL, num[32], pname[100];
+	size_t len = 0, plen, pre;
+	FILE *fp;
+	int fits = ox_split(name, &pre);
+
+	if(fits && (e->link == NULL || strlen(e->link) <= 100) && e->uid <= 07777777 && e->gid <= 07777777
+		&& (uint64_t)e->size <= 077777777777ULL)
+		return;
+
+	if((fp = open_memstream(&buf, &len)) == NULL)
+		return;
+	if(!fits)
+		ox_pax_record(fp, "path", name);
+	if(e->link != NULL && strlen(e->link) > 100)
+		ox_pax_record(fp, "linkpath", e->link);
+	if(e->uid > 07777777) {
+		snprintf(num, sizeof(num), "%u", (unsigned int)e->uid);
+		ox_pax_record(fp, "uid", num);
+	}
+	if(e->gid > 07777777) {
+		snprintf(num, sizeof(num), "%u", (unsigned int)e->gid);
+		ox_pax_record(fp, "gid", num);
+	}
+	if((uint64_t)e->size > 077777777777ULL) {
+		snprintf(num, sizeof(num), "%llu", (unsigned long long)e->size);
+		ox_pax_record(fp, "size", num);
+	}
+	fclose(fp);
+
+	snprintf(pname, sizeof(pname), "PaxHeaders/%.80s", strrchr(name, '/')? strrchr(name, '/') + 1 : name);
+	ox_header(o, pname, 'x', 0644, 0, 0, len, e->mtime, NULL, 0);
+	for(plen = 0; plen < len; ) {
+		size_t n = (len - plen > OX_BUFSIZE)? OX_BUFSIZE : len - plen;
+		memcpy(ox_room(o, n), buf + plen, n);
+		plen += n;
+	}
+	ox_pad(o, len);
+	free(buf);
+}
+
+static void ox_entry(OXOUT *o, OXENT *e)
+{
+	char *name = e->name;
+	size_t len = strlen(e->name);
+	off_t off;
+	size_t n;
+	int ret;
+
+	if(e->err != 0) {								// 스냅샷에서 읽지 못한 파일
+		o->err = e->err;
+		o->failed = e->name;
+		return;
+	}
+	if(e->type == '5') {							// 디렉토리 이름은 '/'로 끝난다
+		name = (char*)malloc(len + 2);
+		memcpy(name, e->name, len);
+		strcpy(name + len, "/");
+	}
+	ox_pax(o, e, name);
+	ox_header(o, name, e->type, e->mode, e->uid, e->gid, (e->type == '0')? e->size : 0,
+		e->mtime, e->link, e->rdev);
+	if(name != e->name)
+		free(name);
+	if(e->type != '0')
+		return;
+
+	/* 파일 데이터를 청크에서 버퍼로 바로 읽는다 */
+	for(off = 0; off < e->size && o->err == 0; off += n) {
+		n = (e->size - off > OFS_CHUNK_SIZE)? OFS_CHUNK_SIZE : e->size - off;
+		if(e->data == NULL)							// 데이터 없이 늘어난 파일
+			memset(ox_room(o, n), 0, n);
+		else if((ret = ofs_data_read(e->data, ox_room(o, n), n, off)) != 0) {
+			o->err = ret;								// 체크섬 에러나 보조 파일 I/O 에러
+			o->failed = e->name;
+		}
+	}
+	ox_pad(o, e->size);
+	if(e->data != NULL) {							// 다 쓴 복제본은 바로 놓아 공유를 푼다
+		ofs_data_free(e->data);
+		e->data = NULL;
+	}
+}
+
+static void* ox_thread(void *arg)
+{
+	OEXPORT *x = (OEXPORT*)arg;
+	OXOUT o;
+	size_t i, n;
+
+	memset(&o, 0, sizeof(o));
+	o.fd = x->fd;
+	if((o.buf = (char*)malloc(OX_BUFSIZE)) == NULL)
+		o.err = -ENOMEM;
+	for(i = 0; i < x->cnt && o.err == 0; i++) {
+		ox_entry(&o, &x->ent[i]);
+		pthread_mutex_lock(&oxlock);
+		ox.done = i + 1;
+		pthread_mutex_unlock(&oxlock);
+	}
+	if(o.err == 0) {								// 0 블록 두 개로 끝내고 레코드 크기에 맞춘다
+		n = 2 * OX_BLOCK + (OX_RECORD - (o.written + o.len + 2 * OX_BLOCK) % OX_RECORD) % OX_RECORD;
+		memset(ox_room(&o, n), 0, n);
+		ox_flush(&o);
+	}
+	if(close(x->fd) < 0 && o.err == 0)
+		o.err = -errno;
+	free(o.buf);
+
+	pthread_mutex_lock(&oxlock);
+	clock_gettime(CLOCK_MONOTONIC, &ox.end);
+	ox.err = o.err;
+	ox.failed = (o.failed != NULL)? strdup(o.failed) : NULL;
+	ox.state = (o.err == 0)? OXS_DONE : OXS_FAILED;
+	pthread_mutex_unlock(&oxlock);
+	ox_free(x);
+	return NULL;
+}
+
+int ofs_export_start(OEXPORT *x, const char *dest)
+{
+	int ret;
+
+	pthread_mutex_lock(&oxlock);
+	if(ox.state == OXS_RUNNING) {
+		pthread_mutex_unlock(&oxlock);
+		ox_free(x);
+		return -EBUSY;
+	}
+	if(ox.joinable) {								// 끝난 이전 스레드 정리
+		pthread_join(ox.thread, NULL);
+		ox.joinable = 0;
+	}
+	free(ox.path);
+	free(ox.dest);
+	ox.path = strdup(x->path);
+	ox.dest = strdup(dest);
+	ox.entries = x->cnt;
+	ox.total = x->total;
+	ox.done = 0;
+	ox.bytes = 0;
+	ox.err = 0;
+	free(ox.failed);
+	ox.failed = NULL;
+	clock_gettime(CLOCK_MONOTONIC, &ox.start);
+	ox.end = ox.start;
+
+	/* FUSE 요청을 막지 않도록 기다리지 않고 연다, FIFO는 읽는 쪽이 먼저 열려 있어야 한다 */
+	if((x->fd = open(dest, O_WRONLY | O_CREAT | O_TRUNC | O_NONBLOCK | O_CLOEXEC, 0644)) < 0) {
+		ox.err = ret = -errno;
+		ox.state = OXS_FAILED;
+		pthread_mutex_unlock(&oxlock);
+		ox_free(x);
+		return ret;
+	}
+	fcntl(x->fd, F_SETFL, fcntl(x->fd, F_GETFL) & ~O_NONBLOCK);
+	ox.state = OXS_RUNNING;
+	if(pthread_create(&ox.thread, NULL, ox_thread, x) != 0) {
+		close(x->fd);
+		ox.err = -EAGAIN;
+		ox.state = OXS_FAILED;
+		pthread_mutex_unlock(&oxlock);
+		ox_free(x);
+		return -EAGAIN;
+	}
+	ox.joinable = 1;
+	pthread_mutex_unlock(&oxlock);
+	return 0;
+}
+
+int ofs_export_busy(void)
+{
+	int ret;
+
+	pthread_mutex_lock(&oxlock);
+	ret = (ox.state == OXS_RUNNING);
+	pthread_mutex_unlock(&oxlock);
+	return ret;
+}
+
+void ofs_export_wait(void)
+{
+	pthread_mutex_lock(&oxlock);
+	if(ox.joinable) {
+		ox.joinable = 0;
+		pthread_mutex_unlock(&oxlock);
+		pthread_join(ox.thread, NULL);
+		return;
+	}
+	pthread_mutex_unlock(&oxlock);
+}
+
+char* ofs_export_show(size_t *len)
+{
+	struct timespec now;
+	FILE *fp;
+	char *buf = NULL;
+	double sec;
+
+	if((fp = open_memstream(&buf, len)) == NULL)
+		return NULL;
+	pthread_mutex_lock(&oxlock);
+	if(ox.state == OXS_RUNNING)
+		clock_gettime(CLOCK_MONOTONIC, &now);
+	else
+		now = ox.end;
+	sec = (now.tv_sec - ox.start.tv_sec) + (now.tv_nsec - ox.start.tv_nsec) / 1e9;
+	fprintf(fp, "state     %s\n", state_names[ox.state]);
+	if(ox.state != OXS_IDLE) {
+		fprintf(fp, "subtree   %s\n", ox.path);
+		fprintf(fp, "dest      %s\n", ox.dest);
+		fprintf(fp, "entries   %zu / %zu\n", ox.done, ox.entries);
+		fprintf(fp, "data      %llu\n", (unsigned long long)ox.total);
+		fprintf(fp, "written   %llu\n", (unsigned long long)ox.bytes);
+		fprintf(fp, "seconds   %.3f\n", sec);
+		fprintf(fp, "MB/s      %.1f\n", (sec > 0)? ox.bytes / sec / (1 << 20) : 0.0);
+		if(ox.err != 0)
+			fprintf(fp, "error     %s\n", strerror(-ox.err));
+		if(ox.failed != NULL)
+			fprintf(fp, "file      %s\n", ox.failed);
+	}
+	fprintf(fp, "# write \"<subtree> <local file or fifo>\" to export a tar archive\n");
+	pthread_mutex_unlock(&oxlock);
+	fclose(fp);
+	return buf;
+}
+
+void ofs_export_reset(void)
+{
+	pthread_mutex_lock(&oxlock);
+	if(ox.state != OXS_RUNNING)
+		ox.state = OXS_IDLE;
+	pthread_mutex_unlock(&oxlock);
+}
@@ -0,0 +1,62 @@
+﻿#ifndef __EXPORT_H
+#define __EXPORT_H
+#include <sys/types.h>
+#include <stdint.h>
+#include "node.h"
+
+/* 트리에서 떼어 낸 내보내기 목록, 스냅샷 이후에는 트리 잠금 없이 기록한다 */
+typedef struct _OEXPORT OEXPORT;
+
+/*######################################
+ 이름 : ofs_export_snapshot
+ 요약 : 서브트리를 내보내기 목록으로 복제 (트리 잠금 안에서 호출)
+ 		파일 데이터는 청크를 공유하는 복제본으로 잡아 두므로 이후의 쓰기와 상관없이 일관된다
+ 		'_'로 시작하는 타입 디렉토리는 넣지 않는다, SYNC는 파일마다 데이터를 잡기 전에 호출
+ 매개변수 : ONODE* [TOP], const char* [PATH], void (*)(ONODE*, const char*) [SYNC]
+ 반환값 : 내보내기 목록
+ #######################################*/
+OEXPORT* 	ofs_export_snapshot	(ONODE*, const char*, void (*)(ONODE*, const char*));
+
+/*######################################
+ 이름 : ofs_export_start
+ 요약 : 목록을 tar(ustar, 긴 이름은 pax)로 기록하는 스레드 시작, 목록은 스레드가 해제한다
+ 		DEST는 로컬 파일이나 FIFO, 이미 진행 중이면 목록을 해제하고 실패
+ 		파일 데이터를 읽지 못하면 (체크섬, 보조 파일 에러) 그 파일에서 멈추고 failed로 끝난다
+ 매개변수 : OEXPORT* [EXPORT], const char* [DEST]
+ 반환값 : 성공시 0, 실패시 음수
+ #######################################*/
+int 		ofs_export_start		(OEXPORT*, const char*);
+
+/*######################################
+ 이름 : ofs_export_busy
+ 요약 : 내보내기가 진행 중인지
+ 매개변수 : 없음
+ 반환값 : 진행 중이면 1, 아니면 0
+ #######################################*/
+int 		ofs_export_busy		(void);
+
+/*######################################
+ 이름 : ofs_export_wait
+ 요약 : 진행 중인 내보내기가 끝날 때까지 기다린다 (마운트 해제시)
+ 매개변수 : 없음
+ 반환값 : 없음
+ #######################################*/
+void 		ofs_export_wait		(void);
+
+/*######################################
+ 이름 : ofs_export_show
+ 요약 : 진행 중이거나 마지막 내보내기의 상태와 처리량을 글로 만든다
+ 매개변수 : size_t* [LEN]
+ 반환값 : malloc된 문자열, 호출자가 해제
+ #######################################*/
+char* 	ofs_export_show		(size_t*);
+
+/*######################################
+ 이름 : ofs_export_reset
+ 요약 : 끝난 내보내기의 상태를 지운다
+ 매개변수 : 없음
+ 반환값 : 없음
+ #######################################*/
+void 		ofs_export_reset		(void);
+
+#endif
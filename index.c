@@ -0,0 +1,263 @@
+﻿#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "index.h"
+
+#define OIX_MAXLEVEL	24				// 스킵 리스트 최대 높이 (4^24개까지 O(log n))
+#define OIX_HASH_MIN	1024
+
+/* 색인된 파일 하나, 값마다 스킵 리스트 하나에 들어 있다 */
+typedef struct _OIXENT {
+	OSTAT			*stat;
+	ino_t			id;
+	int64_t			key[OIX_NFIELD];		// 스킵 리스트에 들어 있는 값 (stat이 바뀌면 다시 넣는다)
+	ONODE			**link;				// 이 파일을 가리키는 노드 (하드 링크가 아니면 하나)
+	uint32_t			nlink;
+	uint32_t			cap;
+	struct _OIXENT	*hnext;				// 노드 번호 해시 체인
+	uint8_t			level[OIX_NFIELD];
+	struct _OIXENT	**next[OIX_NFIELD];		// 값마다 높이만큼의 다음 항목 (fwd를 나눠 쓴다)
+	struct _OIXENT	*fwd[];
+} OIXENT;
+
+static int 		enabled;
+static OIXENT	*head[OIX_NFIELD][OIX_MAXLEVEL];
+static OIXENT	**htab;
+static size_t 	nhash, count;
+static uint32_t	seed = 2463534242U;
+
+int ofs_index_enabled(void)
+{
+	return enabled;
+}
+
+int64_t ofs_index_value(OSTAT *stat, int field)
+{
+	return (field == OIX_SIZE)? (int64_t)stat->of_size : (int64_t)stat->of_mtime.tv_sec;
+}
+
+/* 높이 : 1/4 확률로 한 단씩 높인다 */
+static uint8_t oix_level(void)
+{
+	uint8_t level = 1;
+
+	for(;;) {
+		seed ^= seed << 13;
+		seed ^= seed >> 17;
+		seed ^= seed << 5;
+		if((seed & 3) != 0 || level == OIX_MAXLEVEL)
+			return level;
+		level++;
+	}
+}
+
+/* 값이 같으면 노드 번호로 순서를 정한다 */
+static int oix_before(int f, const OIXENT *a, const OIXENT *b)
+{
+	return (a->key[f] != b->key[f])? a->key[f] < b->key[f] : a->id < b->id;
+}
+
+static void oix_link(int f, OIXENT *e)
+{
+	OIXENT **slot = head[f], **prev[OIX_MAXLEVEL];
+	int l;
+
+	for(l = OIX_MAXLEVEL - 1; l >= 0; l--) {
+		while(slot[l] != NULL && oix_before(f, slot[l], e))
+			slot = slot[l]->next[f];
+		prev[l] = &slot[l];
+	}
+	for(l = 0; l < e->level[f]; l++) {
+		e->next[f][l] = *prev[l];
+		*prev[l] = e;
+	}
+}
+
+static void oix_unlink(int f, OIXENT *e)
+{
+	OIXENT **slot = head[f];
+	int l;
+
+	for(l = OIX_MAXLEVEL - 1; l >= 0; l--) {
+		while(slot[l] != NULL && slot[l] != e && oix_before(f, slot[l], e))
+			slot = slot[l]->next[f];
+		if(slot[l] == e)
+			slot[l] = e->next[f][l];
+	}
+}
+
+static OIXENT** oix_bucket(ino_t id)
+{
+	return &htab[(id * 0x9e3779b97f4a7c15ULL >> 20) & (nhash - 1)];
+}
+
+static OIXENT* oix_find(ino_t id)
+{
+	OIXENT *e;
+
+	if(htab == NULL)
+		return NULL;
+	for(e = *oix_bucket(id); e != NULL; e = e->hnext)
+		if(e->id == id) return e;
+	return NULL;
+}
+
+/* 항목이 버킷 수를 넘으면 해시를 두 배로 늘린다 */
+static void oix_rehash(void)
+{
+	OIXENT **old = htab, *e, *next, **b;
+	size_t i, oldn = nhash;
+
+	nhash = (nhash == 0)? OIX_HASH_MIN : nhash * 2;
+	if((htab = (OIXENT**)calloc(nhash, sizeof(OIXENT*))) == NULL) {
+		htab = old;
+		nhash = oldn;
+		return;
+	}
+	for(i = 0; i < oldn; i++) {
+		for(e = old[i]; e != NULL; e = next) {
+			next = e->hnext;
+			b = oix_bucket(e->id);
+			e->hnext = *b;
+			*b = e;
+		}
+	}
+	free(old);
+}
+
+void ofs_index_add(ONODE *node)
+{
+	OSTAT *st = node->of_stat;
+	OIXENT *e, **b;
+	uint8_t level[OIX_NFIELD];
+	int f;
+
+	if(!enabled || !S_ISREG(st->of_mode))
+		return;
+	if((e = oix_find(st->of_id)) == NULL) {
+		for(f = 0; f < OIX_NFIELD; f++)
+			level[f] = oix_level();
+		e = (OIXENT*)calloc(1, sizeof(OIXENT) + sizeof(OIXENT*) * (level[OIX_SIZE] + level[OIX_MTIME]));
+		if(e == NULL)
+			return;
+		e->stat = st;
+		e->id = st->of_id;
+		e->next[OIX_SIZE] = e->fwd;
+		e->next[OIX_MTIME] = e->fwd + level[OIX_SIZE];
+		for(f = 0; f < OIX_NFIELD; f++) {
+			e->level[f] = level[f];
+			e->key[f] = ofs_index_value(st, f);
+			oix_link(f, e);
+		}
+		if(count >= nhash)
+			oix_rehash();
+		b = oix_bucket(e->id);
+		e->hnext = *b;
+		*b = e;
+		count++;
+	}
+	if(e->nlink == e->cap) {
+		e->cap = (e->cap == 0)? 1 : e->cap * 2;
+		e->link = (ONODE**)realloc(e->link, sizeof(ONODE*) * e->cap);
+	}
+	e->link[e->nlink++] = node;
+}
+
+void ofs_index_del(ONODE *node)
+{
+	OIXENT *e, **b;
+	uint32_t i;
+	int f;
+
+	if(!enabled || (e = oix_find(node->of_stat->of_id)) == NULL)
+		return;
+	for(i = 0; i < e->nlink && e->link[i] != node; i++);
+	if(i == e->nlink)
+		return;
+	memmove(&e->link[i], &e->link[i + 1], sizeof(ONODE*) * (e->nlink - i - 1));
+	if(--e->nlink > 0)
+		return;
+
+	/* 마지막 링크 - 파일을 뺀다 */
+	for(f = 0; f < OIX_NFIELD; f++)
+		oix_unlink(f, e);
+	for(b = oix_bucket(e->id); *b != e; b = &(*b)->hnext);
+	*b = e->hnext;
+	count--;
+	free(e->link);
+	free(e);
+}
+
+void ofs_index_update(OSTAT *stat)
+{
+	OIXENT *e;
+	int64_t key;
+	int f;
+
+	if(!enabled || (e = oix_find(stat->of_id)) == NULL)
+		return;
+	for(f = 0; f < OIX_NFIELD; f++) {
+		if((key = ofs_index_value(stat, f)) == e->key[f])		// 같은 초 안의 덮어쓰기 등은 그대로
+			continue;
+		oix_unlink(f, e);
+		e->key[f] = key;
+		oix_link(f, e);
+	}
+}
+
+size_t ofs_index_scan(int field, int64_t lo, int64_t hi, int (*fn)(ONODE*, void*), void *arg)
+{
+	OIXENT **slot = head[field], *e;
+	size_t n = 0;
+	int l;
+
+	if(!enabled || lo > hi)
+		return 0;
+	for(l = OIX_MAXLEVEL - 1; l >= 0; l--)				// LO 이상인 첫 항목 바로 앞까지
+		while(slot[l] != NULL && slot[l]->key[field] < lo)
+			slot = slot[l]->next[field];
+	for(e = slot[0]; e != NULL && e->key[field] <= hi; e = e->next[field][0]) {
+		n++;
+		if(fn(e->link[0], arg) != 0)
+			break;
+	}
+	return n;
+}
+
+ONODE* ofs_index_find(ino_t id)
+{
+	OIXENT *e;
+
+	if(!enabled || (e = oix_find(id)) == NULL)
+		return NULL;
+	return e->link[0];
+}
+
+ONODE* ofs_index_pick(ONODE *node, int (*fn)(ONODE*))
+{
+	OIXENT *e;
+	uint32_t i;
+
+	if(!enabled || (e = oix_find(node->of_stat->of_id)) == NULL)
+		return NULL;
+	for(i = 0; i < e->nlink; i++)
+		if(fn(e->link[i]))
+			return e->link[i];
+	return NULL;
+}
+
+static void oix_walk(ONODE *node)
+{
+	ONODE *cur;
+
+	ofs_index_add(node);
+	for(cur = node->subhead; cur != NULL; cur = cur->nextnode)
+		oix_walk(cur);
+}
+
+void ofs_index_build(ONODE *root)
+{
+	enabled = 1;
+	oix_walk(root);
+}
@@ -0,0 +1,88 @@
+﻿#ifndef __INDEX_H
+#define __INDEX_H
+#include <sys/types.h>
+#include <stdint.h>
+#include "node.h"
+
+/* 색인하는 값 */
+enum {
+	OIX_SIZE = 0,			// of_size
+	OIX_MTIME,			// of_mtime
+	OIX_NFIELD
+};
+
+/*######################################
+ 이름 : ofs_index_build
+ 요약 : 트리의 일반 파일로 크기/수정 시각 색인을 만들고 이후의 변경을 반영하기 시작
+ 		하드 링크는 파일 하나로 센다, 이후 모든 함수는 트리 잠금 안에서 호출
+ 매개변수 : ONODE* [ROOT]
+ 반환값 : 없음
+ #######################################*/
+void 		ofs_index_build		(ONODE*);
+
+/*######################################
+ 이름 : ofs_index_enabled
+ 요약 : 색인 사용 여부
+ 매개변수 : 없음
+ 반환값 : 사용중이면 1, 아니면 0
+ #######################################*/
+int 		ofs_index_enabled	(void);
+
+/*######################################
+ 이름 : ofs_index_add
+ 요약 : 트리에 들어온 일반 파일 노드를 색인에 넣는다 (하드 링크면 링크만 더한다)
+ 매개변수 : ONODE* [NODE]
+ 반환값 : 없음
+ #######################################*/
+void 		ofs_index_add		(ONODE*);
+
+/*######################################
+ 이름 : ofs_index_del
+ 요약 : 트리에서 빠지는 노드를 색인에서 뺀다, 마지막 링크면 파일을 뺀다 (노드 정보를 해제하기 전에 호출)
+ 매개변수 : ONODE* [NODE]
+ 반환값 : 없음
+ #######################################*/
+void 		ofs_index_del		(ONODE*);
+
+/*######################################
+ 이름 : ofs_index_update
+ 요약 : 크기나 수정 시각이 바뀐 파일의 색인 위치를 옮긴다
+ 매개변수 : OSTAT* [STAT]
+ 반환값 : 없음
+ #######################################*/
+void 		ofs_index_update	(OSTAT*);
+
+/*######################################
+ 이름 : ofs_index_scan
+ 요약 : FIELD 값이 [LO, HI] 안에 있는 파일을 값 순서로 FN에 넘긴다, FN이 0이 아닌 값을 돌려주면 멈춘다
+ 		FN에는 파일의 첫 링크 노드를 넘긴다
+ 매개변수 : int [FIELD], int64_t [LO], int64_t [HI], int (*)(ONODE*, void*) [FN], void* [ARG]
+ 반환값 : FN에 넘긴 파일 수
+ #######################################*/
+size_t 	ofs_index_scan		(int, int64_t, int64_t, int (*)(ONODE*, void*), void*);
+
+/*######################################
+ 이름 : ofs_index_find
+ 요약 : 노드 번호로 색인된 파일의 첫 링크 노드를 찾는다
+ 매개변수 : ino_t [ID]
+ 반환값 : 찾은 노드, 없으면 NULL
+ #######################################*/
+ONODE* 	ofs_index_find		(ino_t);
+
+/*######################################
+ 이름 : ofs_index_pick
+ 요약 : NODE와 같은 파일의 링크 노드 중 FN이 0이 아닌 값을 돌려주는 첫 노드를 찾는다
+ 매개변수 : ONODE* [NODE], int (*)(ONODE*) [FN]
+ 반환값 : 찾은 노드, 없으면 NULL
+ #######################################*/
+ONODE* 	ofs_index_pick		(ONODE*, int (*)(ONODE*));
+
+/*######################################
+ 이름 : ofs_index_value
+ 요약 : 파일의 색인 값
+ 매개변수 : OSTAT* [STAT], int [FIELD]
+ 반환값 : 값
+ #######################################*/
+int64_t	ofs_index_value		(OSTAT*, int);
+
+#endif
@@ -0,0 +1,354 @@
+﻿#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/stat.h>
+#include "journal.h"
+
+#define OJ_MAGIC		0x4a53464fU				// "OFSJ"
+
+/* 디스크상의 레코드 헤더, 뒤에 path, path2, data가 이어진다 */
+typedef struct _OJHDR {
+	uint32_t	magic;
+	uint32_t	len;							// 헤더를 포함한 레코드 전체 길이
+	uint32_t	sum;							// sum 필드 이후 전체에 대한 체크섬
+	uint16_t	type;
+	uint16_t	pad;
+	uint64_t	lsn;
+	uint32_t	uid;
+	uint32_t	gid;
+	uint64_t	arg[3];
+	uint32_t	pathlen;
+	uint32_t	path2len;
+	uint32_t	datalen;
+	uint32_t	pad2;
+} OJHDR;
+
+typedef struct _OJBUF {
+	char		*buf;
+	size_t	len;
+	size_t	cap;
+	uint64_t	last;							// 버퍼에 담긴 마지막 LSN
+} OJBUF;
+
+static int 			jfd = -1;
+static int 			commit_ms;
+static off_t 			checkpoint_size;
+static off_t 			jsize;							// 디스크에 기록된 저널 크기
+static uint64_t 		next_lsn = 1;
+static uint64_t 		durable_lsn;
+static int 			jerr;							// 기록 실패 (음수 errno), 체크포인트가 성공할 때까지 유지
+static OJBUF 		active, spare;
+static int 			running, stopping, waiters, committing;
+static pthread_t 		flusher;
+static pthread_mutex_t	jlock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t	jwork = PTHREAD_COND_INITIALIZER;	// 커밋 스레드 깨우기
+static pthread_cond_t	jdone = PTHREAD_COND_INITIALIZER;	// 커밋 완료 알림
+static void 			(*checkpoint_cb)(void);
+
+static uint32_t oj_sum(const char *p, size_t len, uint32_t h)
+{
+	size_t i;
+	for(i = 0; i < len; i++) {			// FNV-1a
+		h ^= (unsigned char)p[i];
+		h *= 16777619U;
+	}
+	return h;
+}
+
+static void oj_reserve(OJBUF *b, size_t len)
+{
+	if(b->len + len <= b->cap) return;
+	while(b->len + len > b->cap)
+		b->cap = (b->cap == 0)? 65536 : b->cap * 2;
+	b->buf = (char*)realloc(b->buf, b->cap);
+}
+
+int ofs_journal_open(const char *path, int _commit_ms, off_t _checkpoint_size)
+{
+	struct stat st;
+
+	if((jfd = open(path, O_RDWR | O_CREAT, 0600)) < 0)
+		return -errno;
+	if(fstat(jfd, &st) < 0) {
+		close(jfd);
+		jfd = -1;
+		return -errno;
+	}
+	jsize = st.st_size;
+	commit_ms = (_commit_ms < 0)? 0 : _commit_ms;
+	checkpoint_size = _checkpoint_size;
+	return 0;
+}
+
+int ofs_journal_enabled(void)
+{
+	return jfd >= 0;
+}
+
+int ofs_journal_replay(uint64_t from, int (*apply)(const OJREC*))
+{
+	OJHDR hdr;
+	OJREC rec;
+	char *body = NULL;
+	size_t cap = 0, blen;
+	off_t pos = 0;
+	int count = 0;
+
+	if(jfd < 0) return -EBADF;
+	while(pread(jfd, &hdr, sizeof(hdr), pos) == sizeof(hdr)) {
+		if(hdr.magic != OJ_MAGIC || hdr.len < sizeof(hdr)
+			|| hdr.len != sizeof(hdr) + hdr.pathlen + hdr.path2len + hdr.datalen)
+			break;											// 깨진 헤더
+		blen = hdr.len - sizeof(hdr);
+		if(blen > cap) {
+			cap = blen;
+			body = (char*)realloc(body, cap);
+		}
+		if(pread(jfd, body, blen, pos + sizeof(hdr)) != (ssize_t)blen)
+			break;											// 기록이 중간에 끊긴 레코드
+		if(oj_sum(body, blen, oj_sum((char*)&hdr.type, sizeof(hdr) - offsetof(OJHDR, type), 2166136261U)) != hdr.sum)
+			break;
+
+		/* 체크포인트 이미지에 이미 반영된 레코드는 건너뛴다 */
+		if(hdr.lsn > from) {
+			rec.lsn = hdr.lsn;
+			rec.type = hdr.type;
+			rec.uid = hdr.uid;
+			rec.gid = hdr.gid;
+			memcpy(rec.arg, hdr.arg, sizeof(rec.arg));
+			rec.path = body;
+			rec.path2 = (hdr.path2len > 0)? body + hdr.pathlen : NULL;
+			rec.data = body + hdr.pathlen + hdr.path2len;
+			rec.datalen = hdr.datalen;
+			apply(&rec);
+			count++;
+		}
+		if(hdr.lsn >= next_lsn) next_lsn = hdr.lsn + 1;
+		pos += hdr.len;
+	}
+	free(body);
+
+	/* 깨진 꼬리를 잘라내고 이어서 기록한다 */
+	if(pos != jsize) {
+		if(ftruncate(jfd, pos) < 0) return -errno;
+		jsize = pos;
+	}
+	durable_lsn = next_lsn - 1;
+	return count;
+}
+
+void ofs_journal_setlsn(uint64_t lsn)
+{
+	if(lsn >= next_lsn) next_lsn = lsn + 1;
+	durable_lsn = next_lsn - 1;
+}
+
+uint64_t ofs_journal_lsn(void)
+{
+	uint64_t lsn;
+	pthread_mutex_lock(&jlock);
+	lsn = next_lsn - 1;
+	pthread_mutex_unlock(&jlock);
+	return lsn;
+}
+
+uint64_t ofs_journal_append(OJREC *rec)
+{
+	OJHDR hdr;
+	size_t pathlen, path2len;
+	char *p;
+
+	if(jfd < 0) return 0;
+	pathlen = strlen(rec->path) + 1;
+	path2len = (rec->path2 != NULL)? strlen(rec->path2) + 1 : 0;
+
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.magic = OJ_MAGIC;
+	hdr.len = sizeof(hdr) + pathlen + path2len + rec->datalen;
+	hdr.type = rec->type;
+	hdr.uid = rec->uid;
+	hdr.gid = rec->gid;
+	memcpy(hdr.arg, rec->arg, sizeof(hdr.arg));
+	hdr.pathlen = pathlen;
+	hdr.path2len = path2len;
+	hdr.datalen = rec->datalen;
+
+	pthread_mutex_lock(&jlock);
+	rec->lsn = hdr.lsn = next_lsn++;
+	oj_reserve(&active, hdr.len);
+	p = active.buf + active.len;
+	memcpy(p + sizeof(hdr), rec->path, pathlen);
+	if(path2len > 0) memcpy(p + sizeof(hdr) + pathlen, rec->path2, path2len);
+	if(rec->datalen > 0) memcpy(p + sizeof(hdr) + pathlen + path2len, rec->data, rec->datalen);
+	hdr.sum = oj_sum(p + sizeof(hdr), hdr.len - sizeof(hdr),
+		oj_sum((char*)&hdr.type, sizeof(hdr) - offsetof(OJHDR, type), 2166136261U));
+	memcpy(p, &hdr, sizeof(hdr));
+	active.len += hdr.len;
+	active.last = hdr.lsn;
+	pthread_mutex_unlock(&jlock);
+
+	return hdr.lsn;
+}
+
+/* 잠금을 잡은 상태에서 호출, 활성 버퍼를 교체하고 디스크에 기록한다 */
+static void oj_commit_locked(void)
+{
+	OJBUF tmp;
+	size_t done = 0;
+	ssize_t n;
+	int err = 0;
+
+	while(committing)								// 다른 스레드가 기록 중이면 끝날 때까지 대기
+		pthread_cond_wait(&jdone, &jlock);
+	if(active.len == 0) return;
+	committing = 1;
+	tmp = active;
+	active = spare;
+	active.len = 0;
+	pthread_mutex_unlock(&jlock);
+
+	/* 커밋하는 동안 들어온 레코드는 다음 fdatasync에 묶인다 
+	 * 앞선 기록이 실패했으면 이후 레코드는 쓰지 않는다 (빠진 레코드 뒤의 레코드를 재실행하지 않도록) */
+	if(jerr != 0)
+		err = jerr;
+	while(err == 0 && done < tmp.len) {
+		n = pwrite(jfd, tmp.buf + done, tmp.len - done, jsize + done);
+		if(n <= 0) {
+			if(n < 0 && errno == EINTR) continue;
+			err = (n < 0)? -errno : -EIO;
+			break;
+		}
+		done += n;
+	}
+	if(err == 0 && fdatasync(jfd) != 0)
+		err = -errno;
+
+	pthread_mutex_lock(&jlock);
+	if(err == 0) {
+		jsize += done;
+		if(tmp.last > durable_lsn) durable_lsn = tmp.last;
+	} else if(jerr == 0) {								// 다음 체크포인트까지 실패 상태
+		errno = -err;
+		perror("ofs journal");
+		jerr = err;
+		if(done > 0 && ftruncate(jfd, jsize) != 0)		// 반쯤 쓴 레코드는 잘라 낸다 (재실행은 체크섬에서도 멈춘다)
+			perror("ofs journal");
+	}
+	spare = tmp;
+	spare.len = 0;
+	committing = 0;
+	pthread_cond_broadcast(&jdone);
+}
+
+static void* oj_flusher(void *arg)
+{
+	struct timespec ts;
+	(void)arg;
+
+	pthread_mutex_lock(&jlock);
+	while(!stopping) {
+		if(commit_ms > 0) {
+			clock_gettime(CLOCK_REALTIME, &ts);
+			ts.tv_sec += commit_ms / 1000;
+			ts.tv_nsec += (commit_ms % 1000) * 1000000L;
+			if(ts.tv_nsec >= 1000000000L) {
+				ts.tv_sec++;
+				ts.tv_nsec -= 1000000000L;
+			}
+			pthread_cond_timedwait(&jwork, &jlock, &ts);
+		} else {
+			while(!stopping && (active.len == 0 || waiters == 0))
+				pthread_cond_wait(&jwork, &jlock);
+		}
+		oj_commit_locked();
+
+		/* 저널이 커지면 체크포인트로 복구 시간을 제한한다, 기록에 실패했으면 체크포인트로 되살린다 */
+		if(checkpoint_cb != NULL && (jerr != 0 || (checkpoint_size > 0 && jsize >= checkpoint_size))) {
+			pthread_mutex_unlock(&jlock);
+			checkpoint_cb();
+			pthread_mutex_lock(&jlock);
+		}
+	}
+	oj_commit_locked();
+	pthread_mutex_unlock(&jlock);
+	return NULL;
+}
+
+int ofs_journal_start(void (*checkpoint)(void))
+{
+	if(jfd < 0 || running) return 0;
+	checkpoint_cb = checkpoint;
+	stopping = 0;
+	if(pthread_create(&flusher, NULL, oj_flusher, NULL) != 0)
+		return -EAGAIN;
+	running = 1;
+	return 0;
+}
+
+int ofs_journal_wait(uint64_t lsn)
+{
+	int ret;
+
+	if(lsn == 0 || commit_ms > 0) return 0;				// 주기 커밋 모드는 기다리지 않는다
+
+	pthread_mutex_lock(&jlock);
+	if(!running) {									// 커밋 스레드가 없으면 직접 기록
+		oj_commit_locked();
+	} else {
+		waiters++;
+		pthread_cond_signal(&jwork);
+		while(durable_lsn < lsn && jerr == 0)
+			pthread_cond_wait(&jdone, &jlock);
+		waiters--;
+	}
+	ret = (durable_lsn >= lsn)? 0 : (jerr != 0)? jerr : -EIO;
+	pthread_mutex_unlock(&jlock);
+	return ret;
+}
+
+void ofs_journal_checkpointed(uint64_t lsn)
+{
+	if(jfd < 0) return;
+	pthread_mutex_lock(&jlock);
+	/* 트리 잠금 안에서 호출되므로 버퍼의 레코드는 모두 이미지에 들어 있다 */
+	active.len = 0;
+	if(ftruncate(jfd, 0) == 0) {
+		jsize = 0;
+		if(fdatasync(jfd) == 0)
+			jerr = 0;								// 실패로 빠진 레코드도 이미지에 들어 있다
+	}
+	if(lsn > durable_lsn) durable_lsn = lsn;
+	pthread_cond_broadcast(&jdone);
+	pthread_mutex_unlock(&jlock);
+}
+
+void ofs_journal_close(void)
+{
+	if(jfd < 0) return;
+	pthread_mutex_lock(&jlock);
+	if(running) {
+		stopping = 1;
+		pthread_cond_signal(&jwork);
+		pthread_mutex_unlock(&jlock);
+		pthread_join(flusher, NULL);
+		pthread_mutex_lock(&jlock);
+		running = 0;
+	}
+	oj_commit_locked();
+	pthread_mutex_unlock(&jlock);
+
+	/* 마지막 체크포인트로 다음 마운트의 복구 작업을 없앤다 */
+	if(checkpoint_cb != NULL) checkpoint_cb();
+	close(jfd);
+	jfd = -1;
+	free(active.buf);
+	free(spare.buf);
+	memset(&active, 0, sizeof(active));
+	memset(&spare, 0, sizeof(spare));
+}
@@ -0,0 +1,121 @@
+﻿#ifndef __JOURNAL_H
+#define __JOURNAL_H
+#include <sys/types.h>
+#include <stdint.h>
+
+/* 저널 레코드 종류 */
+enum {
+	OJ_MKNOD = 1,			// arg0 : mode, arg1 : dev
+	OJ_MKDIR,				// arg0 : mode
+	OJ_UNLINK,
+	OJ_RMDIR,
+	OJ_SYMLINK,			// path : 링크 대상, path2 : 새 링크
+	OJ_LINK,				// path : 원본, path2 : 새 이름
+	OJ_RENAME,			// path : 이전 이름, path2 : 새 이름
+	OJ_WRITE,				// arg0 : offset, data : 기록한 데이터
+	OJ_TRUNCATE,			// arg0 : length, arg1 : 1이면 늘어난 부분을 미리 할당
+	OJ_CHMOD,				// arg0 : mode
+	OJ_CHOWN,				// arg0 : uid, arg1 : gid
+	OJ_UTIME,				// arg0 : atime, arg1 : mtime, arg2 : 나노초 (atime << 32 | mtime)
+	OJ_CLONE,				// path : 원본, path2 : 대상, arg0 : 원본 offset, arg1 : 대상 offset, arg2 : 길이 (-1이면 파일 전체)
+	OJ_FALLOCATE,			// arg0 : mode, arg1 : offset, arg2 : 길이
+	OJ_RMTREE,			// path : 지울 서브트리
+	OJ_MOVE,				// path : 원본 디렉토리, path2 : 항목을 옮길 디렉토리
+	OJ_SETXATTR,			// path2 : 속성 이름, arg0 : flags, data : 값
+	OJ_REMOVEXATTR,		// path2 : 속성 이름
+	OJ_BATCH				// path : 디렉토리, arg0 : 항목 수, data : 묶음 (ofs_batch_ent 목록)
+};
+
+typedef struct _OJREC {
+	uint64_t		lsn;			// 레코드 일련 번호
+	uint16_t		type;
+	uid_t		uid;			// 연산을 요청한 사용자
+	gid_t		gid;
+	uint64_t		arg[3];
+	const char	*path;
+	const char	*path2;
+	const char	*data;
+	uint32_t		datalen;
+} OJREC;
+
+/*######################################
+ 이름 : ofs_journal_open
+ 요약 : 저널 파일을 열고 그룹 커밋 설정
+ 매개변수 : const char* [PATH], int [COMMIT_MS], off_t [CHECKPOINT_SIZE]
+ 반환값 : 성공시 0, 실패시 음수
+ #######################################*/
+int 		ofs_journal_open		(const char*, int, off_t);
+
+/*######################################
+ 이름 : ofs_journal_replay
+ 요약 : 저널에서 LSN 이후의 레코드를 순서대로 재실행, 깨진 꼬리는 잘라낸다
+ 매개변수 : uint64_t [FROM_LSN], int (*)(const OJREC*) [APPLY]
+ 반환값 : 재실행한 레코드 수, 실패시 음수
+ #######################################*/
+int 		ofs_journal_replay		(uint64_t, int (*)(const OJREC*));
+
+/*######################################
+ 이름 : ofs_journal_start
+ 요약 : 그룹 커밋 스레드 시작 (데몬화 이후에 호출해야 한다)
+ 매개변수 : void (*)(void) [CHECKPOINT]
+ 반환값 : 성공시 0, 실패시 음수
+ #######################################*/
+int 		ofs_journal_start		(void (*)(void));
+
+/*######################################
+ 이름 : ofs_journal_append
+ 요약 : 레코드를 커밋 버퍼에 추가 (트리 쓰기 잠금 안에서 호출)
+ 매개변수 : OJREC* [RECORD]
+ 반환값 : 부여된 LSN, 저널이 꺼져 있으면 0
+ #######################################*/
+uint64_t	ofs_journal_append	(OJREC*);
+
+/*######################################
+ 이름 : ofs_journal_wait
+ 요약 : 동기 커밋 모드에서 LSN이 디스크에 기록될 때까지 대기
+ 매개변수 : uint64_t [LSN]
+ 반환값 : 기록되었으면 0, 기록에 실패했으면 음수 (다음 체크포인트까지 계속 실패한다)
+ #######################################*/
+int 		ofs_journal_wait		(uint64_t);
+
+/*######################################
+ 이름 : ofs_journal_checkpointed
+ 요약 : 체크포인트 이미지가 LSN까지 반영했음을 알리고 저널을 비운다
+ 매개변수 : uint64_t [LSN]
+ 반환값 : 없음
+ #######################################*/
+void 		ofs_journal_checkpointed	(uint64_t);
+
+/*######################################
+ 이름 : ofs_journal_lsn
+ 요약 : 마지막으로 부여된 LSN
+ 매개변수 : 없음
+ 반환값 : LSN
+ #######################################*/
+uint64_t	ofs_journal_lsn		(void);
+
+/*######################################
+ 이름 : ofs_journal_setlsn
+ 요약 : 체크포인트 이미지를 읽은 뒤 LSN 시작점 지정
+ 매개변수 : uint64_t [LSN]
+ 반환값 : 없음
+ #######################################*/
+void 		ofs_journal_setlsn		(uint64_t);
+
+/*######################################
+ 이름 : ofs_journal_enabled
+ 요약 : 저널 사용 여부
+ 매개변수 : 없음
+ 반환값 : 사용중이면 1, 아니면 0
+ #######################################*/
+int 		ofs_journal_enabled	(void);
+
+/*######################################
+ 이름 : ofs_journal_close
+ 요약 : 커밋 스레드를 멈추고 남은 레코드를 기록, 체크포인트 후 저널을 닫는다
+ 매개변수 : 없음
+ 반환값 : 없음
+ #######################################*/
+void 		ofs_journal_close		(void);
+
+#endif
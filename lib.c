@@ -1,99 +1,265 @@
-﻿#include <fuse.h>
-#include <string.h>
-#include <errno.h>
-#include <limits.h>
-#include <unistd.h>
-#include <stdlib.h>
-#include <stdio.h>
-#include <sys/types.h>
-#include <sys/stat.h>
-#include "lib.h"
-
-int ofs_check_path_len(const char *path) {	
-	char tpath[PATH_MAX];
-	char *p;
-	
-	if(strlen(path) > PATH_MAX) return -ENAMETOOLONG;		//전체 패스길이 체크
-	
-	strcpy(tpath, path);
-	
-	p = strtok(tpath+1, "/");
-	
-	while(p != NULL) {
-		if(strlen(p) > NAME_MAX) return -ENAMETOOLONG;	//각각의 파일 길이 체크
-		p = strtok(NULL,"/");
-	}
-	return 0;
-}
-
-int ofs_check_access(mode_t mode, uid_t uid, gid_t gid, int how) {
-	int res=0;
-	
-	if (uid == fuse_get_context()->uid) {					// 오너의 권한 확인(1순위)
-		if(how & R_OK) res |= (mode & S_IRUSR) ^ S_IRUSR;
-		if(how & W_OK) res |= (mode & S_IWUSR) ^ S_IWUSR;
-		if(how & X_OK) res |= (mode & S_IXUSR) ^ S_IXUSR;
-	} else if (gid == fuse_get_context()->gid) {				// 그룹의 권한 확인(2순위)
-		if(how & R_OK) res |= (mode & S_IRGRP) ^ S_IRGRP;
-		if(how & W_OK) res |= (mode & S_IWGRP) ^ S_IWGRP;
-		if(how & X_OK) res |= (mode & S_IXGRP) ^ S_IXGRP;
-	} else {										// Other 권한 확인
-		if(how & R_OK) res |= (mode & S_IROTH) ^ S_IROTH; 
-		if(how & W_OK) res |= (mode & S_IWOTH) ^ S_IWOTH;
-		if(how & X_OK) res |= (mode & S_IXOTH) ^ S_IXOTH;
-	}
-	
-	if(res) 
-		return -EACCES;
-	else
-		return 0;
-}
-
-char* ofs_parsingname(const char *path) {
-	return strrchr(path,'/')+1; //경로의 마지막 이름만 리턴
-}
-
-char* ofs_parsingparent(const char *path) {
-	char * parent;
-	char * p;
-	int size;
-	p = strrchr(path, '/');
-	if(p == NULL)
-		return NULL;
-	size = (int)(p - path);
-	if(size == 0) {
-		// 루트 디렉토리의 경우
-		parent = (char *)malloc(sizeof(char)*1);
-		strcpy(parent, "/");
-	} else {
-		parent = (char *)malloc(sizeof(char)*(size+2));
-		strncpy(parent, path, size);
-		*(parent + size) = '\0';
-	}
-	return parent;		// 부모 디렉토리의 경로 리턴
-}
-
-char* 	ofs_extension		(const char *path) {
-	char* p;
-	p = strrchr(path,'.')+1;
-	if(p <= path + 1) {
-		p = NULL;
-	}
-	return p;
-}
-
-char* 	ofs_typedirname	(const char *path) {
-	char *extension;
-	char *dirname;
-
-	extension = ofs_extension(path);
-	if(extension == NULL) {
-		dirname = (char *)malloc(sizeof(char)*2);
-		strcpy(dirname, "_");
-	} else {
-		dirname = (char *)malloc(sizeof(char)*(strlen(path)+2));
-		strcpy(dirname, "_");
-		strcat(dirname, extension);
-	}
-	return dirname;
-}
+﻿#include <fuse.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "lib.h"
+
+/* 저널 재실행처럼 FUSE 요청 밖에서 핸들러를 호출할 때 사용할 자격 증명 */
+static __thread int		ctx_set = 0;
+static __thread uid_t	ctx_uid;
+static __thread gid_t	ctx_gid;
+
+/*
+ * 요청 자격 증명
+ * FUSE 진입점에서 요청자의 uid, gid, pid를 한번만 읽어 스레드에 두고(ofs_cred_begin)
+ * 연산이 끝나면 버린다(ofs_cred_end). 보조 그룹은 소유자도 주 그룹도 아니어서 그룹
+ * 권한을 따져야 할 때에만 읽는데, /proc을 읽어야 하므로 pid별로 잠시(ttl) 캐시한다.
+ * 연산 중에는 경로 탐색이 지나는 디렉토리마다 검색(X) 권한도 확인한다(ofs_cred_search).
+ * 파일 시각에 쓰는 현재 시각도 연산마다 거친 시계로 한번만 읽는다(ofs_now).
+ */
+#define OFS_CRED_SLOTS	256
+
+typedef struct _OCRED {
+	pid_t		pid;
+	uid_t		uid;
+	gid_t		gid;
+	int			ngroups;				// 보조 그룹 수, 음수면 아직 읽지 않음
+	gid_t		groups[OFS_NGROUPS_MAX];
+	uint64_t		expire;				// 캐시 만료 시각(ms)
+} OCRED;
+
+static OCRED			cred_cache[OFS_CRED_SLOTS];	// pid로 찾는 보조 그룹 캐시
+static pthread_mutex_t	cred_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t		cred_ttl = 1000;
+static __thread OCRED	cred;					// 현재 요청의 자격 증명
+static __thread int		cred_loaded;			// 연산 중 (ofs_cred_begin ~ ofs_cred_end)
+static __thread int		cred_denied;			// 경로 탐색에서 검색 권한이 없었다
+static __thread struct timespec	cred_time;		// 연산 안에서 처음 읽은 시각, tv_sec이 0이면 아직 읽지 않음
+
+static uint64_t ofs_cred_now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+	return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void ofs_cred_fill(struct fuse_context *fc) {
+	if(fc != NULL) {
+		cred.pid = fc->pid;
+		cred.uid = fc->uid;
+		cred.gid = fc->gid;
+	} else {										// 요청이 아닌 스레드는 마운트한 사용자
+		cred.pid = 0;
+		cred.uid = getuid();
+		cred.gid = getgid();
+	}
+	cred.ngroups = -1;
+}
+
+/* 연산 중이면 읽어 둔 자격 증명, 아니면 FUSE 컨텍스트를 그때마다 읽는다 */
+static OCRED* ofs_cred(void) {
+	if(!cred_loaded)
+		ofs_cred_fill(fuse_get_context());
+	return &cred;
+}
+
+/* 보조 그룹 읽기 - 같은 pid, uid, gid의 캐시가 살아 있으면 /proc을 읽지 않는다 */
+static void ofs_cred_groups(OCRED *c) {
+	OCRED *slot = &cred_cache[(unsigned)c->pid % OFS_CRED_SLOTS];
+	uint64_t now = ofs_cred_now();
+	int n;
+
+	pthread_mutex_lock(&cred_lock);
+	if(cred_ttl > 0 && slot->pid == c->pid && slot->uid == c->uid && slot->gid == c->gid && now < slot->expire) {
+		c->ngroups = slot->ngroups;
+		memcpy(c->groups, slot->groups, sizeof(gid_t) * c->ngroups);
+		pthread_mutex_unlock(&cred_lock);
+		return;
+	}
+	pthread_mutex_unlock(&cred_lock);
+
+	n = (c->pid != 0)? fuse_getgroups(OFS_NGROUPS_MAX, c->groups) : 0;
+	c->ngroups = (n < 0)? 0 : (n > OFS_NGROUPS_MAX)? OFS_NGROUPS_MAX : n;	// 넘치는 그룹은 보지 않는다
+	if(cred_ttl > 0 && c->pid != 0) {
+		pthread_mutex_lock(&cred_lock);
+		*slot = *c;
+		slot->expire = now + cred_ttl;
+		pthread_mutex_unlock(&cred_lock);
+	}
+}
+
+static int ofs_cred_ingroup(OCRED *c, gid_t gid) {
+	int i;
+
+	if(c->ngroups < 0)
+		ofs_cred_groups(c);
+	for(i = 0; i < c->ngroups; i++)
+		if(c->groups[i] == gid)
+			return 1;
+	return 0;
+}
+
+void ofs_cred_init(unsigned int ttl) {
+	cred_ttl = ttl;
+}
+
+void ofs_cred_begin(void) {
+	struct fuse_context *fc = fuse_get_context();
+
+	cred_denied = 0;
+	cred_loaded = 0;
+	cred_time.tv_sec = 0;
+	if(fc == NULL)									// 요청이 아닌 스레드는 검사하지 않는다
+		return;
+	ofs_cred_fill(fc);
+	cred_loaded = 1;
+}
+
+int ofs_cred_end(int ret) {
+	cred_loaded = 0;
+	return (ret == -ENOENT && cred_denied)? -EACCES : ret;
+}
+
+int ofs_cred_walking(void) {
+	return cred_loaded && !ctx_set;
+}
+
+int ofs_cred_search(mode_t mode, uid_t uid, gid_t gid) {
+	if(ofs_check_access(mode, uid, gid, X_OK) == 0)
+		return 0;
+	cred_denied = 1;
+	return -EACCES;
+}
+
+void ofs_now(struct timespec *ts) {
+	if(!cred_loaded) {
+		clock_gettime(CLOCK_REALTIME_COARSE, ts);
+		return;
+	}
+	if(cred_time.tv_sec == 0)
+		clock_gettime(CLOCK_REALTIME_COARSE, &cred_time);
+	*ts = cred_time;
+}
+
+void ofs_setcontext(uid_t uid, gid_t gid) {
+	ctx_uid = uid;
+	ctx_gid = gid;
+	ctx_set = 1;
+}
+
+void ofs_clearcontext(void) {
+	ctx_set = 0;
+}
+
+uid_t ofs_context_uid(void) {
+	return ctx_set? ctx_uid : ofs_cred()->uid;
+}
+
+gid_t ofs_context_gid(void) {
+	return ctx_set? ctx_gid : ofs_cred()->gid;
+}
+
+int ofs_check_path_len(const char *path) {	
+	char tpath[PATH_MAX];
+	char *p;
+	
+	if(strlen(path) > PATH_MAX) return -ENAMETOOLONG;		//전체 패스길이 체크
+	
+	strcpy(tpath, path);
+	
+	p = strtok(tpath+1, "/");
+	
+	while(p != NULL) {
+		if(strlen(p) > NAME_MAX) return -ENAMETOOLONG;	//각각의 파일 길이 체크
+		p = strtok(NULL,"/");
+	}
+	return 0;
+}
+
+int ofs_check_access(mode_t mode, uid_t uid, gid_t gid, int how) {
+	OCRED *c;
+	int res=0;
+	
+	if (ctx_set)										// 재실행 : 권한은 기록 당시 이미 확인됨
+		return 0;
+	c = ofs_cred();
+	if (c->uid == 0) {								// Previliged User는 실행 권한만 확인
+		if((how & X_OK) && !S_ISDIR(mode) && !(mode & (S_IXUSR | S_IXGRP | S_IXOTH)))
+			return -EACCES;
+		return 0;
+	}
+	if (uid == c->uid) {								// 오너의 권한 확인(1순위)
+		if(how & R_OK) res |= (mode & S_IRUSR) ^ S_IRUSR;
+		if(how & W_OK) res |= (mode & S_IWUSR) ^ S_IWUSR;
+		if(how & X_OK) res |= (mode & S_IXUSR) ^ S_IXUSR;
+	} else if (gid == c->gid || ofs_cred_ingroup(c, gid)) {	// 그룹의 권한 확인(2순위, 보조 그룹 포함)
+		if(how & R_OK) res |= (mode & S_IRGRP) ^ S_IRGRP;
+		if(how & W_OK) res |= (mode & S_IWGRP) ^ S_IWGRP;
+		if(how & X_OK) res |= (mode & S_IXGRP) ^ S_IXGRP;
+	} else {										// Other 권한 확인
+		if(how & R_OK) res |= (mode & S_IROTH) ^ S_IROTH; 
+		if(how & W_OK) res |= (mode & S_IWOTH) ^ S_IWOTH;
+		if(how & X_OK) res |= (mode & S_IXOTH) ^ S_IXOTH;
+	}
+	
+	if(res) 
+		return -EACCES;
+	else
+		return 0;
+}
+
+char* ofs_parsingname(const char *path) {
+	return strrchr(path,'/')+1; //경로의 마지막 이름만 리턴
+}
+
+char* ofs_parsingparent(const char *path) {
+	char * parent;
+	char * p;
+	int size;
+	p = strrchr(path, '/');
+	if(p == NULL)
+		return NULL;
+	size = (int)(p - path);
+	if(size == 0) {
+		// 루트 디렉토리의 경우
+		parent = (char *)malloc(sizeof(char)*2);
+		strcpy(parent, "/");
+	} else {
+		parent = (char *)malloc(sizeof(char)*(size+2));
+		strncpy(parent, path, size);
+		*(parent + size) = '\0';
+	}
+	return parent;		// 부모 디렉토리의 경로 리턴
+}
+
+char* 	ofs_extension		(const char *path) {
+	char* p;
+	p = strrchr(path,'.')+1;
+	if(p <= path + 1) {
+		p = NULL;
+	}
+	return p;
+}
+
+char* 	ofs_typedirname	(const char *path) {
+	char *extension;
+	char *dirname;
+
+	extension = ofs_extension(path);
+	if(extension == NULL) {
+		dirname = (char *)malloc(sizeof(char)*2);
+		strcpy(dirname, "_");
+	} else {
+		dirname = (char *)malloc(sizeof(char)*(strlen(path)+2));
+		strcpy(dirname, "_");
+		strcat(dirname, extension);
+	}
+	return dirname;
+}
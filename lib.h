@@ -1,55 +1,138 @@
-﻿#ifndef __LIB_H
-#define __LIB_H
-
-#include <sys/types.h>
-
-/*######################################
- 이름 : ofs_check_path_len
- 요약 : 경로와 파일 이름의 무결성 판단 함수
- 매개변수 : const char* [Path]
- 반환값 : 성공시 0, 실패시 음수
- #######################################*/
-int 		ofs_check_path_len		(const char *);
-
-/*######################################
- 이름 : ofs_check_access
- 요약 : 주어진 mode의 Permission 확인
- 매개변수 : mode_t [PERM], uid_t [USER_ID], gid_t [GROUP_ID], int [HOW]
- 반환값 : 성공시 0, 실패시 음수
- #######################################*/
-int 		ofs_check_access		(mode_t, uid_t, gid_t, int);
-
-/*######################################
- 이름 : ofs_parsingname
- 요약 : Path에서 마지막 경로의 이름만 추출
- 매개변수 : const char* [Path]
- 반환값 : 경로의 마지막 이름
- #######################################*/
-char* 	ofs_parsingname		(const char *);
-
-/*######################################
- 이름 : ofs_parsingparent
- 요약 : Path에서 부모 디렉토리 경로 추출
- 매개변수 : const char* [Path]
- 반환값 : 부모 디렉토리의 경로
- #######################################*/
-char* 	ofs_parsingparent		(const char *);
-
-/*######################################
- 이름 : ofs_extension
- 요약 : Path의 확장자 이름 추출
- 매개변수 : const char* [Path]
- 반환값 : 확장자 이름 
- #######################################*/
-char* 	ofs_extension		(const char *);
-
-/*######################################
- 이름 : ofs_typedirname
- 요약 : Path에 해당하는 타입 디렉토리 이름 추출
- 매개변수 : const char* [Path]
- 반환값 : 타입 디렉토리 이름
- #######################################*/
-char* 	ofs_typedirname	(const char *);
-
-#endif
-
+﻿#ifndef __LIB_H
+#define __LIB_H
+
+#include <sys/types.h>
+#include <time.h>
+
+#define OFS_NGROUPS_MAX		32		// 권한 확인에 쓰는 보조 그룹 수
+
+/*######################################
+ 이름 : ofs_check_path_len
+ 요약 : 경로와 파일 이름의 무결성 판단 함수
+ 매개변수 : const char* [Path]
+ 반환값 : 성공시 0, 실패시 음수
+ #######################################*/
+int 		ofs_check_path_len		(const char *);
+
+/*######################################
+ 이름 : ofs_check_access
+ 요약 : 주어진 mode의 Permission 확인 (보조 그룹 포함, Previliged User는 실행 권한만 확인)
+ 매개변수 : mode_t [PERM], uid_t [USER_ID], gid_t [GROUP_ID], int [HOW]
+ 반환값 : 성공시 0, 실패시 음수
+ #######################################*/
+int 		ofs_check_access		(mode_t, uid_t, gid_t, int);
+
+/*######################################
+ 이름 : ofs_parsingname
+ 요약 : Path에서 마지막 경로의 이름만 추출
+ 매개변수 : const char* [Path]
+ 반환값 : 경로의 마지막 이름
+ #######################################*/
+char* 	ofs_parsingname		(const char *);
+
+/*######################################
+ 이름 : ofs_parsingparent
+ 요약 : Path에서 부모 디렉토리 경로 추출
+ 매개변수 : const char* [Path]
+ 반환값 : 부모 디렉토리의 경로
+ #######################################*/
+char* 	ofs_parsingparent		(const char *);
+
+/*######################################
+ 이름 : ofs_extension
+ 요약 : Path의 확장자 이름 추출
+ 매개변수 : const char* [Path]
+ 반환값 : 확장자 이름 
+ #######################################*/
+char* 	ofs_extension		(const char *);
+
+/*######################################
+ 이름 : ofs_typedirname
+ 요약 : Path에 해당하는 타입 디렉토리 이름 추출
+ 매개변수 : const char* [Path]
+ 반환값 : 타입 디렉토리 이름
+ #######################################*/
+char* 	ofs_typedirname	(const char *);
+
+/*######################################
+ 이름 : ofs_setcontext
+ 요약 : 현재 스레드의 요청 자격 증명을 지정 (FUSE 요청 밖에서 핸들러 호출시)
+ 매개변수 : uid_t [USER_ID], gid_t [GROUP_ID]
+ 반환값 : 없음
+ #######################################*/
+void 		ofs_setcontext		(uid_t, gid_t);
+
+/*######################################
+ 이름 : ofs_clearcontext
+ 요약 : 지정한 자격 증명을 해제하고 FUSE 컨텍스트를 다시 사용
+ 매개변수 : 없음
+ 반환값 : 없음
+ #######################################*/
+void 		ofs_clearcontext		(void);
+
+/*######################################
+ 이름 : ofs_context_uid
+ 요약 : 요청한 사용자의 User ID
+ 매개변수 : 없음
+ 반환값 : User ID
+ #######################################*/
+uid_t 	ofs_context_uid		(void);
+
+/*######################################
+ 이름 : ofs_context_gid
+ 요약 : 요청한 사용자의 Group ID
+ 매개변수 : 없음
+ 반환값 : Group ID
+ #######################################*/
+gid_t 	ofs_context_gid		(void);
+
+/*######################################
+ 이름 : ofs_cred_init
+ 요약 : pid별 보조 그룹 캐시의 유효 시간 지정, 0이면 캐시하지 않는다
+ 매개변수 : unsigned int [TTL(ms)]
+ 반환값 : 없음
+ #######################################*/
+void 		ofs_cred_init		(unsigned int);
+
+/*######################################
+ 이름 : ofs_cred_begin
+ 요약 : 요청 자격 증명을 한번 읽어 연산이 끝날 때까지 현재 스레드에서 사용
+ 매개변수 : 없음
+ 반환값 : 없음
+ #######################################*/
+void 		ofs_cred_begin		(void);
+
+/*######################################
+ 이름 : ofs_cred_end
+ 요약 : 읽어 둔 자격 증명을 버린다, 검색 권한이 없어 경로를 찾지 못했으면 -ENOENT를 -EACCES로 바꾼다
+ 매개변수 : int [RET]
+ 반환값 : 연산 결과
+ #######################################*/
+int 		ofs_cred_end		(int);
+
+/*######################################
+ 이름 : ofs_cred_walking
+ 요약 : 경로 탐색에서 디렉토리 검색 권한을 확인해야 하는지 (연산 중이고 재실행이 아님)
+ 매개변수 : 없음
+ 반환값 : 확인해야 하면 1, 아니면 0
+ #######################################*/
+int 		ofs_cred_walking		(void);
+
+/*######################################
+ 이름 : ofs_cred_search
+ 요약 : 경로 탐색이 지나는 디렉토리의 검색(X) 권한 확인, 없으면 연산 결과를 -EACCES로 바꾸도록 남긴다
+ 매개변수 : mode_t [PERM], uid_t [USER_ID], gid_t [GROUP_ID]
+ 반환값 : 성공시 0, 실패시 음수
+ #######################################*/
+int 		ofs_cred_search		(mode_t, uid_t, gid_t);
+
+/*######################################
+ 이름 : ofs_now
+ 요약 : 파일 시각에 쓸 현재 시각 (CLOCK_REALTIME_COARSE), 연산 중에는 처음 읽은 값을 끝날 때까지 쓴다
+ 매개변수 : struct timespec* [TS]
+ 반환값 : 없음
+ #######################################*/
+void 		ofs_now			(struct timespec *);
+
+#endif
+
@@ -1,142 +1,490 @@
-﻿#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <sys/stat.h>
-#include <sys/time.h>
-#include <time.h>
-#include "node.h"
-
-ino_t inumber=1;
-
-void ofs_setdata(ONODE* target, const char* buffer, size_t size, off_t offset) 
-{	
-	/* 저장 공간 확보 */
-	if(offset != 0) {											//파일의 뒷부분에 연결 하는 경우
-		target->of_data = (byte_t*)realloc(target->of_data, offset + size);
-	} else {
-		if(target -> of_data != NULL) {							//저장 된 데이터가 있을 경우
-			target->of_data = (byte_t*)realloc(target->of_data,size);
-		} else {
-			target->of_data = (byte_t*)malloc(size);				//처음 데이터를 저장
-		}
-	}
-	
-	/* 데이터 저장 */
-	memcpy(target->of_data+offset, buffer, size);
-	target->of_stat->of_size = size + offset;						//파일 사이즈 반영
-}
-
-ONODE* ofs_neONODE(const char* _name, mode_t _mode, uid_t _uid, gid_t _gid) 
-{
-	ONODE* ret = (ONODE*)malloc(sizeof(ONODE));					//노드 생성			
-	OSTAT* stat = (OSTAT*)malloc(sizeof(OSTAT));					//파일 정보 구조체 생성
-
-	/* 파일 정보 초기화*/
-	stat -> of_id = inumber++;
-	stat -> of_mode = _mode;
-	stat -> of_nlink = (S_ISDIR(_mode))?2:1; 
-	stat -> of_size = 0;
-	stat -> of_uid = _uid;
-	stat -> of_gid = _gid;
-	stat -> of_rdev = 0;
-	stat -> of_atime = stat -> of_mtime = stat -> of_ctime = time(NULL);
-	
-	/* 노드 초기화 */
-	strcpy(ret -> name, _name);
-	ret -> of_stat = stat;
-	ret -> of_data = NULL;		//데이터 필드 초기화
-	ret -> nextnode = NULL;
-	ret -> prevnode = NULL;
-	ret -> parentdir = NULL;
-	ret -> subhead = NULL;
-	ret -> subtail = NULL;
-
-	return ret;
-}  
-
-ONODE* ofs_insertnode(ONODE* target, ONODE* node) 
-{
-	if(target -> subhead == NULL) {				//비어 있는 디렉터리 넣을 경우
-		node -> prevnode = NULL;
-		target -> subhead = node;
-	} else {								//다른 하위 노드가 있을 경우
-		target -> subtail -> nextnode = node;
-		node -> prevnode = target -> subtail;
-	}
-	node -> nextnode = NULL;
-	node -> parentdir = target;					//부모 디렉터리 지정
-	target -> subtail = node;
-
-	return node;
-}
-
-ONODE* ofs_deletenode(ONODE* node) {
-	if(node->prevnode == NULL && node->nextnode ==  NULL) {			// 단일 서브 노드 였을 경우
-		node->parentdir -> subhead = node->parentdir -> subtail =  NULL;
-	} else if(node->prevnode == NULL) {							// 헤드 노드 였을 경우
-		node->nextnode->prevnode = NULL;
-		node->parentdir->subhead = node->nextnode;
-	} else if(node->nextnode ==  NULL) {							// 테일 노드 였을 경우
-		node->prevnode->nextnode = NULL;
-		node->parentdir->subtail = node->prevnode;
-	} else {												// 그외의 경우
-		node->nextnode->prevnode = node -> prevnode;
-		node->prevnode->nextnode = node -> nextnode;
-	}
-	return node;
-}
-
-ONODE* ofs_findnode(ONODE* root, const char *path) {
-	ONODE *cur, *loc;
-	char tpath[PATH_MAX];
-	char *p;	
-	
-	strcpy(tpath, path);
-	
-	p = strtok(tpath+1, "/");
-	
-	loc = cur = root;	
-	while(p != NULL) {
-		loc = NULL;
-		if(cur->subhead == NULL) return NULL;
-		for(cur=cur->subhead; cur  != NULL ; cur=cur->nextnode) {	//하위 디렉터리에서 Sibling 노드들을 검색
-			if(strcmp(cur->name, p) == 0) {					//해당하는 노드를 찾았을 경우
-				loc = cur;
-				break;
-			}
-		}
-		p = strtok(NULL,"/");								//다음 이름 검색
-	}
-	return loc;
-}
-
-ONODE* ofs_findparent(ONODE* root, const char *path) {
-	ONODE *cur, *loc;
-	char tpath[PATH_MAX];
-	char *p;	
-	
-	strcpy(tpath, path);
-	
-	p = strrchr(tpath, '/');									//마지막 이름은 무시(부모 디렉토리를 찾게됨)
-	
-	*(p+1) = '\0';
-	
-	p = strtok(tpath+1, "/");
-	
-	loc = cur = root;	
-	while(p != NULL) {
-		loc = NULL;
-		if(cur->subhead == NULL) return NULL;
-		for(cur=cur->subhead; cur  != NULL ; cur=cur->nextnode) {
-			if(strcmp(cur->name, p) == 0) {
-				loc = cur;
-				break;
-			}
-		}
-		p = strtok(NULL,"/");
-	}
-	return loc;
-}
-
-
-
+﻿#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <time.h>
+#include "node.h"
+#include "lib.h"
+#include "xattr.h"
+#include "stats.h"
+#include "trace.h"
+
+ino_t inumber=1;
+
+int ofs_setdata(ONODE* target, const char* buffer, size_t size, off_t offset) 
+{	
+	int ret;
+
+	/* 저장 공간 확보 */
+	if(target -> of_data == NULL)								//처음 데이터를 저장
+		target -> of_data = ofs_data_new();
+	
+	/* 데이터 저장 */
+	if((ret = ofs_data_write(target->of_data, buffer, size, offset)) != 0)
+		return ret;
+	if(offset + (off_t)size > target->of_stat->of_size)				//파일 사이즈 반영
+		target->of_stat->of_size = offset + size;
+	return 0;
+}
+
+ONODE* ofs_neONODE(const char* _name, mode_t _mode, uid_t _uid, gid_t _gid) 
+{
+	ONODE* ret = (ONODE*)malloc(sizeof(ONODE));					//노드 생성			
+	OSTAT* stat = (OSTAT*)malloc(sizeof(OSTAT));					//파일 정보 구조체 생성
+
+	/* 파일 정보 초기화*/
+	stat -> of_id = __atomic_fetch_add(&inumber, 1, __ATOMIC_RELAXED);	//가져오기 스레드에서도 호출된다
+	stat -> of_mode = _mode;
+	stat -> of_nlink = (S_ISDIR(_mode))?2:1; 
+	stat -> of_size = 0;
+	stat -> of_uid = _uid;
+	stat -> of_gid = _gid;
+	stat -> of_rdev = 0;
+	stat -> of_xattr = NULL;
+	ofs_now(&stat -> of_atime);
+	stat -> of_mtime = stat -> of_ctime = stat -> of_atime;
+	
+	/* 노드 초기화 */
+	strcpy(ret -> name, _name);
+	ret -> of_stat = stat;
+	ret -> of_data = NULL;		//데이터 필드 초기화
+	ret -> nextnode = NULL;
+	ret -> prevnode = NULL;
+	ret -> parentdir = NULL;
+	ret -> subhead = NULL;
+	ret -> subtail = NULL;
+
+	return ret;
+}  
+
+ONODE* ofs_insertnode(ONODE* target, ONODE* node) 
+{
+	if(target -> subhead == NULL) {				//비어 있는 디렉터리 넣을 경우
+		node -> prevnode = NULL;
+		target -> subhead = node;
+	} else {								//다른 하위 노드가 있을 경우
+		target -> subtail -> nextnode = node;
+		node -> prevnode = target -> subtail;
+	}
+	node -> nextnode = NULL;
+	node -> parentdir = target;					//부모 디렉터리 지정
+	target -> subtail = node;
+
+	return node;
+}
+
+ONODE* ofs_deletenode(ONODE* node) {
+	if(node->prevnode == NULL && node->nextnode ==  NULL) {			// 단일 서브 노드 였을 경우
+		node->parentdir -> subhead = node->parentdir -> subtail =  NULL;
+	} else if(node->prevnode == NULL) {							// 헤드 노드 였을 경우
+		node->nextnode->prevnode = NULL;
+		node->parentdir->subhead = node->nextnode;
+	} else if(node->nextnode ==  NULL) {							// 테일 노드 였을 경우
+		node->prevnode->nextnode = NULL;
+		node->parentdir->subtail = node->prevnode;
+	} else {												// 그외의 경우
+		node->nextnode->prevnode = node -> prevnode;
+		node->prevnode->nextnode = node -> nextnode;
+	}
+	return node;
+}
+
+ONODE* ofs_findnode(ONODE* root, const char *path) {
+	ONODE *cur, *loc;
+	char tpath[PATH_MAX];
+	char *p;	
+	int search = ofs_cred_walking();
+	
+	uint64_t begin = ofs_stats_begin();
+	
+	strcpy(tpath, path);
+	
+	p = strtok(tpath+1, "/");
+	
+	loc = cur = root;	
+	while(p != NULL) {
+		loc = NULL;
+		if(search && S_ISDIR(cur->of_stat->of_mode) && (cur->of_stat->of_mode & 0111) != 0111
+			&& ofs_cred_search(cur->of_stat->of_mode, cur->of_stat->of_uid, cur->of_stat->of_gid) != 0)
+			break;										//지나는 디렉토리의 검색 권한 (모두 있으면 바로 통과)
+		if(cur->subhead == NULL) break;
+		for(cur=cur->subhead; cur  != NULL ; cur=cur->nextnode) {	//하위 디렉터리에서 Sibling 노드들을 검색
+			if(strcmp(cur->name, p) == 0) {					//해당하는 노드를 찾았을 경우
+				loc = cur;
+				break;
+			}
+		}
+		if(loc == NULL) break;								//중간 경로가 없는 경우
+		p = strtok(NULL,"/");								//다음 이름 검색
+	}
+	if(loc != NULL)
+		OFS_TRACE_NODE(loc->of_stat->of_id);						// 추적 레코드의 노드 번호
+	ofs_stats_end(OP_LOOKUP, begin, (loc != NULL)? 0 : -ENOENT);
+	return loc;
+}
+
+int ofs_istypedir(ONODE *node) {
+	return S_ISDIR(node->of_stat->of_mode) && node->of_stat->of_rdev == OFS_TYPEDIR_RDEV;
+}
+
+ONODE* ofs_findparent(ONODE* root, const char *path) {
+	ONODE *cur, *loc;
+	char tpath[PATH_MAX];
+	char *p;	
+	int search = ofs_cred_walking();
+	
+	uint64_t begin = ofs_stats_begin();
+	
+	strcpy(tpath, path);
+	
+	p = strrchr(tpath, '/');									//마지막 이름은 무시(부모 디렉토리를 찾게됨)
+	
+	*(p+1) = '\0';
+	
+	p = strtok(tpath+1, "/");
+	
+	loc = cur = root;	
+	while(p != NULL) {
+		loc = NULL;
+		if(search && S_ISDIR(cur->of_stat->of_mode) && (cur->of_stat->of_mode & 0111) != 0111
+			&& ofs_cred_search(cur->of_stat->of_mode, cur->of_stat->of_uid, cur->of_stat->of_gid) != 0)
+			break;										//지나는 디렉토리의 검색 권한 (모두 있으면 바로 통과)
+		if(cur->subhead == NULL) break;
+		for(cur=cur->subhead; cur  != NULL ; cur=cur->nextnode) {
+			if(strcmp(cur->name, p) == 0) {
+				loc = cur;
+				break;
+			}
+		}
+		if(loc == NULL) break;
+		p = strtok(NULL,"/");
+	}
+	ofs_stats_end(OP_LOOKUP, begin, (loc != NULL)? 0 : -ENOENT);
+	return loc;
+}
+
+
+
+
+
+/* 체크포인트 이미지 형식 */
+#define OFS_IMAGE_MAGIC		0x49534f46U			// "OFSI"
+#define OFS_IMAGE_VERSION	4					// 2 : 노드 정보 뒤에 확장 속성, 3 : 나노초 시각, 4 : 타입 디렉토리 표시
+#define OFS_IMAGE_STAT		offsetof(OSTAT, of_xattr)	// 기록하는 노드 정보 (포인터 제외)
+
+/* 버전 2까지의 노드 정보 (시각이 초 단위) */
+typedef struct _OSTAT2 {
+	ino_t		of_id;
+	mode_t	of_mode;
+	nlink_t	of_nlink;
+	uid_t 	of_uid;
+	gid_t 	of_gid;
+	off_t		of_size;
+	dev_t 	of_rdev;
+	time_t	of_atime;
+	time_t	of_mtime;
+	time_t	of_ctime;
+} OSTAT2;
+#define OFS_IMAGE_STAT2		(offsetof(OSTAT2, of_ctime) + sizeof(time_t))
+
+typedef struct _OIMGHDR {
+	uint32_t	magic;
+	uint32_t	version;
+	uint64_t	lsn;							// 이미지에 반영된 마지막 저널 LSN
+	uint64_t	inumber;
+} OIMGHDR;
+
+/* 하드 링크로 공유되는 노드 정보 목록 (드물기 때문에 선형 검색) */
+typedef struct _OSHARED {
+	ino_t		id;
+	OSTAT		*stat;
+	ODATA		*data;
+} OSHARED;
+
+typedef struct _OSHAREDTAB {
+	OSHARED		*ent;
+	size_t		cnt;
+	size_t		cap;
+} OSHAREDTAB;
+
+static OSHARED* ofs_shared_find(OSHAREDTAB *tab, ino_t id)
+{
+	size_t i;
+	for(i = 0; i < tab->cnt; i++)
+		if(tab->ent[i].id == id) return &tab->ent[i];
+	return NULL;
+}
+
+static void ofs_shared_add(OSHAREDTAB *tab, OSTAT *stat, ODATA *data)
+{
+	if(tab->cnt == tab->cap) {
+		tab->cap = (tab->cap == 0)? 16 : tab->cap * 2;
+		tab->ent = (OSHARED*)realloc(tab->ent, sizeof(OSHARED) * tab->cap);
+	}
+	tab->ent[tab->cnt].id = stat->of_id;
+	tab->ent[tab->cnt].stat = stat;
+	tab->ent[tab->cnt].data = data;
+	tab->cnt++;
+}
+
+static int ofs_save_data(FILE *fp, ODATA *data, uint64_t len)
+{
+	char buf[OFS_CHUNK_SIZE];
+	uint64_t off;
+	size_t n;
+
+	for(off = 0; off < len; off += n) {
+		n = (len - off > sizeof(buf))? sizeof(buf) : len - off;
+		if(ofs_data_read(data, buf, n, off) != 0 || fwrite(buf, 1, n, fp) != n)
+			return -1;
+	}
+	return 0;
+}
+
+static int ofs_load_data(FILE *fp, ODATA *data, uint64_t len)
+{
+	char buf[OFS_CHUNK_SIZE];
+	uint64_t off;
+	size_t n;
+
+	for(off = 0; off < len; off += n) {
+		n = (len - off > sizeof(buf))? sizeof(buf) : len - off;
+		if(fread(buf, 1, n, fp) != n || ofs_data_write(data, buf, n, off) != 0)
+			return -1;
+	}
+	return 0;
+}
+
+static int ofs_save_node(FILE *fp, ONODE *node, OSHAREDTAB *tab)
+{
+	uint16_t namelen = strlen(node->name);
+	uint8_t shared = 0;
+	uint64_t datalen = 0;
+	uint32_t nchild = 0;
+	ONODE *cur;
+
+	if(!S_ISDIR(node->of_stat->of_mode) && node->of_stat->of_nlink > 1) {
+		if(ofs_shared_find(tab, node->of_stat->of_id) != NULL)
+			shared = 1;										// 이미 기록된 하드 링크
+		else
+			ofs_shared_add(tab, node->of_stat, node->of_data);
+	}
+
+	fwrite(&namelen, sizeof(namelen), 1, fp);
+	fwrite(node->name, 1, namelen, fp);
+	fwrite(&shared, sizeof(shared), 1, fp);
+	if(shared) {
+		uint64_t id = node->of_stat->of_id;
+		fwrite(&id, sizeof(id), 1, fp);
+	} else {
+		uint32_t xlen = ofs_xattr_size(node->of_stat);
+		fwrite(node->of_stat, OFS_IMAGE_STAT, 1, fp);
+		fwrite(&xlen, sizeof(xlen), 1, fp);
+		fwrite(node->of_stat->of_xattr, 1, xlen, fp);
+		if(node->of_data != NULL) datalen = node->of_stat->of_size;
+		fwrite(&datalen, sizeof(datalen), 1, fp);
+		if(ofs_save_data(fp, node->of_data, datalen) != 0) return -1;
+	}
+
+	for(cur = node->subhead; cur != NULL; cur = cur->nextnode) nchild++;
+	fwrite(&nchild, sizeof(nchild), 1, fp);
+	for(cur = node->subhead; cur != NULL; cur = cur->nextnode)
+		if(ofs_save_node(fp, cur, tab) != 0) return -1;
+
+	return ferror(fp)? -1 : 0;
+}
+
+/* PATH가 들어 있는 디렉토리를 디스크에 기록 (rename이 전원이 나가도 남도록) */
+static int ofs_sync_dir(const char *path)
+{
+	char *dir = strdup(path), *slash;
+	int fd, ret = -1;
+
+	if((slash = strrchr(dir, '/')) == NULL)
+		strcpy(dir, ".");
+	else if(slash == dir)
+		dir[1] = '\0';
+	else
+		*slash = '\0';
+	if((fd = open(dir, O_RDONLY | O_DIRECTORY)) >= 0) {
+		ret = (fsync(fd) == 0)? 0 : -1;
+		close(fd);
+	}
+	free(dir);
+	return ret;
+}
+
+int ofs_savetree(ONODE *root, const char *path, uint64_t lsn)
+{
+	OIMGHDR hdr;
+	OSHAREDTAB tab = { NULL, 0, 0 };
+	char *tmp;
+	FILE *fp;
+	int ret;
+
+	/* 임시 파일에 쓴 뒤 rename으로 교체하여 이미지가 깨지지 않도록 한다 */
+	tmp = (char*)malloc(strlen(path) + 5);
+	strcpy(tmp, path);
+	strcat(tmp, ".tmp");
+	if((fp = fopen(tmp, "wb")) == NULL) {
+		free(tmp);
+		return -1;
+	}
+
+	hdr.magic = OFS_IMAGE_MAGIC;
+	hdr.version = OFS_IMAGE_VERSION;
+	hdr.lsn = lsn;
+	hdr.inumber = inumber;
+	fwrite(&hdr, sizeof(hdr), 1, fp);
+	ret = ofs_save_node(fp, root, &tab);
+	free(tab.ent);
+
+	if(fflush(fp) != 0 || fsync(fileno(fp)) != 0) ret = -1;
+	if(fclose(fp) != 0) ret = -1;
+	if(ret == 0 && rename(tmp, path) != 0) ret = -1;
+	if(ret != 0) unlink(tmp);
+	else ret = ofs_sync_dir(path);					// 저널을 비우기 전에 새 이미지가 남아야 한다
+	free(tmp);
+	return ret;
+}
+
+static int ofs_load_stat(FILE *fp, OSTAT *stat, uint32_t version)
+{
+	OSTAT2 old;
+
+	if(version >= 3)
+		return (fread(stat, OFS_IMAGE_STAT, 1, fp) == 1)? 0 : -1;
+	if(fread(&old, OFS_IMAGE_STAT2, 1, fp) != 1)
+		return -1;
+	stat->of_id = old.of_id;
+	stat->of_mode = old.of_mode;
+	stat->of_nlink = old.of_nlink;
+	stat->of_uid = old.of_uid;
+	stat->of_gid = old.of_gid;
+	stat->of_size = old.of_size;
+	stat->of_rdev = old.of_rdev;
+	stat->of_atime.tv_sec = old.of_atime;
+	stat->of_mtime.tv_sec = old.of_mtime;
+	stat->of_ctime.tv_sec = old.of_ctime;
+	stat->of_atime.tv_nsec = stat->of_mtime.tv_nsec = stat->of_ctime.tv_nsec = 0;
+	return 0;
+}
+
+static int ofs_load_xattr(FILE *fp, OSTAT *stat, uint32_t version)
+{
+	uint32_t xlen;
+	char *blob;
+	int ret;
+
+	stat->of_xattr = NULL;
+	if(version < 2)
+		return 0;
+	if(fread(&xlen, sizeof(xlen), 1, fp) != 1 || xlen > (1U << 24))
+		return -1;
+	if(xlen == 0)
+		return 0;
+	if((blob = (char*)malloc(xlen)) == NULL)
+		return -1;
+	ret = (fread(blob, 1, xlen, fp) == xlen)? ofs_xattr_load(stat, blob, xlen) : -1;
+	free(blob);
+	return ret;
+}
+
+/*
+ * 버전 3까지의 이미지에는 타입 디렉토리 표시가 없다. ofs_addtypelink가 만드는 모양 -
+ * "_확장자"이거나 같은 디렉토리의 하위 디렉토리 이름 + "_확장자"이고 안에는 심볼릭 링크만
+ * 있는 디렉토리 - 를 타입 디렉토리로 표시한다.
+ */
+static void ofs_load_typedirs(ONODE *dir)
+{
+	ONODE *cur, *sib, *link;
+	char *ext;
+	size_t len;
+
+	for(cur = dir->subhead; cur != NULL; cur = cur->nextnode) {
+		if(!S_ISDIR(cur->of_stat->of_mode) || (ext = strrchr(cur->name, '_')) == NULL || ext[1] == '\0')
+			continue;
+		for(link = cur->subhead; link != NULL && S_ISLNK(link->of_stat->of_mode); link = link->nextnode);
+		if(link != NULL)
+			continue;
+		len = (size_t)(ext - cur->name);
+		for(sib = (len > 0)? dir->subhead : NULL; sib != NULL; sib = sib->nextnode)
+			if(S_ISDIR(sib->of_stat->of_mode) && strlen(sib->name) == len && strncmp(sib->name, cur->name, len) == 0)
+				break;
+		if(len == 0 || sib != NULL)
+			cur->of_stat->of_rdev = OFS_TYPEDIR_RDEV;
+	}
+}
+
+static ONODE* ofs_load_node(FILE *fp, OSHAREDTAB *tab, uint32_t version)
+{
+	uint16_t namelen;
+	uint8_t shared;
+	uint64_t datalen, id;
+	uint32_t nchild, i;
+	ONODE *node, *child;
+	OSHARED *ent;
+
+	if(fread(&namelen, sizeof(namelen), 1, fp) != 1 || namelen >= NAME_MAX) return NULL;
+	node = (ONODE*)calloc(1, sizeof(ONODE));
+	if(fread(node->name, 1, namelen, fp) != namelen || fread(&shared, sizeof(shared), 1, fp) != 1)
+		goto fail;
+
+	if(shared) {
+		if(fread(&id, sizeof(id), 1, fp) != 1 || (ent = ofs_shared_find(tab, id)) == NULL)
+			goto fail;
+		node->of_stat = ent->stat;
+		node->of_data = ent->data;
+	} else {
+		node->of_stat = (OSTAT*)malloc(sizeof(OSTAT));
+		if(ofs_load_stat(fp, node->of_stat, version) != 0 || ofs_load_xattr(fp, node->of_stat, version) != 0
+			|| fread(&datalen, sizeof(datalen), 1, fp) != 1)
+			goto fail;
+		if(datalen > 0) {
+			node->of_data = ofs_data_new();
+			if(ofs_load_data(fp, node->of_data, datalen) != 0) goto fail;
+			ofs_data_seal(node->of_data);			//꼬리 청크까지 중복 제거
+		}
+		if(!S_ISDIR(node->of_stat->of_mode) && node->of_stat->of_nlink > 1)
+			ofs_shared_add(tab, node->of_stat, node->of_data);
+	}
+
+	if(fread(&nchild, sizeof(nchild), 1, fp) != 1) goto fail;
+	for(i = 0; i < nchild; i++) {
+		if((child = ofs_load_node(fp, tab, version)) == NULL) goto fail;
+		ofs_insertnode(node, child);
+	}
+	if(version < 4)
+		ofs_load_typedirs(node);
+	return node;
+
+fail:
+	/* 불완전한 이미지는 사용하지 않는다 (부분 트리는 프로세스 종료 시 회수) */
+	return NULL;
+}
+
+ONODE* ofs_loadtree(const char *path, uint64_t *lsn)
+{
+	OIMGHDR hdr;
+	OSHAREDTAB tab = { NULL, 0, 0 };
+	ONODE *root = NULL;
+	FILE *fp;
+
+	if((fp = fopen(path, "rb")) == NULL) return NULL;
+	if(fread(&hdr, sizeof(hdr), 1, fp) == 1 && hdr.magic == OFS_IMAGE_MAGIC
+		&& hdr.version >= 1 && hdr.version <= OFS_IMAGE_VERSION) {
+		if((root = ofs_load_node(fp, &tab, hdr.version)) != NULL) {
+			inumber = hdr.inumber;
+			*lsn = hdr.lsn;
+		}
+	}
+	free(tab.ent);
+	fclose(fp);
+	return root;
+}
@@ -1,81 +1,112 @@
-﻿#ifndef __NODE_H
-#define __NODE_H
-#include <sys/types.h>
-#include <limits.h>
-
-typedef char byte_t;
-
-typedef struct _OSTAT {
-	ino_t		of_id;
-	mode_t	of_mode;
-	nlink_t	of_nlink;
-	uid_t 	of_uid;
-	gid_t 	of_gid;
-	off_t		of_size;
-	dev_t 	of_rdev;
-	time_t	of_atime;
-	time_t	of_mtime;
-	time_t	of_ctime;
-} OSTAT;
-
-typedef struct _ONODE {
-	char			name[NAME_MAX];
-	OSTAT			*of_stat; 
-	byte_t			*of_data;
-	struct _ONODE	*nextnode;
-	struct _ONODE	*prevnode;
-	struct _ONODE	*parentdir;
-	struct _ONODE	*subhead;
-	struct _ONODE	*subtail;
-} ONODE;
-
-/*######################################
- 이름 : ofs_setdata	
- 요약 : 파일에 데이터 저장 함수
- 매개변수 : ONODE* [ROOT], const char*[PATH], size_t [SIZE], off_t [OFFSET]
- 반환값 : 없음
- #######################################*/
-void 		ofs_setdata		(ONODE*, const char*, size_t, off_t);
-
-/*######################################
- 이름 : ofs_neONODE
- 요약 : 새로운 노드를 생성
- 매개변수 : const char* [PATH], mode_t [MODE], uid_t [OWNER], gid_t[GROUP]
- 반환값 : 생성된 노드
- #######################################*/
-ONODE* 	ofs_neONODE		(const char*, mode_t, uid_t, gid_t);
-
-/*######################################
- 이름 : ofs_insertnode
- 요약 : 노드를 삽입해준다.
- 매개변수 : ONODE* [TARGET], ONODE* [NODE]
- 반환값 : 삽입된 노드
- #######################################*/
-ONODE* 	ofs_insertnode	(ONODE*, ONODE*);
-
-/*######################################
- 이름 : ofs_deletenode
- 요약 : 노드 제거 함수
- 매개변수 : ONODE* [NODE]
- 반환값 : 제거된 노드
- #######################################*/
-ONODE*	ofs_deletenode	(ONODE*);
-
-/*######################################
- 이름 : ofs_setdata	
- 요약 : 루트에서 패스에 해당하는 노드 검색
- 매개변수 : ONODE* [ROOT], const char*[PATH]
- 반환값 : 찾은 노드
- #######################################*/
-ONODE* 	ofs_findnode		(ONODE*, const char *);
-
-/*######################################
- 이름 : ofs_setdata	
- 요약 : 루트에서 패스의 부모 노드 검색
- 매개변수 : ONODE* [ROOT], const char*[PATH]
- 반환값 : 찾은 노드
- #######################################*/
-ONODE* 	ofs_findparent		(ONODE*, const char *); 
-
-#endif
-
+﻿#ifndef __NODE_H
+#define __NODE_H
+#include <sys/types.h>
+#include <limits.h>
+#include <stdint.h>
+#include <time.h>
+#include "data.h"
+
+typedef char byte_t;
+
+typedef struct _OSTAT {
+	ino_t		of_id;
+	mode_t	of_mode;
+	nlink_t	of_nlink;
+	uid_t 	of_uid;
+	gid_t 	of_gid;
+	off_t		of_size;
+	dev_t 	of_rdev;
+	struct timespec	of_atime;		// 나노초 단위 (ofs_now의 거친 시계)
+	struct timespec	of_mtime;
+	struct timespec	of_ctime;
+	char		*of_xattr;		// 확장 속성 묶음 (xattr.c), 없으면 NULL - 이미지에는 따로 기록하므로 맨 뒤에 둔다
+} OSTAT;
+
+/* 타입 디렉토리 표시 - 디렉토리에는 장치 번호가 없으므로 of_rdev에 둔다 (이미지 버전 4부터) */
+#define OFS_TYPEDIR_RDEV	((dev_t)-1)
+
+typedef struct _ONODE {
+	char			name[NAME_MAX];
+	OSTAT			*of_stat; 
+	ODATA			*of_data;		// 청크 단위 파일 데이터 (하드 링크끼리 공유)
+	struct _ONODE	*nextnode;
+	struct _ONODE	*prevnode;
+	struct _ONODE	*parentdir;
+	struct _ONODE	*subhead;
+	struct _ONODE	*subtail;
+} ONODE;
+
+/*######################################
+ 이름 : ofs_setdata	
+ 요약 : 파일에 데이터 저장 함수
+ 매개변수 : ONODE* [ROOT], const char*[PATH], size_t [SIZE], off_t [OFFSET]
+ 반환값 : 성공시 0, 실패시 음수
+ #######################################*/
+int 		ofs_setdata		(ONODE*, const char*, size_t, off_t);
+
+/*######################################
+ 이름 : ofs_neONODE
+ 요약 : 새로운 노드를 생성
+ 매개변수 : const char* [PATH], mode_t [MODE], uid_t [OWNER], gid_t[GROUP]
+ 반환값 : 생성된 노드
+ #######################################*/
+ONODE* 	ofs_neONODE		(const char*, mode_t, uid_t, gid_t);
+
+/*######################################
+ 이름 : ofs_insertnode
+ 요약 : 노드를 삽입해준다.
+ 매개변수 : ONODE* [TARGET], ONODE* [NODE]
+ 반환값 : 삽입된 노드
+ #######################################*/
+ONODE* 	ofs_insertnode	(ONODE*, ONODE*);
+
+/*######################################
+ 이름 : ofs_deletenode
+ 요약 : 노드 제거 함수
+ 매개변수 : ONODE* [NODE]
+ 반환값 : 제거된 노드
+ #######################################*/
+ONODE*	ofs_deletenode	(ONODE*);
+
+/*######################################
+ 이름 : ofs_setdata	
+ 요약 : 루트에서 패스에 해당하는 노드 검색, 연산 중이면 지나는 디렉토리의 검색 권한도 확인
+ 매개변수 : ONODE* [ROOT], const char*[PATH]
+ 반환값 : 찾은 노드, 없거나 검색 권한이 없으면 NULL
+ #######################################*/
+ONODE* 	ofs_findnode		(ONODE*, const char *);
+
+/*######################################
+ 이름 : ofs_setdata	
+ 요약 : 루트에서 패스의 부모 노드 검색, 연산 중이면 지나는 디렉토리의 검색 권한도 확인
+ 매개변수 : ONODE* [ROOT], const char*[PATH]
+ 반환값 : 찾은 노드, 없거나 검색 권한이 없으면 NULL
+ #######################################*/
+ONODE* 	ofs_findparent		(ONODE*, const char *); 
+
+/*######################################
+ 이름 : ofs_istypedir
+ 요약 : ofs_newtypedir로 만든 타입 디렉토리인지 확인 (이름이 같은 사용자 디렉토리와 구별)
+ 매개변수 : ONODE* [NODE]
+ 반환값 : 타입 디렉토리면 1, 아니면 0
+ #######################################*/
+int 		ofs_istypedir		(ONODE*);
+
+/*######################################
+ 이름 : ofs_savetree
+ 요약 : 트리 전체를 체크포인트 이미지로 저장 (임시 파일 기록 후 교체, 디렉토리까지 fsync)
+ 매개변수 : ONODE* [ROOT], const char* [PATH], uint64_t [LSN]
+ 반환값 : 성공시 0, 실패시 음수
+ #######################################*/
+int 		ofs_savetree		(ONODE*, const char*, uint64_t);
+
+/*######################################
+ 이름 : ofs_loadtree
+ 요약 : 체크포인트 이미지에서 트리를 복원
+ 매개변수 : const char* [PATH], uint64_t* [LSN]
+ 반환값 : 복원된 루트 노드, 실패시 NULL
+ #######################################*/
+ONODE* 	ofs_loadtree		(const char*, uint64_t*);
+
+#endif
+
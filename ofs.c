@@ -1,819 +1,4251 @@
-﻿#define FUSE_USE_VERSION 26
-
-#include <fuse.h>
-#include <stdlib.h>
-#include <string.h>
-#include <errno.h>
-#include <unistd.h>
-#include <time.h>
-#include <limits.h>
-#include <stdio.h>
-
-#include "node.h"
-#include "lib.h"
-
-static ONODE *root;
-
-static int ofs_chmod(const char *, mode_t); 
-static int ofs_chown(const char *, uid_t, gid_t); 
-static int ofs_truncate(const char *, off_t);
-static int ofs_mknod(const char *, mode_t, dev_t); 
-static int ofs_link(const char *, const char *); 
-static int ofs_symlink(const char *, const char *); 
-static int ofs_readlink(const char*, char *, size_t); 
-static int ofs_getattr(const char *, struct stat *);
-static int ofs_readdir(const char *, void *, fuse_fill_dir_t, off_t, struct fuse_file_info *);
-static int ofs_access(const char *, int);
-static int ofs_utime(const char *, struct utimbuf *); 
-static int ofs_unlink(const char *);
-static int ofs_rmdir(const char *);
-static int ofs_mkdir(const char *, mode_t);
-static int ofs_open(const char *, struct fuse_file_info *);
-static int ofs_read(const char *, char *, size_t, off_t, struct fuse_file_info *);
-static int ofs_write(const char *, const char *, size_t , off_t , struct fuse_file_info *); 
-static int ofs_rename(const char *, const char *); 
-static int ofs_opendir(const char *, struct fuse_file_info *);
-
-int ofs_makenod (const char*, mode_t, dev_t);
-void ofs_newtypedir(const char *);
-void ofs_addtypelink(const char *);
-int ofs_makedir(const char *, mode_t);
-int ofs_unlink_node(const char *);
-int ofs_removedir(const char *);
-int ofs_rename_node(const char *, const char *);
-
-static int ofs_chmod(const char *path, mode_t mode) 
-{
-	ONODE *node = NULL;
-	ONODE *parent;
-	
-	/* 에러 체크 */
-	if (ofs_check_path_len(path) != 0)					//파일 이름 적합성 검사
-		return -ENAMETOOLONG;
-	if((node = ofs_findnode(root, path)) == NULL)			//파일 존재 여부 검사 
-		return -ENOENT;
-	if(node -> of_stat -> of_uid != fuse_get_context()->uid && fuse_get_context()->uid != 0)	//Owner 혹은 Previliged User여부 확인
-		return -EPERM;
-	parent = ofs_findparent(root, path);			//변경할 노드의 상위 정보 구하기
-	if(*(parent->name) == '_')		// 타입 디렉토리에서 타입 노드 변경 불가
-		return -EACCES;
-	
-	/* 권한 변경 */
-	node -> of_stat -> of_mode = mode; 					//파일의 Permmission 변경
-	
-	return 0;
-}
-
-
-static int ofs_chown(const char *path, uid_t uid, gid_t gid) 
-{
-	ONODE *node = NULL;
-	ONODE *parent;
-	
-	/* 에러 체크  */
-	if (ofs_check_path_len(path) != 0)							
-		return -ENAMETOOLONG;
-	if((node = ofs_findnode(root, path)) == NULL) 			
-		return -ENOENT;
-	if(node -> of_stat -> of_uid != fuse_get_context()->uid && fuse_get_context()->uid != 0)	//Owner 혹은 Previliged User여부 확인
-		return -EPERM;
-	parent = ofs_findparent(root, path);			//변경할 노드의 상위 정보 구하기
-	if(*(parent->name) == '_')		// 타입 디렉토리에서 타입 노드 변경 불가
-		return -EACCES;
-	
-	/* 소유권 변경 */
-	node -> of_stat -> of_uid = uid;						//파일의 Owner 변경
-	node -> of_stat -> of_gid = gid; 						//파일의 Group 변경
-
-	return 0;
-}
-
-
-static int ofs_truncate(const char *path, off_t length) 
-{
-	ONODE *node = NULL;
-	OSTAT *stat = NULL;
-	ONODE *parent;
-	
-	/* 에러 체크 루틴 */
-	if(length < 0)									//Truncate Offset이 음수일 경우 에러 반환
-		return -EINVAL;				
-	if (ofs_check_path_len(path) != 0) 					
-		return -ENAMETOOLONG;
-	if((node = ofs_findnode(root, path)) == NULL) 			
-		return -ENOENT;
-	parent = ofs_findparent(root, path);			//변경할 노드의 상위 정보 구하기
-	if(*(parent->name) == '_')		// 타입 디렉토리에서 타입 노드 변경 불가
-		return -EACCES;
-		
-	stat = node -> of_stat;
-	if ((ofs_check_access(stat->of_mode, stat->of_uid, stat->of_gid, W_OK)) != 0 || 
-		S_ISDIR(stat->of_mode)) 						//엑세스 권한및 디렉토리 여부 확인
-			return -EACCES;
-
-	/* 파일 길이 변경 */
-	if(stat -> of_size > length) {							//파일 길이를 줄이는 경우
-		node -> of_data = (byte_t*)realloc(node -> of_data, length);
-		stat -> of_size = length;
-	}											//파일 길이를 늘리는 경우 (아무것도 하지 않음)
-		
-	return 0;
-}
-
-// 파일 노드를 만든다.
-int ofs_makenod (const char* path, mode_t mode, dev_t dev) {
-	ONODE *newfile = NULL, *target;
-
-	/* 에러 체크 */
-	if (ofs_check_path_len(path) != 0) 
-		return -ENAMETOOLONG;
-	if (ofs_findnode(root, path) != NULL) 
-		return -EEXIST;
-	if((target = ofs_findparent(root, path)) == NULL) 		// 입력된 Path가 존재하는지 확인
-		return -ENOENT;
-	if(!S_ISDIR(target->of_stat->of_mode)) 				// Path가 디렉토리 인지 확인
-		return -ENOTDIR;
-	//파일이 생성될 디렉토리의 권한 확인
-	if ((ofs_check_access(target->of_stat->of_mode, target->of_stat->of_uid, target->of_stat->of_gid, W_OK | X_OK)) != 0)
-		return -EACCES;								
-
-	/* Special Files 처리 */
-	if (S_ISBLK(mode) || S_ISCHR(mode))
-	{
-		if(fuse_get_context()->uid != 0) return -EPERM;					// Previliged User 여부 확인
-		newfile->of_stat->of_rdev = dev;
-	}
-
-	/* 파일 생성 - Real User ID와 Real Group ID를 얻어서 파일을 생성해 준다 */
-	newfile = ofs_neONODE(ofs_parsingname(path), mode , fuse_get_context()->uid , fuse_get_context()->gid);
-	ofs_insertnode(target, newfile);
-
-	return 0;
-}
-
-void ofs_newtypedir(const char *path) {
-	ofs_makedir(path, 0755);
-}
-
-void ofs_addtypelink(const char *path) {
-	ONODE *onode, *typedir;
-	char *typedir_name, *file_name;
-	char *typedir_path, *parent_path, *link_path;
-	char *old_path;
-
-	// 부모 디렉토리로부터 타입 디렉토리를 찾는다.
-	typedir_name = ofs_typedirname(path);
-	onode = ofs_findnode(root, path);
-	typedir = ofs_findnode(onode->parentdir, typedir_name);
-	fprintf(stderr, "** typedir_name %s\n", typedir_name);
-
-	// 부모 디렉토리와 타입 디렉토리의 경로를 얻는다.
-	parent_path = ofs_parsingparent(path);
-	typedir_path = (char *)malloc(sizeof(char)*(strlen(parent_path)+strlen(typedir_name)+1));
-	strcpy(typedir_path, parent_path);
-	strcat(typedir_path, typedir_name);
-	fprintf(stderr, "** parent_path %s\n", parent_path);
-	fprintf(stderr, "** typedir_path %s\n", typedir_path);
-
-	// 타입 디렉토리가 없으면 새로 만든다.
-	if(typedir == NULL)
-		ofs_newtypedir(typedir_path);
-
-	// 타입 디렉토리 내에 심볼릭 링크를 만든다.
-	file_name = ofs_parsingname(path);
-	old_path = (char *)malloc(sizeof(char)*(3+strlen(file_name)+1));
-	strcpy(old_path, "../");
-	strcat(old_path, file_name);
-	fprintf(stderr, "** old_path %s\n", old_path);
-	link_path = (char *)malloc(sizeof(char)*(strlen(typedir_path)+1+strlen(file_name)+1));
-	strcpy(link_path, typedir_path);
-	strcat(link_path, "/");
-	strcat(link_path, file_name);
-	fprintf(stderr, "** link_path %s\n", link_path);
-	ofs_symlink(old_path, link_path);
-
-	free(typedir_name);
-	free(typedir_path);
-	free(parent_path);
-	free(link_path);
-	free(old_path);
-}
-
-// 일반 파일 노드를 만든다.
-static int ofs_mknod(const char *path, mode_t mode, dev_t dev) 
-{
-	int ret;
-	char *node_name;
-	ONODE *parent;
-
-	/* 에러 체크 */
-	if (ofs_check_path_len(path) != 0)
-		return -ENAMETOOLONG;
-	parent = ofs_findparent(root, path);			//삽입할 노드의 상위 정보 구하기
-	if(*(parent->name) == '_')		// 타입 디렉토리에서는 생성 불가
-		return -EACCES;
-	node_name = ofs_parsingname(path);
-	if(*node_name == '_')
-		return -EINVAL;				// 파일 이름은 _로 시작할 수 없다.
-
-	// 파일 노드를 만든다.
-	ret = ofs_makenod(path, mode, dev);
-
-	if(ret == 0) {
-		fprintf(stderr, "** add type link %s\n", path);
-		// 이 파일 노드에 대한 새로운 타입 링크를 추가한다.
-		if(ofs_extension(node_name) != NULL) {	
-			ofs_addtypelink(path);
-		}
-	}
-
-	return ret;
-}
-
-static int ofs_link(const char *oldname, const char *newname) 
-{
-	ONODE *dstnode, *srcnode;
-	int ret;
-	
-	/* 에러 체크 */
-	if (ofs_check_path_len(oldname) != 0)
-		return -ENAMETOOLONG;
-	if((srcnode = ofs_findnode(root, oldname)) == NULL)
-		return -ENOENT;
-	if(S_ISDIR(srcnode->of_stat->of_mode) && fuse_get_context()->uid != 0)	//Hard Link생성 권한 확인
-		return -EPERM;
-	
-	/* Hard Link 파일 생성 - 에러 발생시 에러 반환 */
-	if((ret = ofs_makenod(newname, srcnode->of_stat->of_mode, srcnode->of_stat->of_rdev)) != 0) 
-		return ret;
-	
-	/* 파일 연결 */
-	srcnode -> of_stat -> of_nlink++;					//nlink 증가 시킴
-	dstnode = ofs_findnode(root, newname);
-	dstnode -> of_data = srcnode -> of_data;				//data정보 연결
-	dstnode -> of_stat = srcnode -> of_stat;				//node정보 연결
-
-	return 0;
-}
-
-static int ofs_symlink(const char *oldname, const char *newname) 
-{
-	ONODE *dstnode;
-	int ret, len;
-	
-	/* 에러 체크 */
-	if (ofs_check_path_len(oldname) != 0)
-		return -ENAMETOOLONG;
-		
-	/* Symbolic Link 파일 생성 */
-	if((ret = ofs_makenod(newname, S_IFLNK | 0777, 0)) != 0) 
-		return ret;
-	
-	/* Symoblic Link 데이터 저장 */
-	len = strlen(oldname)+1;
-	dstnode = ofs_findnode(root, newname);
-	ofs_setdata(dstnode, oldname, len, 0);					//파일의 데이터 영역에 이름을 저장
-	
-	return 0;
-}
-
-static int ofs_readlink(const char* path, char *buffer, size_t size) 
-{
-	ONODE *node = NULL;
-	
-	/* 에러 체크 */
-	if (ofs_check_path_len(path) != 0) 
-		return -ENAMETOOLONG;
-	if ((node = ofs_findnode(root, path)) == NULL) 
-		return -ENOENT;
-	if ((ofs_check_access(node -> of_stat -> of_mode, node -> of_stat -> of_uid, node -> of_stat -> of_gid, R_OK)) != 0) 
-		return -EACCES;
-	if (!S_ISLNK(node-> of_stat ->of_mode)) 				//심볼릭 링크 파일인지 확인
-		return -EINVAL;
-	
-	/* 심볼링 링크 저장 */
-	memcpy(buffer, node->of_data, size); 
-	
-	return 0;
-}
-
-static int ofs_getattr(const char *path, struct stat *stbuf)
-{
-	ONODE *node = NULL;
-	
-	/* 에러 체크 */
-	if (ofs_check_path_len(path) != 0)
-		return -ENAMETOOLONG;
-	
-	/* node attribute 반환 */
-	memset(stbuf, 0, sizeof(struct stat));					//stat 구조체 초기화
-	if ((node = ofs_findnode(root, path)) != NULL) {
-		stbuf -> st_ino = node -> of_stat -> of_id;
-		stbuf -> st_mode = node -> of_stat -> of_mode;
-		stbuf -> st_nlink = node -> of_stat -> of_nlink;
-		stbuf -> st_uid = node -> of_stat -> of_uid;
-		stbuf -> st_gid = node -> of_stat -> of_gid;
-		stbuf -> st_size = node -> of_stat -> of_size;
-		stbuf -> st_atime = node -> of_stat -> of_atime;
-		stbuf -> st_mtime = node -> of_stat -> of_mtime;
-		stbuf -> st_ctime = node -> of_stat -> of_ctime;
-		return 0;
-	} else {
-		return -ENOENT;
-	}
-}
-
-static int ofs_readdir(const char *path, void *buf, fuse_fill_dir_t filler, off_t offset, struct fuse_file_info *fi)
-{
-	(void) offset;
-	(void) fi;
-	ONODE *loc, *cur;
-	
-	/* 에러 체크 */
-	if (ofs_check_path_len(path) != 0)
-		return -ENAMETOOLONG;
-	if((loc = ofs_findnode(root, path)) == NULL)
-		return -ENOENT;
-	if(!S_ISDIR(loc-> of_stat -> of_mode)) 
-		return -ENOTDIR;
-	
-	/* 디렉토리 이름 정보 반환 */
-	filler(buf, ".", NULL, 0);
-	filler(buf, "..", NULL, 0);
-	for(cur = loc->subhead;cur != NULL;cur = cur->nextnode) {		//디렉토리의 서브 엔트리 반복
-		filler(buf, cur->name, NULL, 0);						//디렉토리 채우기
-	}
-
-	return 0;
-}
-
-static int ofs_access(const char *path, int how) 
-{
-	ONODE *node = NULL;
-	
-	/* 에러 체크 */
-	if (ofs_check_path_len(path) != 0)
-		return -ENAMETOOLONG;
-	if ((node = ofs_findnode(root, path)) == NULL) 
-		return -ENOENT;
-		
-	/* 권한 체크 */	
-	if(how == F_OK)								//파일 존재 여부 확인 
-		return 0;
-	return ofs_check_access(node -> of_stat -> of_mode, node -> of_stat -> of_uid, node -> of_stat -> of_gid, how);
-}
-
-static int ofs_utime(const char *path, struct utimbuf *times) 
-{
-	ONODE *node = NULL;
-	OSTAT *stat = NULL;
-	ONODE *parent;
-	
-	/* 에러 체크 */
-	if (ofs_check_path_len(path) != 0) 
-		return -ENAMETOOLONG;
-	if ((node = ofs_findnode(root, path)) == NULL) 
-		return -ENOENT;
-	stat = node -> of_stat;
-	if ((ofs_check_access(stat -> of_mode, stat -> of_uid, stat -> of_gid, W_OK)) != 0) 
-		return -EACCES;
-	parent = ofs_findparent(root, path);			//변경할 노드의 상위 정보 구하기
-	if(*(parent->name) == '_')		// 타입 디렉토리에서 타입 노드 변경 불가
-		return -EACCES;
-	
-	/* 시간 변경 */
-	if(times == NULL) {									//NULL일경우 현재시간 저장
-		node-> of_stat -> of_atime = time(NULL);
-		node-> of_stat -> of_mtime = time(NULL);		
-	} else {											//전달 받은 시간 저장
-		if (node-> of_stat -> of_uid != fuse_get_context()->uid && fuse_get_context()->uid != 0) 	//소유자 이거나 Previliged인지 확인
-			return -EPERM;
-		node-> of_stat -> of_atime = times -> actime;		
-		node-> of_stat -> of_mtime = times -> modtime;
-	}
-	return 0;
-}
-
-int ofs_unlink_node(const char *path) {
-	ONODE *node = NULL, *parent = NULL;
-	OSTAT *stat = NULL;
-	
-	/* 에러 체크 */
-	if (ofs_check_path_len(path) != 0)
-		return -ENAMETOOLONG;
-	parent = ofs_findparent(root, path);			//삭제할 노드의 상위 정보 구하기
-	stat = parent -> of_stat;
-	if ((ofs_check_access(stat -> of_mode, stat -> of_uid, stat -> of_gid, W_OK | X_OK)) != 0) 
-		return -EACCES;
-	if((node = ofs_findnode(root, path)) == NULL) 
-		return -ENOENT;
-	if(S_ISDIR(node-> of_stat ->of_mode)) 
-		return -EPERM;
-	
-	/* 파일 삭제 */
-	if(node -> of_stat -> of_nlink == 1) {			//하드 링크 수가 1일 경우 - 실제 데이터와 노드정보를 삭제
-		if(node -> of_data != NULL) free(node -> of_data);	
-		if(node -> of_stat != NULL) free(node -> of_stat);
-	} else {								//하드 링크수가 1이상일 경우 하드 링크수를 1 감소
-		node -> of_stat -> of_nlink -= 1;		
-	}
-	free(ofs_deletenode(node));				//노드 제거
-	return 0;
-}
-
-static int ofs_unlink(const char *path) {
-	ONODE *parent = NULL, *typedir = NULL;
-	char *file_name, *typedir_name;
-	char *parent_path, *typedir_path, *link_path;
-	char *extension;
-	int ret;
-
-	/* 에러 체크 */
-	if (ofs_check_path_len(path) != 0)
-		return -ENAMETOOLONG;
-	parent = ofs_findparent(root, path);			//삭제할 노드의 상위 정보 구하기
-	if(*(parent->name) == '_')		// 타입 디렉토리에서 타입 노드 삭제 불가
-		return -EACCES;
-	if(ofs_findnode(root, path) == NULL) 
-		return -ENOENT;
-
-	file_name = ofs_parsingname(path);
-	extension = ofs_extension(file_name);
-	if(extension != NULL) {
-		// 확장자가 있는 경우, 타입 노드를 삭제한다.
-		parent_path = ofs_parsingparent(path);
-		typedir_name = ofs_typedirname(file_name);
-		typedir_path = (char *)malloc(sizeof(char)*(strlen(parent_path)+strlen(typedir_name)+1));
-		strcpy(typedir_path, parent_path);
-		strcat(typedir_path, typedir_name);
-		link_path = (char *)malloc(sizeof(char)*(strlen(typedir_path)+1+strlen(file_name)+1));
-		strcpy(link_path, typedir_path);
-		strcat(link_path, "/");
-		strcat(link_path, file_name);
-		ofs_unlink_node(link_path);
-
-		// 타입 디렉토리가 비어버린 경우, 타입 디렉토리도 삭제한다.
-		typedir = ofs_findnode(root, typedir_path);
-		if(typedir->subhead == NULL) {
-			ofs_removedir(typedir_path);
-		}
-		
-		free(parent_path);
-		free(typedir_name);
-		free(typedir_path);
-		free(link_path);
-	}
-
-	ret = ofs_unlink_node(path);
-	return ret;
-}
-
-int ofs_removedir(const char *path) {
-	ONODE *node = NULL, *parent = NULL;
-	OSTAT *stat = NULL;
-	
-	/* 에러 체크 */
-	if(strcmp(path, "/") == 0)					//루트(마운트 포인트) 삭제 불가 
-		return -EBUSY;
-	if (ofs_check_path_len(path) != 0) 
-		return -ENAMETOOLONG;
-	parent = ofs_findparent(root, path);
-	stat = parent -> of_stat;
-	if ((ofs_check_access(stat -> of_mode, stat -> of_uid, stat -> of_gid, W_OK | X_OK)) != 0) 
-		return -EACCES;
-	if((node = ofs_findnode(root, path)) == NULL) 
-		return -ENOENT;
-	if(node-> subhead != NULL) 			//부모 디렉토리가 비어있지 않은 경우
-		return -ENOTEMPTY;
-	if(!S_ISDIR(node-> of_stat ->of_mode)) 	//디렉토리가 아닌 경우
-		return -EPERM;
-	
-	/* 디렉토리 삭제 */
-	if(node -> of_stat != NULL) 
-		free(node -> of_stat);				//디렉토리 노드 정보 삭제
-	parent -> of_stat -> of_nlink -= 1;		//부모 디렉토리의 링크 수 감소
-	free(ofs_deletenode(node));			//노드 제거	
-
-	return 0;
-}
-
-static int ofs_rmdir(const char *path) {
-	int ret;
-	char *dir_name;
-
-	dir_name = ofs_parsingname(path);
-	if(*dir_name == '_')					// 타입 디렉토리는 삭제할 수 없다
-		return -EACCES;
-
-	ret = ofs_removedir(path);
-	return ret;
-}
-
-// 디렉토리를 만든다.
-int ofs_makedir(const char *path, mode_t mode) {
-	ONODE *newdir = NULL, *target = NULL;
-	OSTAT *stat = NULL;
-	
-	/* 에러 체크 */
-	if (ofs_check_path_len(path) != 0) 
-		return -ENAMETOOLONG;
-	if (ofs_findnode(root, path) != NULL) 			//이미 존재하는 이름일 경우
-		return -EEXIST;
-	if((target = ofs_findparent(root, path)) == NULL) 
-		return -ENOENT;	
-	stat = target -> of_stat;
-	if ((ofs_check_access(stat -> of_mode, stat -> of_uid, stat -> of_gid, W_OK | X_OK)) != 0) 
-		return -EACCES;
-	if(!S_ISDIR(target-> of_stat ->of_mode)) 			//Path 의 적합성 판단
-		return -ENOTDIR;
-	
-	/* 디렉토리 생성 */
-	target -> of_stat -> of_nlink++;					//부모 디렉토리의 링크 수 증가
-	newdir = ofs_neONODE(ofs_parsingname(path), S_IFDIR | mode , fuse_get_context()->uid, fuse_get_context()->gid);
-	ofs_insertnode(target, newdir);
-	
-	return 0;
-}
-
-// 일반 디렉토리를 만든다.
-static int ofs_mkdir(const char *path, mode_t mode) {
-	int ret;
-	char *dir_name;
-	ONODE *parent;
-
-	/* 에러 체크 */
-	if (ofs_check_path_len(path) != 0)
-		return -ENAMETOOLONG;
-	parent = ofs_findparent(root, path);			//삽입할 노드의 상위 정보 구하기
-	if(*(parent->name) == '_')		// 타입 디렉토리에서는 생성 불가
-		return -EACCES;
-	dir_name = ofs_parsingname(path);
-	if(*dir_name == '_')
-		return -EINVAL;				// 디렉토리 이름은 _로 시작할 수 없다.
-
-	ret = ofs_makedir(path, mode);
-	return ret;
-}
-
-static int ofs_open(const char *path, struct fuse_file_info *fi)
-{
-	int how;
-	ONODE *node = NULL;
-	
-	/* 에러 체크 */
-	if (ofs_check_path_len(path) != 0) 
-		return -ENAMETOOLONG;
-	if ((node = ofs_findnode(root, path)) == NULL) 
-		return -ENOENT;	
-	if(S_ISDIR(node-> of_stat ->of_mode) && (fi-> flags & (O_WRONLY | O_RDWR))) //디렉터리 open시 처리
-		return -EISDIR;	
-	
-	/* OPEN FLAG 정보 파싱 */
-	if((fi -> flags & O_ACCMODE) == O_WRONLY) how = W_OK;
-	else if((fi -> flags & O_ACCMODE) == O_RDONLY) how = R_OK;
-	else how = W_OK | R_OK;
-	
-	/* 파일 권한 확인 */
-	if ((ofs_check_access(node -> of_stat -> of_mode, node -> of_stat -> of_uid, node -> of_stat -> of_gid, how)) != 0) {
-		return -EACCES;
-	}
-	
-	return 0;
-}
-
-static int ofs_read(const char *path, char *buf, size_t size, off_t offset, struct fuse_file_info *fi)
-{
-	(void) fi;	
-	int len;
-	ONODE* node;
-	
-	/* 에러 체크 */
-	if ((node = ofs_findnode(root, path)) == NULL) 
-		return -ENOENT;
-	
-	/* 파일 읽기 */
-	len = node -> of_stat -> of_size;					//데이터 길이 확인
-	if (offset < len) {								//Offset이 데이터 길이를 넘어간 경우 에러
-		if (offset + size > len)						//적합한 크기 구하기
-			size = len - offset;
-		memcpy(buf, node -> of_data + offset, size);	//데이터 읽기 버퍼에 저장
-	} else {
-		size = 0;
-	}
-	
-	return size;
-}
-
-
-static int ofs_write(const char *path, const char *buf, size_t size, off_t offset, struct fuse_file_info *fi) 
-{
-	(void)fi;
-	ONODE* node;
-	ONODE *parent;
-	
-	if ((node = ofs_findnode(root, path)) == NULL) 
-		return -ENOENT;
-	parent = ofs_findparent(root, path);			//변경할 노드의 상위 정보 구하기
-	if(*(parent->name) == '_')		// 타입 디렉토리에서 타입 노드 변경 불가
-		return -EACCES;
-			
-	ofs_setdata(node, buf, size, offset);
-	
-	return size;
-}
-
-int ofs_rename_node(const char *oldname, const char *newname) 
-{
-	int ret;
-	ONODE *oldp, *newp, *old, *new; 
-	OSTAT *olds, *news;
-	
-	/* 에러 체크 */
-	if (ofs_check_path_len(oldname) != 0 || ofs_check_path_len(newname) != 0)
-		return -ENAMETOOLONG;
-	if ((oldp = ofs_findparent(root, oldname)) == NULL 
-		|| (newp = ofs_findparent(root, newname)) == NULL) 			//각각의 부모 디렉토리가 존재하는지 확인
-			return -ENOENT;
-	olds = oldp->of_stat;
-	news = newp->of_stat;
-	if ((ofs_check_access(olds->of_mode, olds->of_uid, olds->of_gid, W_OK | X_OK)) != 0
-		|| (ofs_check_access(news->of_mode, news->of_uid, news->of_gid, W_OK | X_OK)) != 0)
-			return -EACCES;
-	if((old = ofs_findnode(root, oldname)) == NULL) 
-		return -ENOENT;	
-	if ((new = ofs_findnode(root, newname)) != NULL)
-		if((ret = ofs_unlink(newname)) != 0) 
-			return ret;
-	
-	/* 파일 이름 변경 */
-	strcpy(old->name, ofs_parsingname(newname));
-	if(oldp != newp) {
-		oldp -> of_stat -> of_nlink--;					//oldname의 부모 디렉토리의 링크 수 감소	
-		newp -> of_stat -> of_nlink++;					//newname의 부모 디렉토리의 링크 수 증가
-		ofs_insertnode(newp, ofs_deletenode(old));
-	}
-	return 0;
-}
-
-static int ofs_rename(const char *oldname, const char *newname) 
-{
-	char *old_parent_path, *new_parent_path;
-	ONODE *neONODE;
-	int ret;
-
-	// 변경 전후의 디렉토리 이름을 알아낸다.
-	old_parent_path = ofs_parsingparent(oldname);
-	new_parent_path = ofs_parsingparent(newname);
-
-	/* 에러 체크 */
-	// 변경 후의 디렉토리가 타입 디렉토리일 수 없다.
-	fprintf(stderr, "** %s : %s\n", new_parent_path, ofs_parsingname(new_parent_path));
-	fprintf(stderr, "** %s : %s\n", newname, ofs_parsingname(new_parent_path));
-	if(*(ofs_parsingname(new_parent_path)) == '_')
-		return -EACCES;
-	if(*(ofs_parsingname(newname)) == '_')
-		return -EACCES;
-
-	// 노드의 이름을 바꾼다.
-	ret = ofs_rename_node(oldname, newname);
-	
-	fprintf(stderr, "** %s to %s\n", oldname, newname);
-
-	if(ret == 0) {
-		// 변경된 노드가 디렉토리가 아닌 경우, 타입 링크를 변경해야 한다.
-		neONODE = ofs_findnode(root, newname);
-		if(S_ISDIR(neONODE->of_stat->of_mode) == 0) {
-			char *old_extension, *new_extension;
-			char *old_file_name, *new_file_name;
-			char *old_typedir_path, *new_typedir_path;
-			char *old_typedir_name, *new_typedir_name;
-			char *old_link_path, *new_link_path;
-			char *new_link_target;
-			ONODE *typedir;
-
-			// 변경 전후의 확장자명을 알아낸다.
-			old_file_name = ofs_parsingname(oldname);
-			new_file_name = ofs_parsingname(newname);
-			old_extension = ofs_extension(old_file_name);
-			new_extension = ofs_extension(new_file_name);
-
-			// 변경 전후의 타입 링크 주소를 알아낸다.
-			old_typedir_name = ofs_typedirname(old_file_name);
-
-			old_typedir_path = (char *)malloc(sizeof(char)*(strlen(old_parent_path)+strlen(old_typedir_name)+1));
-			strcpy(old_typedir_path, old_parent_path);
-			strcat(old_typedir_path, old_typedir_name);
-			old_link_path = (char *)malloc(sizeof(char)*(strlen(old_typedir_path)+1+strlen(old_file_name)+1));
-			strcat(old_link_path, old_typedir_path);
-			strcat(old_link_path, "/");
-			strcat(old_link_path, old_file_name);
-			
-			new_typedir_name = ofs_typedirname(new_file_name);
-
-			new_typedir_path = (char *)malloc(sizeof(char)*(strlen(new_parent_path)+strlen(new_typedir_name)+1));
-			strcpy(new_typedir_path, new_parent_path);
-			strcat(new_typedir_path, new_typedir_name);
-			new_link_path = (char *)malloc(sizeof(char)*(strlen(new_typedir_path)+1+strlen(new_file_name)+1));
-			strcat(new_link_path, new_typedir_path);
-			strcat(new_link_path, "/");
-			strcat(new_link_path, new_file_name);
-
-			if(old_extension != NULL || new_extension != NULL) {
-				// 타입 디렉토리 노드를 알아낸다.
-				typedir = ofs_findnode(root, new_typedir_path);
-
-				// 확장자가 있는 파일로 옮기며 타입 디렉토리가 없는 경우, 새로 만든다.
-				if(new_extension != NULL && typedir == NULL) {
-					ofs_newtypedir(new_typedir_path);
-				}
-
-				// 타입 노드를 옮긴다.
-				new_link_target = (char *)malloc(sizeof(char)*(3+strlen(new_file_name)+1));
-				strcpy(new_link_target, "../");
-				strcat(new_link_target, new_file_name);
-				// 확장자 있는 파일로부터 옮기는 경우
-				if(old_extension != NULL) {
-					// 타입 노드를 제거한다.
-					ofs_unlink_node(old_link_path);
-				}
-				// 확장자 있는 파일로 옮기는 경우
-				if(new_extension != NULL) {
-					// 타입 노드를 생성한다.
-					ofs_symlink(new_link_target, new_link_path);
-				}
-
-				// 확장자 있는 파일로부터 옮기는 경우, 타입 디렉토리가 비게 되면 지운다.
-				if(old_extension != NULL) {
-					typedir = ofs_findnode(root, old_typedir_path);
-					if(typedir->subhead == NULL) {
-						ofs_removedir(old_typedir_path);
-					}
-				}
-			}
-
-			free(old_typedir_path);
-			free(new_typedir_path);
-			free(old_typedir_name);
-			free(new_typedir_name);
-			free(old_link_path);
-			free(new_link_path);
-		}
-	}
-	free(old_parent_path);
-	free(new_parent_path);
-	return ret;
-}
-
-static int ofs_opendir(const char *path, struct fuse_file_info *fi) 
-{
-	int how;
-	ONODE *node = NULL;
-
-	/* 에러 체크 */
-	if (ofs_check_path_len(path) != 0) 
-		return -ENAMETOOLONG;
-	if ((node = ofs_findnode(root, path)) == NULL) 
-		return -ENOENT;
-	
-	/* OPEN FLAG 파싱*/
-	if((fi -> flags & O_ACCMODE) == O_WRONLY) how = W_OK;
-	else if((fi -> flags & O_ACCMODE) == O_RDONLY) how = R_OK;
-	else how = W_OK | R_OK;
-	
-	/* 디렉토리 권한 확인*/
-	if ((ofs_check_access(node -> of_stat -> of_mode, node -> of_stat -> of_uid, node -> of_stat -> of_gid, how)) != 0) {
-		return -EACCES;
-	}
-	
-	return 0;
-}
-
-static struct fuse_operations ofs_oper = {
-	.access = ofs_access,
-	.getattr = ofs_getattr,
-	.readdir	= ofs_readdir,
-	.mknod = ofs_mknod,
-	.open = ofs_open,
-	.read	= ofs_read,
-	.write = ofs_write,
-	.unlink = ofs_unlink,
-	.readlink = ofs_readlink,
-	.mkdir = ofs_mkdir,
-	.rmdir = ofs_rmdir,
-	.utime = ofs_utime,
-	.symlink = ofs_symlink,
-	.link = ofs_link,
-	.chmod = ofs_chmod,
-	.chown = ofs_chown,
-	.truncate = ofs_truncate,
-	.rename = ofs_rename,
-	.opendir = ofs_opendir,
-};
-
-int main(int argc, char *argv[]) 
-{
-	int ret;
-	root = ofs_neONODE("/", S_IFDIR | 0755, getuid(), getgid());
-	ret = fuse_main(argc, argv, &ofs_oper, NULL);
-	return ret;
-}
+﻿#define FUSE_USE_VERSION 31
+
+#include <fuse.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <ctype.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <poll.h>
+#include <sys/statvfs.h>
+
+#include "node.h"
+#include "lib.h"
+#include "journal.h"
+#include "data.h"
+#include "ofs_ioctl.h"
+#include "stats.h"
+#include "trace.h"
+#include "quota.h"
+#include "export.h"
+#include "changelog.h"
+#include "index.h"
+#include "xattr.h"
+
+#ifndef RENAME_NOREPLACE
+#define RENAME_NOREPLACE	(1 << 0)
+#endif
+#ifndef FALLOC_FL_KEEP_SIZE
+#define FALLOC_FL_KEEP_SIZE	0x01
+#endif
+
+static ONODE *root;
+static pthread_rwlock_t ofs_tree_lock = PTHREAD_RWLOCK_INITIALIZER;	// 트리 전체 잠금
+
+/* 마운트 옵션 */
+struct ofs_config {
+	char			*journal;				// 저널 파일 경로 (없으면 저널 사용 안함)
+	int			journal_commit;		// 그룹 커밋 주기(ms), 0이면 연산마다 커밋을 기다린다
+	unsigned long	journal_checkpoint;	// 체크포인트를 만드는 저널 크기(MB)
+	unsigned long	mem_budget;			// 파일 데이터가 쓸 메모리 한도(MB), 0이면 제한 없음
+	char			*spill;				// 한도를 넘은 데이터를 내보낼 보조 파일
+	int			compress;			// 차가운 청크 압축 레벨(1-9), 0이면 압축하지 않음
+	int			compress_age;		// 압축할 때까지 참조되지 않아야 하는 시간(초)
+	unsigned long	compress_cache;		// 압축을 푼 핫 청크 캐시 크기(MB)
+	int			dedup;				// 청크 단위 중복 제거
+	unsigned long	huge_file;			// 이 크기(MB)를 넘는 파일은 큰 페이지 매핑에 둔다, 0이면 쓰지 않음
+	int			checksum;			// 청크별 CRC32C
+	unsigned int	checksum_verify;		// 청크 읽기 N번에 한번 체크섬 검사, 0이면 검사 안함
+	unsigned long	scrub;				// 스크러버가 초당 검사할 데이터(MB), 0이면 쓰지 않음
+	int			stats;				// 마운트할 때부터 연산 통계 수집 (없으면 /.ofs/stats를 처음 읽을 때부터)
+	char			*trace;				// 추적 수준 (off, err, info, debug), 기본은 err
+	unsigned long	trace_size;			// 스레드별 추적 레코드 수
+	unsigned long	size;				// 파일 시스템 크기(MB), 넘으면 ENOSPC, 0이면 제한 없음
+	unsigned long	inodes;				// 노드 수 한도
+	unsigned long	user_quota;			// 사용자별 기본 한도(MB), 넘으면 EDQUOT
+	unsigned long	user_inodes;
+	unsigned long	group_quota;			// 그룹별 기본 한도(MB)
+	unsigned long	group_inodes;
+	unsigned long	wbuf;				// 핸들별 쓰기 모음 버퍼 크기(KB), 0이면 쓰지 않음
+	char			*import;				// 마운트 전에 가져올 로컬 디렉토리
+	int			import_threads;		// 가져오기 스레드 수, 0이면 CPU 수
+	unsigned long	changelog;			// 변경 기록으로 남길 레코드 수, 0이면 남기지 않음
+	int			index;				// 크기/수정 시각 색인과 /_query 디렉토리
+	int			tags;				// user.tag.* 태그 색인과 /_tag 디렉토리
+	unsigned int	cred_ttl;			// 요청 프로세스의 보조 그룹을 캐시할 시간(ms), 0이면 캐시하지 않음
+	int			noatime;			// 접근 시각을 고치지 않는다
+	int			strictatime;		// 읽을 때마다 접근 시각을 고친다 (없으면 relatime)
+};
+
+static struct ofs_config conf;
+static char *ofs_image_path;
+
+#define OFS_OPT(t, p) { t, offsetof(struct ofs_config, p), 1 }
+
+static struct fuse_opt ofs_opts[] = {
+	OFS_OPT("journal=%s", journal),
+	OFS_OPT("journal_commit=%d", journal_commit),
+	OFS_OPT("journal_checkpoint=%lu", journal_checkpoint),
+	OFS_OPT("mem_budget=%lu", mem_budget),
+	OFS_OPT("spill=%s", spill),
+	OFS_OPT("compress=%d", compress),
+	OFS_OPT("compress_age=%d", compress_age),
+	OFS_OPT("compress_cache=%lu", compress_cache),
+	OFS_OPT("dedup", dedup),
+	OFS_OPT("huge_file=%lu", huge_file),
+	OFS_OPT("checksum", checksum),
+	OFS_OPT("checksum_verify=%u", checksum_verify),
+	OFS_OPT("scrub=%lu", scrub),
+	OFS_OPT("stats", stats),
+	OFS_OPT("trace=%s", trace),
+	OFS_OPT("trace_size=%lu", trace_size),
+	OFS_OPT("size=%lu", size),
+	OFS_OPT("inodes=%lu", inodes),
+	OFS_OPT("user_quota=%lu", user_quota),
+	OFS_OPT("user_inodes=%lu", user_inodes),
+	OFS_OPT("group_quota=%lu", group_quota),
+	OFS_OPT("group_inodes=%lu", group_inodes),
+	OFS_OPT("wbuf=%lu", wbuf),
+	OFS_OPT("import=%s", import),
+	OFS_OPT("import_threads=%d", import_threads),
+	OFS_OPT("changelog=%lu", changelog),
+	OFS_OPT("index", index),
+	OFS_OPT("tags", tags),
+	OFS_OPT("cred_ttl=%u", cred_ttl),
+	OFS_OPT("noatime", noatime),
+	OFS_OPT("strictatime", strictatime),
+	FUSE_OPT_END
+};
+
+static int ofs_chmod(const char *, mode_t); 
+static int ofs_chown(const char *, uid_t, gid_t); 
+static int ofs_truncate(const char *, off_t, int);
+static int ofs_fallocate(const char *, int, off_t, off_t);
+static int ofs_mknod(const char *, mode_t, dev_t); 
+static int ofs_link(const char *, const char *); 
+static int ofs_symlink(const char *, const char *); 
+static int ofs_readlink(const char*, char *, size_t); 
+static int ofs_getattr(const char *, struct stat *);
+static int ofs_readdir(const char *, void *, fuse_fill_dir_t, off_t, struct fuse_file_info *);
+static int ofs_access(const char *, int);
+static int ofs_utimens(const char *, const struct timespec[2]); 
+static int ofs_setxattr(const char *, const char *, const char *, size_t, int);
+static int ofs_removexattr(const char *, const char *);
+static int ofs_unlink(const char *);
+static int ofs_rmdir(const char *);
+static int ofs_mkdir(const char *, mode_t);
+static int ofs_open(const char *, struct fuse_file_info *);
+static int ofs_read(const char *, char *, size_t, off_t, struct fuse_file_info *);
+static int ofs_write(const char *, const char *, size_t , off_t , struct fuse_file_info *); 
+static int ofs_rename(const char *, const char *); 
+static int ofs_opendir(const char *, struct fuse_file_info *);
+static int ofs_release(const char *, struct fuse_file_info *);
+static ssize_t ofs_clone(const char *, off_t, const char *, off_t, size_t);
+static int ofs_clonefile(const char *, const char *);
+
+int ofs_makenod (const char*, mode_t, dev_t);
+void ofs_newtypedir(const char *);
+void ofs_addtypelink(const char *);
+int ofs_makedir(const char *, mode_t);
+int ofs_unlink_node(const char *);
+int ofs_removedir(const char *);
+int ofs_rename_node(const char *, const char *);
+
+/*
+ * 사용량 계산
+ * 노드(디렉토리 항목마다 ONODE, 파일마다 OSTAT)와 데이터(청크에 들어 있는 바이트)를
+ * 파일 소유자에게 센다. 타입 링크를 관리하는 동안 생기거나 지워지는 노드와 데이터는
+ * typelink로 세고, 파일을 만든 뒤에 타입 링크가 실패하지 않도록 한도를 검사하지 않는다.
+ */
+static int ofs_qtypelink;				// 타입 링크 관리 중 (중첩될 수 있다)
+
+#define OFS_QNODE		((ofs_qtypelink > 0)? OQ_TYPELINK : OQ_NODE)
+#define OFS_QDATA		((ofs_qtypelink > 0)? OQ_TYPELINK : OQ_DATA)
+#define OFS_INODE_BYTES	(sizeof(ONODE) + sizeof(OSTAT))		// 새 파일 하나의 노드 사용량
+#define OFS_STATFS_BLOCK	4096
+
+static int ofs_qcheck(uid_t uid, gid_t gid, uint64_t bytes, uint64_t inodes)
+{
+	return (ofs_qtypelink > 0)? 0 : ofs_quota_check(uid, gid, bytes, inodes);
+}
+
+static uint64_t ofs_qused(ONODE *node)
+{
+	return (node -> of_data != NULL)? node -> of_data -> used : 0;
+}
+
+/* 데이터 사용량의 변화를 소유자에게 반영 */
+static void ofs_qdata(ONODE *node, uint64_t before)
+{
+	int64_t delta = (int64_t)(ofs_qused(node) - before);
+
+	if(delta != 0)
+		ofs_quota_charge(node -> of_stat -> of_uid, node -> of_stat -> of_gid, OFS_QDATA, delta, 0);
+}
+
+/*
+ * 파일 시각
+ * 현재 시각은 연산마다 거친 시계로 한번만 읽는다(ofs_now). 수정 시각과 변경 시각은 쓰기
+ * 잠금 안에서 고친다. 접근 시각은 relatime과 같이 수정/변경 뒤에 처음 읽거나 하루가
+ * 지났을 때만 고치므로 대부분의 읽기는 노드에 쓰지 않는다. 읽기 잠금 안에서 여러 스레드가
+ * 고칠 수 있어 필드마다 원자적으로 쓰고, 저널에는 남기지 않는다 (lazytime과 같이
+ * 체크포인트 이미지로 저장된다).
+ */
+#define OFS_ATIME_RELATIME	86400			// relatime에서 접근 시각을 다시 고치는 간격(초)
+
+static int ofs_tsbefore(const struct timespec *a, const struct timespec *b)
+{
+	return a -> tv_sec < b -> tv_sec || (a -> tv_sec == b -> tv_sec && a -> tv_nsec < b -> tv_nsec);
+}
+
+/* 내용이 바뀌었다 (디렉토리는 항목이 바뀌었다) */
+static void ofs_modified(OSTAT *st)
+{
+	ofs_now(&st -> of_mtime);
+	st -> of_ctime = st -> of_mtime;
+}
+
+/* 노드 정보만 바뀌었다 */
+static void ofs_changed(OSTAT *st)
+{
+	ofs_now(&st -> of_ctime);
+}
+
+/* 읽었다 - 읽기 잠금 안에서 호출 */
+static void ofs_accessed(OSTAT *st)
+{
+	struct timespec at, now;
+
+	if(conf.noatime)
+		return;
+	at.tv_sec = __atomic_load_n(&st -> of_atime.tv_sec, __ATOMIC_RELAXED);
+	at.tv_nsec = __atomic_load_n(&st -> of_atime.tv_nsec, __ATOMIC_RELAXED);
+	ofs_now(&now);
+	if(!conf.strictatime && ofs_tsbefore(&st -> of_mtime, &at) && ofs_tsbefore(&st -> of_ctime, &at)
+		&& now.tv_sec - at.tv_sec < OFS_ATIME_RELATIME)
+		return;
+	if(at.tv_sec == now.tv_sec && at.tv_nsec == now.tv_nsec)	// 같은 시계 눈금 안에서는 한번만
+		return;
+	__atomic_store_n(&st -> of_atime.tv_sec, now.tv_sec, __ATOMIC_RELAXED);
+	__atomic_store_n(&st -> of_atime.tv_nsec, now.tv_nsec, __ATOMIC_RELAXED);
+}
+
+static int ofs_chmod(const char *path, mode_t mode) 
+{
+	ONODE *node = NULL;
+	ONODE *parent;
+	
+	/* 에러 체크 */
+	if (ofs_check_path_len(path) != 0)					//파일 이름 적합성 검사
+		return -ENAMETOOLONG;
+	if((node = ofs_findnode(root, path)) == NULL)			//파일 존재 여부 검사 
+		return -ENOENT;
+	if(node -> of_stat -> of_uid != ofs_context_uid() && ofs_context_uid() != 0)	//Owner 혹은 Previliged User여부 확인
+		return -EPERM;
+	if((parent = ofs_findparent(root, path)) == NULL)			//변경할 노드의 상위 정보 구하기
+		return -ENOENT;
+	if(ofs_istypedir(parent))		// 타입 디렉토리에서 타입 노드 변경 불가
+		return -EACCES;
+	
+	/* 권한 변경 */
+	node -> of_stat -> of_mode = mode; 					//파일의 Permmission 변경
+	ofs_changed(node -> of_stat);
+	
+	return 0;
+}
+
+
+static int ofs_chown(const char *path, uid_t uid, gid_t gid) 
+{
+	ONODE *node = NULL;
+	ONODE *parent;
+	OSTAT *st;
+	int64_t nbytes, dbytes;
+	int ret;
+	
+	/* 에러 체크  */
+	if (ofs_check_path_len(path) != 0)							
+		return -ENAMETOOLONG;
+	if((node = ofs_findnode(root, path)) == NULL) 			
+		return -ENOENT;
+	if(node -> of_stat -> of_uid != ofs_context_uid() && ofs_context_uid() != 0)	//Owner 혹은 Previliged User여부 확인
+		return -EPERM;
+	if((parent = ofs_findparent(root, path)) == NULL)			//변경할 노드의 상위 정보 구하기
+		return -ENOENT;
+	if(ofs_istypedir(parent))		// 타입 디렉토리에서 타입 노드 변경 불가
+		return -EACCES;
+	
+	/* 사용량을 새 소유자에게 옮긴다 - 먼저 빼고 검사해야 같은 사용자/그룹이 두 번 세지 않는다 */
+	st = node -> of_stat;
+	if(st -> of_uid != uid || st -> of_gid != gid) {
+		nbytes = sizeof(OSTAT) + ofs_xattr_size(st) + sizeof(ONODE) * (S_ISDIR(st -> of_mode)? 1 : st -> of_nlink);
+		dbytes = ofs_qused(node);
+		ofs_quota_charge(st -> of_uid, st -> of_gid, OQ_NODE, -nbytes, -1);
+		ofs_quota_charge(st -> of_uid, st -> of_gid, OQ_DATA, -dbytes, 0);
+		if((ret = ofs_quota_check(uid, gid, nbytes + dbytes, 1)) != 0) {
+			ofs_quota_charge(st -> of_uid, st -> of_gid, OQ_NODE, nbytes, 1);
+			ofs_quota_charge(st -> of_uid, st -> of_gid, OQ_DATA, dbytes, 0);
+			return ret;
+		}
+		ofs_quota_charge(uid, gid, OQ_NODE, nbytes, 1);
+		ofs_quota_charge(uid, gid, OQ_DATA, dbytes, 0);
+	}
+
+	/* 소유권 변경 */
+	node -> of_stat -> of_uid = uid;						//파일의 Owner 변경
+	node -> of_stat -> of_gid = gid; 						//파일의 Group 변경
+	ofs_changed(node -> of_stat);
+
+	return 0;
+}
+
+
+static int ofs_truncate(const char *path, off_t length, int reserve) 
+{
+	ONODE *node = NULL;
+	OSTAT *stat = NULL;
+	ONODE *parent;
+	uint64_t before;
+	int ret;
+	
+	/* 에러 체크 루틴 */
+	if(length < 0)									//Truncate Offset이 음수일 경우 에러 반환
+		return -EINVAL;				
+	if(length > OFS_FILE_MAX)							//최대 파일 크기
+		return -EFBIG;
+	if (ofs_check_path_len(path) != 0) 					
+		return -ENAMETOOLONG;
+	if((node = ofs_findnode(root, path)) == NULL) 			
+		return -ENOENT;
+	if((parent = ofs_findparent(root, path)) == NULL)			//변경할 노드의 상위 정보 구하기
+		return -ENOENT;
+	if(ofs_istypedir(parent))		// 타입 디렉토리에서 타입 노드 변경 불가
+		return -EACCES;
+		
+	stat = node -> of_stat;
+	if ((ofs_check_access(stat->of_mode, stat->of_uid, stat->of_gid, W_OK)) != 0 || 
+		S_ISDIR(stat->of_mode)) 						//엑세스 권한및 디렉토리 여부 확인
+			return -EACCES;
+
+	/* 파일 길이 변경 */
+	if(stat -> of_size > length && node -> of_data != NULL) {		//파일 길이를 줄이는 경우 - 뒤쪽 청크 해제
+		before = ofs_qused(node);
+		ofs_data_truncate(node -> of_data, length);
+		ofs_qdata(node, before);
+	} else if(reserve && stat -> of_size < length) {				//ftruncate로 늘리는 경우 - fallocate와 같이 미리 할당
+		if((ret = ofs_fallocate(path, 0, stat -> of_size, length - stat -> of_size)) != 0)
+			return ret;
+	}
+	stat -> of_size = length;								//파일 길이를 늘리는 경우 - 구멍은 0으로 읽힌다
+	ofs_modified(stat);
+	ofs_index_update(stat);
+		
+	return 0;
+}
+
+static int ofs_fallocate(const char *path, int mode, off_t offset, off_t length)
+{
+	ONODE *node = NULL;
+	OSTAT *stat = NULL;
+	ONODE *parent;
+	uint64_t before;
+	int ret;
+
+	/* 에러 체크 */
+	if(mode & ~FALLOC_FL_KEEP_SIZE)						//구멍 뚫기 등은 지원하지 않는다
+		return -EOPNOTSUPP;
+	if(offset < 0 || length <= 0)
+		return -EINVAL;
+	if(offset > OFS_FILE_MAX - length)					//최대 파일 크기
+		return -EFBIG;
+	if (ofs_check_path_len(path) != 0) 
+		return -ENAMETOOLONG;
+	if((node = ofs_findnode(root, path)) == NULL) 
+		return -ENOENT;
+	if((parent = ofs_findparent(root, path)) == NULL)
+		return -ENOENT;
+	if(ofs_istypedir(parent))		// 타입 디렉토리에서 타입 노드 변경 불가
+		return -EACCES;
+	stat = node -> of_stat;
+	if(!S_ISREG(stat->of_mode))
+		return -ENODEV;
+	if ((ofs_check_access(stat->of_mode, stat->of_uid, stat->of_gid, W_OK)) != 0)
+		return -EACCES;
+	if((ret = ofs_qcheck(stat->of_uid, stat->of_gid,
+		ofs_data_growth(node->of_data, length, offset), 0)) != 0)	//새로 차지할 만큼 한도 확인
+		return ret;
+
+	/* 저장 공간 미리 할당 */
+	if(node -> of_data == NULL)
+		node -> of_data = ofs_data_new();
+	before = ofs_qused(node);
+	ret = ofs_data_reserve(node -> of_data, offset, length);
+	ofs_qdata(node, before);
+	if(ret != 0)
+		return ret;
+	if(!(mode & FALLOC_FL_KEEP_SIZE) && offset + length > stat -> of_size) {
+		stat -> of_size = offset + length;				//KEEP_SIZE가 아니면 파일 크기도 늘린다
+		ofs_modified(stat);
+		ofs_index_update(stat);
+	} else {
+		ofs_changed(stat);
+	}
+	return 0;
+}
+
+// 파일 노드를 만든다.
+int ofs_makenod (const char* path, mode_t mode, dev_t dev) {
+	ONODE *newfile = NULL, *target;
+	int ret;
+
+	/* 에러 체크 */
+	if (ofs_check_path_len(path) != 0) 
+		return -ENAMETOOLONG;
+	if (ofs_findnode(root, path) != NULL) 
+		return -EEXIST;
+	if((target = ofs_findparent(root, path)) == NULL) 		// 입력된 Path가 존재하는지 확인
+		return -ENOENT;
+	if(!S_ISDIR(target->of_stat->of_mode)) 				// Path가 디렉토리 인지 확인
+		return -ENOTDIR;
+	//파일이 생성될 디렉토리의 권한 확인
+	if ((ofs_check_access(target->of_stat->of_mode, target->of_stat->of_uid, target->of_stat->of_gid, W_OK | X_OK)) != 0)
+		return -EACCES;								
+
+	/* Special Files 처리 */
+	if ((S_ISBLK(mode) || S_ISCHR(mode)) && ofs_context_uid() != 0)
+		return -EPERM;							// Previliged User 여부 확인
+	if ((ret = ofs_qcheck(ofs_context_uid(), ofs_context_gid(), OFS_INODE_BYTES, 1)) != 0)
+		return ret;								// 노드 수, 사용량 한도 확인
+
+	/* 파일 생성 - Real User ID와 Real Group ID를 얻어서 파일을 생성해 준다 */
+	newfile = ofs_neONODE(ofs_parsingname(path), mode , ofs_context_uid() , ofs_context_gid());
+	if (S_ISBLK(mode) || S_ISCHR(mode))
+		newfile->of_stat->of_rdev = dev;
+	ofs_insertnode(target, newfile);
+	ofs_modified(target -> of_stat);
+	ofs_index_add(newfile);
+	ofs_quota_charge(ofs_context_uid(), ofs_context_gid(), OFS_QNODE, OFS_INODE_BYTES, 1);
+	ofs_quota_names(strlen(newfile->name) + 1);
+
+	return 0;
+}
+
+void ofs_newtypedir(const char *path) {
+	ONODE *node;
+
+	if(ofs_makedir(path, 0755) == 0 && (node = ofs_findnode(root, path)) != NULL)
+		node->of_stat->of_rdev = OFS_TYPEDIR_RDEV;		// 같은 이름의 사용자 디렉토리와 구별
+}
+
+void ofs_addtypelink(const char *path) {
+	ONODE *onode, *typedir;
+	char *typedir_name, *file_name;
+	char *typedir_path, *parent_path, *link_path;
+	char *old_path;
+	uint64_t begin = ofs_stats_begin();
+
+	ofs_qtypelink++;
+	typedir_name = ofs_typedirname(path);
+	onode = ofs_findnode(root, path);
+
+	// 부모 디렉토리와 타입 디렉토리의 경로를 얻는다.
+	parent_path = ofs_parsingparent(path);
+	typedir_path = (char *)malloc(sizeof(char)*(strlen(parent_path)+strlen(typedir_name)+1));
+	strcpy(typedir_path, parent_path);
+	strcat(typedir_path, typedir_name);
+
+	// 타입 디렉토리가 없으면 새로 만든다.
+	if((typedir = ofs_findnode(root, typedir_path)) == NULL) {
+		ofs_newtypedir(typedir_path);
+		typedir = ofs_findnode(root, typedir_path);
+	}
+
+	// 타입 디렉토리 내에 심볼릭 링크를 만든다.
+	file_name = ofs_parsingname(path);
+	old_path = (char *)malloc(sizeof(char)*(3+strlen(file_name)+1));
+	strcpy(old_path, "../");
+	strcat(old_path, file_name);
+	link_path = (char *)malloc(sizeof(char)*(strlen(typedir_path)+1+strlen(file_name)+1));
+	strcpy(link_path, typedir_path);
+	strcat(link_path, "/");
+	strcat(link_path, file_name);
+	if(typedir != NULL && ofs_istypedir(typedir))			// 이름이 같은 사용자 디렉토리에는 넣지 않는다
+		ofs_symlink(old_path, link_path);
+	OFS_TRACE(OT_DEBUG, OP_TYPELINK, link_path, onode->of_stat->of_id, begin, 0);
+
+	free(typedir_name);
+	free(typedir_path);
+	free(parent_path);
+	free(link_path);
+	free(old_path);
+	ofs_qtypelink--;
+	ofs_stats_end(OP_TYPELINK, begin, 0);
+}
+
+// 일반 파일 노드를 만든다.
+static int ofs_mknod(const char *path, mode_t mode, dev_t dev) 
+{
+	int ret;
+	char *node_name;
+	ONODE *parent;
+
+	/* 에러 체크 */
+	if (ofs_check_path_len(path) != 0)
+		return -ENAMETOOLONG;
+	if((parent = ofs_findparent(root, path)) == NULL)			//삽입할 노드의 상위 정보 구하기
+		return -ENOENT;
+	if(ofs_istypedir(parent))		// 타입 디렉토리에서는 생성 불가
+		return -EACCES;
+	node_name = ofs_parsingname(path);
+	if(*node_name == '_')
+		return -EINVAL;				// 파일 이름은 _로 시작할 수 없다.
+
+	// 파일 노드를 만든다.
+	ret = ofs_makenod(path, mode, dev);
+
+	if(ret == 0) {
+		// 이 파일 노드에 대한 새로운 타입 링크를 추가한다.
+		if(ofs_extension(node_name) != NULL) {	
+			ofs_addtypelink(path);
+		}
+	}
+
+	return ret;
+}
+
+static int ofs_link(const char *oldname, const char *newname) 
+{
+	ONODE *dstnode, *srcnode;
+	int ret;
+	
+	/* 에러 체크 */
+	if (ofs_check_path_len(oldname) != 0)
+		return -ENAMETOOLONG;
+	if((srcnode = ofs_findnode(root, oldname)) == NULL)
+		return -ENOENT;
+	if(S_ISDIR(srcnode->of_stat->of_mode) && ofs_context_uid() != 0)	//Hard Link생성 권한 확인
+		return -EPERM;
+	
+	/* Hard Link 파일 생성 - 에러 발생시 에러 반환 */
+	if((ret = ofs_makenod(newname, srcnode->of_stat->of_mode, srcnode->of_stat->of_rdev)) != 0) 
+		return ret;
+	
+	/* 파일 연결 */
+	srcnode -> of_stat -> of_nlink++;					//nlink 증가 시킴
+	ofs_changed(srcnode -> of_stat);
+	dstnode = ofs_findnode(root, newname);
+	if(srcnode -> of_data == NULL)						//이후의 쓰기도 공유되도록 데이터를 미리 만든다
+		srcnode -> of_data = ofs_data_new();
+	/* 새 파일로 센 사용량을 원본 소유자의 디렉토리 항목 하나로 바꾼다 */
+	ofs_quota_charge(dstnode -> of_stat -> of_uid, dstnode -> of_stat -> of_gid, OQ_NODE, -(int64_t)OFS_INODE_BYTES, -1);
+	ofs_quota_charge(srcnode -> of_stat -> of_uid, srcnode -> of_stat -> of_gid, OQ_NODE, sizeof(ONODE), 0);
+	ofs_index_del(dstnode);
+	free(dstnode -> of_stat);							//원본의 정보를 공유하므로 새로 만든 정보는 버린다
+	dstnode -> of_data = srcnode -> of_data;				//data정보 연결
+	dstnode -> of_stat = srcnode -> of_stat;				//node정보 연결
+	ofs_index_add(dstnode);
+	ofs_xattr_link(dstnode);
+
+	return 0;
+}
+
+static int ofs_symlink(const char *oldname, const char *newname) 
+{
+	ONODE *dstnode;
+	int ret, len;
+	
+	/* 에러 체크 */
+	if (ofs_check_path_len(oldname) != 0)
+		return -ENAMETOOLONG;
+		
+	/* Symbolic Link 파일 생성 */
+	if((ret = ofs_makenod(newname, S_IFLNK | 0777, 0)) != 0) 
+		return ret;
+	
+	/* Symoblic Link 데이터 저장 */
+	len = strlen(oldname)+1;
+	dstnode = ofs_findnode(root, newname);
+	ret = ofs_setdata(dstnode, oldname, len, 0);				//파일의 데이터 영역에 이름을 저장
+	ofs_qdata(dstnode, 0);
+	return ret;
+}
+
+static int ofs_readlink(const char* path, char *buffer, size_t size) 
+{
+	ONODE *node = NULL;
+	size_t len;
+	int ret;
+	
+	/* 에러 체크 */
+	if (ofs_check_path_len(path) != 0) 
+		return -ENAMETOOLONG;
+	if ((node = ofs_findnode(root, path)) == NULL) 
+		return -ENOENT;
+	if ((ofs_check_access(node -> of_stat -> of_mode, node -> of_stat -> of_uid, node -> of_stat -> of_gid, R_OK)) != 0) 
+		return -EACCES;
+	if (!S_ISLNK(node-> of_stat ->of_mode)) 				//심볼릭 링크 파일인지 확인
+		return -EINVAL;
+	
+	/* 심볼링 링크 저장 */
+	if(size == 0)
+		return 0;
+	len = (node->of_stat->of_size < (off_t)size)? node->of_stat->of_size : size;
+	if(node->of_data == NULL)
+		len = 0;
+	else if((ret = ofs_data_read(node->of_data, buffer, len, 0)) != 0)
+		return ret;
+	buffer[(len < size)? len : size - 1] = '\0';
+	ofs_accessed(node -> of_stat);
+	
+	return 0;
+}
+
+static int ofs_getattr(const char *path, struct stat *stbuf)
+{
+	ONODE *node = NULL;
+	
+	/* 에러 체크 */
+	if (ofs_check_path_len(path) != 0)
+		return -ENAMETOOLONG;
+	
+	/* node attribute 반환 */
+	memset(stbuf, 0, sizeof(struct stat));					//stat 구조체 초기화
+	if ((node = ofs_findnode(root, path)) != NULL) {
+		stbuf -> st_ino = node -> of_stat -> of_id;
+		stbuf -> st_mode = node -> of_stat -> of_mode;
+		stbuf -> st_nlink = node -> of_stat -> of_nlink;
+		stbuf -> st_uid = node -> of_stat -> of_uid;
+		stbuf -> st_gid = node -> of_stat -> of_gid;
+		stbuf -> st_size = node -> of_stat -> of_size;
+		stbuf -> st_blocks = (ofs_qused(node) + 511) / 512;		//구멍은 차지하지 않는다
+		stbuf -> st_atim = node -> of_stat -> of_atime;
+		stbuf -> st_mtim = node -> of_stat -> of_mtime;
+		stbuf -> st_ctim = node -> of_stat -> of_ctime;
+		return 0;
+	} else {
+		return -ENOENT;
+	}
+}
+
+static int ofs_readdir(const char *path, void *buf, fuse_fill_dir_t filler, off_t offset, struct fuse_file_info *fi)
+{
+	(void) offset;
+	(void) fi;
+	ONODE *loc, *cur;
+	
+	/* 에러 체크 */
+	if (ofs_check_path_len(path) != 0)
+		return -ENAMETOOLONG;
+	if((loc = ofs_findnode(root, path)) == NULL)
+		return -ENOENT;
+	if(!S_ISDIR(loc-> of_stat -> of_mode)) 
+		return -ENOTDIR;
+	
+	/* 디렉토리 이름 정보 반환 */
+	filler(buf, ".", NULL, 0, 0);
+	filler(buf, "..", NULL, 0, 0);
+	for(cur = loc->subhead;cur != NULL;cur = cur->nextnode) {		//디렉토리의 서브 엔트리 반복
+		filler(buf, cur->name, NULL, 0, 0);						//디렉토리 채우기
+	}
+	ofs_accessed(loc -> of_stat);
+
+	return 0;
+}
+
+static int ofs_access(const char *path, int how) 
+{
+	ONODE *node = NULL;
+	
+	/* 에러 체크 */
+	if (ofs_check_path_len(path) != 0)
+		return -ENAMETOOLONG;
+	if ((node = ofs_findnode(root, path)) == NULL) 
+		return -ENOENT;
+		
+	/* 권한 체크 */	
+	if(how == F_OK)								//파일 존재 여부 확인 
+		return 0;
+	return ofs_check_access(node -> of_stat -> of_mode, node -> of_stat -> of_uid, node -> of_stat -> of_gid, how);
+}
+
+static int ofs_utimens(const char *path, const struct timespec tv[2]) 
+{
+	ONODE *node = NULL;
+	OSTAT *stat = NULL;
+	ONODE *parent;
+	struct timespec now;
+	int owner, i;
+	
+	/* 에러 체크 */
+	if (ofs_check_path_len(path) != 0) 
+		return -ENAMETOOLONG;
+	if ((node = ofs_findnode(root, path)) == NULL) 
+		return -ENOENT;
+	if(tv != NULL && tv[0].tv_nsec == UTIME_OMIT && tv[1].tv_nsec == UTIME_OMIT)
+		return 0;					// 둘 다 그대로 두면 권한 검사도 ctime 변경도 없다
+	stat = node -> of_stat;
+	owner = (stat -> of_uid == ofs_context_uid() || ofs_context_uid() == 0);	//소유자 이거나 Previliged인지 확인
+	for(i = 0; tv != NULL && i < 2; i++) {
+		if(tv[i].tv_nsec != UTIME_NOW && tv[i].tv_nsec != UTIME_OMIT && !owner)
+			return -EPERM;			// 시각을 직접 지정하는 것은 소유자만
+	}
+	if (!owner && (ofs_check_access(stat -> of_mode, stat -> of_uid, stat -> of_gid, W_OK)) != 0) 
+		return -EACCES;				// 현재 시각으로 바꾸는 것은 소유자나 쓰기 권한이 있으면
+	if((parent = ofs_findparent(root, path)) == NULL)			//변경할 노드의 상위 정보 구하기
+		return -ENOENT;
+	if(ofs_istypedir(parent))		// 타입 디렉토리에서 타입 노드 변경 불가
+		return -EACCES;
+	
+	/* 시간 변경 */
+	ofs_now(&now);
+	if(tv == NULL || (tv[0].tv_nsec == UTIME_NOW && tv[1].tv_nsec == UTIME_NOW)) {	//NULL일경우 현재시간 저장
+		node-> of_stat -> of_atime = now;
+		node-> of_stat -> of_mtime = now;		
+	} else {											//전달 받은 시간 저장
+		if(tv[0].tv_nsec != UTIME_OMIT)					//UTIME_OMIT은 그대로 둔다
+			node-> of_stat -> of_atime = (tv[0].tv_nsec == UTIME_NOW)? now : tv[0];		
+		if(tv[1].tv_nsec != UTIME_OMIT)
+			node-> of_stat -> of_mtime = (tv[1].tv_nsec == UTIME_NOW)? now : tv[1];
+	}
+	node -> of_stat -> of_ctime = now;					//변경 시각은 항상 현재 시각
+	ofs_index_update(node -> of_stat);
+	return 0;
+}
+
+/* 이름 공간별 확장 속성 권한, HOW는 R_OK(읽기) 또는 W_OK(쓰기) */
+static int ofs_xattr_access(ONODE *node, const char *name, int how)
+{
+	OSTAT *st = node -> of_stat;
+
+	if(strncmp(name, "user.", 5) == 0) {
+		if(!S_ISREG(st -> of_mode) && !S_ISDIR(st -> of_mode))	// 링크와 장치 파일에는 붙일 수 없다
+			return (how == W_OK)? -EPERM : -ENODATA;
+		return (ofs_check_access(st -> of_mode, st -> of_uid, st -> of_gid, how) != 0)? -EACCES : 0;
+	}
+	if(strncmp(name, "trusted.", 8) == 0)
+		return (ofs_context_uid() == 0)? 0 : (how == W_OK)? -EPERM : -ENODATA;
+	if(strncmp(name, "security.", 9) == 0) {
+		if(how == W_OK && st -> of_uid != ofs_context_uid() && ofs_context_uid() != 0)
+			return -EPERM;
+		return 0;
+	}
+	return -EOPNOTSUPP;								// system.* (ACL) 등은 지원하지 않는다
+}
+
+static int ofs_setxattr(const char *path, const char *name, const char *value, size_t size, int flags)
+{
+	ONODE *node, *parent;
+	OSTAT *st;
+	size_t before;
+	int64_t growth;
+	int ret, old;
+
+	/* 에러 체크 */
+	if (ofs_check_path_len(path) != 0)
+		return -ENAMETOOLONG;
+	if((node = ofs_findnode(root, path)) == NULL)
+		return -ENOENT;
+	if((ret = ofs_xattr_access(node, name, W_OK)) != 0)
+		return ret;
+	if(node != root && (parent = node -> parentdir) != NULL && ofs_istypedir(parent))	// 타입 디렉토리에서 타입 노드 변경 불가
+		return -EACCES;
+
+	/* 늘어날 크기로 소유자의 한도를 먼저 검사한다 */
+	st = node -> of_stat;
+	before = ofs_xattr_size(st);
+	old = ofs_xattr_get(st, name, NULL, 0);
+	growth = (old >= 0)? (int64_t)size - old : (int64_t)(5 + strlen(name) + size + (before == 0? 4 : 0));
+	if(growth > 0 && (ret = ofs_qcheck(st -> of_uid, st -> of_gid, growth, 0)) != 0)
+		return ret;
+	if((ret = ofs_xattr_set(node, name, value, size, flags)) != 0)
+		return ret;
+	ofs_quota_charge(st -> of_uid, st -> of_gid, OFS_QNODE, (int64_t)ofs_xattr_size(st) - (int64_t)before, 0);
+	ofs_changed(st);
+	return 0;
+}
+
+static int ofs_getxattr(const char *path, const char *name, char *value, size_t size)
+{
+	ONODE *node;
+	int ret;
+
+	if (ofs_check_path_len(path) != 0)
+		return -ENAMETOOLONG;
+	if((node = ofs_findnode(root, path)) == NULL)
+		return -ENOENT;
+	if(node -> of_stat -> of_xattr == NULL)					// 대부분의 파일 (security.capability 조회 등)
+		return -ENODATA;
+	if((ret = ofs_xattr_access(node, name, R_OK)) != 0)
+		return ret;
+	return ofs_xattr_get(node -> of_stat, name, value, size);
+}
+
+static int ofs_listxattr(const char *path, char *list, size_t size)
+{
+	ONODE *node;
+
+	if (ofs_check_path_len(path) != 0)
+		return -ENAMETOOLONG;
+	if((node = ofs_findnode(root, path)) == NULL)
+		return -ENOENT;
+	return ofs_xattr_list(node -> of_stat, list, size);
+}
+
+static int ofs_removexattr(const char *path, const char *name)
+{
+	ONODE *node, *parent;
+	OSTAT *st;
+	size_t before;
+	int ret;
+
+	if (ofs_check_path_len(path) != 0)
+		return -ENAMETOOLONG;
+	if((node = ofs_findnode(root, path)) == NULL)
+		return -ENOENT;
+	if((ret = ofs_xattr_access(node, name, W_OK)) != 0)
+		return ret;
+	if(node != root && (parent = node -> parentdir) != NULL && ofs_istypedir(parent))	// 타입 디렉토리에서 타입 노드 변경 불가
+		return -EACCES;
+
+	st = node -> of_stat;
+	before = ofs_xattr_size(st);
+	if((ret = ofs_xattr_remove(node, name)) != 0)
+		return ret;
+	ofs_quota_charge(st -> of_uid, st -> of_gid, OFS_QNODE, (int64_t)ofs_xattr_size(st) - (int64_t)before, 0);
+	ofs_changed(st);
+	return 0;
+}
+
+int ofs_unlink_node(const char *path) {
+	ONODE *node = NULL, *parent = NULL;
+	OSTAT *stat = NULL;
+	
+	/* 에러 체크 */
+	if (ofs_check_path_len(path) != 0)
+		return -ENAMETOOLONG;
+	if((parent = ofs_findparent(root, path)) == NULL)			//삭제할 노드의 상위 정보 구하기
+		return -ENOENT;
+	stat = parent -> of_stat;
+	if ((ofs_check_access(stat -> of_mode, stat -> of_uid, stat -> of_gid, W_OK | X_OK)) != 0) 
+		return -EACCES;
+	if((node = ofs_findnode(root, path)) == NULL) 
+		return -ENOENT;
+	if(S_ISDIR(node-> of_stat ->of_mode)) 
+		return -EPERM;
+	
+	/* 파일 삭제 */
+	ofs_modified(parent -> of_stat);
+	stat = node -> of_stat;
+	ofs_index_del(node);
+	ofs_quota_names(-(int64_t)(strlen(node -> name) + 1));
+	if(stat -> of_nlink == 1) {				//하드 링크 수가 1일 경우 - 실제 데이터와 노드정보를 삭제
+		ofs_quota_charge(stat -> of_uid, stat -> of_gid, OFS_QDATA, -(int64_t)ofs_qused(node), 0);
+		ofs_quota_charge(stat -> of_uid, stat -> of_gid, OFS_QNODE, -(int64_t)(OFS_INODE_BYTES + ofs_xattr_size(stat)), -1);
+		ofs_xattr_drop(node, 1);
+		if(node -> of_data != NULL) ofs_data_free(node -> of_data);	
+		free(stat);
+	} else {								//하드 링크수가 1이상일 경우 하드 링크수를 1 감소
+		ofs_quota_charge(stat -> of_uid, stat -> of_gid, OFS_QNODE, -(int64_t)sizeof(ONODE), 0);
+		ofs_xattr_drop(node, 0);
+		stat -> of_nlink -= 1;		
+		ofs_changed(stat);
+	}
+	free(ofs_deletenode(node));				//노드 제거
+	return 0;
+}
+
+static int ofs_unlink(const char *path) {
+	ONODE *parent = NULL, *typedir = NULL;
+	char *file_name, *typedir_name;
+	char *parent_path, *typedir_path, *link_path;
+	char *extension;
+	int ret;
+	uint64_t begin;
+
+	/* 에러 체크 */
+	if (ofs_check_path_len(path) != 0)
+		return -ENAMETOOLONG;
+	if((parent = ofs_findparent(root, path)) == NULL)			//삭제할 노드의 상위 정보 구하기
+		return -ENOENT;
+	if(ofs_istypedir(parent))		// 타입 디렉토리에서 타입 노드 삭제 불가
+		return -EACCES;
+	if(ofs_findnode(root, path) == NULL) 
+		return -ENOENT;
+
+	file_name = ofs_parsingname(path);
+	extension = ofs_extension(file_name);
+	if(extension != NULL) {
+		// 확장자가 있는 경우, 타입 노드를 삭제한다.
+		begin = ofs_stats_begin();
+		ofs_qtypelink++;
+		parent_path = ofs_parsingparent(path);
+		typedir_name = ofs_typedirname(file_name);
+		typedir_path = (char *)malloc(sizeof(char)*(strlen(parent_path)+strlen(typedir_name)+1));
+		strcpy(typedir_path, parent_path);
+		strcat(typedir_path, typedir_name);
+		link_path = (char *)malloc(sizeof(char)*(strlen(typedir_path)+1+strlen(file_name)+1));
+		strcpy(link_path, typedir_path);
+		strcat(link_path, "/");
+		strcat(link_path, file_name);
+
+		// 이름이 같은 사용자 디렉토리의 파일은 지우지 않는다.
+		typedir = ofs_findnode(root, typedir_path);
+		if(typedir != NULL && ofs_istypedir(typedir)) {
+			ofs_unlink_node(link_path);
+
+			// 타입 디렉토리가 비어버린 경우, 타입 디렉토리도 삭제한다.
+			if(typedir->subhead == NULL)
+				ofs_removedir(typedir_path);
+		}
+		
+		free(parent_path);
+		free(typedir_name);
+		free(typedir_path);
+		OFS_TRACE(OT_DEBUG, OP_TYPELINK, link_path, 0, begin, 0);
+		free(link_path);
+		ofs_qtypelink--;
+		ofs_stats_end(OP_TYPELINK, begin, 0);
+	}
+
+	ret = ofs_unlink_node(path);
+	return ret;
+}
+
+int ofs_removedir(const char *path) {
+	ONODE *node = NULL, *parent = NULL;
+	OSTAT *stat = NULL;
+	
+	/* 에러 체크 */
+	if(strcmp(path, "/") == 0)					//루트(마운트 포인트) 삭제 불가 
+		return -EBUSY;
+	if (ofs_check_path_len(path) != 0) 
+		return -ENAMETOOLONG;
+	if((parent = ofs_findparent(root, path)) == NULL)
+		return -ENOENT;
+	stat = parent -> of_stat;
+	if ((ofs_check_access(stat -> of_mode, stat -> of_uid, stat -> of_gid, W_OK | X_OK)) != 0) 
+		return -EACCES;
+	if((node = ofs_findnode(root, path)) == NULL) 
+		return -ENOENT;
+	if(node-> subhead != NULL) 			//부모 디렉토리가 비어있지 않은 경우
+		return -ENOTEMPTY;
+	if(!S_ISDIR(node-> of_stat ->of_mode)) 	//디렉토리가 아닌 경우
+		return -EPERM;
+	
+	/* 디렉토리 삭제 */
+	ofs_quota_charge(node -> of_stat -> of_uid, node -> of_stat -> of_gid, OFS_QNODE,
+		-(int64_t)(OFS_INODE_BYTES + ofs_xattr_size(node -> of_stat)), -1);
+	ofs_quota_names(-(int64_t)(strlen(node -> name) + 1));
+	ofs_xattr_drop(node, 1);
+	if(node -> of_stat != NULL) 
+		free(node -> of_stat);				//디렉토리 노드 정보 삭제
+	parent -> of_stat -> of_nlink -= 1;		//부모 디렉토리의 링크 수 감소
+	ofs_modified(parent -> of_stat);
+	free(ofs_deletenode(node));			//노드 제거	
+
+	return 0;
+}
+
+static int ofs_rmdir(const char *path) {
+	int ret;
+	char *dir_name;
+	ONODE *node;
+
+	dir_name = ofs_parsingname(path);
+	if(*dir_name == '_' || ((node = ofs_findnode(root, path)) != NULL && ofs_istypedir(node)))
+		return -EACCES;					// 타입 디렉토리는 삭제할 수 없다
+
+	ret = ofs_removedir(path);
+	return ret;
+}
+
+// 디렉토리를 만든다.
+int ofs_makedir(const char *path, mode_t mode) {
+	ONODE *newdir = NULL, *target = NULL;
+	OSTAT *stat = NULL;
+	int ret;
+	
+	/* 에러 체크 */
+	if (ofs_check_path_len(path) != 0) 
+		return -ENAMETOOLONG;
+	if (ofs_findnode(root, path) != NULL) 			//이미 존재하는 이름일 경우
+		return -EEXIST;
+	if((target = ofs_findparent(root, path)) == NULL) 
+		return -ENOENT;	
+	stat = target -> of_stat;
+	if ((ofs_check_access(stat -> of_mode, stat -> of_uid, stat -> of_gid, W_OK | X_OK)) != 0) 
+		return -EACCES;
+	if(!S_ISDIR(target-> of_stat ->of_mode)) 			//Path 의 적합성 판단
+		return -ENOTDIR;
+	if ((ret = ofs_qcheck(ofs_context_uid(), ofs_context_gid(), OFS_INODE_BYTES, 1)) != 0)
+		return ret;									//노드 수, 사용량 한도 확인
+	
+	/* 디렉토리 생성 */
+	target -> of_stat -> of_nlink++;					//부모 디렉토리의 링크 수 증가
+	newdir = ofs_neONODE(ofs_parsingname(path), S_IFDIR | mode , ofs_context_uid(), ofs_context_gid());
+	ofs_insertnode(target, newdir);
+	ofs_modified(target -> of_stat);
+	ofs_quota_charge(ofs_context_uid(), ofs_context_gid(), OFS_QNODE, OFS_INODE_BYTES, 1);
+	ofs_quota_names(strlen(newdir -> name) + 1);
+	
+	return 0;
+}
+
+// 일반 디렉토리를 만든다.
+static int ofs_mkdir(const char *path, mode_t mode) {
+	int ret;
+	char *dir_name;
+	ONODE *parent;
+
+	/* 에러 체크 */
+	if (ofs_check_path_len(path) != 0)
+		return -ENAMETOOLONG;
+	if((parent = ofs_findparent(root, path)) == NULL)			//삽입할 노드의 상위 정보 구하기
+		return -ENOENT;
+	if(ofs_istypedir(parent))		// 타입 디렉토리에서는 생성 불가
+		return -EACCES;
+	dir_name = ofs_parsingname(path);
+	if(*dir_name == '_')
+		return -EINVAL;				// 디렉토리 이름은 _로 시작할 수 없다.
+
+	ret = ofs_makedir(path, mode);
+	return ret;
+}
+
+static int ofs_open(const char *path, struct fuse_file_info *fi)
+{
+	int how;
+	ONODE *node = NULL;
+	
+	/* 에러 체크 */
+	if (ofs_check_path_len(path) != 0) 
+		return -ENAMETOOLONG;
+	if ((node = ofs_findnode(root, path)) == NULL) 
+		return -ENOENT;	
+	if(S_ISDIR(node-> of_stat ->of_mode) && (fi-> flags & (O_WRONLY | O_RDWR))) //디렉터리 open시 처리
+		return -EISDIR;	
+	
+	/* OPEN FLAG 정보 파싱 */
+	if((fi -> flags & O_ACCMODE) == O_WRONLY) how = W_OK;
+	else if((fi -> flags & O_ACCMODE) == O_RDONLY) how = R_OK;
+	else how = W_OK | R_OK;
+	
+	/* 파일 권한 확인 */
+	if ((ofs_check_access(node -> of_stat -> of_mode, node -> of_stat -> of_uid, node -> of_stat -> of_gid, how)) != 0) {
+		return -EACCES;
+	}
+	
+	return 0;
+}
+
+static int ofs_read(const char *path, char *buf, size_t size, off_t offset, struct fuse_file_info *fi)
+{
+	(void) fi;	
+	off_t len;
+	ONODE* node;
+	int ret;
+	
+	/* 에러 체크 */
+	if ((node = ofs_findnode(root, path)) == NULL) 
+		return -ENOENT;
+	
+	/* 파일 읽기 */
+	len = node -> of_stat -> of_size;					//데이터 길이 확인
+	if (offset < len) {								//Offset이 데이터 길이를 넘어간 경우 에러
+		if (offset + (off_t)size > len)					//적합한 크기 구하기
+			size = len - offset;
+		if (node -> of_data == NULL)					//데이터 없이 늘어난 파일
+			memset(buf, 0, size);
+		else if ((ret = ofs_data_read(node -> of_data, buf, size, offset)) != 0)	//데이터 읽기 버퍼에 저장
+			return ret;
+	} else {
+		size = 0;
+	}
+	ofs_accessed(node -> of_stat);
+	
+	return size;
+}
+
+
+static int ofs_write(const char *path, const char *buf, size_t size, off_t offset, struct fuse_file_info *fi) 
+{
+	(void)fi;
+	ONODE* node;
+	ONODE *parent;
+	uint64_t before;
+	int ret;
+	
+	if ((node = ofs_findnode(root, path)) == NULL) 
+		return -ENOENT;
+	if((parent = ofs_findparent(root, path)) == NULL)			//변경할 노드의 상위 정보 구하기
+		return -ENOENT;
+	if(ofs_istypedir(parent))		// 타입 디렉토리에서 타입 노드 변경 불가
+		return -EACCES;
+	if(offset < 0 || offset > OFS_FILE_MAX - (off_t)size)	//최대 파일 크기
+		return -EFBIG;
+	if((ret = ofs_qcheck(node->of_stat->of_uid, node->of_stat->of_gid,
+		ofs_data_growth(node->of_data, size, offset), 0)) != 0)	//새로 차지할 만큼 한도 확인
+		return ret;
+			
+	before = ofs_qused(node);
+	ret = ofs_setdata(node, buf, size, offset);
+	ofs_qdata(node, before);
+	if(ret != 0)
+		return ret;
+	ofs_modified(node -> of_stat);						//변경 시각 반영
+	ofs_index_update(node -> of_stat);
+	
+	return size;
+}
+
+int ofs_rename_node(const char *oldname, const char *newname) 
+{
+	int ret;
+	ONODE *oldp, *newp, *old, *new; 
+	OSTAT *olds, *news;
+	
+	/* 에러 체크 */
+	if (ofs_check_path_len(oldname) != 0 || ofs_check_path_len(newname) != 0)
+		return -ENAMETOOLONG;
+	if ((oldp = ofs_findparent(root, oldname)) == NULL 
+		|| (newp = ofs_findparent(root, newname)) == NULL) 			//각각의 부모 디렉토리가 존재하는지 확인
+			return -ENOENT;
+	olds = oldp->of_stat;
+	news = newp->of_stat;
+	if ((ofs_check_access(olds->of_mode, olds->of_uid, olds->of_gid, W_OK | X_OK)) != 0
+		|| (ofs_check_access(news->of_mode, news->of_uid, news->of_gid, W_OK | X_OK)) != 0)
+			return -EACCES;
+	if((old = ofs_findnode(root, oldname)) == NULL) 
+		return -ENOENT;	
+	if ((new = ofs_findnode(root, newname)) != NULL)
+		if((ret = ofs_unlink(newname)) != 0) 
+			return ret;
+	
+	/* 파일 이름 변경 */
+	ofs_quota_names((int64_t)strlen(ofs_parsingname(newname)) - (int64_t)strlen(old->name));
+	strcpy(old->name, ofs_parsingname(newname));
+	if(oldp != newp) {
+		oldp -> of_stat -> of_nlink--;					//oldname의 부모 디렉토리의 링크 수 감소	
+		newp -> of_stat -> of_nlink++;					//newname의 부모 디렉토리의 링크 수 증가
+		ofs_insertnode(newp, ofs_deletenode(old));
+		ofs_modified(newp -> of_stat);
+	}
+	ofs_modified(oldp -> of_stat);
+	ofs_changed(old -> of_stat);
+	return 0;
+}
+
+/* 이름 바꾸기의 한쪽이 타입 디렉토리이거나 그 안인지 (타입 디렉토리와 링크는 원본 파일을 따라서만 옮긴다) */
+static int ofs_rename_typedir(const char *path, const char *parent_path)
+{
+	ONODE *node;
+
+	if((node = ofs_findnode(root, parent_path)) != NULL && ofs_istypedir(node))
+		return 1;
+	return (node = ofs_findnode(root, path)) != NULL && ofs_istypedir(node);
+}
+
+static int ofs_rename(const char *oldname, const char *newname) 
+{
+	char *old_parent_path, *new_parent_path;
+	ONODE *neONODE;
+	int ret;
+
+	// 변경 전후의 디렉토리 이름을 알아낸다.
+	old_parent_path = ofs_parsingparent(oldname);
+	new_parent_path = ofs_parsingparent(newname);
+
+	/* 에러 체크 */
+	// 변경 전후의 디렉토리가 타입 디렉토리일 수 없다.
+	if(ofs_rename_typedir(oldname, old_parent_path) || ofs_rename_typedir(newname, new_parent_path))
+		return -EACCES;
+	if(*(ofs_parsingname(newname)) == '_')
+		return -EACCES;
+
+	// 노드의 이름을 바꾼다.
+	ret = ofs_rename_node(oldname, newname);
+	OFS_TRACE(OT_DEBUG, OP_RENAME, oldname, 0, 0, ret);			// 새 이름은 진입점에서 남긴다
+
+	if(ret == 0) {
+		// 변경된 노드가 디렉토리가 아닌 경우, 타입 링크를 변경해야 한다.
+		neONODE = ofs_findnode(root, newname);
+		if(S_ISDIR(neONODE->of_stat->of_mode) == 0) {
+			char *old_extension, *new_extension;
+			char *old_file_name, *new_file_name;
+			char *old_typedir_path, *new_typedir_path;
+			char *old_typedir_name, *new_typedir_name;
+			char *old_link_path, *new_link_path;
+			char *new_link_target;
+			ONODE *typedir;
+			uint64_t begin = ofs_stats_begin();
+
+			ofs_qtypelink++;
+			// 변경 전후의 확장자명을 알아낸다.
+			old_file_name = ofs_parsingname(oldname);
+			new_file_name = ofs_parsingname(newname);
+			old_extension = ofs_extension(old_file_name);
+			new_extension = ofs_extension(new_file_name);
+
+			// 변경 전후의 타입 링크 주소를 알아낸다.
+			old_typedir_name = ofs_typedirname(old_file_name);
+
+			old_typedir_path = (char *)malloc(sizeof(char)*(strlen(old_parent_path)+strlen(old_typedir_name)+1));
+			strcpy(old_typedir_path, old_parent_path);
+			strcat(old_typedir_path, old_typedir_name);
+			old_link_path = (char *)malloc(sizeof(char)*(strlen(old_typedir_path)+1+strlen(old_file_name)+1));
+			strcpy(old_link_path, old_typedir_path);
+			strcat(old_link_path, "/");
+			strcat(old_link_path, old_file_name);
+			
+			new_typedir_name = ofs_typedirname(new_file_name);
+
+			new_typedir_path = (char *)malloc(sizeof(char)*(strlen(new_parent_path)+strlen(new_typedir_name)+1));
+			strcpy(new_typedir_path, new_parent_path);
+			strcat(new_typedir_path, new_typedir_name);
+			new_link_path = (char *)malloc(sizeof(char)*(strlen(new_typedir_path)+1+strlen(new_file_name)+1));
+			strcpy(new_link_path, new_typedir_path);
+			strcat(new_link_path, "/");
+			strcat(new_link_path, new_file_name);
+
+			if(old_extension != NULL || new_extension != NULL) {
+				// 타입 디렉토리 노드를 알아낸다.
+				typedir = ofs_findnode(root, new_typedir_path);
+
+				// 확장자가 있는 파일로 옮기며 타입 디렉토리가 없는 경우, 새로 만든다.
+				if(new_extension != NULL && typedir == NULL) {
+					ofs_newtypedir(new_typedir_path);
+				}
+
+				// 타입 노드를 옮긴다.
+				new_link_target = (char *)malloc(sizeof(char)*(3+strlen(new_file_name)+1));
+				strcpy(new_link_target, "../");
+				strcat(new_link_target, new_file_name);
+				// 확장자 있는 파일로부터 옮기는 경우 (이름이 같은 사용자 디렉토리는 건드리지 않는다)
+				typedir = (old_extension != NULL)? ofs_findnode(root, old_typedir_path) : NULL;
+				if(typedir != NULL && ofs_istypedir(typedir)) {
+					// 타입 노드를 제거한다.
+					ofs_unlink_node(old_link_path);
+				}
+				// 확장자 있는 파일로 옮기는 경우
+				typedir = (new_extension != NULL)? ofs_findnode(root, new_typedir_path) : NULL;
+				if(typedir != NULL && ofs_istypedir(typedir)) {
+					// 타입 노드를 생성한다.
+					ofs_symlink(new_link_target, new_link_path);
+				}
+
+				// 확장자 있는 파일로부터 옮기는 경우, 타입 디렉토리가 비게 되면 지운다.
+				typedir = (old_extension != NULL)? ofs_findnode(root, old_typedir_path) : NULL;
+				if(typedir != NULL && ofs_istypedir(typedir) && typedir->subhead == NULL) {
+					ofs_removedir(old_typedir_path);
+				}
+			}
+
+			free(old_typedir_path);
+			free(new_typedir_path);
+			free(old_typedir_name);
+			free(new_typedir_name);
+			free(old_link_path);
+			OFS_TRACE(OT_DEBUG, OP_TYPELINK, new_link_path, neONODE->of_stat->of_id, begin, 0);
+			free(new_link_path);
+			ofs_qtypelink--;
+			ofs_stats_end(OP_TYPELINK, begin, 0);
+		}
+	}
+	free(old_parent_path);
+	free(new_parent_path);
+	return ret;
+}
+
+static int ofs_opendir(const char *path, struct fuse_file_info *fi) 
+{
+	int how;
+	ONODE *node = NULL;
+
+	/* 에러 체크 */
+	if (ofs_check_path_len(path) != 0) 
+		return -ENAMETOOLONG;
+	if ((node = ofs_findnode(root, path)) == NULL) 
+		return -ENOENT;
+	
+	/* OPEN FLAG 파싱*/
+	if((fi -> flags & O_ACCMODE) == O_WRONLY) how = W_OK;
+	else if((fi -> flags & O_ACCMODE) == O_RDONLY) how = R_OK;
+	else how = W_OK | R_OK;
+	
+	/* 디렉토리 권한 확인*/
+	if ((ofs_check_access(node -> of_stat -> of_mode, node -> of_stat -> of_uid, node -> of_stat -> of_gid, how)) != 0) {
+		return -EACCES;
+	}
+	
+	return 0;
+}
+
+static int ofs_release(const char *path, struct fuse_file_info *fi)
+{
+	ONODE *node;
+
+	/* 쓰기로 연 파일을 닫을 때 꼬리 청크까지 중복 제거하고 덮어쓴 청크의 체크섬을 채운다 */
+	if((fi -> flags & O_ACCMODE) == O_RDONLY)
+		return 0;
+	if((node = ofs_findnode(root, path)) == NULL || node -> of_data == NULL)
+		return 0;
+	ofs_data_seal(node -> of_data);
+
+	return 0;
+}
+
+/* 같은 마운트 안의 복사 - 청크 경계가 맞는 부분은 데이터를 복사하지 않고 공유한다 */
+/* 복제할 원본과 대상 노드를 찾고 권한을 확인한다 */
+static int ofs_clone_nodes(const char *src, const char *dst, ONODE **snode, ONODE **dnode)
+{
+	ONODE *parent;
+	OSTAT *ss, *ds;
+
+	if (ofs_check_path_len(src) != 0 || ofs_check_path_len(dst) != 0)
+		return -ENAMETOOLONG;
+	if ((*snode = ofs_findnode(root, src)) == NULL || (*dnode = ofs_findnode(root, dst)) == NULL)
+		return -ENOENT;
+	if((parent = ofs_findparent(root, dst)) == NULL)			//변경할 노드의 상위 정보 구하기
+		return -ENOENT;
+	if(ofs_istypedir(parent))		// 타입 디렉토리에서 타입 노드 변경 불가
+		return -EACCES;
+	ss = (*snode) -> of_stat;
+	ds = (*dnode) -> of_stat;
+	if (S_ISDIR(ss->of_mode) || S_ISDIR(ds->of_mode))
+		return -EISDIR;
+	if (!S_ISREG(ss->of_mode) || !S_ISREG(ds->of_mode))		//일반 파일끼리만 복제
+		return -EINVAL;
+	if ((ofs_check_access(ss->of_mode, ss->of_uid, ss->of_gid, R_OK)) != 0
+		|| (ofs_check_access(ds->of_mode, ds->of_uid, ds->of_gid, W_OK)) != 0)
+			return -EACCES;
+	return 0;
+}
+
+static ssize_t ofs_clone(const char *src, off_t src_off, const char *dst, off_t dst_off, size_t size)
+{
+	ONODE *snode, *dnode;
+	OSTAT *ss, *ds;
+	off_t end;
+	uint64_t before;
+	int ret;
+
+	/* 에러 체크 */
+	if ((ret = ofs_clone_nodes(src, dst, &snode, &dnode)) != 0)
+		return ret;
+	ss = snode -> of_stat;
+	ds = dnode -> of_stat;
+	if (src_off < 0 || dst_off < 0)
+		return -EINVAL;
+
+	/* 복제할 범위 구하기 */
+	if (src_off >= ss->of_size)						//원본 끝 이후는 복사할 것이 없다
+		return 0;
+	if ((off_t)size > ss->of_size - src_off)
+		size = ss->of_size - src_off;
+	if (dst_off > OFS_FILE_MAX - (off_t)size)					//최대 파일 크기
+		return -EFBIG;
+	end = dst_off + size;
+	if (ss == ds && src_off < end && dst_off < src_off + (off_t)size)	//같은 파일의 겹치는 범위
+		return -EINVAL;
+
+	/* 공유한 청크도 대상 파일의 사용량으로 센다 (덮어쓸 때와 같은 양) */
+	if ((ret = ofs_qcheck(ds->of_uid, ds->of_gid, ofs_data_growth(dnode -> of_data, size, dst_off), 0)) != 0)
+		return ret;
+
+	/* 데이터 복제 */
+	if (snode -> of_data == NULL)						//데이터 없이 늘어난 파일
+		snode -> of_data = ofs_data_new();
+	if (dnode -> of_data == NULL)
+		dnode -> of_data = ofs_data_new();
+	before = ofs_qused(dnode);
+	ret = ofs_data_clone(dnode -> of_data, dst_off, snode -> of_data, src_off, size,
+		src_off + (off_t)size == ss->of_size && end >= ds->of_size);
+	ofs_qdata(dnode, before);
+	if (ret != 0)
+		return ret;
+	if (end > ds->of_size)							//파일 사이즈 반영
+		ds->of_size = end;
+	ofs_modified(ds);
+	ofs_index_update(ds);
+
+	return size;
+}
+
+/* 대상 파일의 내용을 원본 파일 전체로 바꾼다 (FICLONE)
+   실패하면 대상이 그대로 남도록 자르기 전에 모든 검사를 마친다 */
+static int ofs_clonefile(const char *src, const char *dst)
+{
+	ONODE *snode, *dnode;
+	OSTAT *ds;
+	uint64_t growth, used;
+	ssize_t ret;
+
+	if ((ret = ofs_clone_nodes(src, dst, &snode, &dnode)) != 0)
+		return ret;
+	if (snode -> of_stat == dnode -> of_stat)			//자기 자신(또는 하드 링크)은 그대로 둔다
+		return 0;
+	ds = dnode -> of_stat;
+	growth = ofs_data_growth(NULL, snode -> of_stat -> of_size, 0);	//자른 뒤 원본 전체를 차지한다
+	used = ofs_qused(dnode);
+	if (growth > used && (ret = ofs_qcheck(ds->of_uid, ds->of_gid, growth - used, 0)) != 0)
+		return ret;
+	if ((ret = ofs_truncate(dst, 0, 0)) != 0)
+		return ret;
+	if ((ret = ofs_clone(src, 0, dst, 0, snode -> of_stat -> of_size)) < 0)
+		return ret;
+	return 0;
+}
+
+/*
+ * 가상 파일
+ * /.ofs 아래의 파일은 트리에 없고 열 때마다 내용을 새로 만든다.
+ * 마운트한 사용자는 파일에 쓰거나 0으로 잘라서 내용을 초기화할 수 있다.
+ */
+#define OFS_VDIR		"/.ofs"
+
+/* 열 때 내용을 만들지 않고 핸들마다 커서를 두고 이어서 읽는 가상 파일 */
+typedef struct _OVSTREAM {
+	size_t 	(*read)(uint64_t*, char*, size_t);		// 커서 이후를 읽고 커서를 옮긴다
+	int 		(*ready)(uint64_t);					// 커서 이후에 읽을 것이 있는지 (poll)
+	uint64_t	(*last)(void);						// 지금의 끝, "now"를 쓰면 커서를 여기로 옮긴다
+} OVSTREAM;
+
+typedef struct _OVFILE {
+	const char	*name;							// /.ofs 아래의 이름
+	char*		(*show)(size_t*);					// 열 때 내용을 만든다
+	void 		(*reset)(void);					// 쓰거나 자를 때 호출
+	int 		(*store)(const char*, size_t);		// 있으면 쓸 때 reset 대신 내용을 넘긴다
+	const OVSTREAM	*stream;					// 있으면 show 대신 쓰고, 핸들에 쓰면 커서를 옮긴다
+} OVFILE;
+
+/* 연 가상 파일의 내용 (fi->fh) */
+typedef struct _OVSNAP {
+	char		*buf;
+	size_t	len;
+	const OVFILE	*vf;
+	uint64_t	cursor;							// 스트림에서 읽은 마지막 번호
+} OVSNAP;
+
+static int ofs_export_store(const char *, size_t);
+static void ofs_checksum_report(FILE *);
+
+/* 연산 통계 뒤에 체크섬 불일치를 붙인다 (통계를 켜기 전의 불일치도 따로 센다) */
+static char* ofs_stats_vshow(size_t *len)
+{
+	char *buf = ofs_stats_show(len), *out = NULL;
+	FILE *fp;
+
+	if(buf == NULL || !conf.checksum || (fp = open_memstream(&out, len)) == NULL)
+		return buf;
+	fprintf(fp, "%s# ", buf);
+	ofs_checksum_report(fp);
+	fclose(fp);
+	free(buf);
+	return out;
+}
+
+/*
+ * 변경 기록 (-o changelog=RECORDS)
+ * 성공한 변경 연산을 일련 번호와 함께 한 줄씩 읽는다 (changelog.c). 핸들에 번호를 쓰면
+ * 그 이후부터, "now"를 쓰면 지금 이후부터 읽고, 읽을 것이 없으면 0을 돌려주며 poll로
+ * 새 기록을 기다릴 수 있다. 커서 이후의 기록이 버려졌으면 lost 줄이 먼저 나오므로
+ * 그때는 트리를 다시 훑어야 한다.
+ */
+static const OVSTREAM ofs_changelog_stream = { ofs_changelog_read, ofs_changelog_ready, ofs_changelog_last };
+
+static const OVFILE ofs_vfiles[] = {
+	{ "stats", ofs_stats_vshow, ofs_stats_reset, NULL, NULL },
+	{ "trace", ofs_trace_show, ofs_trace_reset, ofs_trace_store, NULL },
+	{ "quota", ofs_quota_show, ofs_quota_reset, ofs_quota_store, NULL },
+	{ "export", ofs_export_show, ofs_export_reset, ofs_export_store, NULL },
+	{ "changelog", NULL, ofs_changelog_reset, NULL, &ofs_changelog_stream },
+};
+
+#define OFS_NVFILES		(sizeof(ofs_vfiles) / sizeof(ofs_vfiles[0]))
+#define OFS_VMODE		(S_IFREG | 0644)
+
+enum {
+	OV_NONE = 0,		// 일반 경로
+	OV_DIR,			// /.ofs
+	OV_FILE,			// /.ofs 아래의 가상 파일
+	OV_MISSING,		// /.ofs 아래의 없는 이름 (또는 /_query 아래의 잘못된 질의)
+	OV_QUERY,			// /_query 또는 /_query/<질의> (/_tag, /_tag/<값>)
+	OV_QENT			// /_query/<질의>/<결과> (/_tag/<값>/<결과>)
+};
+
+/*
+ * 질의 디렉토리 (-o index)
+ * /_query/<질의> 디렉토리를 읽으면 크기/수정 시각 색인(index.c)에서 조건에 맞는 파일만
+ * 값 순서로 찾아 "<노드 번호>_<이름>" 심볼릭 링크로 보여준다. 질의는 "size>100M",
+ * "mtime<1h"(1시간 안에 수정됨) 같은 조건을 ','로 이은 것으로, 첫 조건의 색인을 따라가고
+ * 나머지 조건으로 거른다. 읽기 전용이며 색인을 켜면 루트의 "query" 타입 디렉토리를 가린다.
+ */
+#define OFS_QDIR		"/_query"
+#define OFS_QMAX		4
+
+typedef struct _OQUERY {
+	int		n;
+	int		field[OFS_QMAX];
+	int64_t	lo[OFS_QMAX];						// 값의 범위 [lo, hi]
+	int64_t	hi[OFS_QMAX];
+} OQUERY;
+
+/* 조건 하나 : size 또는 mtime, < <= > >= =, 값과 단위(크기 K M G T, 시간 s m h d w) */
+static int ofs_qcond(const char *cond, size_t len, OQUERY *q)
+{
+	char buf[64], *p, *end, op;
+	int field, eq;
+	int64_t v, mul = 1;
+
+	if(len == 0 || len >= sizeof(buf) || q -> n == OFS_QMAX)
+		return -1;
+	memcpy(buf, cond, len);
+	buf[len] = '\0';
+	if(strncmp(buf, "size", 4) == 0) {
+		field = OIX_SIZE;
+		p = buf + 4;
+	} else if(strncmp(buf, "mtime", 5) == 0) {
+		field = OIX_MTIME;
+		p = buf + 5;
+	} else {
+		return -1;
+	}
+	if((op = *p++) != '<' && op != '>' && op != '=')
+		return -1;
+	if((eq = (op == '=')) == 0 && *p == '=') {
+		eq = 1;
+		p++;
+	}
+	if(*p < '0' || *p > '9')
+		return -1;
+	v = strtoll(p, &end, 10);
+	if(*end != '\0') {
+		switch((field == OIX_SIZE)? toupper(*end) : *end) {
+		case 'K':	mul = 1LL << 10; break;
+		case 'M':	mul = (field == OIX_SIZE)? 1LL << 20 : 60; break;
+		case 'G':	mul = 1LL << 30; break;
+		case 'T':	mul = 1LL << 40; break;
+		case 's':	mul = 1; break;
+		case 'm':	mul = 60; break;
+		case 'h':	mul = 3600; break;
+		case 'd':	mul = 86400; break;
+		case 'w':	mul = 604800; break;
+		default:	return -1;
+		}
+		if(end[1] != '\0')
+			return -1;
+	}
+	if(v < 0 || v > INT64_MAX / mul)
+		return -1;
+	v *= mul;
+	if(field == OIX_MTIME) {							// 지난 시간을 시각으로, 비교 방향은 반대
+		v = (int64_t)time(NULL) - v;
+		op = (op == '<')? '>' : (op == '>')? '<' : op;
+	}
+	q -> field[q -> n] = field;
+	q -> lo[q -> n] = (op == '<')? INT64_MIN : (eq)? v : v + 1;
+	q -> hi[q -> n] = (op == '>')? INT64_MAX : (eq)? v : v - 1;
+	q -> n++;
+	return 0;
+}
+
+static int ofs_qparse(const char *expr, size_t len, OQUERY *q)
+{
+	const char *comma;
+	size_t n;
+
+	q -> n = 0;
+	while(len > 0) {
+		comma = memchr(expr, ',', len);
+		n = (comma != NULL)? (size_t)(comma - expr) : len;
+		if(ofs_qcond(expr, n, q) != 0)
+			return -1;
+		expr += n;
+		len -= n;
+		if(comma != NULL) {
+			expr++;
+			len--;
+		}
+	}
+	return (q -> n > 0)? 0 : -1;
+}
+
+/* /_query 아래 경로 판별, 질의가 맞는지만 보고 결과가 있는지는 보지 않는다 */
+static int ofs_qpath(const char *path)
+{
+	const char *expr, *name;
+	OQUERY q;
+
+	if(*path == '\0')
+		return OV_QUERY;
+	if(*path != '/')								// "/_queryx" 등은 일반 경로
+		return OV_NONE;
+	expr = path + 1;
+	if((name = strchr(expr, '/')) == NULL)
+		return (ofs_qparse(expr, strlen(expr), &q) == 0)? OV_QUERY : OV_MISSING;
+	if(ofs_qparse(expr, name - expr, &q) != 0 || name[1] == '\0' || strchr(name + 1, '/') != NULL)
+		return OV_MISSING;
+	return OV_QENT;
+}
+
+/*
+ * 태그 디렉토리 (-o tags)
+ * /_tag에는 색인된 "user.tag.*" 값마다 디렉토리가 있고 /_tag/<값>에는 그 값이 붙은 파일과
+ * 디렉토리가 /_query와 같은 "<노드 번호>_<이름>" 심볼릭 링크로 있다. 태그 색인(xattr.c)에서
+ * 바로 꺼내므로 트리를 돌지 않는다. 질의처럼 아무 값이나 (빈) 디렉토리로 보이며 루트의
+ * "tag" 타입 디렉토리를 가린다.
+ */
+#define OFS_TDIR		"/_tag"
+
+static int ofs_tpath(const char *path)
+{
+	const char *name;
+
+	if(*path == '\0')
+		return OV_QUERY;
+	if(*path != '/')								// "/_tagx" 등은 일반 경로
+		return OV_NONE;
+	if((name = strchr(path + 1, '/')) == NULL)
+		return (path[1] != '\0' && strlen(path + 1) < NAME_MAX)? OV_QUERY : OV_MISSING;
+	if(name == path + 1 || name - path - 1 >= NAME_MAX || name[1] == '\0' || strchr(name + 1, '/') != NULL)
+		return OV_MISSING;
+	return OV_QENT;
+}
+
+/* 가상 경로 판별, 가상 파일이면 vf에 넣는다 */
+static int ofs_vpath(const char *path, const OVFILE **vf)
+{
+	size_t i;
+
+	if(ofs_index_enabled() && strncmp(path, OFS_QDIR, sizeof(OFS_QDIR) - 1) == 0)
+		return ofs_qpath(path + sizeof(OFS_QDIR) - 1);
+	if(ofs_xattr_tags_enabled() && strncmp(path, OFS_TDIR, sizeof(OFS_TDIR) - 1) == 0)
+		return ofs_tpath(path + sizeof(OFS_TDIR) - 1);
+	if(strncmp(path, OFS_VDIR, sizeof(OFS_VDIR) - 1) != 0)
+		return OV_NONE;
+	path += sizeof(OFS_VDIR) - 1;
+	if(*path == '\0')
+		return OV_DIR;
+	if(*path != '/')								// "/.ofsx" 등은 일반 경로
+		return OV_NONE;
+	for(i = 0; i < OFS_NVFILES; i++) {
+		if(strcmp(path + 1, ofs_vfiles[i].name) == 0) {
+			if(vf != NULL) *vf = &ofs_vfiles[i];
+			return OV_FILE;
+		}
+	}
+	return OV_MISSING;
+}
+
+static int ofs_vgetattr(int kind, struct stat *stbuf)
+{
+	memset(stbuf, 0, sizeof(struct stat));
+	if(kind == OV_MISSING)
+		return -ENOENT;
+	stbuf -> st_mode = (kind == OV_DIR || kind == OV_QUERY)? S_IFDIR | 0555 : OFS_VMODE;
+	stbuf -> st_nlink = (kind == OV_DIR || kind == OV_QUERY)? 2 : 1;
+	stbuf -> st_uid = getuid();							// 마운트한 사용자
+	stbuf -> st_gid = getgid();
+	ofs_now(&stbuf -> st_mtim);
+	stbuf -> st_atim = stbuf -> st_ctim = stbuf -> st_mtim;
+	return 0;
+}
+
+static int ofs_vopen(int kind, const OVFILE *vf, struct fuse_file_info *fi)
+{
+	OVSNAP *snap;
+	int how;
+
+	if(kind == OV_MISSING)
+		return -ENOENT;
+	if(kind == OV_DIR || kind == OV_QUERY)
+		return -EISDIR;
+	if(kind == OV_QENT)								// 링크를 따라가지 않고 열 때
+		return -ELOOP;
+	if((fi -> flags & O_ACCMODE) == O_WRONLY) how = W_OK;
+	else if((fi -> flags & O_ACCMODE) == O_RDONLY) how = R_OK;
+	else how = W_OK | R_OK;
+	if(ofs_check_access(OFS_VMODE, getuid(), getgid(), how) != 0)
+		return -EACCES;
+
+	/* 연 순간의 내용을 핸들에 붙여 둔다 (크기를 모르므로 direct_io로 읽게 한다) */
+	fi -> fh = 0;
+	fi -> direct_io = 1;
+	if(vf -> stream != NULL) {						// 스트림은 내용 대신 커서를 붙인다
+		if((snap = (OVSNAP*)calloc(1, sizeof(OVSNAP))) == NULL)
+			return -ENOMEM;
+		snap -> vf = vf;
+		fi -> nonseekable = 1;
+		fi -> fh = (uintptr_t)snap;
+	} else if(how & R_OK) {
+		if((snap = (OVSNAP*)calloc(1, sizeof(OVSNAP))) == NULL)
+			return -ENOMEM;
+		snap -> vf = vf;
+		if((snap -> buf = vf -> show(&snap -> len)) == NULL) {
+			free(snap);
+			return -ENOMEM;
+		}
+		fi -> fh = (uintptr_t)snap;
+	}
+	return 0;
+}
+
+static int ofs_vread(struct fuse_file_info *fi, char *buf, size_t size, off_t offset)
+{
+	OVSNAP *snap = (OVSNAP*)(uintptr_t)fi -> fh;
+
+	if(snap != NULL && snap -> vf -> stream != NULL)		// 스트림은 위치와 상관없이 커서부터
+		return snap -> vf -> stream -> read(&snap -> cursor, buf, size);
+	if(snap == NULL || offset >= (off_t)snap -> len)
+		return 0;
+	if(offset + (off_t)size > (off_t)snap -> len)
+		size = snap -> len - offset;
+	memcpy(buf, snap -> buf + offset, size);
+	return size;
+}
+
+/* 자르면(buf == NULL) 초기화, 쓰면 store가 있는 파일은 내용을 넘긴다 */
+static int ofs_vreset(int kind, const OVFILE *vf, const char *buf, size_t size)
+{
+	if(kind != OV_FILE)
+		return (kind == OV_DIR || kind == OV_QUERY)? -EISDIR : (kind == OV_QENT)? -EPERM : -ENOENT;
+	if(ofs_check_access(OFS_VMODE, getuid(), getgid(), W_OK) != 0)
+		return -EACCES;
+	if(buf != NULL && vf -> store != NULL)
+		return (vf -> store(buf, size) == 0)? 0 : -EINVAL;
+	vf -> reset();
+	return 0;
+}
+
+/* 스트림 핸들에 쓴 번호나 "now"로 커서를 옮긴다 */
+static int ofs_vseek(struct fuse_file_info *fi, const char *buf, size_t size)
+{
+	OVSNAP *snap = (OVSNAP*)(uintptr_t)fi -> fh;
+	char num[32], *end;
+	uint64_t cursor;
+	size_t n;
+
+	for(n = 0; n < size && n < sizeof(num) - 1 && buf[n] != '\n'; n++)
+		num[n] = buf[n];
+	num[n] = '\0';
+	if(strcmp(num, "now") == 0) {
+		snap -> cursor = snap -> vf -> stream -> last();
+		return 0;
+	}
+	cursor = strtoull(num, &end, 10);
+	if(n == 0 || *end != '\0')
+		return -EINVAL;
+	snap -> cursor = cursor;
+	return 0;
+}
+
+/*
+ * poll
+ * 스트림에 읽을 것이 없으면 핸들을 모아 두었다가 새 기록이 생기면 한번에 깨운다.
+ * 깨운 핸들은 버리므로 읽는 쪽은 다시 poll을 부른다.
+ */
+static struct fuse_pollhandle **ofs_pollers;
+static size_t ofs_npollers;
+static pthread_mutex_t ofs_poll_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int ofs_vpoll(struct fuse_file_info *fi, struct fuse_pollhandle *ph, unsigned *reventsp)
+{
+	OVSNAP *snap = (OVSNAP*)(uintptr_t)fi -> fh;
+
+	if(snap == NULL || snap -> vf -> stream == NULL) {		// 내용이 정해진 파일은 항상 준비되어 있다
+		if(ph != NULL)
+			fuse_pollhandle_destroy(ph);
+		*reventsp = POLLIN | POLLOUT;
+		return 0;
+	}
+	if(ph != NULL) {								// 확인하기 전에 넣어야 그 사이의 기록을 놓치지 않는다
+		pthread_mutex_lock(&ofs_poll_lock);
+		ofs_pollers = (struct fuse_pollhandle**)realloc(ofs_pollers, sizeof(*ofs_pollers) * (ofs_npollers + 1));
+		ofs_pollers[ofs_npollers] = ph;
+		__atomic_store_n(&ofs_npollers, ofs_npollers + 1, __ATOMIC_RELEASE);
+		pthread_mutex_unlock(&ofs_poll_lock);
+	}
+	*reventsp = POLLOUT;
+	if(snap -> vf -> stream -> ready(snap -> cursor))
+		*reventsp |= POLLIN;
+	return 0;
+}
+
+static void ofs_vwake(void)
+{
+	size_t i;
+
+	if(__atomic_load_n(&ofs_npollers, __ATOMIC_ACQUIRE) == 0)
+		return;
+	pthread_mutex_lock(&ofs_poll_lock);
+	for(i = 0; i < ofs_npollers; i++) {
+		fuse_notify_poll(ofs_pollers[i]);
+		fuse_pollhandle_destroy(ofs_pollers[i]);
+	}
+	__atomic_store_n(&ofs_npollers, 0, __ATOMIC_RELEASE);
+	pthread_mutex_unlock(&ofs_poll_lock);
+}
+
+static void ofs_vrelease(struct fuse_file_info *fi)
+{
+	OVSNAP *snap = (OVSNAP*)(uintptr_t)fi -> fh;
+
+	if(snap != NULL) {
+		free(snap -> buf);
+		free(snap);
+		fi -> fh = 0;
+	}
+}
+
+/* 첫 조건 밖의 나머지 조건도 맞는지 */
+static int ofs_qmatch(const OQUERY *q, OSTAT *st)
+{
+	int64_t v;
+	int i;
+
+	for(i = 0; i < q -> n; i++) {
+		v = ofs_index_value(st, q -> field[i]);
+		if(v < q -> lo[i] || v > q -> hi[i])
+			return 0;
+	}
+	return 1;
+}
+
+/* 지운 서브트리에서 아직 해제되지 않은 노드는 루트에 닿지 않는다 (하드 링크는 살아 있는 쪽으로 보여 준다) */
+static int ofs_qlive(ONODE *node)
+{
+	while(node -> parentdir != NULL)
+		node = node -> parentdir;
+	return node == root;
+}
+
+/* 결과 항목 이름, 이름이 같은 다른 디렉토리의 파일과 겹치지 않도록 노드 번호를 붙인다 (NAME_MAX를 넘으면 -1) */
+static int ofs_qname(ONODE *node, char *name, size_t size)
+{
+	int n = snprintf(name, size, "%llu_%s", (unsigned long long)node -> of_stat -> of_id, node -> name);
+
+	return (n < 0 || (size_t)n >= size)? -1 : 0;
+}
+
+/* 결과 링크가 가리킬 곳, /_query/<질의>/에서 본 상대 경로 */
+static int ofs_qtarget(ONODE *node, char *buf, size_t size)
+{
+	char path[PATH_MAX];
+	size_t pos = sizeof(path) - 1, len;
+	ONODE *cur;
+
+	path[pos] = '\0';
+	for(cur = node; cur -> parentdir != NULL; cur = cur -> parentdir) {
+		len = strlen(cur -> name);
+		if(pos < len + 1)
+			return -ENAMETOOLONG;
+		pos -= len;
+		memcpy(path + pos, cur -> name, len);
+		path[--pos] = '/';
+	}
+	return snprintf(buf, size, "../..%s", path + pos);
+}
+
+/* 태그가 붙은 파일의 링크 중 지금 트리에 있는 첫 링크 (readdir과 조회가 같은 이름을 쓴다) */
+static ONODE* ofs_tlink(ONODE **link, uint32_t n)
+{
+	uint32_t i;
+
+	for(i = 0; i < n; i++)
+		if(ofs_qlive(link[i])) return link[i];
+	return NULL;
+}
+
+/* "/_tag/<값>/<결과>"의 노드 (트리 읽기 잠금 안에서 호출) */
+static ONODE* ofs_tnode(const char *path)
+{
+	const char *value = path + sizeof(OFS_TDIR), *name = strrchr(path, '/') + 1;
+	char key[NAME_MAX], expect[NAME_MAX + 1], *end;
+	unsigned long long id;
+	ONODE **link, *node;
+	uint32_t n;
+
+	memcpy(key, value, name - 1 - value);
+	key[name - 1 - value] = '\0';
+	id = strtoull(name, &end, 10);
+	if(end == name || *end != '_' || (link = ofs_xattr_tagfind(key, (ino_t)id, &n)) == NULL
+		|| (node = ofs_tlink(link, n)) == NULL)
+		return NULL;
+	if(ofs_qname(node, expect, sizeof(expect)) != 0)
+		return NULL;
+	return (strcmp(expect, name) == 0)? node : NULL;
+}
+
+/* "/_query/<질의>/<결과>"의 파일 노드, 지금도 질의에 맞아야 한다 (트리 읽기 잠금 안에서 호출) */
+static ONODE* ofs_qnode(const char *path)
+{
+	const char *expr = path + sizeof(OFS_QDIR), *name = strrchr(path, '/') + 1;
+	char expect[NAME_MAX + 1], *end;
+	unsigned long long id;
+	ONODE *node;
+	OQUERY q;
+
+	if(strncmp(path, OFS_TDIR, sizeof(OFS_TDIR) - 1) == 0)
+		return ofs_tnode(path);
+	if(ofs_qparse(expr, name - 1 - expr, &q) != 0)
+		return NULL;
+	id = strtoull(name, &end, 10);
+	if(end == name || *end != '_' || (node = ofs_index_find((ino_t)id)) == NULL || !ofs_qmatch(&q, node -> of_stat) || (node = ofs_index_pick(node, ofs_qlive)) == NULL)
+		return NULL;
+	if(ofs_qname(node, expect, sizeof(expect)) != 0)
+		return NULL;
+	return (strcmp(expect, name) == 0)? node : NULL;
+}
+
+static int ofs_qgetattr(const char *path, struct stat *stbuf)
+{
+	char target[PATH_MAX];
+	ONODE *node;
+	int len;
+
+	memset(stbuf, 0, sizeof(struct stat));
+	if((node = ofs_qnode(path)) == NULL)
+		return -ENOENT;
+	if((len = ofs_qtarget(node, target, sizeof(target))) < 0)
+		return len;
+	stbuf -> st_mode = S_IFLNK | 0777;
+	stbuf -> st_nlink = 1;
+	stbuf -> st_uid = node -> of_stat -> of_uid;
+	stbuf -> st_gid = node -> of_stat -> of_gid;
+	stbuf -> st_size = len;
+	stbuf -> st_atim = stbuf -> st_mtim = stbuf -> st_ctim = node -> of_stat -> of_mtime;
+	return 0;
+}
+
+static int ofs_qreadlink(const char *path, char *buffer, size_t size)
+{
+	ONODE *node;
+	int len;
+
+	if((node = ofs_qnode(path)) == NULL)
+		return -ENOENT;
+	if(size == 0)
+		return 0;
+	len = ofs_qtarget(node, buffer, size);
+	return (len < 0)? len : 0;
+}
+
+typedef struct _OQSCAN {
+	const OQUERY		*q;
+	void				*buf;
+	fuse_fill_dir_t	filler;
+} OQSCAN;
+
+static int ofs_qfill(ONODE *node, void *arg)
+{
+	OQSCAN *scan = (OQSCAN*)arg;
+	char name[NAME_MAX + 1];
+
+	if(!ofs_qmatch(scan -> q, node -> of_stat) || (node = ofs_index_pick(node, ofs_qlive)) == NULL)
+		return 0;
+	if(ofs_qname(node, name, sizeof(name)) != 0)
+		return 0;									// 이름이 너무 길면 목록에 보일 수 없다
+	return scan -> filler(scan -> buf, name, NULL, 0, 0);
+}
+
+static int ofs_tfill_value(const char *value, void *arg)
+{
+	OQSCAN *scan = (OQSCAN*)arg;
+
+	return scan -> filler(scan -> buf, value, NULL, 0, 0);
+}
+
+static int ofs_tfill(ONODE **link, uint32_t n, void *arg)
+{
+	OQSCAN *scan = (OQSCAN*)arg;
+	char name[NAME_MAX + 1];
+	ONODE *node;
+
+	if((node = ofs_tlink(link, n)) == NULL)
+		return 0;
+	if(ofs_qname(node, name, sizeof(name)) != 0)
+		return 0;									// 이름이 너무 길면 목록에 보일 수 없다
+	return scan -> filler(scan -> buf, name, NULL, 0, 0);
+}
+
+static int ofs_treaddir(const char *path, void *buf, fuse_fill_dir_t filler)
+{
+	const char *value = path + sizeof(OFS_TDIR) - 1;
+	OQSCAN scan;
+
+	filler(buf, ".", NULL, 0, 0);
+	filler(buf, "..", NULL, 0, 0);
+	scan.q = NULL;
+	scan.buf = buf;
+	scan.filler = filler;
+	if(*value == '\0')								// /_tag : 색인된 값
+		ofs_xattr_tags(ofs_tfill_value, &scan);
+	else
+		ofs_xattr_tagged(value + 1, ofs_tfill, &scan);
+	return 0;
+}
+
+static int ofs_qreaddir(const char *path, void *buf, fuse_fill_dir_t filler)
+{
+	const char *expr = path + sizeof(OFS_QDIR) - 1;
+	OQSCAN scan;
+	OQUERY q;
+
+	if(strncmp(path, OFS_TDIR, sizeof(OFS_TDIR) - 1) == 0)
+		return ofs_treaddir(path, buf, filler);
+	filler(buf, ".", NULL, 0, 0);
+	filler(buf, "..", NULL, 0, 0);
+	if(*expr == '\0')								// /_query 자체는 비어 있다
+		return 0;
+	if(ofs_qparse(expr + 1, strlen(expr + 1), &q) != 0)
+		return -ENOENT;
+	scan.q = &q;
+	scan.buf = buf;
+	scan.filler = filler;
+	ofs_index_scan(q.field[0], q.lo[0], q.hi[0], ofs_qfill, &scan);
+	return 0;
+}
+
+/*
+ * FUSE 진입점
+ * 트리 잠금을 잡고 핸들러를 호출한다. 변경 연산이 성공하면 잠금 안에서
+ * 저널에 기록하여 저널 순서와 트리 반영 순서를 일치시키고, 잠금을 푼 뒤에
+ * 그룹 커밋을 기다린다. 핸들러끼리의 내부 호출(타입 링크 등)은 기록하지 않는다.
+ * 연산별 횟수와 지연(저널 커밋 대기 포함)은 stats.c에 모으고, 추적 수준에 따라
+ * 연산마다 trace.c의 링 버퍼에 레코드를 남긴다. 요청 자격 증명은 잠금을 잡기 전에 한번
+ * 읽어 두고 권한 검사와 경로 탐색의 검색 권한 확인에 함께 쓴다(lib.c).
+ */
+static uint64_t ofs_op_lock(int write)
+{
+	uint64_t begin = ofs_stats_begin();
+
+	if(begin == 0 && OFS_TRACING(OT_INFO))				// 통계를 안 모아도 추적에는 시간이 필요하다
+		begin = ofs_trace_now();
+	ofs_trace_node = 0;
+	ofs_cred_begin();								// 요청 자격 증명은 연산마다 한번만 읽는다
+
+	if(write)
+		pthread_rwlock_wrlock(&ofs_tree_lock);
+	else
+		pthread_rwlock_rdlock(&ofs_tree_lock);
+	ofs_stats_end(OP_LOCK_WAIT, begin, 0);
+	return begin;
+}
+
+/* 성공한 변경 연산을 저널에 추가 (트리 쓰기 잠금 안에서 호출) */
+static uint64_t ofs_op_log(int ret, int type, const char *path, const char *path2,
+	uint64_t arg0, uint64_t arg1, uint64_t arg2, const char *data, size_t len)
+{
+	OJREC rec;
+	uint64_t lsn = 0;
+
+	if(ret >= 0 && ofs_changelog_add(type, path, path2, arg0, arg1, arg2, len) != 0)
+		ofs_vwake();								// 변경 기록을 기다리는 poll 깨우기
+	if(ret >= 0 && ofs_journal_enabled()) {
+		memset(&rec, 0, sizeof(rec));
+		rec.type = type;
+		rec.uid = ofs_context_uid();
+		rec.gid = ofs_context_gid();
+		rec.arg[0] = arg0;
+		rec.arg[1] = arg1;
+		rec.arg[2] = arg2;
+		rec.path = path;
+		rec.path2 = path2;
+		rec.data = data;
+		rec.datalen = len;
+		lsn = ofs_journal_append(&rec);
+	}
+	return lsn;
+}
+
+static int ofs_op_end(int ret, int type, const char *path, const char *path2,
+	uint64_t arg0, uint64_t arg1, uint64_t arg2, const char *data, size_t len)
+{
+	uint64_t lsn = ofs_op_log(ret, type, path, path2, arg0, arg1, arg2, data, len);
+	int err;
+
+	pthread_rwlock_unlock(&ofs_tree_lock);
+	if((err = ofs_journal_wait(lsn)) != 0 && ret >= 0)	// 적용은 되었지만 디스크에 남지 않았다
+		ret = err;
+	return ret;
+}
+
+static int ofs_op_done(int op, const char *path, uint64_t begin, int ret)
+{
+	ret = ofs_cred_end(ret);
+	OFS_TRACE((ret < 0 && ret != -ENOENT)? OT_ERR : OT_INFO, op, path, ofs_trace_node, begin, ret);
+	return ofs_stats_end(op, begin, ret);
+}
+
+/*
+ * 쓰기 모음 버퍼 (-o wbuf=KB)
+ * 쓰기로 연 핸들마다 버퍼(fi->fh)를 두고, 이어지는 작은 쓰기를 경로 탐색과 트리 쓰기 잠금
+ * 없이 모았다가 가득 차거나 flush/fsync/release 때 한번의 ofs_write로 반영한다.
+ * 다른 핸들의 겹치는 읽기나 그 파일을 바꾸는 연산 앞에서도 먼저 반영하므로 쓴 내용은
+ * 어느 핸들에서나 보인다. 모으기는 트리 읽기 잠금, 반영은 쓰기 잠금 안에서 하므로 반영하는
+ * 동안에는 버퍼를 건드리는 스레드가 없다. 한 파일에는 한 핸들만 모을 수 있어 쓰기 순서가
+ * 유지된다. 반영이 실패하면(한도 초과 등) 에러를 남겨 두었다가 flush/fsync에서 돌려준다.
+ */
+typedef struct _OWBUF {
+	pthread_mutex_t	lock;				// 같은 핸들로 동시에 들어온 쓰기
+	char			*buf;
+	size_t		cap;
+	size_t		len;					// 모은 바이트, 0보다 크면 목록에 있다
+	off_t			off;					// buf[0]의 파일 위치
+	OSTAT		*stat;				// 모으는 파일
+	int			err;					// 반영하다 생긴 에러
+	uint64_t		lsn;					// 마지막으로 반영한 저널 번호
+	struct timespec	mtime;				// 마지막으로 모은 쓰기의 시각 (반영할 때 수정 시각으로)
+	struct _OWBUF	*prev, *next;
+} OWBUF;
+
+static OWBUF *ofs_wbufs;						// 반영할 데이터가 있는 버퍼
+static int ofs_wb_count;
+static pthread_mutex_t ofs_wb_lock = PTHREAD_MUTEX_INITIALIZER;	// 읽기 잠금 안에서 목록 변경
+
+static OWBUF* ofs_wb_get(struct fuse_file_info *fi)
+{
+	return (fi != NULL)? (OWBUF*)(uintptr_t)fi -> fh : NULL;
+}
+
+static int ofs_wb_pending(void)
+{
+	return __atomic_load_n(&ofs_wb_count, __ATOMIC_ACQUIRE) > 0;
+}
+
+/* 목록에서 파일의 버퍼 찾기 (ofs_wb_lock이나 트리 쓰기 잠금 안에서 호출) */
+static OWBUF* ofs_wb_find(OSTAT *stat)
+{
+	OWBUF *wb;
+
+	for(wb = ofs_wbufs; wb != NULL; wb = wb -> next)
+		if(wb -> stat == stat) break;
+	return wb;
+}
+
+static void ofs_wb_unlist(OWBUF *wb)
+{
+	if(wb -> prev != NULL) wb -> prev -> next = wb -> next; else ofs_wbufs = wb -> next;
+	if(wb -> next != NULL) wb -> next -> prev = wb -> prev;
+	wb -> prev = wb -> next = NULL;
+	wb -> len = 0;
+	__atomic_sub_fetch(&ofs_wb_count, 1, __ATOMIC_RELEASE);
+}
+
+static void ofs_wb_open(struct fuse_file_info *fi)
+{
+	OWBUF *wb;
+
+	fi -> fh = 0;
+	if(conf.wbuf == 0 || (fi -> flags & O_ACCMODE) == O_RDONLY || (fi -> flags & (O_SYNC | O_DSYNC)))
+		return;									// 동기 쓰기는 모으지 않는다
+	if((wb = (OWBUF*)calloc(1, sizeof(OWBUF))) == NULL)
+		return;
+	if((wb -> buf = (char*)malloc(conf.wbuf << 10)) == NULL) {
+		free(wb);
+		return;
+	}
+	pthread_mutex_init(&wb -> lock, NULL);
+	wb -> cap = conf.wbuf << 10;
+	fi -> fh = (uintptr_t)wb;
+}
+
+/* 쓰기를 버퍼에 모은다, 모았으면 1, 먼저 반영하거나 바로 써야 하면 0 (트리 잠금 안에서 호출) */
+static int ofs_wb_add(OWBUF *wb, const char *path, const char *buf, size_t size, off_t offset)
+{
+	ONODE *node;
+	int ret = 0;
+
+	pthread_mutex_lock(&wb -> lock);
+	if(wb -> err != 0 || size > wb -> cap - wb -> len || offset > OFS_FILE_MAX - (off_t)size) {
+		/* 가득 찼거나 반영에 실패한 뒤에는 바로 쓴다 (최대 크기를 넘는 쓰기는 ofs_write가 거절) */
+	} else if(wb -> len > 0) {						// 이어지는 쓰기만 모은다
+		if(offset == wb -> off + (off_t)wb -> len) {
+			memcpy(wb -> buf + wb -> len, buf, size);
+			wb -> len += size;
+			ret = 1;
+		}
+	} else if((node = ofs_findnode(root, path)) != NULL && S_ISREG(node -> of_stat -> of_mode)) {
+		pthread_mutex_lock(&ofs_wb_lock);
+		if(ofs_wb_find(node -> of_stat) == NULL) {		// 다른 핸들이 모으는 중이면 그것부터 반영
+			memcpy(wb -> buf, buf, size);
+			wb -> len = size;
+			wb -> off = offset;
+			wb -> stat = node -> of_stat;
+			wb -> next = ofs_wbufs;
+			if(ofs_wbufs != NULL) ofs_wbufs -> prev = wb;
+			ofs_wbufs = wb;
+			__atomic_add_fetch(&ofs_wb_count, 1, __ATOMIC_RELEASE);
+			ret = 1;
+		}
+		pthread_mutex_unlock(&ofs_wb_lock);
+	}
+	if(ret)
+		ofs_now(&wb -> mtime);
+	pthread_mutex_unlock(&wb -> lock);
+	return ret;
+}
+
+/* 모은 쓰기를 파일에 반영하고 저널에 추가 (트리 쓰기 잠금 안에서 호출) */
+static void ofs_wb_commit(OWBUF *wb, const char *path)
+{
+	uint64_t begin = ofs_stats_begin(), lsn;
+	int ret;
+
+	ret = ofs_write(path, wb -> buf, wb -> len, wb -> off, NULL);
+	if(ret >= 0) {
+		wb -> stat -> of_mtime = wb -> stat -> of_ctime = wb -> mtime;	// 반영한 때가 아니라 쓴 때
+		ofs_index_update(wb -> stat);
+		if((lsn = ofs_op_log(ret, OJ_WRITE, path, NULL, wb -> off, 0, 0, wb -> buf, wb -> len)) != 0)
+			wb -> lsn = lsn;
+	} else if(wb -> err == 0) {
+		wb -> err = ret;
+	}
+	ofs_stats_end(OP_WB_COMMIT, begin, ret);
+	ofs_wb_unlist(wb);
+}
+
+/* PATH 파일에 모인 쓰기를 반영 (트리 쓰기 잠금 안에서 호출) */
+static void ofs_wb_sync(const char *path)
+{
+	ONODE *node;
+	OWBUF *wb;
+
+	if(!ofs_wb_pending() || path == NULL || (node = ofs_findnode(root, path)) == NULL)
+		return;
+	if((wb = ofs_wb_find(node -> of_stat)) != NULL)
+		ofs_wb_commit(wb, path);
+}
+
+/* 읽을 범위에 다른 핸들이 모아 둔 쓰기가 겹치는지 (트리 읽기 잠금 안에서 호출) */
+static int ofs_wb_overlap(const char *path, size_t size, off_t offset)
+{
+	ONODE *node;
+	OWBUF *wb;
+	int ret = 0;
+
+	if(!ofs_wb_pending() || (node = ofs_findnode(root, path)) == NULL)
+		return 0;
+	pthread_mutex_lock(&ofs_wb_lock);
+	if((wb = ofs_wb_find(node -> of_stat)) != NULL) {
+		pthread_mutex_lock(&wb -> lock);
+		ret = (offset < wb -> off + (off_t)wb -> len && offset + (off_t)size > wb -> off);
+		pthread_mutex_unlock(&wb -> lock);
+	}
+	pthread_mutex_unlock(&ofs_wb_lock);
+	return ret;
+}
+
+/* 모아 둔 쓰기로 늘어날 크기를 속성에 반영 (트리 읽기 잠금 안에서 호출) */
+static void ofs_wb_stat(const char *path, struct stat *stbuf)
+{
+	ONODE *node;
+	OWBUF *wb;
+
+	if(!ofs_wb_pending() || (node = ofs_findnode(root, path)) == NULL)
+		return;
+	pthread_mutex_lock(&ofs_wb_lock);
+	if((wb = ofs_wb_find(node -> of_stat)) != NULL) {
+		pthread_mutex_lock(&wb -> lock);
+		if(wb -> off + (off_t)wb -> len > stbuf -> st_size)
+			stbuf -> st_size = wb -> off + wb -> len;
+		stbuf -> st_mtim = stbuf -> st_ctim = wb -> mtime;
+		pthread_mutex_unlock(&wb -> lock);
+	}
+	pthread_mutex_unlock(&ofs_wb_lock);
+}
+
+/* DIR 아래 파일들에 모인 쓰기를 모두 반영, PATH는 DIR의 경로를 담은 PATH_MAX 버퍼 (트리 쓰기 잠금 안에서 호출) */
+static void ofs_wb_sync_tree(ONODE *dir, char *path)
+{
+	size_t len = strlen(path);
+	ONODE *cur;
+	OWBUF *wb;
+
+	for(cur = dir -> subhead; cur != NULL && ofs_wb_pending(); cur = cur -> nextnode) {
+		if(len + 1 + strlen(cur -> name) >= PATH_MAX)
+			continue;
+		snprintf(path + len, PATH_MAX - len, "%s%s", (len > 1)? "/" : "", cur -> name);
+		if(S_ISDIR(cur -> of_stat -> of_mode))
+			ofs_wb_sync_tree(cur, path);
+		else if((wb = ofs_wb_find(cur -> of_stat)) != NULL)
+			ofs_wb_commit(wb, path);
+	}
+	path[len] = '\0';
+}
+
+/*
+ * 옮길 디렉토리 아래 파일들에 모인 쓰기를 먼저 반영 (트리 쓰기 잠금 안에서 호출)
+ * ioctl로 옮기면 libfuse는 열린 핸들의 경로를 바꾸지 않아서 나중의 flush/release가 옛 경로로
+ * 반영하려다 실패하고, 이미 성공을 돌려준 쓰기가 버려진다.
+ */
+static void ofs_wb_move(const char *path)
+{
+	char tpath[PATH_MAX];
+	ONODE *node;
+
+	if(!ofs_wb_pending() || (node = ofs_findnode(root, path)) == NULL || !S_ISDIR(node -> of_stat -> of_mode))
+		return;
+	snprintf(tpath, sizeof(tpath), "%s", path);
+	ofs_wb_sync_tree(node, tpath);
+}
+
+/* 핸들을 닫는다, 반영하지 못한 쓰기(지워진 파일)는 버린다 (트리 쓰기 잠금 안에서 호출) */
+static void ofs_wb_close(OWBUF *wb, const char *path)
+{
+	ofs_wb_sync(path);
+	if(wb -> len > 0)
+		ofs_wb_unlist(wb);
+	pthread_mutex_destroy(&wb -> lock);
+	free(wb -> buf);
+	free(wb);
+}
+
+/*
+ * 서브트리 지우기와 옮기기 (OFS_IOC_RMTREE, OFS_IOC_MOVE)
+ * 지울 서브트리는 트리 쓰기 잠금 안에서 부모에서 떼어 내기만 하고, 노드와 데이터는 정리
+ * 스레드가 OFS_REAP_BATCH개씩 쓰기 잠금을 잡고 해제한다 (색인, 모아 둔 쓰기 때문에 잠금이
+ * 필요하다). 데몬화 전(저널 재실행)에는 바로 해제한다.
+ * 떼어 내기 전에 rm -rf와 같은 권한을 서브트리 전체에서 확인하므로, 해제와 달리 확인은
+ * 쓰기 잠금 안에서 서브트리 크기만큼 걸린다 (확인과 떼어 내기 사이에 트리가 바뀌지 않도록).
+ * 같은 순회에서 하드 링크를 모아 바로 해제하므로 바깥에 남는 이름의 링크 수는 떼어 낼 때
+ * 맞춰지고, 정리 중에 체크포인트를 해도 바깥 트리는 올바르다. 정리 스레드는 멈출 때 남은
+ * 서브트리를 모두 해제하고 끝난다 (마지막 체크포인트 전).
+ */
+#define OFS_REAP_BATCH		4096
+
+static struct {
+	ONODE			*queue;				// 떼어 낸 서브트리 (nextnode로 잇는다)
+	int				async;				// 정리 스레드를 쓸 수 있음 (ofs_init 이후)
+	int				running;
+	int				stop;
+	pthread_t		thread;
+	pthread_mutex_t	lock;
+	pthread_cond_t	wait;
+} ofs_reap = { .lock = PTHREAD_MUTEX_INITIALIZER, .wait = PTHREAD_COND_INITIALIZER };
+
+/* 떼어 낸 노드 하나 해제, 사용량은 ofs_unlink_node와 같이 돌려준다 (트리 쓰기 잠금 안에서 호출) */
+static void ofs_reap_node(ONODE *node)
+{
+	OSTAT *st = node -> of_stat;
+	OWBUF *wb;
+	int typelink = (ofs_istypedir(node) || (node -> parentdir != NULL && ofs_istypedir(node -> parentdir)));
+
+	ofs_quota_names(-(int64_t)(strlen(node -> name) + 1));
+	ofs_index_del(node);
+	if(S_ISDIR(st -> of_mode) || st -> of_nlink <= 1) {
+		if(ofs_wb_pending() && (wb = ofs_wb_find(st)) != NULL)
+			ofs_wb_unlist(wb);							// 지워진 파일에 모아 둔 쓰기는 버린다
+		ofs_quota_charge(st -> of_uid, st -> of_gid, typelink? OQ_TYPELINK : OQ_DATA, -(int64_t)ofs_qused(node), 0);
+		ofs_quota_charge(st -> of_uid, st -> of_gid, typelink? OQ_TYPELINK : OQ_NODE,
+			-(int64_t)(OFS_INODE_BYTES + ofs_xattr_size(st)), -1);
+		ofs_xattr_drop(node, 1);
+		if(node -> of_data != NULL)
+			ofs_data_free(node -> of_data);
+		free(st);
+	} else {											// 서브트리 밖(또는 아직 남은) 하드 링크
+		ofs_quota_charge(st -> of_uid, st -> of_gid, typelink? OQ_TYPELINK : OQ_NODE, -(int64_t)sizeof(ONODE), 0);
+		ofs_xattr_drop(node, 0);
+		st -> of_nlink--;
+	}
+	free(node);
+}
+
+/* 서브트리를 잎부터 BUDGET개까지 해제, 다 해제했으면 1 (트리 쓰기 잠금 안에서 호출) */
+static int ofs_reap_some(ONODE *top, size_t budget)
+{
+	ONODE *cur = top, *parent;
+
+	for(; budget > 0; budget--) {
+		while(cur -> subhead != NULL)
+			cur = cur -> subhead;
+		if(cur == top) {
+			ofs_reap_node(top);
+			return 1;
+		}
+		parent = cur -> parentdir;
+		ofs_reap_node(ofs_deletenode(cur));
+		cur = parent;
+	}
+	return 0;
+}
+
+static void* ofs_reap_worker(void *arg)
+{
+	ONODE *top = NULL;
+	uint64_t begin;
+	int done;
+
+	(void)arg;
+	for(;;) {
+		pthread_mutex_lock(&ofs_reap.lock);
+		while(top == NULL && ofs_reap.queue == NULL && !ofs_reap.stop)
+			pthread_cond_wait(&ofs_reap.wait, &ofs_reap.lock);
+		if(top == NULL && ofs_reap.queue == NULL) {			// 멈출 때는 남은 서브트리를 모두 해제한 뒤
+			pthread_mutex_unlock(&ofs_reap.lock);
+			return NULL;
+		}
+		if(top == NULL) {
+			top = ofs_reap.queue;
+			ofs_reap.queue = top -> nextnode;
+		}
+		pthread_mutex_unlock(&ofs_reap.lock);
+
+		begin = ofs_op_lock(1);						// 묶음 사이에 다른 연산이 끼어들 수 있다
+		done = ofs_reap_some(top, OFS_REAP_BATCH);
+		pthread_rwlock_unlock(&ofs_tree_lock);
+		ofs_stats_end(OP_REAP, begin, 0);
+		if(done)
+			top = NULL;
+	}
+}
+
+/* 부모에서 떼어 낸 서브트리를 정리 스레드에 넘긴다 (트리 쓰기 잠금 안에서 호출) */
+static void ofs_reap_queue(ONODE *top)
+{
+	top -> parentdir = top -> prevnode = NULL;
+	pthread_mutex_lock(&ofs_reap.lock);
+	if(ofs_reap.async && !ofs_reap.running && !ofs_reap.stop
+		&& pthread_create(&ofs_reap.thread, NULL, ofs_reap_worker, NULL) == 0)
+		ofs_reap.running = 1;
+	if(ofs_reap.running) {
+		top -> nextnode = ofs_reap.queue;
+		ofs_reap.queue = top;
+		pthread_cond_signal(&ofs_reap.wait);
+		pthread_mutex_unlock(&ofs_reap.lock);
+		return;
+	}
+	pthread_mutex_unlock(&ofs_reap.lock);
+	top -> nextnode = NULL;
+	while(!ofs_reap_some(top, SIZE_MAX));					// 저널 재실행 중이거나 스레드를 만들 수 없다
+}
+
+static void ofs_reap_stop(void)
+{
+	pthread_mutex_lock(&ofs_reap.lock);
+	ofs_reap.stop = 1;
+	pthread_cond_broadcast(&ofs_reap.wait);
+	pthread_mutex_unlock(&ofs_reap.lock);
+	if(ofs_reap.running)
+		pthread_join(ofs_reap.thread, NULL);
+}
+
+static int ofs_namecmp(const void *a, const void *b)
+{
+	return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+/* 디렉토리 항목의 이름을 정렬한 배열 (bsearch용, 항목이 없으면 NULL) */
+static char **ofs_dir_names(ONODE *dir, size_t *n)
+{
+	ONODE *cur;
+	char **names;
+	size_t i = 0;
+
+	for(*n = 0, cur = dir -> subhead; cur != NULL; cur = cur -> nextnode)
+		(*n)++;
+	if(*n == 0)
+		return NULL;
+	names = (char**)malloc(sizeof(char*) * *n);
+	for(cur = dir -> subhead; cur != NULL; cur = cur -> nextnode)
+		names[i++] = cur -> name;
+	qsort(names, *n, sizeof(char*), ofs_namecmp);
+	return names;
+}
+
+/* DIR 바로 아래 파일들의 타입 디렉토리 이름("_txt")을 확장자마다 한번씩 FN에 넘긴다 */
+static void ofs_typedirs(ONODE *dir, void (*fn)(const char*, void*), void *arg)
+{
+	ONODE *cur;
+	char **exts = NULL, *ext, *name;
+	size_t n = 0, i;
+
+	for(cur = dir -> subhead; cur != NULL; cur = cur -> nextnode) {
+		if(S_ISDIR(cur -> of_stat -> of_mode) || (ext = ofs_extension(cur -> name)) == NULL)
+			continue;
+		for(i = 0; i < n && strcmp(exts[i], ext) != 0; i++);
+		if(i < n)
+			continue;
+		exts = (char**)realloc(exts, sizeof(char*) * (n + 1));
+		exts[n++] = ext;
+		name = ofs_typedirname(cur -> name);
+		fn(name, arg);
+		free(name);
+	}
+	free(exts);
+}
+
+/* 지우거나 옮기는 디렉토리와 그 타입 디렉토리 */
+typedef struct _OMOVE {
+	const char	*src;
+	const char	*dst;				// 지울 때는 NULL
+	char			**names;			// 원본 디렉토리 항목 이름 (정렬)
+	size_t		n;
+} OMOVE;
+
+/* 원본 디렉토리의 파일을 가리키는 타입 링크인지 - 이름이 같은 링크만 건드린다 */
+static int ofs_move_typelink(OMOVE *mv, ONODE *link)
+{
+	char *key = link -> name;
+
+	return S_ISLNK(link -> of_stat -> of_mode) && mv -> n > 0
+		&& bsearch(&key, mv -> names, mv -> n, sizeof(char*), ofs_namecmp) != NULL;
+}
+
+/* 지울 디렉토리의 타입 디렉토리는 디렉토리 바깥(부모 쪽)에 있으므로 그 링크를 함께 지운다 */
+static void ofs_rmtree_typedir(const char *tname, void *arg)
+{
+	OMOVE *mv = (OMOVE*)arg;
+	char *tpath = (char*)malloc(strlen(mv -> src) + strlen(tname) + 1);
+	ONODE *typedir, *cur, *next;
+
+	strcpy(tpath, mv -> src);
+	strcat(tpath, tname);
+	if((typedir = ofs_findnode(root, tpath)) != NULL && ofs_istypedir(typedir)) {
+		for(cur = typedir -> subhead; cur != NULL; cur = next) {
+			next = cur -> nextnode;
+			if(ofs_move_typelink(mv, cur))
+				ofs_reap_node(ofs_deletenode(cur));
+		}
+		ofs_modified(typedir -> of_stat);
+		if(typedir -> subhead == NULL) {					// 비었을 때만 타입 디렉토리도 지운다
+			typedir -> parentdir -> of_stat -> of_nlink--;
+			ofs_reap_queue(ofs_deletenode(typedir));
+		}
+	}
+	free(tpath);
+}
+
+/* DIR에서 NODE를 지울 수 있는지 - 스티키 디렉토리에서는 항목이나 디렉토리의 소유자만 지운다 */
+static int ofs_rmtree_sticky(ONODE *dir, ONODE *node)
+{
+	uid_t uid = ofs_context_uid();
+
+	if(!(dir -> of_stat -> of_mode & S_ISVTX) || uid == 0)
+		return 0;
+	return (node -> of_stat -> of_uid == uid || dir -> of_stat -> of_uid == uid)? 0 : -EACCES;
+}
+
+/*
+ * rm -rf와 같은 권한 - 지나는 디렉토리마다 목록을 읽고(R) 항목을 지울 수 있어야(W, X) 한다.
+ * 바깥과 노드 정보를 공유할 수 있는 하드 링크는 LINKS에 모은다.
+ */
+static int ofs_rmtree_access(ONODE *dir, ONODE ***links, size_t *nlinks)
+{
+	OSTAT *st = dir -> of_stat;
+	ONODE *cur;
+	int ret;
+
+	if(dir -> subhead == NULL)
+		return 0;
+	if(ofs_check_access(st -> of_mode, st -> of_uid, st -> of_gid, R_OK | W_OK | X_OK) != 0)
+		return -EACCES;
+	for(cur = dir -> subhead; cur != NULL; cur = cur -> nextnode) {
+		if(ofs_istypedir(cur))
+			continue;								// 타입 디렉토리는 원본 파일과 함께 정리된다
+		if((ret = ofs_rmtree_sticky(dir, cur)) != 0)
+			return ret;
+		if(S_ISDIR(cur -> of_stat -> of_mode)) {
+			if((ret = ofs_rmtree_access(cur, links, nlinks)) != 0)
+				return ret;
+		} else if(cur -> of_stat -> of_nlink > 1) {
+			*links = (ONODE**)realloc(*links, sizeof(ONODE*) * (*nlinks + 1));
+			(*links)[(*nlinks)++] = cur;
+		}
+	}
+	return 0;
+}
+
+static int ofs_rmtree(const char *path)
+{
+	ONODE *node, *parent;
+	OSTAT *st;
+	OMOVE mv;
+	ONODE **links = NULL;
+	size_t nlinks = 0, i;
+	int ret;
+
+	/* 에러 체크 */
+	if(strcmp(path, "/") == 0)
+		return -EBUSY;
+	if (ofs_check_path_len(path) != 0)
+		return -ENAMETOOLONG;
+	if((node = ofs_findnode(root, path)) == NULL)
+		return -ENOENT;
+	if(!S_ISDIR(node -> of_stat -> of_mode))
+		return -ENOTDIR;
+	parent = node -> parentdir;
+	if(ofs_istypedir(node) || ofs_istypedir(parent))		// 타입 디렉토리는 지울 수 없다
+		return -EACCES;
+	st = parent -> of_stat;
+	if ((ofs_check_access(st -> of_mode, st -> of_uid, st -> of_gid, W_OK | X_OK)) != 0)
+		return -EACCES;
+	if((ret = ofs_rmtree_sticky(parent, node)) != 0 || (ret = ofs_rmtree_access(node, &links, &nlinks)) != 0) {
+		free(links);
+		return ret;
+	}
+
+	/* 떼어 내기 - 이름은 여기서 사라지고 해제는 정리 스레드가 한다 */
+	mv.src = path;
+	mv.dst = NULL;
+	mv.names = ofs_dir_names(node, &mv.n);
+	ofs_qtypelink++;
+	ofs_typedirs(node, ofs_rmtree_typedir, &mv);
+	ofs_qtypelink--;
+	free(mv.names);
+	for(i = 0; i < nlinks; i++)							// 바깥에 남은 이름의 링크 수를 지금 맞춘다
+		ofs_reap_node(ofs_deletenode(links[i]));
+	free(links);
+	parent -> of_stat -> of_nlink--;
+	ofs_modified(parent -> of_stat);
+	ofs_reap_queue(ofs_deletenode(node));
+	return 0;
+}
+
+/*
+ * 원본의 타입 디렉토리 하나에서 옮기는 파일들의 링크를 대상의 타입 디렉토리로 옮긴다 (링크 내용
+ * "../이름"은 그대로). 대상에 타입 디렉토리를 둘 수 없거나 같은 이름의 링크가 있으면 링크만 지운다.
+ */
+static void ofs_move_typedir(const char *tname, void *arg)
+{
+	OMOVE *mv = (OMOVE*)arg;
+	char *spath = (char*)malloc(strlen(mv -> src) + strlen(tname) + 1);
+	char *dpath = (char*)malloc(strlen(mv -> dst) + strlen(tname) + 1);
+	ONODE *tsrc, *tdst, *cur, *next;
+	char **names = NULL, *key;
+	size_t n = 0;
+
+	strcpy(spath, mv -> src);
+	strcat(spath, tname);
+	strcpy(dpath, mv -> dst);
+	strcat(dpath, tname);
+	if((tsrc = ofs_findnode(root, spath)) != NULL && ofs_istypedir(tsrc)) {
+		if((tdst = ofs_findnode(root, dpath)) == NULL) {
+			ofs_newtypedir(dpath);
+			tdst = ofs_findnode(root, dpath);
+		}
+		if(tdst != NULL && !ofs_istypedir(tdst))
+			tdst = NULL;								// 이름이 같은 사용자 디렉토리에는 넣지 않는다
+		if(tdst != NULL)
+			names = ofs_dir_names(tdst, &n);
+		for(cur = tsrc -> subhead; cur != NULL; cur = next) {
+			next = cur -> nextnode;
+			if(!ofs_move_typelink(mv, cur))
+				continue;
+			key = cur -> name;
+			if(tdst != NULL && (n == 0 || bsearch(&key, names, n, sizeof(char*), ofs_namecmp) == NULL))
+				ofs_insertnode(tdst, ofs_deletenode(cur));
+			else
+				ofs_reap_node(ofs_deletenode(cur));
+		}
+		free(names);
+		ofs_modified(tsrc -> of_stat);
+		if(tdst != NULL)
+			ofs_modified(tdst -> of_stat);
+		if(tsrc -> subhead == NULL)						// 다른 링크가 남아 있으면 디렉토리는 둔다
+			ofs_removedir(spath);
+	}
+	free(spath);
+	free(dpath);
+}
+
+static int ofs_movetree(const char *src, const char *dst)
+{
+	ONODE *snode, *dnode, *cur, *next;
+	OSTAT *ss, *ds;
+	OMOVE mv;
+	char **names = NULL, *key;
+	size_t n = 0;
+	int ret = 0;
+
+	/* 에러 체크 */
+	if (ofs_check_path_len(src) != 0 || ofs_check_path_len(dst) != 0)
+		return -ENAMETOOLONG;
+	if((snode = ofs_findnode(root, src)) == NULL || (dnode = ofs_findnode(root, dst)) == NULL)
+		return -ENOENT;
+	ss = snode -> of_stat;
+	ds = dnode -> of_stat;
+	if(!S_ISDIR(ss -> of_mode) || !S_ISDIR(ds -> of_mode))
+		return -ENOTDIR;
+	if(snode == root)
+		return -EBUSY;
+	if(ofs_istypedir(snode) || ofs_istypedir(snode -> parentdir) || ofs_istypedir(dnode))
+		return -EACCES;								// 타입 디렉토리에서 옮기거나 넣을 수 없다
+	if ((ofs_check_access(ss -> of_mode, ss -> of_uid, ss -> of_gid, W_OK | X_OK)) != 0
+		|| (ofs_check_access(ds -> of_mode, ds -> of_uid, ds -> of_gid, W_OK | X_OK)) != 0)
+		return -EACCES;
+	for(cur = dnode; cur != NULL; cur = cur -> parentdir)	// 자기 자신이나 아래로는 옮길 수 없다
+		if(cur == snode)
+			return -EINVAL;
+
+	/* 이름이 겹치면 아무것도 옮기지 않는다 - 대상의 이름을 정렬해 두고 찾는다 */
+	if((names = ofs_dir_names(dnode, &n)) != NULL) {
+		for(cur = snode -> subhead; cur != NULL && ret == 0; cur = cur -> nextnode) {
+			key = cur -> name;
+			if(bsearch(&key, names, n, sizeof(char*), ofs_namecmp) != NULL)
+				ret = -EEXIST;
+		}
+		free(names);
+		if(ret != 0)
+			return ret;
+	}
+
+	/* 타입 링크는 확장자마다 한번에 옮기고 항목은 노드째 옮긴다 */
+	mv.src = src;
+	mv.dst = dst;									// 루트의 타입 디렉토리도 "/" + "_txt"
+	mv.names = ofs_dir_names(snode, &mv.n);
+	ofs_qtypelink++;
+	ofs_typedirs(snode, ofs_move_typedir, &mv);
+	ofs_qtypelink--;
+	free(mv.names);
+	for(cur = snode -> subhead; cur != NULL; cur = next) {
+		next = cur -> nextnode;
+		ofs_insertnode(dnode, ofs_deletenode(cur));
+		if(S_ISDIR(cur -> of_stat -> of_mode)) {
+			ss -> of_nlink--;
+			ds -> of_nlink++;
+		}
+	}
+	ofs_modified(ss);
+	ofs_modified(ds);
+	return 0;
+}
+
+/*
+ * 묶음 만들기 (OFS_IOC_BATCH)
+ * 한 디렉토리에 이름, 모드, 내용을 가진 일반 파일 여러 개를 한번의 요청과 한번의 트리
+ * 쓰기 잠금으로 만든다. 디렉토리 탐색과 권한 검사는 한번만 하고, 이름 충돌은 디렉토리
+ * 항목을 정렬해 두고 찾는다. 모든 항목을 검사하고 내용까지 채운 뒤에 트리에 넣으므로
+ * 검사나 저장에 실패하면 아무것도 만들지 않는다. 타입 링크는 확장자마다 타입 디렉토리를
+ * 한번만 찾거나 만들어 넣는다.
+ */
+typedef struct _OBATCHENT {
+	char			*name;
+	mode_t		mode;
+	uint32_t		size;
+	const char	*data;				// 묶음 안의 내용
+} OBATCHENT;
+
+/* 묶음의 한 확장자에 해당하는 타입 디렉토리 */
+typedef struct _OBATCHTYPE {
+	char			*name;				// 타입 디렉토리 이름 (_확장자)
+	ONODE		*dir;				// 만들 수 없으면 NULL
+	char			**names;			// 이미 있던 링크 이름 (정렬), 새로 만든 디렉토리면 NULL
+	size_t		n;
+} OBATCHTYPE;
+
+/* 새로 만든 파일들의 타입 링크 (ofs_addtypelink와 같은 위치와 내용) */
+static void ofs_batch_typelinks(const char *path, ONODE **nodes, uint32_t count)
+{
+	OBATCHTYPE *tab = NULL;
+	size_t cnt = 0, i;
+	uint32_t k;
+	ONODE *tdir, *link;
+	char *typedir_name, *typedir_path, *old_path, *key;
+	uint64_t begin = ofs_stats_begin();
+
+	ofs_qtypelink++;
+	for(k = 0; k < count; k++) {
+		if(ofs_extension(nodes[k] -> name) == NULL)
+			continue;
+
+		/* 확장자마다 타입 디렉토리를 한번만 찾거나 만든다 */
+		typedir_name = ofs_typedirname(nodes[k] -> name);
+		for(i = 0; i < cnt && strcmp(tab[i].name, typedir_name) != 0; i++);
+		if(i == cnt) {
+			tab = (OBATCHTYPE*)realloc(tab, sizeof(OBATCHTYPE) * (cnt + 1));
+			tab[i].name = typedir_name;
+			tab[i].names = NULL;
+			tab[i].n = 0;
+			typedir_path = (char*)malloc(strlen(path) + strlen(typedir_name) + 1);	// 루트의 타입 디렉토리는 "/_txt"
+			strcpy(typedir_path, path);
+			strcat(typedir_path, typedir_name);
+			if((tdir = ofs_findnode(root, typedir_path)) == NULL) {
+				ofs_newtypedir(typedir_path);
+				tdir = ofs_findnode(root, typedir_path);
+			} else if(ofs_istypedir(tdir)) {
+				tab[i].names = ofs_dir_names(tdir, &tab[i].n);
+			}
+			tab[i].dir = (tdir != NULL && ofs_istypedir(tdir))? tdir : NULL;
+			free(typedir_path);
+			cnt++;
+		} else {
+			free(typedir_name);
+		}
+
+		/* 이미 같은 이름의 링크가 있으면 그대로 둔다 */
+		key = nodes[k] -> name;
+		if(tab[i].dir == NULL
+			|| (tab[i].n > 0 && bsearch(&key, tab[i].names, tab[i].n, sizeof(char*), ofs_namecmp) != NULL))
+			continue;
+		old_path = (char*)malloc(3 + strlen(key) + 1);
+		strcpy(old_path, "../");
+		strcat(old_path, key);
+		link = ofs_neONODE(key, S_IFLNK | 0777, ofs_context_uid(), ofs_context_gid());
+		ofs_setdata(link, old_path, strlen(old_path) + 1, 0);
+		ofs_insertnode(tab[i].dir, link);
+		ofs_modified(tab[i].dir -> of_stat);
+		ofs_index_add(link);
+		ofs_quota_charge(ofs_context_uid(), ofs_context_gid(), OFS_QNODE, OFS_INODE_BYTES, 1);
+		ofs_quota_names(strlen(link -> name) + 1);
+		ofs_qdata(link, 0);
+		free(old_path);
+	}
+	for(i = 0; i < cnt; i++) {
+		free(tab[i].name);
+		free(tab[i].names);
+	}
+	free(tab);
+	ofs_qtypelink--;
+	ofs_stats_end(OP_TYPELINK, begin, 0);
+}
+
+/* 묶음을 읽어 검사한다 (이름은 복사해 둔다) */
+static int ofs_batch_parse(const char *path, const char *buf, size_t len, uint32_t count, OBATCHENT *ents)
+{
+	struct ofs_batch_ent ent;
+	size_t off = 0;
+	uint32_t k;
+
+	for(k = 0; k < count; k++) {
+		if(len - off < sizeof(ent))
+			return -EINVAL;
+		memcpy(&ent, buf + off, sizeof(ent));				// 항목은 정렬되어 있지 않다
+		off += sizeof(ent);
+		if(ent.namelen > len - off || ent.size > len - off - ent.namelen)
+			return -EINVAL;
+		if(ent.namelen >= NAME_MAX || strlen(path) + 1 + ent.namelen >= PATH_MAX)
+			return -ENAMETOOLONG;
+		if(ent.namelen == 0 || memchr(buf + off, '/', ent.namelen) != NULL
+			|| memchr(buf + off, '\0', ent.namelen) != NULL)
+			return -EINVAL;
+		if((ent.mode & S_IFMT) != 0 && !S_ISREG(ent.mode))	// 일반 파일만 만든다
+			return -EINVAL;
+		ents[k].name = strndup(buf + off, ent.namelen);
+		ents[k].mode = S_IFREG | (ent.mode & 07777);
+		ents[k].size = ent.size;
+		ents[k].data = buf + off + ent.namelen;
+		off += ent.namelen + ent.size;
+		if(strcmp(ents[k].name, ".") == 0 || strcmp(ents[k].name, "..") == 0)
+			return -EINVAL;
+		if(*(ents[k].name) == '_')						// 파일 이름은 _로 시작할 수 없다.
+			return -EINVAL;
+	}
+	return (off == len)? 0 : -EINVAL;
+}
+
+static int ofs_batch(const char *path, const char *buf, size_t len, uint32_t count)
+{
+	ONODE *dir, *node, **nodes;
+	OSTAT *st;
+	OBATCHENT *ents;
+	char **names, **sorted, *key;
+	size_t n;
+	uint64_t bytes;
+	uint32_t k, made;
+	int ret;
+
+	/* 에러 체크 */
+	if (ofs_check_path_len(path) != 0)
+		return -ENAMETOOLONG;
+	if((dir = ofs_findnode(root, path)) == NULL)
+		return -ENOENT;
+	st = dir -> of_stat;
+	if(!S_ISDIR(st -> of_mode))
+		return -ENOTDIR;
+	if(ofs_istypedir(dir))							// 타입 디렉토리에서는 생성 불가
+		return -EACCES;
+	if ((ofs_check_access(st -> of_mode, st -> of_uid, st -> of_gid, W_OK | X_OK)) != 0)
+		return -EACCES;
+	if(count == 0)
+		return (len == 0)? 0 : -EINVAL;
+	if(count > len / (sizeof(struct ofs_batch_ent) + 1))	// 항목마다 이름이 한 글자 이상
+		return -EINVAL;
+
+	/* 항목 검사 - 묶음 안의 같은 이름과 디렉토리에 이미 있는 이름 */
+	ents = (OBATCHENT*)calloc(count, sizeof(OBATCHENT));
+	sorted = (char**)malloc(sizeof(char*) * count);
+	ret = ofs_batch_parse(path, buf, len, count, ents);
+	if(ret == 0) {
+		for(k = 0; k < count; k++)
+			sorted[k] = ents[k].name;
+		qsort(sorted, count, sizeof(char*), ofs_namecmp);
+		for(k = 1; k < count && ret == 0; k++)
+			if(strcmp(sorted[k - 1], sorted[k]) == 0)
+				ret = -EEXIST;
+	}
+	if(ret == 0 && (names = ofs_dir_names(dir, &n)) != NULL) {
+		for(k = 0; k < count && ret == 0; k++) {
+			key = ents[k].name;
+			if(bsearch(&key, names, n, sizeof(char*), ofs_namecmp) != NULL)
+				ret = -EEXIST;
+		}
+		free(names);
+	}
+	if(ret == 0) {										// 노드 수, 사용량 한도 확인
+		for(bytes = 0, k = 0; k < count; k++)
+			bytes += OFS_INODE_BYTES + ofs_data_growth(NULL, ents[k].size, 0);
+		ret = ofs_qcheck(ofs_context_uid(), ofs_context_gid(), bytes, count);
+	}
+
+	/* 내용을 먼저 모두 채운다 - 하나라도 실패하면 트리에 넣기 전에 모두 버린다 */
+	nodes = (ONODE**)malloc(sizeof(ONODE*) * count);
+	for(made = 0; made < count && ret == 0; made++) {
+		node = nodes[made] = ofs_neONODE(ents[made].name, ents[made].mode, ofs_context_uid(), ofs_context_gid());
+		if(ents[made].size > 0)
+			ret = ofs_setdata(node, ents[made].data, ents[made].size, 0);
+	}
+	if(ret != 0) {
+		for(k = 0; k < made; k++) {
+			if(nodes[k] -> of_data != NULL) ofs_data_free(nodes[k] -> of_data);
+			free(nodes[k] -> of_stat);
+			free(nodes[k]);
+		}
+	}
+
+	/* 파일 생성 - ofs_makenod와 ofs_write를 항목마다 한 것과 같다 */
+	for(k = 0; k < count && ret == 0; k++) {
+		node = nodes[k];
+		ofs_insertnode(dir, node);
+		ofs_index_add(node);
+		ofs_quota_charge(ofs_context_uid(), ofs_context_gid(), OFS_QNODE, OFS_INODE_BYTES, 1);
+		ofs_quota_names(strlen(node -> name) + 1);
+		ofs_qdata(node, 0);
+	}
+	if(ret == 0) {
+		ofs_modified(st);
+		ofs_batch_typelinks(path, nodes, count);
+	}
+
+	for(k = 0; k < count; k++)
+		free(ents[k].name);
+	free(ents);
+	free(sorted);
+	free(nodes);
+	return (ret == 0)? (int)count : ret;
+}
+
+/*
+ * 내보내기 (/.ofs/export)
+ * "<서브트리> <로컬 파일>"을 쓰면 트리 잠금 안에서 서브트리의 스냅샷을 뜨고
+ * 잠금을 푼 뒤 export.c의 스레드가 tar로 기록한다. 모아 둔 쓰기가 있으면 쓰기 잠금을
+ * 잡고 스냅샷에 넣기 전에 반영한다.
+ */
+static void ofs_export_sync(ONODE *node, const char *path)
+{
+	OWBUF *wb;
+
+	if((wb = ofs_wb_find(node -> of_stat)) != NULL)
+		ofs_wb_commit(wb, path);
+}
+
+static int ofs_export_store(const char *buf, size_t size)
+{
+	char line[PATH_MAX * 2], *dest;
+	ONODE *node;
+	OEXPORT *x;
+	uint64_t begin;
+	size_t n;
+	int write;
+
+	for(n = 0; n < size && buf[n] != '\n'; n++);
+	if(n == 0 || n >= sizeof(line))
+		return -1;
+	memcpy(line, buf, n);
+	line[n] = '\0';
+	if(*line != '/' || (dest = strchr(line, ' ')) == NULL)
+		return -1;
+	*dest++ = '\0';
+	while(*dest == ' ') dest++;
+	for(n = strlen(line); n > 1 && line[n - 1] == '/'; n--)
+		line[n - 1] = '\0';
+	if(*dest == '\0' || ofs_export_busy())
+		return -1;
+
+	write = ofs_wb_pending();
+	begin = ofs_op_lock(write);
+	if((node = ofs_findnode(root, line)) == NULL) {
+		pthread_rwlock_unlock(&ofs_tree_lock);
+		return ofs_op_done(OP_EXPORT, line, begin, -ENOENT);
+	}
+	x = ofs_export_snapshot(node, line, write? ofs_export_sync : NULL);
+	pthread_rwlock_unlock(&ofs_tree_lock);
+	ofs_op_done(OP_EXPORT, line, begin, 0);
+	return (ofs_export_start(x, dest) == 0)? 0 : -1;
+}
+
+/* 가상 경로는 만들거나 지우거나 속성을 바꿀 수 없다 */
+#define OFS_VDENY(path)		do { if(ofs_vpath(path, NULL) != OV_NONE) return -EPERM; } while(0)
+
+static int ofs_op_access(const char *path, int how)
+{
+	int ret, kind;
+	uint64_t begin;
+
+	if((kind = ofs_vpath(path, NULL)) != OV_NONE) {
+		if(kind == OV_MISSING) return -ENOENT;
+		if(how == F_OK) return 0;
+		return ofs_check_access((kind == OV_DIR || kind == OV_QUERY)? S_IFDIR | 0555 :
+			(kind == OV_QENT)? S_IFLNK | 0777 : OFS_VMODE, getuid(), getgid(), how);
+	}
+	begin = ofs_op_lock(0);
+	ret = ofs_access(path, how);
+	pthread_rwlock_unlock(&ofs_tree_lock);
+	return ofs_op_done(OP_ACCESS, path, begin, ret);
+}
+
+static int ofs_op_getattr(const char *path, struct stat *stbuf, struct fuse_file_info *fi)
+{
+	int ret, kind;
+	uint64_t begin;
+
+	if((kind = ofs_vpath(path, NULL)) == OV_QENT) {
+		pthread_rwlock_rdlock(&ofs_tree_lock);
+		ret = ofs_qgetattr(path, stbuf);
+		pthread_rwlock_unlock(&ofs_tree_lock);
+		return ret;
+	}
+	if(kind != OV_NONE)
+		return ofs_vgetattr(kind, stbuf);
+	begin = ofs_op_lock(0);
+	ret = ofs_getattr(path, stbuf);
+	if(ret == 0)
+		ofs_wb_stat(path, stbuf);
+	pthread_rwlock_unlock(&ofs_tree_lock);
+	return ofs_op_done(OP_GETATTR, path, begin, ret);
+}
+
+static int ofs_op_readdir(const char *path, void *buf, fuse_fill_dir_t filler, off_t offset, struct fuse_file_info *fi,
+	enum fuse_readdir_flags flags)
+{
+	int ret, kind;
+	size_t i;
+	uint64_t begin;
+
+	if((kind = ofs_vpath(path, NULL)) == OV_QUERY) {
+		pthread_rwlock_rdlock(&ofs_tree_lock);
+		ret = ofs_qreaddir(path, buf, filler);
+		pthread_rwlock_unlock(&ofs_tree_lock);
+		return ret;
+	}
+	if(kind != OV_NONE) {
+		if(kind != OV_DIR) return (kind == OV_FILE || kind == OV_QENT)? -ENOTDIR : -ENOENT;
+		filler(buf, ".", NULL, 0, 0);
+		filler(buf, "..", NULL, 0, 0);
+		for(i = 0; i < OFS_NVFILES; i++)
+			filler(buf, ofs_vfiles[i].name, NULL, 0, 0);
+		return 0;
+	}
+	begin = ofs_op_lock(0);
+	ret = ofs_readdir(path, buf, filler, offset, fi);
+	pthread_rwlock_unlock(&ofs_tree_lock);
+	return ofs_op_done(OP_READDIR, path, begin, ret);
+}
+
+static int ofs_op_readlink(const char *path, char *buffer, size_t size)
+{
+	int ret, kind;
+	uint64_t begin;
+
+	if((kind = ofs_vpath(path, NULL)) == OV_QENT) {
+		pthread_rwlock_rdlock(&ofs_tree_lock);
+		ret = ofs_qreadlink(path, buffer, size);
+		pthread_rwlock_unlock(&ofs_tree_lock);
+		return ret;
+	}
+	if(kind != OV_NONE)
+		return -EINVAL;
+	begin = ofs_op_lock(0);
+	ret = ofs_readlink(path, buffer, size);
+	pthread_rwlock_unlock(&ofs_tree_lock);
+	return ofs_op_done(OP_READLINK, path, begin, ret);
+}
+
+static int ofs_op_open(const char *path, struct fuse_file_info *fi)
+{
+	int ret, kind;
+	const OVFILE *vf = NULL;
+	uint64_t begin;
+
+	if((kind = ofs_vpath(path, &vf)) != OV_NONE)
+		return ofs_vopen(kind, vf, fi);
+	begin = ofs_op_lock(0);
+	ret = ofs_open(path, fi);
+	if(ret == 0)
+		ofs_wb_open(fi);
+	pthread_rwlock_unlock(&ofs_tree_lock);
+	return ofs_op_done(OP_OPEN, path, begin, ret);
+}
+
+static int ofs_op_opendir(const char *path, struct fuse_file_info *fi)
+{
+	int ret, kind;
+	uint64_t begin;
+
+	if((kind = ofs_vpath(path, NULL)) != OV_NONE)
+		return (kind == OV_DIR || kind == OV_QUERY)? 0 : (kind == OV_FILE || kind == OV_QENT)? -ENOTDIR : -ENOENT;
+	begin = ofs_op_lock(0);
+	ret = ofs_opendir(path, fi);
+	pthread_rwlock_unlock(&ofs_tree_lock);
+	return ofs_op_done(OP_OPENDIR, path, begin, ret);
+}
+
+static int ofs_op_read(const char *path, char *buf, size_t size, off_t offset, struct fuse_file_info *fi)
+{
+	int ret;
+	uint64_t begin;
+
+	if(ofs_vpath(path, NULL) == OV_FILE)
+		return ofs_vread(fi, buf, size, offset);
+	begin = ofs_op_lock(0);
+	if(ofs_wb_overlap(path, size, offset)) {			// 모아 둔 쓰기를 먼저 반영
+		pthread_rwlock_unlock(&ofs_tree_lock);
+		pthread_rwlock_wrlock(&ofs_tree_lock);
+		ofs_wb_sync(path);
+		pthread_rwlock_unlock(&ofs_tree_lock);
+		pthread_rwlock_rdlock(&ofs_tree_lock);
+	}
+	ret = ofs_read(path, buf, size, offset, fi);
+	pthread_rwlock_unlock(&ofs_tree_lock);
+	return ofs_op_done(OP_READ, path, begin, ret);
+}
+
+static int ofs_op_release(const char *path, struct fuse_file_info *fi)
+{
+	int ret;
+	uint64_t begin;
+	OWBUF *wb;
+
+	if(ofs_vpath(path, NULL) == OV_FILE) {
+		ofs_vrelease(fi);
+		return 0;
+	}
+	wb = ofs_wb_get(fi);
+	if(!conf.dedup && !conf.checksum && wb == NULL)		// 닫을 때 할 일이 없으면 잠그지 않는다
+		return 0;
+	begin = ofs_op_lock(1);
+	if(wb != NULL) {
+		ofs_wb_close(wb, path);
+		fi -> fh = 0;
+	}
+	ret = (path != NULL)? ofs_release(path, fi) : 0;
+	pthread_rwlock_unlock(&ofs_tree_lock);
+	return ofs_op_done(OP_RELEASE, path, begin, ret);
+}
+
+/* 모아 둔 쓰기를 반영하고 저널 커밋을 기다린다, 반영하다 생긴 에러는 여기서 돌려준다 */
+static int ofs_op_flush(const char *path, struct fuse_file_info *fi)
+{
+	int ret, err;
+	uint64_t begin, lsn;
+	OWBUF *wb;
+
+	if(ofs_vpath(path, NULL) != OV_NONE || (wb = ofs_wb_get(fi)) == NULL)
+		return 0;
+	begin = ofs_op_lock(1);
+	ofs_wb_sync(path);
+	lsn = wb -> lsn;								// 이 핸들로 반영한 쓰기가 모두 기록될 때까지
+	ret = wb -> err;
+	wb -> err = 0;
+	pthread_rwlock_unlock(&ofs_tree_lock);
+	if((err = ofs_journal_wait(lsn)) != 0 && ret == 0)
+		ret = err;
+	return ofs_op_done(OP_FLUSH, path, begin, ret);
+}
+
+static int ofs_op_fsync(const char *path, int datasync, struct fuse_file_info *fi)
+{
+	(void)datasync;
+	return ofs_op_flush(path, fi);
+}
+
+static int ofs_op_poll(const char *path, struct fuse_file_info *fi, struct fuse_pollhandle *ph, unsigned *reventsp)
+{
+	if(path != NULL && ofs_vpath(path, NULL) == OV_FILE)
+		return ofs_vpoll(fi, ph, reventsp);
+	if(ph != NULL)									// 일반 파일은 항상 읽고 쓸 수 있다
+		fuse_pollhandle_destroy(ph);
+	*reventsp = POLLIN | POLLOUT;
+	return 0;
+}
+
+static int ofs_op_mknod(const char *path, mode_t mode, dev_t dev)
+{
+	uint64_t begin;
+
+	OFS_VDENY(path);
+	begin = ofs_op_lock(1);
+	return ofs_op_done(OP_MKNOD, path, begin,
+		ofs_op_end(ofs_mknod(path, mode, dev), OJ_MKNOD, path, NULL, mode, dev, 0, NULL, 0));
+}
+
+static int ofs_op_mkdir(const char *path, mode_t mode)
+{
+	uint64_t begin;
+
+	OFS_VDENY(path);
+	begin = ofs_op_lock(1);
+	return ofs_op_done(OP_MKDIR, path, begin,
+		ofs_op_end(ofs_mkdir(path, mode), OJ_MKDIR, path, NULL, mode, 0, 0, NULL, 0));
+}
+
+static int ofs_op_unlink(const char *path)
+{
+	uint64_t begin;
+
+	OFS_VDENY(path);
+	begin = ofs_op_lock(1);
+	ofs_wb_sync(path);
+	return ofs_op_done(OP_UNLINK, path, begin,
+		ofs_op_end(ofs_unlink(path), OJ_UNLINK, path, NULL, 0, 0, 0, NULL, 0));
+}
+
+static int ofs_op_rmdir(const char *path)
+{
+	uint64_t begin;
+
+	OFS_VDENY(path);
+	begin = ofs_op_lock(1);
+	return ofs_op_done(OP_RMDIR, path, begin,
+		ofs_op_end(ofs_rmdir(path), OJ_RMDIR, path, NULL, 0, 0, 0, NULL, 0));
+}
+
+static int ofs_op_symlink(const char *oldname, const char *newname)
+{
+	uint64_t begin;
+
+	OFS_VDENY(newname);
+	begin = ofs_op_lock(1);
+	return ofs_op_done(OP_SYMLINK, newname, begin,
+		ofs_op_end(ofs_symlink(oldname, newname), OJ_SYMLINK, oldname, newname, 0, 0, 0, NULL, 0));
+}
+
+static int ofs_op_link(const char *oldname, const char *newname)
+{
+	uint64_t begin;
+
+	OFS_VDENY(oldname);
+	OFS_VDENY(newname);
+	begin = ofs_op_lock(1);
+	ofs_wb_sync(oldname);
+	return ofs_op_done(OP_LINK, newname, begin,
+		ofs_op_end(ofs_link(oldname, newname), OJ_LINK, oldname, newname, 0, 0, 0, NULL, 0));
+}
+
+static int ofs_op_rename(const char *oldname, const char *newname, unsigned int flags)
+{
+	int ret;
+	uint64_t begin;
+
+	if(flags & ~RENAME_NOREPLACE)						// RENAME_EXCHANGE는 지원하지 않는다
+		return -EINVAL;
+	OFS_VDENY(oldname);
+	OFS_VDENY(newname);
+	begin = ofs_op_lock(1);
+	ofs_wb_sync(oldname);
+	ofs_wb_sync(newname);
+	if((flags & RENAME_NOREPLACE) && ofs_findnode(root, newname) != NULL)
+		ret = -EEXIST;
+	else
+		ret = ofs_rename(oldname, newname);
+	return ofs_op_done(OP_RENAME, newname, begin,
+		ofs_op_end(ret, OJ_RENAME, oldname, newname, 0, 0, 0, NULL, 0));
+}
+
+static int ofs_op_write(const char *path, const char *buf, size_t size, off_t offset, struct fuse_file_info *fi)
+{
+	int ret, kind;
+	const OVFILE *vf = NULL;
+	uint64_t begin;
+	OWBUF *wb;
+
+	if((kind = ofs_vpath(path, &vf)) != OV_NONE) {			// 가상 파일에 쓰면 초기화
+		if(kind == OV_FILE && vf -> stream != NULL && fi != NULL && fi -> fh != 0)
+			ret = ofs_vseek(fi, buf, size);				// 스트림은 핸들의 커서를 옮긴다
+		else
+			ret = ofs_vreset(kind, vf, buf, size);
+		return (ret == 0)? (int)size : ret;
+	}
+	if((wb = ofs_wb_get(fi)) != NULL && size < wb -> cap) {		// 이어지는 작은 쓰기는 읽기 잠금으로 모은다
+		begin = ofs_op_lock(0);
+		ret = ofs_wb_add(wb, path, buf, size, offset);
+		pthread_rwlock_unlock(&ofs_tree_lock);
+		if(ret)
+			return ofs_op_done(OP_WRITE, path, begin, (int)size);
+	}
+	begin = ofs_op_lock(1);
+	ofs_wb_sync(path);
+	if(wb != NULL && ofs_wb_add(wb, path, buf, size, offset)) {	// 비운 버퍼에 새로 모은다
+		pthread_rwlock_unlock(&ofs_tree_lock);
+		return ofs_op_done(OP_WRITE, path, begin, (int)size);
+	}
+	ret = ofs_write(path, buf, size, offset, fi);
+	return ofs_op_done(OP_WRITE, path, begin,
+		ofs_op_end(ret, OJ_WRITE, path, NULL, offset, 0, 0, buf, (ret > 0)? ret : 0));
+}
+
+static int ofs_op_truncate(const char *path, off_t length, struct fuse_file_info *fi)
+{
+	int kind;
+	const OVFILE *vf = NULL;
+	uint64_t begin;
+
+	if((kind = ofs_vpath(path, &vf)) != OV_NONE)
+		return (length == 0)? ofs_vreset(kind, vf, NULL, 0) : -EPERM;
+	begin = ofs_op_lock(1);
+	ofs_wb_sync(path);
+	return ofs_op_done(OP_TRUNCATE, path, begin,					// ftruncate(열린 파일)로 늘리면 미리 할당
+		ofs_op_end(ofs_truncate(path, length, fi != NULL), OJ_TRUNCATE, path, NULL, length, fi != NULL, 0, NULL, 0));
+}
+
+static int ofs_op_fallocate(const char *path, int mode, off_t offset, off_t length, struct fuse_file_info *fi)
+{
+	uint64_t begin;
+
+	if(ofs_vpath(path, NULL) != OV_NONE)
+		return -EOPNOTSUPP;
+	begin = ofs_op_lock(1);
+	ofs_wb_sync(path);
+	return ofs_op_done(OP_FALLOCATE, path, begin,
+		ofs_op_end(ofs_fallocate(path, mode, offset, length), OJ_FALLOCATE, path, NULL, mode, offset, length, NULL, 0));
+}
+
+static int ofs_op_chmod(const char *path, mode_t mode, struct fuse_file_info *fi)
+{
+	uint64_t begin;
+
+	OFS_VDENY(path);
+	begin = ofs_op_lock(1);
+	return ofs_op_done(OP_CHMOD, path, begin,
+		ofs_op_end(ofs_chmod(path, mode), OJ_CHMOD, path, NULL, mode, 0, 0, NULL, 0));
+}
+
+static int ofs_op_chown(const char *path, uid_t uid, gid_t gid, struct fuse_file_info *fi)
+{
+	uint64_t begin;
+
+	OFS_VDENY(path);
+	begin = ofs_op_lock(1);
+	ofs_wb_sync(path);
+	return ofs_op_done(OP_CHOWN, path, begin,
+		ofs_op_end(ofs_chown(path, uid, gid), OJ_CHOWN, path, NULL, uid, gid, 0, NULL, 0));
+}
+
+static int ofs_op_utimens(const char *path, const struct timespec tv[2], struct fuse_file_info *fi)
+{
+	int ret;
+	ONODE *node;
+	uint64_t atime = 0, mtime = 0, nsec = 0, begin;
+
+	if(ofs_vpath(path, NULL) != OV_NONE)				// 가상 파일의 시간은 항상 현재 시각
+		return 0;
+	begin = ofs_op_lock(1);
+	ret = ofs_utimens(path, tv);
+	if(ret == 0 && tv != NULL && tv[0].tv_nsec == UTIME_OMIT && tv[1].tv_nsec == UTIME_OMIT) {
+		pthread_rwlock_unlock(&ofs_tree_lock);			// 바뀐 것이 없으니 기록하지 않는다
+		return ofs_op_done(OP_UTIMENS, path, begin, 0);
+	}
+	if(ret == 0 && (node = ofs_findnode(root, path)) != NULL) {	// 재실행 결과가 같도록 적용된 시간을 기록
+		atime = node -> of_stat -> of_atime.tv_sec;
+		mtime = node -> of_stat -> of_mtime.tv_sec;
+		nsec = (uint64_t)node -> of_stat -> of_atime.tv_nsec << 32 | (uint64_t)node -> of_stat -> of_mtime.tv_nsec;
+	}
+	return ofs_op_done(OP_UTIMENS, path, begin,
+		ofs_op_end(ret, OJ_UTIME, path, NULL, atime, mtime, nsec, NULL, 0));
+}
+
+static int ofs_op_setxattr(const char *path, const char *name, const char *value, size_t size, int flags)
+{
+	uint64_t begin;
+
+	OFS_VDENY(path);
+	begin = ofs_op_lock(1);
+	return ofs_op_done(OP_SETXATTR, path, begin,
+		ofs_op_end(ofs_setxattr(path, name, value, size, flags), OJ_SETXATTR, path, name, flags, 0, 0, value, size));
+}
+
+static int ofs_op_getxattr(const char *path, const char *name, char *value, size_t size)
+{
+	int ret;
+	uint64_t begin;
+
+	if(ofs_vpath(path, NULL) != OV_NONE)
+		return -ENODATA;
+	begin = ofs_op_lock(0);
+	ret = ofs_getxattr(path, name, value, size);
+	pthread_rwlock_unlock(&ofs_tree_lock);
+	return ofs_op_done(OP_GETXATTR, path, begin, ret);
+}
+
+static int ofs_op_listxattr(const char *path, char *list, size_t size)
+{
+	int ret;
+	uint64_t begin;
+
+	if(ofs_vpath(path, NULL) != OV_NONE)
+		return 0;
+	begin = ofs_op_lock(0);
+	ret = ofs_listxattr(path, list, size);
+	pthread_rwlock_unlock(&ofs_tree_lock);
+	return ofs_op_done(OP_LISTXATTR, path, begin, ret);
+}
+
+static int ofs_op_removexattr(const char *path, const char *name)
+{
+	uint64_t begin;
+
+	OFS_VDENY(path);
+	begin = ofs_op_lock(1);
+	return ofs_op_done(OP_REMOVEXATTR, path, begin,
+		ofs_op_end(ofs_removexattr(path, name), OJ_REMOVEXATTR, path, name, 0, 0, 0, NULL, 0));
+}
+
+static ssize_t ofs_op_copy_file_range(const char *path_in, struct fuse_file_info *fi_in, off_t off_in,
+	const char *path_out, struct fuse_file_info *fi_out, off_t off_out, size_t size, int flags)
+{
+	ssize_t ret;
+	uint64_t begin;
+
+	if(flags != 0)
+		return -EINVAL;
+	if(ofs_vpath(path_in, NULL) != OV_NONE || ofs_vpath(path_out, NULL) != OV_NONE)
+		return -EOPNOTSUPP;							// 커널이 일반 복사로 처리한다
+	if(size > INT_MAX)								// 짧게 복사하면 커널이 이어서 요청한다
+		size = INT_MAX & ~(OFS_CHUNK_SIZE - 1);
+	begin = ofs_op_lock(1);
+	ofs_wb_sync(path_in);
+	ofs_wb_sync(path_out);
+	ret = ofs_clone(path_in, off_in, path_out, off_out, size);
+	return ofs_op_done(OP_COPY_RANGE, path_out, begin,
+		ofs_op_end(ret, OJ_CLONE, path_in, path_out, off_in, off_out, (ret > 0)? ret : 0, NULL, 0));
+}
+
+/* 커널이 mknod에 하듯 호출한 프로세스의 umask를 모드에 적용한다 (저널에는 적용한 모드를 남긴다) */
+static void ofs_batch_umask(struct ofs_batch_arg *batch)
+{
+	struct ofs_batch_ent ent;
+	mode_t mask = fuse_get_context()->umask;
+	size_t off = 0;
+	uint32_t k;
+
+	for(k = 0; k < batch->count && batch->len - off >= sizeof(ent); k++) {
+		memcpy(&ent, batch->buf + off, sizeof(ent));
+		ent.mode &= ~mask;
+		memcpy(batch->buf + off, &ent, sizeof(ent));
+		off += sizeof(ent);
+		if(ent.namelen > batch->len - off || ent.size > batch->len - off - ent.namelen)
+			break;
+		off += ent.namelen + ent.size;
+	}
+}
+
+static int ofs_op_ioctl(const char *path, int cmd, void *arg, struct fuse_file_info *fi, unsigned int flags, void *data)
+{
+	struct ofs_clone_arg *clone;
+	struct ofs_move_arg *move;
+	struct ofs_batch_arg *batch;
+	uint64_t begin;
+
+	if(flags & FUSE_IOCTL_COMPAT)
+		return -ENOSYS;
+	OFS_VDENY(path);
+	switch((unsigned int)cmd) {
+	case OFS_IOC_CLONE:
+		clone = (struct ofs_clone_arg*)data;
+		clone->src[PATH_MAX - 1] = '\0';
+		OFS_VDENY(clone->src);
+		begin = ofs_op_lock(1);
+		ofs_wb_sync(clone->src);
+		ofs_wb_sync(path);
+		return ofs_op_done(OP_IOCTL, path, begin,
+			ofs_op_end(ofs_clonefile(clone->src, path), OJ_CLONE, clone->src, path, 0, 0, UINT64_MAX, NULL, 0));
+	case OFS_IOC_RMTREE:
+		begin = ofs_op_lock(1);
+		return ofs_op_done(OP_RMTREE, path, begin,
+			ofs_op_end(ofs_rmtree(path), OJ_RMTREE, path, NULL, 0, 0, 0, NULL, 0));
+	case OFS_IOC_MOVE:
+		move = (struct ofs_move_arg*)data;
+		move->dst[PATH_MAX - 1] = '\0';
+		OFS_VDENY(move->dst);
+		begin = ofs_op_lock(1);
+		ofs_wb_move(path);
+		return ofs_op_done(OP_MOVE, path, begin,
+			ofs_op_end(ofs_movetree(path, move->dst), OJ_MOVE, path, move->dst, 0, 0, 0, NULL, 0));
+	case OFS_IOC_BATCH:
+		batch = (struct ofs_batch_arg*)data;
+		if(batch->len > OFS_BATCH_SIZE)
+			batch->len = OFS_BATCH_SIZE;
+		ofs_batch_umask(batch);
+		begin = ofs_op_lock(1);
+		return ofs_op_done(OP_BATCH, path, begin,
+			ofs_op_end(ofs_batch(path, batch->buf, batch->len, batch->count), OJ_BATCH, path, NULL,
+				batch->count, 0, 0, batch->buf, batch->len));
+	default:
+		return -ENOTTY;
+	}
+}
+
+/* 사용량은 카운터에서 바로 읽는다 (트리를 돌지 않는다) */
+static int ofs_op_statfs(const char *path, struct statvfs *st)
+{
+	OQUSAGE u;
+	uint64_t total, files, begin = ofs_stats_begin();
+
+	ofs_quota_usage(ofs_context_uid(), ofs_context_gid(), &u);
+	total = u.limit_bytes;
+	if(total == 0)									// 크기 제한이 없으면 물리 메모리 크기
+		total = (uint64_t)sysconf(_SC_PHYS_PAGES) * sysconf(_SC_PAGESIZE);
+	if(total < u.bytes)
+		total = u.bytes;
+	memset(st, 0, sizeof(struct statvfs));
+	st -> f_bsize = st -> f_frsize = OFS_STATFS_BLOCK;
+	st -> f_blocks = total / OFS_STATFS_BLOCK;
+	st -> f_bfree = (total - u.bytes) / OFS_STATFS_BLOCK;
+	st -> f_bavail = (u.avail_bytes / OFS_STATFS_BLOCK < st -> f_bfree)? u.avail_bytes / OFS_STATFS_BLOCK : st -> f_bfree;
+	files = u.limit_inodes;
+	if(files == 0)									// 노드 수 제한이 없으면 남은 공간에 만들 수 있는 만큼
+		files = u.inodes + (total - u.bytes) / OFS_INODE_BYTES;
+	if(files < u.inodes)
+		files = u.inodes;
+	st -> f_files = files;
+	st -> f_ffree = files - u.inodes;
+	st -> f_favail = (u.avail_inodes < st -> f_ffree)? u.avail_inodes : st -> f_ffree;
+	st -> f_namemax = NAME_MAX - 1;						//이름 버퍼에 NULL 문자 포함
+	return ofs_stats_end(OP_STATFS, begin, 0);
+}
+
+/* 저널 레코드 재실행 - 기록 당시 사용자의 자격 증명으로 핸들러를 다시 호출한다 */
+static int ofs_replay(const OJREC *rec)
+{
+	struct timespec tv[2];
+	int ret;
+
+	ofs_setcontext(rec->uid, rec->gid);
+	switch(rec->type) {
+	case OJ_MKNOD:		ret = ofs_mknod(rec->path, rec->arg[0], rec->arg[1]); break;
+	case OJ_MKDIR:		ret = ofs_mkdir(rec->path, rec->arg[0]); break;
+	case OJ_UNLINK:		ret = ofs_unlink(rec->path); break;
+	case OJ_RMDIR:		ret = ofs_rmdir(rec->path); break;
+	case OJ_SYMLINK:	ret = ofs_symlink(rec->path, rec->path2); break;
+	case OJ_LINK:		ret = ofs_link(rec->path, rec->path2); break;
+	case OJ_RENAME:		ret = ofs_rename(rec->path, rec->path2); break;
+	case OJ_WRITE:		ret = ofs_write(rec->path, rec->data, rec->datalen, rec->arg[0], NULL); break;
+	case OJ_TRUNCATE:	ret = ofs_truncate(rec->path, rec->arg[0], rec->arg[1]); break;
+	case OJ_FALLOCATE:	ret = ofs_fallocate(rec->path, rec->arg[0], rec->arg[1], rec->arg[2]); break;
+	case OJ_CHMOD:		ret = ofs_chmod(rec->path, rec->arg[0]); break;
+	case OJ_CHOWN:		ret = ofs_chown(rec->path, rec->arg[0], rec->arg[1]); break;
+	case OJ_UTIME:
+		ofs_setcontext(0, 0);						// 권한은 기록 당시 이미 확인됨
+		tv[0].tv_sec = rec->arg[0];
+		tv[1].tv_sec = rec->arg[1];
+		tv[0].tv_nsec = rec->arg[2] >> 32;
+		tv[1].tv_nsec = rec->arg[2] & 0xffffffff;
+		ret = ofs_utimens(rec->path, tv);
+		break;
+	case OJ_CLONE:
+		if(rec->arg[2] == UINT64_MAX)				// ioctl 파일 전체 복제
+			ret = ofs_clonefile(rec->path, rec->path2);
+		else
+			ret = ofs_clone(rec->path, rec->arg[0], rec->path2, rec->arg[1], rec->arg[2]);
+		break;
+	case OJ_RMTREE:		ret = ofs_rmtree(rec->path); break;
+	case OJ_MOVE:		ret = ofs_movetree(rec->path, rec->path2); break;
+	case OJ_SETXATTR:
+		ret = ofs_setxattr(rec->path, rec->path2, rec->data, rec->datalen, (int)rec->arg[0]);
+		break;
+	case OJ_REMOVEXATTR:	ret = ofs_removexattr(rec->path, rec->path2); break;
+	case OJ_BATCH:		ret = ofs_batch(rec->path, rec->data, rec->datalen, (uint32_t)rec->arg[0]); break;
+	default:
+		ret = -EINVAL;
+	}
+	ofs_clearcontext();
+	if(ret < 0)
+		fprintf(stderr, "ofs: journal replay failed at lsn %llu (%d)\n", (unsigned long long)rec->lsn, ret);
+	return ret;
+}
+
+/* 트리 전체의 사용량을 다시 센다 (이미지를 읽은 뒤, 저널을 재실행하기 전) */
+static void ofs_quota_walk(ONODE *node, int typelink, OSTAT ***seen, size_t *nseen)
+{
+	ONODE *cur;
+	OSTAT *st = node -> of_stat;
+	size_t i;
+
+	if(ofs_istypedir(node))							// 타입 디렉토리와 그 안의 링크 (만들 때와 같은 기준)
+		typelink = 1;
+	ofs_quota_names(strlen(node -> name) + 1);
+	for(i = 0; i < *nseen && (*seen)[i] != st; i++);
+	if(i < *nseen) {								// 이미 센 파일의 하드 링크
+		ofs_quota_charge(st -> of_uid, st -> of_gid, typelink? OQ_TYPELINK : OQ_NODE, sizeof(ONODE), 0);
+	} else {
+		if(!S_ISDIR(st -> of_mode) && st -> of_nlink > 1) {
+			*seen = (OSTAT**)realloc(*seen, sizeof(OSTAT*) * (*nseen + 1));
+			(*seen)[(*nseen)++] = st;
+		}
+		ofs_quota_charge(st -> of_uid, st -> of_gid, typelink? OQ_TYPELINK : OQ_NODE, OFS_INODE_BYTES + ofs_xattr_size(st), 1);
+		ofs_quota_charge(st -> of_uid, st -> of_gid, typelink? OQ_TYPELINK : OQ_DATA, ofs_qused(node), 0);
+	}
+	for(cur = node -> subhead; cur != NULL; cur = cur -> nextnode)
+		ofs_quota_walk(cur, typelink, seen, nseen);
+}
+
+static void ofs_quota_rebuild(void)
+{
+	OSTAT **seen = NULL;
+	size_t nseen = 0;
+
+	ofs_quota_clear();
+	ofs_quota_walk(root, 0, &seen, &nseen);
+	free(seen);
+}
+
+/* 트리를 이미지로 저장하고 반영된 저널을 비운다 */
+static void ofs_checkpoint(void)
+{
+	uint64_t lsn;
+
+	pthread_rwlock_rdlock(&ofs_tree_lock);
+	lsn = ofs_journal_lsn();
+	if(ofs_savetree(root, ofs_image_path, lsn) == 0)
+		ofs_journal_checkpointed(lsn);
+	else
+		perror("ofs checkpoint");
+	pthread_rwlock_unlock(&ofs_tree_lock);
+}
+
+/* 이미지를 읽고 그 이후의 저널을 재실행한다 */
+static int ofs_recover(void)
+{
+	uint64_t lsn = 0;
+	int ret;
+
+	ofs_image_path = (char*)malloc(strlen(conf.journal) + 5);
+	strcpy(ofs_image_path, conf.journal);
+	strcat(ofs_image_path, ".img");
+
+	root = ofs_loadtree(ofs_image_path, &lsn);
+	if(root == NULL)
+		root = ofs_neONODE("/", S_IFDIR | 0755, getuid(), getgid());
+	ofs_quota_rebuild();
+
+	if((ret = ofs_journal_open(conf.journal, conf.journal_commit, (off_t)conf.journal_checkpoint << 20)) != 0) {
+		fprintf(stderr, "ofs: cannot open journal %s: %s\n", conf.journal, strerror(-ret));
+		return ret;
+	}
+	ofs_journal_setlsn(lsn);
+	ofs_quota_enforce(0);								// 기록 당시 통과한 연산은 한도가 바뀌어도 재실행한다
+	ret = ofs_journal_replay(lsn, ofs_replay);
+	ofs_quota_enforce(1);
+	if(ret < 0)
+		return ret;
+	if(ret > 0)										// 재실행한 내용을 바로 이미지로 옮긴다
+		ofs_checkpoint();
+	return 0;
+}
+
+/*
+ * 디렉토리 가져오기 (-o import=PATH)
+ * 마운트 전에 로컬 디렉토리 트리를 읽어 메모리 트리를 바로 만든다. 디렉토리 하나가 작업 하나이고,
+ * 여러 스레드(import_threads)가 작업을 나누어 자식 노드를 만들고 파일 내용을 청크 단위로 읽는다.
+ * 스레드마다 자기 디렉토리에만 노드를 넣으므로 트리 잠금이 필요 없다. 타입 디렉토리는 모든
+ * 디렉토리를 읽은 뒤 디렉토리마다 한번에 정리한다 (확장자마다 한번 찾고 링크는 경로 탐색 없이 넣는다).
+ * 저널에는 남기지 않고 끝난 뒤 체크포인트를 만들며, 사용량은 트리를 다시 세어 맞춘다.
+ */
+typedef struct _OIMPJOB {
+	char			*src;				// 로컬 디렉토리 경로
+	char			*path;				// OFS 안의 경로
+	ONODE		*dir;
+	struct _OIMPJOB	*next;
+} OIMPJOB;
+
+/* 하드 링크로 묶을 원본 파일 (드물기 때문에 선형 검색) */
+typedef struct _OIMPLINK {
+	dev_t		dev;
+	ino_t		ino;
+	ONODE		*node;				// 처음 만든 노드, 나머지는 이 정보를 공유한다
+} OIMPLINK;
+
+/* 디렉토리 하나에서 찾은 타입 디렉토리 */
+typedef struct _OIMPTYPE {
+	char			*name;				// 타입 디렉토리 이름 (_확장자)
+	ONODE		*dir;				// 만들 수 없으면 NULL
+	int			fresh;				// 이번에 새로 만듦
+} OIMPTYPE;
+
+static struct {
+	OIMPJOB		*queue;				// 읽을 디렉토리
+	OIMPJOB		*done;				// 타입 디렉토리를 정리할 디렉토리
+	int			pending;				// 큐에 있거나 읽는 중인 작업 수
+	OIMPLINK		*link;
+	size_t		nlink;
+	uint64_t		dirs, files, bytes, skipped, errors;
+	pthread_mutex_t	lock;
+	pthread_cond_t	wait;
+} ofs_imp = { .lock = PTHREAD_MUTEX_INITIALIZER, .wait = PTHREAD_COND_INITIALIZER };
+
+static char* ofs_import_join(const char *dir, const char *name)
+{
+	size_t len = strlen(dir);
+	char *path = (char*)malloc(len + strlen(name) + 2);
+
+	strcpy(path, dir);
+	if(len == 0 || dir[len - 1] != '/')
+		strcat(path, "/");
+	strcat(path, name);
+	return path;
+}
+
+static void ofs_import_push(const char *src, const char *path, ONODE *dir)
+{
+	OIMPJOB *job = (OIMPJOB*)malloc(sizeof(OIMPJOB));
+
+	job -> src = strdup(src);
+	job -> path = strdup(path);
+	job -> dir = dir;
+	pthread_mutex_lock(&ofs_imp.lock);
+	job -> next = ofs_imp.queue;						// 깊이 우선으로 꺼내 큐가 커지지 않게 한다
+	ofs_imp.queue = job;
+	ofs_imp.pending++;
+	pthread_cond_signal(&ofs_imp.wait);
+	pthread_mutex_unlock(&ofs_imp.lock);
+}
+
+static void ofs_import_count(uint64_t *counter, uint64_t n)
+{
+	__atomic_add_fetch(counter, n, __ATOMIC_RELAXED);
+}
+
+/* 이미 가져온 하드 링크면 그 노드를, 처음이면 NODE를 등록하고 NULL을 돌려준다 */
+static ONODE* ofs_import_link(const struct stat *st, ONODE *node)
+{
+	ONODE *first = NULL;
+	size_t i;
+
+	pthread_mutex_lock(&ofs_imp.lock);
+	for(i = 0; i < ofs_imp.nlink; i++) {
+		if(ofs_imp.link[i].dev == st -> st_dev && ofs_imp.link[i].ino == st -> st_ino) {
+			first = ofs_imp.link[i].node;
+			break;
+		}
+	}
+	if(first == NULL) {
+		if(S_ISREG(st -> st_mode))						// 다른 스레드가 나머지 링크에 공유할 데이터를 먼저 만든다
+			node -> of_data = ofs_data_new();
+		ofs_imp.link = (OIMPLINK*)realloc(ofs_imp.link, sizeof(OIMPLINK) * (ofs_imp.nlink + 1));
+		ofs_imp.link[ofs_imp.nlink].dev = st -> st_dev;
+		ofs_imp.link[ofs_imp.nlink].ino = st -> st_ino;
+		ofs_imp.link[ofs_imp.nlink].node = node;
+		ofs_imp.nlink++;
+	} else {
+		first -> of_stat -> of_nlink++;					// 가져온 트리 안의 링크만 센다
+	}
+	pthread_mutex_unlock(&ofs_imp.lock);
+	return first;
+}
+
+/* 하드 링크로 나중에 만든 노드인지 (타입 링크는 처음 이름에만 있다) */
+static int ofs_import_islink(ONODE *node)
+{
+	size_t i;
+
+	if(S_ISDIR(node -> of_stat -> of_mode) || node -> of_stat -> of_nlink < 2)
+		return 0;
+	for(i = 0; i < ofs_imp.nlink; i++)
+		if(ofs_imp.link[i].node -> of_stat == node -> of_stat)
+			return ofs_imp.link[i].node != node;
+	return 0;
+}
+
+/* DIR 바로 아래의 NAME 항목 (ofs_findnode는 이름이 아니라 경로를 받는다) */
+static ONODE* ofs_import_child(ONODE *dir, const char *name)
+{
+	ONODE *cur;
+
+	for(cur = dir -> subhead; cur != NULL; cur = cur -> nextnode)
+		if(strcmp(cur -> name, name) == 0) break;
+	return cur;
+}
+
+/* 일반 파일 내용을 청크 단위로 읽어 넣는다, 청크 크기로 써서 버퍼를 다시 할당하지 않는다 */
+static int ofs_import_data(int dirfd, const char *name, ONODE *node, char *buf)
+{
+	uint64_t begin = ofs_stats_begin();
+	off_t off = 0;
+	ssize_t n;
+	int fd, ret = 0;
+
+	if((fd = openat(dirfd, name, O_RDONLY | O_NOFOLLOW)) < 0)
+		return ofs_stats_end(OP_IMPORT, begin, -errno);
+	if(node -> of_data == NULL)						// 하드 링크는 ofs_import_link에서 만들었다
+		node -> of_data = ofs_data_new();
+	while((n = pread(fd, buf, OFS_CHUNK_SIZE, off)) != 0) {
+		if(n < 0) {
+			if(errno == EINTR) continue;
+			ret = -errno;
+			break;
+		}
+		if((ret = ofs_data_write(node -> of_data, buf, n, off)) != 0)
+			break;
+		off += n;
+	}
+	close(fd);
+	node -> of_stat -> of_size = off;
+	ofs_data_seal(node -> of_data);
+	ofs_import_count(&ofs_imp.bytes, off);
+	return ofs_stats_end(OP_IMPORT, begin, ret);
+}
+
+/* 디렉토리 하나의 항목을 노드로 만든다, 하위 디렉토리는 큐에 넣는다 */
+static void ofs_import_dir(OIMPJOB *job, char *buf)
+{
+	DIR *dp;
+	struct dirent *de;
+	struct stat st;
+	ONODE *node, *first;
+	char *src, *path;
+	ssize_t n;
+	int ret;
+
+	if((dp = opendir(job -> src)) == NULL) {
+		fprintf(stderr, "ofs: import %s: %s\n", job -> src, strerror(errno));
+		ofs_import_count(&ofs_imp.errors, 1);
+		return;
+	}
+	while((de = readdir(dp)) != NULL) {
+		if(strcmp(de -> d_name, ".") == 0 || strcmp(de -> d_name, "..") == 0)
+			continue;
+		path = ofs_import_join(job -> path, de -> d_name);
+		if(*(de -> d_name) == '_' || strlen(de -> d_name) >= NAME_MAX
+			|| ofs_check_path_len(path) != 0) {			// 타입 디렉토리 이름이나 담을 수 없는 이름
+			ofs_import_count(&ofs_imp.skipped, 1);
+			free(path);
+			continue;
+		}
+		if(fstatat(dirfd(dp), de -> d_name, &st, AT_SYMLINK_NOFOLLOW) < 0) {
+			fprintf(stderr, "ofs: import %s/%s: %s\n", job -> src, de -> d_name, strerror(errno));
+			ofs_import_count(&ofs_imp.errors, 1);
+			free(path);
+			continue;
+		}
+
+		/* 노드 생성 - 원본의 모드, 소유자, 시각을 그대로 옮긴다 */
+		node = ofs_neONODE(de -> d_name, st.st_mode, st.st_uid, st.st_gid);
+		node -> of_stat -> of_rdev = (S_ISBLK(st.st_mode) || S_ISCHR(st.st_mode))? st.st_rdev : 0;
+		first = (!S_ISDIR(st.st_mode) && st.st_nlink > 1)? ofs_import_link(&st, node) : NULL;
+		if(first != NULL) {							// 하드 링크는 처음 노드의 정보와 데이터를 공유
+			free(node -> of_stat);
+			node -> of_stat = first -> of_stat;
+			node -> of_data = first -> of_data;
+			ofs_insertnode(job -> dir, node);
+			free(path);
+			continue;
+		}
+		node -> of_stat -> of_atime = st.st_atim;
+		node -> of_stat -> of_mtime = st.st_mtim;
+		node -> of_stat -> of_ctime = st.st_ctim;
+		if(S_ISDIR(st.st_mode)) {
+			job -> dir -> of_stat -> of_nlink++;			//부모 디렉토리의 링크 수 증가
+			ofs_import_count(&ofs_imp.dirs, 1);
+		} else if(S_ISREG(st.st_mode)) {
+			if((ret = ofs_import_data(dirfd(dp), de -> d_name, node, buf)) != 0) {
+				fprintf(stderr, "ofs: import %s/%s: %s\n", job -> src, de -> d_name, strerror(-ret));
+				ofs_import_count(&ofs_imp.errors, 1);
+			}
+			ofs_import_count(&ofs_imp.files, 1);
+		} else if(S_ISLNK(st.st_mode)) {
+			if((n = readlinkat(dirfd(dp), de -> d_name, buf, PATH_MAX - 1)) >= 0) {
+				buf[n] = '\0';
+				ofs_setdata(node, buf, n + 1, 0);			//심볼릭 링크와 같이 이름을 저장
+			}
+			ofs_import_count(&ofs_imp.files, 1);
+		} else {
+			ofs_import_count(&ofs_imp.files, 1);
+		}
+		/* 노드를 다 채우고 넣은 뒤에야 하위 디렉토리를 다른 스레드에 넘긴다 */
+		ofs_insertnode(job -> dir, node);
+		if(S_ISDIR(st.st_mode)) {
+			src = ofs_import_join(job -> src, de -> d_name);
+			ofs_import_push(src, path, node);
+			free(src);
+		}
+		free(path);
+	}
+	closedir(dp);
+}
+
+static void* ofs_import_worker(void *arg)
+{
+	char *buf = (char*)malloc(OFS_CHUNK_SIZE);		// 파일 청크와 심볼릭 링크 읽기 버퍼
+	OIMPJOB *job;
+	(void)arg;
+
+	pthread_mutex_lock(&ofs_imp.lock);
+	while(1) {
+		while(ofs_imp.queue == NULL && ofs_imp.pending > 0)
+			pthread_cond_wait(&ofs_imp.wait, &ofs_imp.lock);
+		if((job = ofs_imp.queue) == NULL)				// 남은 작업이 없다
+			break;
+		ofs_imp.queue = job -> next;
+		pthread_mutex_unlock(&ofs_imp.lock);
+
+		ofs_import_dir(job, buf);
+
+		pthread_mutex_lock(&ofs_imp.lock);
+		job -> next = ofs_imp.done;
+		ofs_imp.done = job;
+		if(--ofs_imp.pending == 0)
+			pthread_cond_broadcast(&ofs_imp.wait);
+	}
+	pthread_mutex_unlock(&ofs_imp.lock);
+	free(buf);
+	return NULL;
+}
+
+/* 디렉토리의 타입 링크를 한번에 만든다 (ofs_addtypelink와 같은 위치와 내용) */
+static void ofs_import_typelinks(OIMPJOB *job)
+{
+	OIMPTYPE *tab = NULL;
+	size_t cnt = 0, i;
+	ONODE *cur, *link;
+	char *typedir_name, *typedir_path, *old_path;
+
+	ofs_qtypelink++;
+	for(cur = job -> dir -> subhead; cur != NULL; cur = cur -> nextnode) {
+		if(S_ISDIR(cur -> of_stat -> of_mode) || S_ISLNK(cur -> of_stat -> of_mode)
+			|| ofs_extension(cur -> name) == NULL || ofs_import_islink(cur))
+			continue;
+
+		/* 확장자마다 타입 디렉토리를 한번만 찾거나 만든다 */
+		typedir_name = ofs_typedirname(cur -> name);
+		for(i = 0; i < cnt && strcmp(tab[i].name, typedir_name) != 0; i++);
+		if(i == cnt) {
+			tab = (OIMPTYPE*)realloc(tab, sizeof(OIMPTYPE) * (cnt + 1));
+			tab[i].name = typedir_name;
+			typedir_path = (char*)malloc(strlen(job -> path) + strlen(typedir_name) + 1);
+			strcpy(typedir_path, job -> path);
+			strcat(typedir_path, typedir_name);
+			tab[i].fresh = (ofs_findnode(root, typedir_path) == NULL);
+			if(tab[i].fresh)
+				ofs_newtypedir(typedir_path);
+			tab[i].dir = ofs_findnode(root, typedir_path);
+			if(tab[i].dir != NULL && !ofs_istypedir(tab[i].dir))
+				tab[i].dir = NULL;						// 이름이 같은 사용자 디렉토리
+			free(typedir_path);
+			cnt++;
+		} else {
+			free(typedir_name);
+		}
+		/* 새로 만든 타입 디렉토리에는 같은 이름이 있을 수 없으므로 찾지 않고 넣는다 */
+		if(tab[i].dir == NULL || (!tab[i].fresh && ofs_import_child(tab[i].dir, cur -> name) != NULL))
+			continue;
+		old_path = (char*)malloc(3 + strlen(cur -> name) + 1);
+		strcpy(old_path, "../");
+		strcat(old_path, cur -> name);
+		link = ofs_neONODE(cur -> name, S_IFLNK | 0777, getuid(), getgid());	// 마운트 전이라 요청 정보가 없다
+		ofs_setdata(link, old_path, strlen(old_path) + 1, 0);
+		ofs_insertnode(tab[i].dir, link);
+		free(old_path);
+	}
+	for(i = 0; i < cnt; i++)
+		free(tab[i].name);
+	free(tab);
+	ofs_qtypelink--;
+}
+
+/* 로컬 디렉토리를 루트로 가져온다 */
+static int ofs_import(const char *src, int nthread)
+{
+	struct timespec t0, t1;
+	pthread_t *tid;
+	OIMPJOB *job;
+	int i, n = 0;
+
+	if(root -> subhead != NULL) {					// 복구한 트리 위에는 덮어쓰지 않는다
+		fprintf(stderr, "ofs: import %s skipped, file system is not empty\n", src);
+		return 0;
+	}
+	if(access(src, R_OK | X_OK) != 0) {
+		fprintf(stderr, "ofs: cannot import %s: %s\n", src, strerror(errno));
+		return -errno;
+	}
+	if(nthread <= 0)
+		nthread = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	if(nthread <= 0)
+		nthread = 1;
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+
+	/* 디렉토리 읽기 */
+	ofs_import_push(src, "/", root);
+	tid = (pthread_t*)malloc(sizeof(pthread_t) * nthread);
+	for(i = 0; i < nthread; i++)
+		if(pthread_create(&tid[n], NULL, ofs_import_worker, NULL) == 0)
+			n++;
+	if(n == 0)										// 스레드를 못 만들면 직접 읽는다
+		ofs_import_worker(NULL);
+	for(i = 0; i < n; i++)
+		pthread_join(tid[i], NULL);
+	free(tid);
+
+	/* 타입 디렉토리 정리 */
+	while((job = ofs_imp.done) != NULL) {
+		ofs_imp.done = job -> next;
+		ofs_import_typelinks(job);
+		free(job -> src);
+		free(job -> path);
+		free(job);
+	}
+	free(ofs_imp.link);
+	ofs_imp.link = NULL;
+	ofs_imp.nlink = 0;
+
+	ofs_quota_rebuild();
+	if(ofs_journal_enabled())						// 가져온 트리는 저널 대신 이미지로 남긴다
+		ofs_checkpoint();
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	fprintf(stderr, "ofs: imported %llu dirs, %llu files, %llu bytes from %s in %.2f s (%d threads)",
+		(unsigned long long)ofs_imp.dirs, (unsigned long long)ofs_imp.files,
+		(unsigned long long)ofs_imp.bytes, src,
+		(t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9, (n > 0)? n : 1);
+	if(ofs_imp.skipped > 0 || ofs_imp.errors > 0)
+		fprintf(stderr, ", %llu skipped, %llu errors",
+			(unsigned long long)ofs_imp.skipped, (unsigned long long)ofs_imp.errors);
+	fprintf(stderr, "\n");
+	return 0;
+}
+
+/* 확장자별 압축 통계 */
+typedef struct _OZSTAT {
+	char		ext[NAME_MAX];
+	uint64_t	files;
+	uint64_t	logical;
+	uint64_t	stored;
+	uint64_t	zreads;
+	uint64_t	zns;
+} OZSTAT;
+
+static void ofs_zstat_walk(ONODE *dir, OZSTAT **tab, size_t *cnt)
+{
+	ONODE *cur;
+	OZSTAT *ent;
+	char *ext;
+	uint64_t stored, zreads, zns;
+	size_t i;
+
+	for(cur = dir->subhead; cur != NULL; cur = cur->nextnode) {
+		if(S_ISDIR(cur->of_stat->of_mode)) {
+			if(*(cur->name) != '_')				// 타입 디렉토리에는 심볼릭 링크만 있다
+				ofs_zstat_walk(cur, tab, cnt);
+			continue;
+		}
+		if(!S_ISREG(cur->of_stat->of_mode) || cur->of_data == NULL)
+			continue;
+		ext = ofs_extension(cur->name);
+		if(ext == NULL) ext = "";
+		for(i = 0; i < *cnt && strcmp((*tab)[i].ext, ext) != 0; i++);
+		if(i == *cnt) {
+			*tab = (OZSTAT*)realloc(*tab, sizeof(OZSTAT) * (*cnt + 1));
+			memset(&(*tab)[i], 0, sizeof(OZSTAT));
+			strcpy((*tab)[i].ext, ext);
+			(*cnt)++;
+		}
+		ent = &(*tab)[i];
+		ofs_data_usage(cur->of_data, &stored, &zreads, &zns);
+		ent->files++;
+		ent->logical += cur->of_stat->of_size;
+		ent->stored += stored;
+		ent->zreads += zreads;
+		ent->zns += zns;
+	}
+}
+
+/* 확장자별 압축률과 압축 해제 지연 출력 */
+static void ofs_compress_report(FILE *fp)
+{
+	OZSTAT *tab = NULL;
+	size_t cnt = 0, i;
+
+	pthread_rwlock_rdlock(&ofs_tree_lock);
+	ofs_zstat_walk(root, &tab, &cnt);
+	pthread_rwlock_unlock(&ofs_tree_lock);
+
+	fprintf(fp, "%-12s %10s %14s %14s %7s %10s %12s\n",
+		"type", "files", "bytes", "stored", "ratio", "inflates", "avg_us");
+	for(i = 0; i < cnt; i++) {
+		fprintf(fp, "%-12s %10llu %14llu %14llu %7.2f %10llu %12.1f\n",
+			(*tab[i].ext)? tab[i].ext : "(none)",
+			(unsigned long long)tab[i].files, (unsigned long long)tab[i].logical,
+			(unsigned long long)tab[i].stored,
+			(tab[i].stored > 0)? (double)tab[i].logical / tab[i].stored : 1.0,
+			(unsigned long long)tab[i].zreads,
+			(tab[i].zreads > 0)? tab[i].zns / 1000.0 / tab[i].zreads : 0.0);
+	}
+	free(tab);
+}
+
+/* 중복 제거율과 해시 비용 출력 */
+static void ofs_dedup_report(FILE *fp)
+{
+	OZSTAT *tab = NULL;
+	size_t cnt = 0, i;
+	uint64_t logical = 0, hits, saved, hashed, ns;
+
+	pthread_rwlock_rdlock(&ofs_tree_lock);
+	ofs_zstat_walk(root, &tab, &cnt);
+	pthread_rwlock_unlock(&ofs_tree_lock);
+	for(i = 0; i < cnt; i++)
+		logical += tab[i].logical;
+	free(tab);
+
+	ofs_data_dedup_stats(&hits, &saved, &hashed, &ns);
+	fprintf(fp, "dedup: %llu shared chunks, %llu bytes saved, ratio %.2f, hashed %llu bytes in %.1f ms (%.0f MB/s)\n",
+		(unsigned long long)hits, (unsigned long long)saved,
+		(logical > saved)? (double)logical / (logical - saved) : 1.0,
+		(unsigned long long)hashed, ns / 1e6,
+		(ns > 0)? hashed / (ns / 1e9) / (1 << 20) : 0.0);
+}
+
+/* 체크섬 검사 횟수와 불일치 출력 */
+static void ofs_checksum_report(FILE *fp)
+{
+	uint64_t verified, rbad, scrubbed, sbad, passes;
+
+	ofs_data_checksum_stats(&verified, &rbad, &scrubbed, &sbad, &passes);
+	fprintf(fp, "checksum: %llu reads verified, %llu read mismatches, %llu chunks scrubbed in %llu passes, %llu scrub mismatches\n",
+		(unsigned long long)verified, (unsigned long long)rbad,
+		(unsigned long long)scrubbed, (unsigned long long)passes, (unsigned long long)sbad);
+}
+
+static void *ofs_init(struct fuse_conn_info *conn, struct fuse_config *cfg)
+{
+	(void)conn;
+	(void)cfg;
+	ofs_journal_start(ofs_checkpoint);					// 데몬화 이후에 커밋 스레드를 만든다
+	ofs_data_start();
+	ofs_reap.async = 1;								// 정리 스레드는 처음 지울 때 만든다
+	return NULL;
+}
+
+static void ofs_destroy(void *data)
+{
+	(void)data;
+	if(conf.compress > 0)
+		ofs_compress_report(stderr);
+	if(conf.dedup)
+		ofs_dedup_report(stderr);
+	if(conf.checksum)
+		ofs_checksum_report(stderr);
+	ofs_export_wait();
+	ofs_reap_stop();
+	ofs_journal_close();
+	ofs_data_stop();
+}
+
+static struct fuse_operations ofs_oper = {
+	.init = ofs_init,
+	.destroy = ofs_destroy,
+	.access = ofs_op_access,
+	.getattr = ofs_op_getattr,
+	.readdir	= ofs_op_readdir,
+	.mknod = ofs_op_mknod,
+	.open = ofs_op_open,
+	.read	= ofs_op_read,
+	.write = ofs_op_write,
+	.unlink = ofs_op_unlink,
+	.readlink = ofs_op_readlink,
+	.mkdir = ofs_op_mkdir,
+	.rmdir = ofs_op_rmdir,
+	.utimens = ofs_op_utimens,
+	.symlink = ofs_op_symlink,
+	.link = ofs_op_link,
+	.chmod = ofs_op_chmod,
+	.chown = ofs_op_chown,
+	.truncate = ofs_op_truncate,
+	.fallocate = ofs_op_fallocate,
+	.rename = ofs_op_rename,
+	.opendir = ofs_op_opendir,
+	.release = ofs_op_release,
+	.flush = ofs_op_flush,
+	.fsync = ofs_op_fsync,
+	.poll = ofs_op_poll,
+	.copy_file_range = ofs_op_copy_file_range,
+	.ioctl = ofs_op_ioctl,
+	.statfs = ofs_op_statfs,
+	.setxattr = ofs_op_setxattr,
+	.getxattr = ofs_op_getxattr,
+	.listxattr = ofs_op_listxattr,
+	.removexattr = ofs_op_removexattr,
+};
+
+/* 마운트 옵션을 읽고 데이터 저장소와 트리를 준비한다 */
+static int ofs_setup(struct fuse_args *args)
+{
+	int ret;
+
+	conf.journal_commit = 0;
+	conf.journal_checkpoint = 64;
+	conf.compress_age = 30;
+	conf.compress_cache = 16;
+	conf.checksum_verify = 64;
+	conf.scrub = 16;
+	conf.cred_ttl = 1000;
+	if(fuse_opt_parse(args, &conf, ofs_opts, NULL) == -1)
+		return -EINVAL;
+	if((ret = ofs_data_init(conf.spill, (size_t)conf.mem_budget << 20)) != 0) {
+		fprintf(stderr, "ofs: cannot open spill file: %s\n", strerror(-ret));
+		return ret;
+	}
+	ofs_data_compress(conf.compress, conf.compress_age, (size_t)conf.compress_cache << 20);
+	ofs_data_dedup(conf.dedup);
+	ofs_data_huge((size_t)conf.huge_file << 20);
+	ofs_cred_init(conf.cred_ttl);
+	if(conf.checksum)
+		ofs_data_checksum(conf.checksum_verify, (size_t)conf.scrub << 20);
+	if(conf.stats)
+		ofs_stats_enable();
+	if(ofs_trace_init(conf.trace, conf.trace_size) != 0) {
+		fprintf(stderr, "ofs: unknown trace level %s\n", conf.trace);
+		return -EINVAL;
+	}
+
+	ofs_changelog_init(conf.changelog);
+	ofs_quota_init((uint64_t)conf.size << 20, conf.inodes, (uint64_t)conf.user_quota << 20, conf.user_inodes,
+		(uint64_t)conf.group_quota << 20, conf.group_inodes);
+
+	if(conf.journal != NULL) {
+		if((ret = ofs_recover()) != 0)
+			return ret;
+	} else {
+		root = ofs_neONODE("/", S_IFDIR | 0755, getuid(), getgid());
+		ofs_quota_rebuild();
+	}
+	if(conf.import != NULL && (ret = ofs_import(conf.import, conf.import_threads)) != 0)
+		return ret;
+	if(conf.index)									// 가져오거나 복구한 트리로 만든다
+		ofs_index_build(root);
+	if(conf.tags)
+		ofs_xattr_build(root);
+	return 0;
+}
+
+#ifdef OFS_BENCH
+/* 벤치마크 빌드(bench.c)는 마운트 없이 핸들러를 직접 호출한다 */
+const struct fuse_operations *ofs_bench_setup(int argc, char *argv[])
+{
+	struct fuse_args args = FUSE_ARGS_INIT(argc, argv);
+	int ret;
+
+	ret = ofs_setup(&args);
+	fuse_opt_free_args(&args);
+	return (ret == 0)? &ofs_oper : NULL;
+}
+#else
+int main(int argc, char *argv[]) 
+{
+	int ret;
+	struct fuse_args args = FUSE_ARGS_INIT(argc, argv);
+
+	if(ofs_setup(&args) != 0)
+		return 1;
+	ret = fuse_main(args.argc, args.argv, &ofs_oper, NULL);
+	fuse_opt_free_args(&args);
+	return ret;
+}
+#endif
@@ -0,0 +1,54 @@
+﻿#ifndef __OFS_IOCTL_H
+#define __OFS_IOCTL_H
+#include <sys/ioctl.h>
+#include <limits.h>
+#include <stdint.h>
+
+/*
+ * OFS 전용 ioctl
+ * 커널은 FICLONE을 FUSE로 넘기지 않으므로 같은 기능을 별도 번호로 제공한다.
+ * 경로는 마운트 지점 기준의 절대 경로("/dir/file")로 넘긴다.
+ */
+#define OFS_IOC_MAGIC		'O'
+
+struct ofs_clone_arg {
+	char		src[PATH_MAX];		// 복제할 원본 파일
+};
+
+struct ofs_move_arg {
+	char		dst[PATH_MAX];		// 항목을 옮길 디렉토리
+};
+
+/*
+ * 묶음 만들기 항목 : 헤더 뒤에 이름(namelen 바이트, '\0' 없음)과 내용(size 바이트)이
+ * 정렬 없이 이어지고 바로 다음 항목이 온다. mode의 종류는 0 또는 S_IFREG만 쓸 수 있다.
+ */
+struct ofs_batch_ent {
+	uint32_t	mode;
+	uint32_t	size;
+	uint32_t	namelen;
+};
+
+#define OFS_BATCH_SIZE		16368		// ioctl 인자는 16KB 미만이어야 한다
+
+struct ofs_batch_arg {
+	uint32_t	count;				// 항목 수
+	uint32_t	len;					// buf에 채운 바이트
+	char		buf[OFS_BATCH_SIZE];
+};
+
+/* ioctl을 호출한 파일의 내용을 원본 파일의 내용으로 바꾼다 (데이터 청크는 공유) */
+#define OFS_IOC_CLONE		_IOW(OFS_IOC_MAGIC, 1, struct ofs_clone_arg)
+
+/* ioctl을 호출한 디렉토리를 서브트리째 지운다, 이름은 바로 사라지고 해제는 뒤에서 한다
+   rm -rf와 같은 권한이 필요하고 하나라도 지울 수 없으면 아무것도 지우지 않는다
+   (권한 확인은 서브트리 전체를 돌며 그동안 다른 연산은 기다린다) */
+#define OFS_IOC_RMTREE		_IO(OFS_IOC_MAGIC, 2)
+
+/* ioctl을 호출한 디렉토리의 항목을 모두 dst 디렉토리로 옮긴다 (mv dir/<모두> dst/) */
+#define OFS_IOC_MOVE		_IOW(OFS_IOC_MAGIC, 3, struct ofs_move_arg)
+
+/* ioctl을 호출한 디렉토리에 파일을 한번에 만든다, 하나라도 만들 수 없으면 아무것도 만들지 않는다 */
+#define OFS_IOC_BATCH		_IOW(OFS_IOC_MAGIC, 4, struct ofs_batch_arg)
+
+#endif
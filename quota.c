@@ -0,0 +1,257 @@
+﻿#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include "quota.h"
+
+#define OQ_HASH		256
+
+/* 사용자 또는 그룹 하나의 사용량과 한도 */
+typedef struct _OQENT {
+	uint32_t			id;
+	int				group;			// 1이면 그룹
+	int64_t			bytes;
+	int64_t			inodes;
+	int				set;				// 한도를 따로 지정함, 아니면 기본 한도
+	uint64_t			limit_bytes;
+	uint64_t			limit_inodes;
+	struct _OQENT		*next;
+} OQENT;
+
+static const char *kind_names[OQ_NUM] = { "data", "nodes", "typelinks" };
+
+static OQENT 			*qtab[OQ_HASH];
+static int64_t 			used[OQ_NUM];				// 종류별 바이트
+static int64_t 			names;						// 이름 길이 합계 (nodes에 포함)
+static int64_t 			ninodes;
+static uint64_t 			lim_bytes, lim_inodes;		// 파일 시스템 한도
+static uint64_t 			def_limit[2][2];				// [사용자/그룹][바이트/노드 수] 기본 한도
+static int 				enforce = 1;
+static pthread_mutex_t	qlock = PTHREAD_MUTEX_INITIALIZER;
+
+/* 사용자/그룹 항목 찾기, make면 없을 때 만든다 (qlock 안에서 호출) */
+static OQENT* oq_find(int group, uint32_t id, int make)
+{
+	OQENT *e;
+	size_t h = (id * 2 + group) % OQ_HASH;
+
+	for(e = qtab[h]; e != NULL; e = e->next)
+		if(e->id == id && e->group == group) return e;
+	if(!make || (e = (OQENT*)calloc(1, sizeof(OQENT))) == NULL)
+		return NULL;
+	e->id = id;
+	e->group = group;
+	e->next = qtab[h];
+	qtab[h] = e;
+	return e;
+}
+
+static uint64_t oq_limit(OQENT *e, int group, int which)
+{
+	if(e != NULL && e->set)
+		return which? e->limit_inodes : e->limit_bytes;
+	return def_limit[group][which];
+}
+
+/* 항목에 BYTES, INODES를 더하면 한도를 넘는지 */
+static int oq_over(OQENT *e, int group, uint64_t bytes, uint64_t inodes)
+{
+	uint64_t lb = oq_limit(e, group, 0), li = oq_limit(e, group, 1);
+
+	if(bytes > 0 && lb != 0 && (e? e->bytes : 0) + bytes > lb) return 1;
+	if(inodes > 0 && li != 0 && (e? e->inodes : 0) + inodes > li) return 1;
+	return 0;
+}
+
+/* 한도까지 남은 양, 한도가 없으면 UINT64_MAX */
+static uint64_t oq_left(uint64_t limit, int64_t use)
+{
+	if(limit == 0) return UINT64_MAX;
+	return ((uint64_t)use >= limit)? 0 : limit - use;
+}
+
+static uint64_t oq_min(uint64_t a, uint64_t b)
+{
+	return (a < b)? a : b;
+}
+
+void ofs_quota_init(uint64_t bytes, uint64_t inodes, uint64_t ubytes, uint64_t uinodes, uint64_t gbytes, uint64_t ginodes)
+{
+	pthread_mutex_lock(&qlock);
+	lim_bytes = bytes;
+	lim_inodes = inodes;
+	def_limit[0][0] = ubytes;
+	def_limit[0][1] = uinodes;
+	def_limit[1][0] = gbytes;
+	def_limit[1][1] = ginodes;
+	pthread_mutex_unlock(&qlock);
+}
+
+void ofs_quota_enforce(int enable)
+{
+	pthread_mutex_lock(&qlock);
+	enforce = enable;
+	pthread_mutex_unlock(&qlock);
+}
+
+int ofs_quota_check(uid_t uid, gid_t gid, uint64_t bytes, uint64_t inodes)
+{
+	int ret = 0;
+
+	pthread_mutex_lock(&qlock);
+	if(enforce) {
+		if((bytes > 0 && lim_bytes != 0 && used[OQ_DATA] + used[OQ_NODE] + used[OQ_TYPELINK] + bytes > lim_bytes)
+			|| (inodes > 0 && lim_inodes != 0 && ninodes + inodes > lim_inodes))
+			ret = -ENOSPC;
+		else if(uid != 0 && (oq_over(oq_find(0, uid, 0), 0, bytes, inodes)
+			|| oq_over(oq_find(1, gid, 0), 1, bytes, inodes)))
+			ret = -EDQUOT;
+	}
+	pthread_mutex_unlock(&qlock);
+	return ret;
+}
+
+void ofs_quota_charge(uid_t uid, gid_t gid, int kind, int64_t bytes, int64_t inodes)
+{
+	OQENT *e;
+
+	pthread_mutex_lock(&qlock);
+	used[kind] += bytes;
+	ninodes += inodes;
+	if((e = oq_find(0, uid, 1)) != NULL) {
+		e->bytes += bytes;
+		e->inodes += inodes;
+	}
+	if((e = oq_find(1, gid, 1)) != NULL) {
+		e->bytes += bytes;
+		e->inodes += inodes;
+	}
+	pthread_mutex_unlock(&qlock);
+}
+
+void ofs_quota_names(int64_t bytes)
+{
+	pthread_mutex_lock(&qlock);
+	names += bytes;
+	pthread_mutex_unlock(&qlock);
+}
+
+void ofs_quota_usage(uid_t uid, gid_t gid, OQUSAGE *u)
+{
+	OQENT *e;
+
+	pthread_mutex_lock(&qlock);
+	u->bytes = used[OQ_DATA] + used[OQ_NODE] + used[OQ_TYPELINK];
+	u->inodes = ninodes;
+	u->limit_bytes = lim_bytes;
+	u->limit_inodes = lim_inodes;
+	u->avail_bytes = oq_left(lim_bytes, u->bytes);
+	u->avail_inodes = oq_left(lim_inodes, u->inodes);
+	if(uid != 0) {
+		e = oq_find(0, uid, 0);
+		u->avail_bytes = oq_min(u->avail_bytes, oq_left(oq_limit(e, 0, 0), e? e->bytes : 0));
+		u->avail_inodes = oq_min(u->avail_inodes, oq_left(oq_limit(e, 0, 1), e? e->inodes : 0));
+		e = oq_find(1, gid, 0);
+		u->avail_bytes = oq_min(u->avail_bytes, oq_left(oq_limit(e, 1, 0), e? e->bytes : 0));
+		u->avail_inodes = oq_min(u->avail_inodes, oq_left(oq_limit(e, 1, 1), e? e->inodes : 0));
+	}
+	pthread_mutex_unlock(&qlock);
+}
+
+void ofs_quota_clear(void)
+{
+	OQENT *e;
+	int i;
+
+	pthread_mutex_lock(&qlock);
+	memset(used, 0, sizeof(used));
+	names = ninodes = 0;
+	for(i = 0; i < OQ_HASH; i++)
+		for(e = qtab[i]; e != NULL; e = e->next)
+			e->bytes = e->inodes = 0;
+	pthread_mutex_unlock(&qlock);
+}
+
+char* ofs_quota_show(size_t *len)
+{
+	OQENT *e;
+	FILE *fp;
+	char *buf = NULL;
+	int i, k;
+
+	if((fp = open_memstream(&buf, len)) == NULL)
+		return NULL;
+	pthread_mutex_lock(&qlock);
+	fprintf(fp, "%-10s %16s\n", "kind", "bytes");
+	for(k = 0; k < OQ_NUM; k++)
+		fprintf(fp, "%-10s %16lld\n", kind_names[k], (long long)used[k]);
+	fprintf(fp, "%-10s %16lld (in nodes)\n", "names", (long long)names);
+	fprintf(fp, "%-10s %16lld / %llu\n", "total", (long long)(used[OQ_DATA] + used[OQ_NODE] + used[OQ_TYPELINK]),
+		(unsigned long long)lim_bytes);
+	fprintf(fp, "%-10s %16lld / %llu\n", "inodes", (long long)ninodes, (unsigned long long)lim_inodes);
+	fprintf(fp, "# limit 0 means unlimited, write \"user|group <id> <MB> <inodes>\" to set one\n");
+	fprintf(fp, "%-6s %10s %16s %16s %12s %12s\n", "type", "id", "bytes", "limit_bytes", "inodes", "limit_inodes");
+	fprintf(fp, "%-6s %10s %16s %16llu %12s %12llu\n", "user", "default", "-",
+		(unsigned long long)def_limit[0][0], "-", (unsigned long long)def_limit[0][1]);
+	fprintf(fp, "%-6s %10s %16s %16llu %12s %12llu\n", "group", "default", "-",
+		(unsigned long long)def_limit[1][0], "-", (unsigned long long)def_limit[1][1]);
+	for(i = 0; i < OQ_HASH; i++) {
+		for(e = qtab[i]; e != NULL; e = e->next) {
+			if(e->bytes == 0 && e->inodes == 0 && !e->set) continue;
+			fprintf(fp, "%-6s %10u %16lld %16llu %12lld %12llu\n", e->group? "group" : "user", e->id,
+				(long long)e->bytes, (unsigned long long)oq_limit(e, e->group, 0),
+				(long long)e->inodes, (unsigned long long)oq_limit(e, e->group, 1));
+		}
+	}
+	pthread_mutex_unlock(&qlock);
+	fclose(fp);
+	return buf;
+}
+
+void ofs_quota_reset(void)
+{
+	OQENT *e;
+	int i;
+
+	pthread_mutex_lock(&qlock);
+	for(i = 0; i < OQ_HASH; i++)
+		for(e = qtab[i]; e != NULL; e = e->next)
+			e->set = 0;
+	pthread_mutex_unlock(&qlock);
+}
+
+int ofs_quota_store(const char *buf, size_t size)
+{
+	char line[128], type[16];
+	unsigned int id;
+	unsigned long mb, inodes;
+	size_t n;
+	OQENT *e;
+	int ret = 0;
+
+	while(size > 0 && ret == 0) {
+		for(n = 0; n < size && buf[n] != '\n'; n++);
+		if(n > 0) {
+			if(n >= sizeof(line)) return -1;
+			memcpy(line, buf, n);
+			line[n] = '\0';
+			if(sscanf(line, "%15s %u %lu %lu", type, &id, &mb, &inodes) != 4
+				|| (strcmp(type, "user") != 0 && strcmp(type, "group") != 0))
+				return -1;
+			pthread_mutex_lock(&qlock);
+			if((e = oq_find(strcmp(type, "group") == 0, id, 1)) != NULL) {
+				e->set = 1;
+				e->limit_bytes = (uint64_t)mb << 20;
+				e->limit_inodes = inodes;
+			} else {
+				ret = -1;
+			}
+			pthread_mutex_unlock(&qlock);
+		}
+		if(n < size) n++;
+		buf += n;
+		size -= n;
+	}
+	return ret;
+}
@@ -0,0 +1,104 @@
+﻿#ifndef __QUOTA_H
+#define __QUOTA_H
+#include <sys/types.h>
+#include <stdint.h>
+
+/* 사용량 종류 */
+enum {
+	OQ_DATA = 0,			// 파일 데이터 (청크에 들어 있는 바이트)
+	OQ_NODE,				// 노드 구조체 (ONODE, OSTAT)
+	OQ_TYPELINK,			// 타입 디렉토리와 타입 링크의 노드와 데이터
+	OQ_NUM
+};
+
+/* 파일 시스템 또는 사용자에게 보이는 사용량 (statfs) */
+typedef struct _OQUSAGE {
+	uint64_t		bytes;			// 사용중인 바이트
+	uint64_t		inodes;			// 사용중인 노드 수
+	uint64_t		limit_bytes;		// 한도, 0이면 제한 없음
+	uint64_t		limit_inodes;
+	uint64_t		avail_bytes;		// 요청한 사용자가 더 쓸 수 있는 양 (한도가 없으면 UINT64_MAX)
+	uint64_t		avail_inodes;
+} OQUSAGE;
+
+/*######################################
+ 이름 : ofs_quota_init
+ 요약 : 파일 시스템 한도와 사용자/그룹별 기본 한도 설정, 0이면 제한 없음
+ 매개변수 : uint64_t [BYTES], uint64_t [INODES], uint64_t [USER_BYTES], uint64_t [USER_INODES], uint64_t [GROUP_BYTES], uint64_t [GROUP_INODES]
+ 반환값 : 없음
+ #######################################*/
+void 		ofs_quota_init		(uint64_t, uint64_t, uint64_t, uint64_t, uint64_t, uint64_t);
+
+/*######################################
+ 이름 : ofs_quota_enforce
+ 요약 : 한도 검사 사용 여부 (저널 재실행 중에는 끈다)
+ 매개변수 : int [ENABLE]
+ 반환값 : 없음
+ #######################################*/
+void 		ofs_quota_enforce	(int);
+
+/*######################################
+ 이름 : ofs_quota_check
+ 요약 : 사용량을 늘려도 되는지 검사, root 소유는 사용자/그룹 한도를 받지 않는다
+ 매개변수 : uid_t [OWNER], gid_t [GROUP], uint64_t [BYTES], uint64_t [INODES]
+ 반환값 : 가능하면 0, 파일 시스템 한도를 넘으면 -ENOSPC, 사용자/그룹 한도를 넘으면 -EDQUOT
+ #######################################*/
+int 		ofs_quota_check		(uid_t, gid_t, uint64_t, uint64_t);
+
+/*######################################
+ 이름 : ofs_quota_charge
+ 요약 : 사용량 더하기 (음수면 빼기)
+ 매개변수 : uid_t [OWNER], gid_t [GROUP], int [KIND], int64_t [BYTES], int64_t [INODES]
+ 반환값 : 없음
+ #######################################*/
+void 		ofs_quota_charge		(uid_t, gid_t, int, int64_t, int64_t);
+
+/*######################################
+ 이름 : ofs_quota_names
+ 요약 : 이름 길이 합계 더하기 (노드 구조체 안의 이름 버퍼 중 실제로 쓰는 부분)
+ 매개변수 : int64_t [BYTES]
+ 반환값 : 없음
+ #######################################*/
+void 		ofs_quota_names		(int64_t);
+
+/*######################################
+ 이름 : ofs_quota_usage
+ 요약 : 파일 시스템 사용량과 사용자가 더 쓸 수 있는 양, 카운터만 읽는다
+ 매개변수 : uid_t [USER], gid_t [GROUP], OQUSAGE* [USAGE]
+ 반환값 : 없음
+ #######################################*/
+void 		ofs_quota_usage		(uid_t, gid_t, OQUSAGE*);
+
+/*######################################
+ 이름 : ofs_quota_clear
+ 요약 : 모든 사용량을 0으로 (트리를 다시 세기 전에 호출)
+ 매개변수 : 없음
+ 반환값 : 없음
+ #######################################*/
+void 		ofs_quota_clear		(void);
+
+/*######################################
+ 이름 : ofs_quota_show
+ 요약 : 종류별 사용량과 사용자/그룹별 사용량과 한도를 글로 만든다
+ 매개변수 : size_t* [LEN]
+ 반환값 : malloc된 문자열, 호출자가 해제
+ #######################################*/
+char* 	ofs_quota_show		(size_t*);
+
+/*######################################
+ 이름 : ofs_quota_reset
+ 요약 : 사용자/그룹별로 지정한 한도를 지우고 기본 한도로 되돌린다
+ 매개변수 : 없음
+ 반환값 : 없음
+ #######################################*/
+void 		ofs_quota_reset		(void);
+
+/*######################################
+ 이름 : ofs_quota_store
+ 요약 : "user|group <ID> <MB> <INODES>" 줄로 사용자/그룹 한도 지정 (0이면 제한 없음)
+ 매개변수 : const char* [BUF], size_t [SIZE]
+ 반환값 : 성공시 0, 형식이 틀리면 음수
+ #######################################*/
+int 		ofs_quota_store		(const char*, size_t);
+
+#endif
@@ -0,0 +1,250 @@
+﻿#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include "stats.h"
+
+typedef struct _OPCNT {
+	uint64_t	count;
+	uint64_t	errors;
+	uint64_t	ns;									// 지연 합계
+	uint64_t	hist[OFS_STATS_BUCKETS];
+} OPCNT;
+
+/* 스레드별 카운터 - 해당 스레드만 쓰므로 잠금 없이 더한다 */
+typedef struct _OPTHREAD {
+	OPCNT				op[OP_NUM];
+	uint64_t				max[OP_NUM];			// 초기화 이후 최대 지연
+	uint32_t				gen;					// max를 비운 초기화 세대
+	struct _OPTHREAD		*prev;
+	struct _OPTHREAD		*next;
+} OPTHREAD;
+
+static const char *op_names[OP_NUM] = {
+	"getattr", "access", "readdir", "readlink", "open", "opendir", "read", "release",
+	"mknod", "mkdir", "unlink", "rmdir", "symlink", "link", "rename", "write",
+	"truncate", "chmod", "chown", "utimens", "copy_range", "ioctl", "statfs", "fallocate",
+	"flush", "setxattr", "getxattr", "listxattr", "removexattr",
+	"lock_wait", "lookup", "typelink", "data_read", "data_write", "wb_commit",
+	"import", "export", "rmtree", "reap", "move", "verify", "scrub", "batch"
+};
+
+static __thread OPTHREAD	*self;
+static OPTHREAD 			*threads;						// 살아 있는 스레드의 카운터
+static OPCNT 			retired[OP_NUM];				// 끝난 스레드의 카운터
+static uint64_t 			retired_max[OP_NUM];
+static OPCNT 			base[OP_NUM];					// 마지막 초기화 시점의 합계
+static int 				enabled;						// 수집 여부, 꺼져 있으면 시각도 읽지 않는다
+static uint32_t 			gen;							// 초기화 세대
+static uint64_t 			reset_at;						// 마지막 초기화 시각
+static pthread_mutex_t	slock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_key_t 		skey;
+static pthread_once_t 	sonce = PTHREAD_ONCE_INIT;
+
+static void os_add(OPCNT *dst, const OPCNT *src)
+{
+	int i, b;
+	for(i = 0; i < OP_NUM; i++) {
+		dst[i].count += src[i].count;
+		dst[i].errors += src[i].errors;
+		dst[i].ns += src[i].ns;
+		for(b = 0; b < OFS_STATS_BUCKETS; b++)
+			dst[i].hist[b] += src[i].hist[b];
+	}
+}
+
+/* 스레드가 끝나면 카운터를 retired로 옮긴다 (FUSE 스레드 풀은 스레드를 줄였다 늘린다) */
+static void os_retire(void *arg)
+{
+	OPTHREAD *t = (OPTHREAD*)arg;
+	int i;
+
+	pthread_mutex_lock(&slock);
+	os_add(retired, t->op);
+	if(t->gen == gen)
+		for(i = 0; i < OP_NUM; i++)
+			if(t->max[i] > retired_max[i]) retired_max[i] = t->max[i];
+	if(t->prev != NULL) t->prev->next = t->next;
+	else threads = t->next;
+	if(t->next != NULL) t->next->prev = t->prev;
+	pthread_mutex_unlock(&slock);
+	free(t);
+}
+
+static void os_init(void)
+{
+	pthread_key_create(&skey, os_retire);
+}
+
+static OPTHREAD* os_self(void)
+{
+	OPTHREAD *t;
+
+	if(self != NULL) return self;
+	pthread_once(&sonce, os_init);
+	if((t = (OPTHREAD*)calloc(1, sizeof(OPTHREAD))) == NULL)
+		return NULL;
+	pthread_mutex_lock(&slock);
+	t->gen = gen;
+	t->next = threads;
+	if(threads != NULL) threads->prev = t;
+	threads = t;
+	pthread_mutex_unlock(&slock);
+	pthread_setspecific(skey, t);
+	return self = t;
+}
+
+static uint64_t os_now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void ofs_stats_enable(void)
+{
+	pthread_once(&sonce, os_init);
+	pthread_mutex_lock(&slock);
+	if(!enabled) {
+		reset_at = os_now();
+		enabled = 1;
+	}
+	pthread_mutex_unlock(&slock);
+}
+
+uint64_t ofs_stats_begin(void)
+{
+	return enabled? os_now() : 0;
+}
+
+int ofs_stats_end(int op, uint64_t begin, int ret)
+{
+	OPTHREAD *t;
+	OPCNT *c;
+	uint64_t ns;
+	int b;
+
+	if(begin == 0 || !enabled) return ret;				// 수집을 켜기 전에 시작한 연산, 추적만 켠 경우
+	ns = os_now() - begin;
+	if((t = os_self()) == NULL) return ret;
+	c = &t->op[op];
+	b = (ns == 0)? 0 : 64 - __builtin_clzll(ns);
+	if(b >= OFS_STATS_BUCKETS) b = OFS_STATS_BUCKETS - 1;
+	c->count++;
+	if(ret < 0) c->errors++;
+	c->ns += ns;
+	c->hist[b]++;
+	if(t->gen != gen) {								// 초기화 이후 처음이면 최대값을 비운다
+		memset(t->max, 0, sizeof(t->max));
+		t->gen = gen;
+	}
+	if(ns > t->max[op]) t->max[op] = ns;
+	return ret;
+}
+
+void ofs_stats_reset(void)
+{
+	OPTHREAD *t;
+
+	pthread_once(&sonce, os_init);
+	pthread_mutex_lock(&slock);
+	/* 카운터는 그대로 두고 현재 합계를 기준점으로 삼는다 (쓰는 스레드와 경쟁하지 않도록) */
+	memcpy(base, retired, sizeof(base));
+	for(t = threads; t != NULL; t = t->next)
+		os_add(base, t->op);
+	memset(retired_max, 0, sizeof(retired_max));
+	gen++;
+	reset_at = os_now();
+	pthread_mutex_unlock(&slock);
+}
+
+const char* ofs_stats_opname(int op)
+{
+	return (op >= 0 && op < OP_NUM)? op_names[op] : "?";
+}
+
+/* 히스토그램 칸의 상한을 읽기 쉬운 단위로 */
+static const char* os_unit(int b, char *buf)
+{
+	static const char *suffix[] = { "ns", "us", "ms", "s" };
+	uint64_t v = 1ULL << b;
+	int i = 0;
+
+	while(v >= 1024 && i < 3) {
+		v >>= 10;
+		i++;
+	}
+	sprintf(buf, "%llu%s", (unsigned long long)v, suffix[i]);
+	return buf;
+}
+
+/* 히스토그램에서 백분위 지연(us), 칸의 상한으로 어림하되 최대값을 넘지 않는다 */
+static double os_pct(const OPCNT *c, uint64_t max, double p)
+{
+	uint64_t need = (uint64_t)(c->count * p / 100.0 + 0.5), sum = 0;
+	int b;
+
+	if(need == 0) need = 1;
+	for(b = 0; b < OFS_STATS_BUCKETS; b++) {
+		sum += c->hist[b];
+		if(sum >= need) break;
+	}
+	return (double)((1ULL << b) < max? (1ULL << b) : max) / 1000.0;
+}
+
+char* ofs_stats_show(size_t *len)
+{
+	OPCNT sum[OP_NUM];
+	uint64_t max[OP_NUM];
+	OPTHREAD *t;
+	FILE *fp;
+	char *buf = NULL, unit[16];
+	double sec;
+	int i, b;
+
+	ofs_stats_enable();								// 처음 읽으면 그때부터 모은다
+	pthread_mutex_lock(&slock);
+	memcpy(sum, retired, sizeof(sum));
+	memcpy(max, retired_max, sizeof(max));
+	for(t = threads; t != NULL; t = t->next) {
+		os_add(sum, t->op);
+		if(t->gen == gen)
+			for(i = 0; i < OP_NUM; i++)
+				if(t->max[i] > max[i]) max[i] = t->max[i];
+	}
+	for(i = 0; i < OP_NUM; i++) {						// 초기화 이후의 변화만 보여준다
+		sum[i].count -= base[i].count;
+		sum[i].errors -= base[i].errors;
+		sum[i].ns -= base[i].ns;
+		for(b = 0; b < OFS_STATS_BUCKETS; b++)
+			sum[i].hist[b] -= base[i].hist[b];
+	}
+	sec = (os_now() - reset_at) / 1e9;
+	pthread_mutex_unlock(&slock);
+
+	if((fp = open_memstream(&buf, len)) == NULL)
+		return NULL;
+	fprintf(fp, "# since reset %.3f s ago\n", sec);
+	fprintf(fp, "%-12s %12s %10s %10s %10s %10s %10s %10s\n",
+		"op", "count", "errors", "avg_us", "p50_us", "p90_us", "p99_us", "max_us");
+	for(i = 0; i < OP_NUM; i++) {
+		if(sum[i].count == 0) continue;
+		fprintf(fp, "%-12s %12llu %10llu %10.2f %10.2f %10.2f %10.2f %10.2f\n", op_names[i],
+			(unsigned long long)sum[i].count, (unsigned long long)sum[i].errors,
+			sum[i].ns / 1000.0 / sum[i].count,
+			os_pct(&sum[i], max[i], 50), os_pct(&sum[i], max[i], 90), os_pct(&sum[i], max[i], 99),
+			max[i] / 1000.0);
+	}
+	fprintf(fp, "# latency histogram, <upper bound>:<count>\n");
+	for(i = 0; i < OP_NUM; i++) {
+		if(sum[i].count == 0) continue;
+		fprintf(fp, "%-12s", op_names[i]);
+		for(b = 0; b < OFS_STATS_BUCKETS; b++)
+			if(sum[i].hist[b] > 0)
+				fprintf(fp, " %s:%llu", os_unit(b, unit), (unsigned long long)sum[i].hist[b]);
+		fprintf(fp, "\n");
+	}
+	fclose(fp);
+	return buf;
+}
@@ -0,0 +1,104 @@
+﻿#ifndef __STATS_H
+#define __STATS_H
+#include <sys/types.h>
+#include <stdint.h>
+
+/* 통계를 모으는 연산과 내부 단계 */
+enum {
+	OP_GETATTR = 0,
+	OP_ACCESS,
+	OP_READDIR,
+	OP_READLINK,
+	OP_OPEN,
+	OP_OPENDIR,
+	OP_READ,
+	OP_RELEASE,
+	OP_MKNOD,
+	OP_MKDIR,
+	OP_UNLINK,
+	OP_RMDIR,
+	OP_SYMLINK,
+	OP_LINK,
+	OP_RENAME,
+	OP_WRITE,
+	OP_TRUNCATE,
+	OP_CHMOD,
+	OP_CHOWN,
+	OP_UTIMENS,
+	OP_COPY_RANGE,
+	OP_IOCTL,
+	OP_STATFS,
+	OP_FALLOCATE,
+	OP_FLUSH,
+	OP_SETXATTR,
+	OP_GETXATTR,
+	OP_LISTXATTR,
+	OP_REMOVEXATTR,
+	OP_LOCK_WAIT,			// 트리 잠금 대기
+	OP_LOOKUP,			// 경로 탐색 (ofs_findnode, ofs_findparent)
+	OP_TYPELINK,			// 타입 디렉토리와 타입 링크 관리
+	OP_DATA_READ,			// 파일 데이터 복사 (읽기)
+	OP_DATA_WRITE,		// 파일 데이터 복사 (쓰기)
+	OP_WB_COMMIT,			// 쓰기 모음 버퍼 반영
+	OP_IMPORT,			// 가져오기에서 파일 하나 읽기
+	OP_EXPORT,			// 내보내기 스냅샷 (트리 잠금 포함)
+	OP_RMTREE,			// 서브트리 떼어 내기
+	OP_REAP,				// 떼어 낸 서브트리 해제 (한 묶음)
+	OP_MOVE,				// 서브트리 항목 옮기기
+	OP_VERIFY,			// 읽는 청크의 체크섬 검사 (불일치는 오류로 센다)
+	OP_SCRUB,				// 스크러버의 청크 검사 (불일치는 오류로 센다)
+	OP_BATCH,				// 묶음 만들기 (OFS_IOC_BATCH)
+	OP_NUM
+};
+
+#define OFS_STATS_BUCKETS	32		// 지연 히스토그램 칸 수, i번째 칸은 [2^(i-1), 2^i) ns
+
+/*######################################
+ 이름 : ofs_stats_enable
+ 요약 : 통계 수집 시작 (마운트 옵션 stats, 또는 통계를 처음 읽을 때)
+ 매개변수 : 없음
+ 반환값 : 없음
+ #######################################*/
+void 		ofs_stats_enable		(void);
+
+/*######################################
+ 이름 : ofs_stats_begin
+ 요약 : 측정 시작 시각
+ 매개변수 : 없음
+ 반환값 : 단조 증가 시각(ns), 수집하지 않는 중이면 0
+ #######################################*/
+uint64_t	ofs_stats_begin		(void);
+
+/*######################################
+ 이름 : ofs_stats_end
+ 요약 : 연산 하나의 횟수와 지연을 호출한 스레드의 카운터에 더한다
+ 매개변수 : int [OP], uint64_t [BEGIN], int [RET]
+ 반환값 : RET을 그대로 반환
+ #######################################*/
+int 		ofs_stats_end		(int, uint64_t, int);
+
+/*######################################
+ 이름 : ofs_stats_show
+ 요약 : 모든 스레드의 통계를 합쳐 글로 만든다 (마지막 초기화 이후), 수집 중이 아니면 시작한다
+ 매개변수 : size_t* [LEN]
+ 반환값 : malloc된 문자열, 호출자가 해제
+ #######################################*/
+char* 	ofs_stats_show		(size_t*);
+
+/*######################################
+ 이름 : ofs_stats_reset
+ 요약 : 통계 초기화
+ 매개변수 : 없음
+ 반환값 : 없음
+ #######################################*/
+void 		ofs_stats_reset		(void);
+
+/*######################################
+ 이름 : ofs_stats_opname
+ 요약 : 연산 이름
+ 매개변수 : int [OP]
+ 반환값 : 이름, 모르는 연산이면 "?"
+ #######################################*/
+const char*	ofs_stats_opname		(int);
+
+#endif
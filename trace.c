@@ -0,0 +1,245 @@
+﻿#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include "trace.h"
+#include "stats.h"
+
+/* 스레드별 링 버퍼 - 해당 스레드만 쓰고, 읽는 쪽은 head를 다시 확인해 덮어쓰인 레코드를 버린다 */
+typedef struct _OTRING {
+	OTREC			*rec;
+	uint64_t			head;			// 다음에 쓸 레코드 번호
+	uint64_t			tail;			// 초기화 시점의 head (읽는 쪽만 사용)
+	int				tid;				// 마지막으로 쓴 스레드
+	int				live;			// 스레드가 사용중
+	struct _OTRING	*next;
+} OTRING;
+
+/* 읽을 때 모은 레코드 */
+typedef struct _OTDUMP {
+	OTREC		rec;
+	int			tid;
+} OTDUMP;
+
+static const char *level_names[] = { "off", "err", "info", "debug" };
+
+int ofs_trace_level = OT_ERR;
+__thread uint64_t ofs_trace_node;
+
+static __thread OTRING	*self;
+static OTRING 			*rings;						// 모든 링, 스레드가 끝나면 다음 스레드가 물려받는다
+static int 				nrings;
+static size_t 			ring_size = 1024;				// 2의 거듭제곱
+static pthread_mutex_t	tlock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_key_t 		tkey;
+static pthread_once_t 	tonce = PTHREAD_ONCE_INIT;
+
+static void ot_release(void *arg)
+{
+	OTRING *r = (OTRING*)arg;
+
+	pthread_mutex_lock(&tlock);
+	r->live = 0;
+	pthread_mutex_unlock(&tlock);
+}
+
+static void ot_init(void)
+{
+	pthread_key_create(&tkey, ot_release);
+}
+
+static OTRING* ot_self(void)
+{
+	OTRING *r;
+
+	if(self != NULL) return self;
+	pthread_once(&tonce, ot_init);
+	pthread_mutex_lock(&tlock);
+	for(r = rings; r != NULL; r = r->next)			// 끝난 스레드의 링을 다시 쓴다
+		if(!r->live) break;
+	if(r == NULL) {
+		if((r = (OTRING*)calloc(1, sizeof(OTRING))) == NULL
+			|| (r->rec = (OTREC*)calloc(ring_size, sizeof(OTREC))) == NULL) {
+			free(r);
+			pthread_mutex_unlock(&tlock);
+			return NULL;
+		}
+		r->next = rings;
+		rings = r;
+		nrings++;
+	}
+	r->live = 1;
+	r->tid = (int)syscall(SYS_gettid);
+	pthread_mutex_unlock(&tlock);
+	pthread_setspecific(tkey, r);
+	return self = r;
+}
+
+static int ot_level(const char *s, size_t len)
+{
+	int i;
+
+	while(len > 0 && (s[len - 1] == '\n' || s[len - 1] == ' '))
+		len--;
+	if(len == 1 && s[0] >= '0' && s[0] <= '3')
+		return s[0] - '0';
+	for(i = OT_OFF; i <= OT_DEBUG; i++)
+		if(strlen(level_names[i]) == len && strncasecmp(s, level_names[i], len) == 0)
+			return i;
+	return -1;
+}
+
+int ofs_trace_init(const char *level, size_t records)
+{
+	int lv = OT_ERR;
+
+	if(level != NULL && (lv = ot_level(level, strlen(level))) < 0)
+		return -1;
+	ofs_trace_level = lv;
+	if(records > 0) {
+		for(ring_size = 1; ring_size < records; ring_size <<= 1);
+	}
+	return 0;
+}
+
+uint64_t ofs_trace_now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* FNV-1a */
+static uint32_t ot_hash(const char *s)
+{
+	uint32_t h = 2166136261U;
+
+	while(*s) {
+		h ^= (unsigned char)*s++;
+		h *= 16777619U;
+	}
+	return h;
+}
+
+void ofs_trace_put(int level, int op, const char *path, uint64_t id, uint64_t begin, int ret)
+{
+	OTRING *r;
+	OTREC *e;
+	uint64_t h, now;
+	size_t len;
+
+	if((r = ot_self()) == NULL) return;
+	h = r->head;
+	e = &r->rec[h & (ring_size - 1)];
+	now = ofs_trace_now();
+	e->ts = now;
+	e->id = id;
+	e->ns = (begin == 0)? 0 : (now - begin > UINT32_MAX)? UINT32_MAX : (uint32_t)(now - begin);
+	e->ret = ret;
+	e->op = (uint8_t)op;
+	e->level = (uint8_t)level;
+	if(path == NULL) path = "";
+	e->hash = ot_hash(path);
+	len = strlen(path);
+	e->cut = (len >= OFS_TRACE_NAME);
+	if(e->cut) path += len - (OFS_TRACE_NAME - 1);
+	strncpy(e->name, path, OFS_TRACE_NAME - 1);
+	e->name[OFS_TRACE_NAME - 1] = '\0';
+	__atomic_store_n(&r->head, h + 1, __ATOMIC_RELEASE);
+}
+
+void ofs_trace_reset(void)
+{
+	OTRING *r;
+
+	pthread_mutex_lock(&tlock);
+	for(r = rings; r != NULL; r = r->next)
+		r->tail = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+	pthread_mutex_unlock(&tlock);
+}
+
+int ofs_trace_store(const char *buf, size_t size)
+{
+	int lv;
+
+	if((lv = ot_level(buf, size)) < 0)
+		return -1;
+	ofs_trace_level = lv;
+	return 0;
+}
+
+static int ot_cmp(const void *a, const void *b)
+{
+	uint64_t x = ((const OTDUMP*)a)->rec.ts, y = ((const OTDUMP*)b)->rec.ts;
+	return (x < y)? -1 : (x > y);
+}
+
+char* ofs_trace_show(size_t *len)
+{
+	OTRING *r;
+	OTDUMP *all;
+	FILE *fp;
+	char *buf = NULL, when[32];
+	struct timespec rt;
+	struct tm tm;
+	uint64_t h1, h2, from, i, off;
+	size_t n = 0, k;
+	time_t sec;
+
+	pthread_mutex_lock(&tlock);
+	if((all = (OTDUMP*)malloc((nrings + 1) * ring_size * sizeof(OTDUMP))) == NULL) {
+		pthread_mutex_unlock(&tlock);
+		return NULL;
+	}
+	for(r = rings; r != NULL; r = r->next) {
+		h1 = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+		from = (h1 > ring_size)? h1 - ring_size : 0;
+		if(from < r->tail) from = r->tail;
+		k = n;
+		for(i = from; i < h1; i++) {
+			all[n].rec = r->rec[i & (ring_size - 1)];
+			all[n++].tid = r->tid;
+		}
+		/* 복사하는 동안 덮어쓰인 레코드는 버린다 */
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		h2 = __atomic_load_n(&r->head, __ATOMIC_RELAXED);
+		if(h2 >= ring_size && h2 - ring_size + 1 > from) {
+			off = h2 - ring_size + 1 - from;
+			if(off > n - k) off = n - k;
+			memmove(&all[k], &all[k + off], (n - k - off) * sizeof(OTDUMP));
+			n -= off;
+		}
+	}
+	pthread_mutex_unlock(&tlock);
+	qsort(all, n, sizeof(OTDUMP), ot_cmp);
+
+	/* 단조 시각을 벽시계로 바꿔서 보여준다 */
+	clock_gettime(CLOCK_REALTIME, &rt);
+	off = rt.tv_sec * 1000000000ULL + rt.tv_nsec - ofs_trace_now();
+
+	if((fp = open_memstream(&buf, len)) == NULL) {
+		free(all);
+		return NULL;
+	}
+	fprintf(fp, "# level %s (compiled up to %s), %zu records per thread, %d threads\n",
+		level_names[ofs_trace_level], level_names[OFS_TRACE_MAX], ring_size, nrings);
+	fprintf(fp, "# %-24s %7s %-5s %-12s %10s %6s %8s %8s %s\n",
+		"time", "tid", "level", "op", "dur_us", "ret", "node", "hash", "path");
+	for(k = 0; k < n; k++) {
+		OTREC *e = &all[k].rec;
+		sec = (time_t)((e->ts + off) / 1000000000ULL);
+		localtime_r(&sec, &tm);
+		strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", &tm);
+		fprintf(fp, "%s.%06llu %7d %-5s %-12s %10.2f %6d %8llu %08x %s%s\n", when,
+			(unsigned long long)((e->ts + off) % 1000000000ULL / 1000), all[k].tid,
+			level_names[e->level], ofs_stats_opname(e->op), e->ns / 1000.0, e->ret,
+			(unsigned long long)e->id, e->hash, e->cut? "..." : "", e->name);
+	}
+	fclose(fp);
+	free(all);
+	return buf;
+}
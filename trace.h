@@ -0,0 +1,92 @@
+﻿#ifndef __TRACE_H
+#define __TRACE_H
+#include <sys/types.h>
+#include <stdint.h>
+
+/* 추적 수준 (전처리기에서 비교하므로 enum이 아니다) */
+#define OT_OFF			0
+#define OT_ERR			1		// 실패한 연산
+#define OT_INFO			2		// 모든 연산
+#define OT_DEBUG			3		// 타입 링크 등 내부 단계
+
+/* 컴파일할 때 남길 최대 수준, 이보다 자세한 추적은 코드에서 빠진다 (make TRACE=1) */
+#ifndef OFS_TRACE_MAX
+#define OFS_TRACE_MAX		OT_DEBUG
+#endif
+
+#define OFS_TRACE_NAME		33		// 레코드에 남기는 경로 꼬리 길이
+
+/* 추적 레코드 (캐시 라인 하나) */
+typedef struct _OTREC {
+	uint64_t		ts;				// 기록 시각 (단조 증가, ns)
+	uint64_t		id;				// 노드 번호, 모르면 0
+	uint32_t		hash;			// 전체 경로 해시
+	uint32_t		ns;				// 걸린 시간, 재지 않았으면 0
+	int32_t		ret;
+	uint8_t		op;				// stats.h의 OP_*
+	uint8_t		level;
+	uint8_t		cut;				// 경로가 잘림
+	char			name[OFS_TRACE_NAME];	// 경로의 끝부분
+} OTREC;
+
+extern int ofs_trace_level;					// 실행 중 추적 수준
+extern __thread uint64_t ofs_trace_node;		// 이 스레드가 연산 중에 처음 찾은 노드 (대개 연산 대상)
+
+#define OFS_TRACING(lv)		((lv) <= OFS_TRACE_MAX && (lv) <= ofs_trace_level)
+#define OFS_TRACE(lv, op, path, id, begin, ret) \
+	do { if(OFS_TRACING(lv)) ofs_trace_put(lv, op, path, id, begin, ret); } while(0)
+#if OFS_TRACE_MAX > OT_OFF
+#define OFS_TRACE_NODE(nid)	do { if(ofs_trace_node == 0) ofs_trace_node = (nid); } while(0)
+#else
+#define OFS_TRACE_NODE(nid)	do { } while(0)
+#endif
+
+/*######################################
+ 이름 : ofs_trace_init
+ 요약 : 추적 수준과 스레드별 링 버퍼 크기 설정 (연산을 받기 전에 호출)
+ 매개변수 : const char* [LEVEL], size_t [RECORDS]
+ 반환값 : 성공시 0, 모르는 수준이면 음수
+ #######################################*/
+int 		ofs_trace_init		(const char*, size_t);
+
+/*######################################
+ 이름 : ofs_trace_now
+ 요약 : 추적용 시각
+ 매개변수 : 없음
+ 반환값 : 단조 증가 시각(ns)
+ #######################################*/
+uint64_t	ofs_trace_now		(void);
+
+/*######################################
+ 이름 : ofs_trace_put
+ 요약 : 이 스레드의 링 버퍼에 레코드 추가 (OFS_TRACE로 호출)
+ 매개변수 : int [LEVEL], int [OP], const char* [PATH], uint64_t [NODE_ID], uint64_t [BEGIN], int [RESULT]
+ 반환값 : 없음
+ #######################################*/
+void 		ofs_trace_put		(int, int, const char*, uint64_t, uint64_t, int);
+
+/*######################################
+ 이름 : ofs_trace_show
+ 요약 : 모든 스레드의 레코드를 시간 순으로 합쳐 글로 만든다
+ 매개변수 : size_t* [LEN]
+ 반환값 : malloc된 문자열, 호출자가 해제
+ #######################################*/
+char* 	ofs_trace_show		(size_t*);
+
+/*######################################
+ 이름 : ofs_trace_reset
+ 요약 : 지금까지의 레코드를 비운다
+ 매개변수 : 없음
+ 반환값 : 없음
+ #######################################*/
+void 		ofs_trace_reset		(void);
+
+/*######################################
+ 이름 : ofs_trace_store
+ 요약 : 가상 파일에 쓴 수준 이름(off, err, info, debug 또는 0-3)으로 추적 수준 변경
+ 매개변수 : const char* [BUF], size_t [SIZE]
+ 반환값 : 성공시 0, 모르는 수준이면 음수
+ #######################################*/
+int 		ofs_trace_store		(const char*, size_t);
+
+#endif
@@ -0,0 +1,570 @@
+﻿#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/xattr.h>
+#include "xattr.h"
+
+/*
+ * 확장 속성은 노드 정보(OSTAT)마다 malloc 한 번으로 된 묶음에 둔다.
+ * [전체 길이 uint32] 뒤에 [이름 길이 uint8][값 길이 uint32][이름][값] 레코드가 이어지며
+ * 속성이 없으면 of_xattr는 NULL이다. 태그 색인(-o tags)은 "user.tag.*" 속성의 값마다
+ * 그 값을 가진 파일 목록을 두므로 /_tag/<값>을 읽는 비용은 결과 수에만 비례한다.
+ */
+#define OX_HDR			sizeof(uint32_t)
+#define OX_REC			(1 + sizeof(uint32_t))		// 레코드 머리 (이름 길이, 값 길이)
+#define OX_HASH_MIN		256
+
+typedef struct _OXTAG OXTAG;
+
+/* 태그가 붙은 파일, 링크 노드를 모두 가지고 있다 (디렉토리와 일반 파일만) */
+typedef struct _OXFILE {
+	OSTAT			*stat;
+	ONODE			**link;
+	uint32_t			nlink, cap;
+	OXTAG			**tag;				// 이 파일이 들어 있는 태그 값
+	size_t			*pos;				// tag[i]의 파일 배열 안에서의 위치
+	uint32_t			ntag;
+	struct _OXFILE	*hnext;
+} OXFILE;
+
+struct _OXTAG {
+	char				*value;
+	OXFILE			**file;
+	size_t			n, cap;
+	struct _OXTAG		*hnext;
+};
+
+static int 		enabled;
+static ONODE 		*oxroot;
+static OXTAG 		**ttab;
+static size_t 		ntbucket, ntag;
+static OXFILE 		**ftab;
+static size_t 		nfbucket, nfile;
+
+static uint32_t ox_u32(const char *p)
+{
+	uint32_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+size_t ofs_xattr_size(OSTAT *stat)
+{
+	return (stat->of_xattr != NULL)? ox_u32(stat->of_xattr) : 0;
+}
+
+/* 레코드를 차례로 돈다, *REC가 NULL이면 처음부터 */
+static int ox_next(OSTAT *stat, char **rec, const char **name, size_t *nlen, const char **value, size_t *vlen)
+{
+	char *blob = stat->of_xattr, *p;
+
+	if(blob == NULL)
+		return 0;
+	p = (*rec == NULL)? blob + OX_HDR : *rec + OX_REC + (uint8_t)**rec + ox_u32(*rec + 1);
+	if(p >= blob + ox_u32(blob))
+		return 0;
+	*rec = p;
+	*nlen = (uint8_t)*p;
+	*vlen = ox_u32(p + 1);
+	*name = p + OX_REC;
+	*value = *name + *nlen;
+	return 1;
+}
+
+static char* ox_find(OSTAT *stat, const char *name, const char **value, size_t *vlen)
+{
+	char *rec = NULL;
+	const char *n;
+	size_t nlen, len = strlen(name);
+
+	while(ox_next(stat, &rec, &n, &nlen, value, vlen))
+		if(nlen == len && memcmp(n, name, len) == 0)
+			return rec;
+	return NULL;
+}
+
+int ofs_xattr_get(OSTAT *stat, const char *name, char *buf, size_t size)
+{
+	const char *value;
+	size_t vlen;
+
+	if(ox_find(stat, name, &value, &vlen) == NULL)
+		return -ENODATA;
+	if(size == 0)
+		return (int)vlen;
+	if(size < vlen)
+		return -ERANGE;
+	memcpy(buf, value, vlen);
+	return (int)vlen;
+}
+
+int ofs_xattr_list(OSTAT *stat, char *buf, size_t size)
+{
+	char *rec = NULL;
+	const char *name, *value;
+	size_t nlen, vlen, len = 0;
+
+	while(ox_next(stat, &rec, &name, &nlen, &value, &vlen)) {
+		if(size > 0) {
+			if(len + nlen + 1 > size)
+				return -ERANGE;
+			memcpy(buf + len, name, nlen);
+			buf[len + nlen] = '\0';
+		}
+		len += nlen + 1;
+	}
+	return (int)len;
+}
+
+/* SKIP 레코드를 빼고 (NAME, VALUE)를 더한 새 묶음으로 바꾼다, NAME이 NULL이면 빼기만 */
+static int ox_rebuild(OSTAT *stat, char *skip, const char *name, const char *value, size_t size)
+{
+	char *old = stat->of_xattr, *blob, *p;
+	size_t oldlen = ofs_xattr_size(stat), skiplen = 0, nlen = 0, len;
+	uint32_t v;
+
+	if(skip != NULL)
+		skiplen = OX_REC + (uint8_t)*skip + ox_u32(skip + 1);
+	if(name != NULL)
+		nlen = strlen(name);
+	len = (oldlen > 0? oldlen : OX_HDR) - skiplen + ((name != NULL)? OX_REC + nlen + size : 0);
+	if(len == OX_HDR) {								// 남은 속성이 없다
+		free(old);
+		stat->of_xattr = NULL;
+		return 0;
+	}
+	if((blob = (char*)malloc(len)) == NULL)
+		return -ENOMEM;
+	p = blob + OX_HDR;
+	if(old != NULL) {
+		if(skip != NULL) {
+			memcpy(p, old + OX_HDR, skip - old - OX_HDR);
+			p += skip - old - OX_HDR;
+			memcpy(p, skip + skiplen, old + oldlen - (skip + skiplen));
+			p += old + oldlen - (skip + skiplen);
+		} else {
+			memcpy(p, old + OX_HDR, oldlen - OX_HDR);
+			p += oldlen - OX_HDR;
+		}
+	}
+	if(name != NULL) {
+		*p++ = (char)(uint8_t)nlen;
+		v = (uint32_t)size;
+		memcpy(p, &v, sizeof(v));
+		p += sizeof(v);
+		memcpy(p, name, nlen);
+		memcpy(p + nlen, value, size);
+	}
+	v = (uint32_t)len;
+	memcpy(blob, &v, sizeof(v));
+	free(old);
+	stat->of_xattr = blob;
+	return 0;
+}
+
+int ofs_xattr_load(OSTAT *stat, char *blob, size_t size)
+{
+	char *rec = NULL;
+	const char *name, *value;
+	size_t nlen, vlen, end = OX_HDR;
+
+	stat->of_xattr = NULL;
+	if(size == 0)
+		return 0;
+	if(size <= OX_HDR || ox_u32(blob) != size)
+		return -1;
+	stat->of_xattr = blob;								// 레코드 경계가 길이와 맞는지 본다
+	while(end < size && size - end >= OX_REC && ox_next(stat, &rec, &name, &nlen, &value, &vlen))
+		end = (rec - blob) + OX_REC + nlen + vlen;
+	stat->of_xattr = NULL;
+	if(end != size)
+		return -1;
+	if((stat->of_xattr = (char*)malloc(size)) == NULL)
+		return -1;
+	memcpy(stat->of_xattr, blob, size);
+	return 0;
+}
+
+/*
+ * 태그 색인
+ */
+static size_t ox_strhash(const char *s)
+{
+	uint64_t h = 1469598103934665603ULL;
+
+	for(; *s != '\0'; s++)
+		h = (h ^ (uint8_t)*s) * 1099511628211ULL;
+	return (size_t)h;
+}
+
+/* 파일은 노드 번호로 찾는다 (/_tag/<값>/<번호>_<이름>) */
+static OXFILE** ox_fbucket(ino_t id)
+{
+	return &ftab[((uint64_t)id * 0x9e3779b97f4a7c15ULL >> 20) & (nfbucket - 1)];
+}
+
+static OXFILE* ox_file(OSTAT *stat)
+{
+	OXFILE *f;
+
+	if(ftab == NULL)
+		return NULL;
+	for(f = *ox_fbucket(stat->of_id); f != NULL; f = f->hnext)
+		if(f->stat == stat) return f;
+	return NULL;
+}
+
+static OXTAG* ox_tag(const char *value)
+{
+	OXTAG *t;
+
+	if(ttab == NULL)
+		return NULL;
+	for(t = ttab[ox_strhash(value) & (ntbucket - 1)]; t != NULL; t = t->hnext)
+		if(strcmp(t->value, value) == 0) return t;
+	return NULL;
+}
+
+/* 항목이 버킷 수를 넘으면 두 배로 늘린다 */
+static void ox_grow_files(void)
+{
+	OXFILE **old = ftab, *f, *next, **b;
+	size_t i, oldn = nfbucket;
+
+	nfbucket = (nfbucket == 0)? OX_HASH_MIN : nfbucket * 2;
+	if((ftab = (OXFILE**)calloc(nfbucket, sizeof(OXFILE*))) == NULL) {
+		ftab = old;
+		nfbucket = oldn;
+		return;
+	}
+	for(i = 0; i < oldn; i++) {
+		for(f = old[i]; f != NULL; f = next) {
+			next = f->hnext;
+			b = ox_fbucket(f->stat->of_id);
+			f->hnext = *b;
+			*b = f;
+		}
+	}
+	free(old);
+}
+
+static void ox_grow_tags(void)
+{
+	OXTAG **old = ttab, *t, *next, **b;
+	size_t i, oldn = ntbucket;
+
+	ntbucket = (ntbucket == 0)? OX_HASH_MIN : ntbucket * 2;
+	if((ttab = (OXTAG**)calloc(ntbucket, sizeof(OXTAG*))) == NULL) {
+		ttab = old;
+		ntbucket = oldn;
+		return;
+	}
+	for(i = 0; i < oldn; i++) {
+		for(t = old[i]; t != NULL; t = next) {
+			next = t->hnext;
+			b = &ttab[ox_strhash(t->value) & (ntbucket - 1)];
+			t->hnext = *b;
+			*b = t;
+		}
+	}
+	free(old);
+}
+
+/* 디렉토리 항목 이름이 될 수 있는 값만 색인한다 */
+static int ox_tagvalue(const char *value, size_t vlen)
+{
+	if(vlen == 0 || vlen >= NAME_MAX || memchr(value, '/', vlen) != NULL || memchr(value, '\0', vlen) != NULL)
+		return 0;
+	return !((vlen == 1 && value[0] == '.') || (vlen == 2 && value[0] == '.' && value[1] == '.'));
+}
+
+static void ox_post(OXFILE *f, const char *value, size_t vlen)
+{
+	char key[NAME_MAX];
+	OXTAG *t, **b;
+	uint32_t i;
+
+	memcpy(key, value, vlen);
+	key[vlen] = '\0';
+	if((t = ox_tag(key)) == NULL) {
+		if(ntag >= ntbucket)
+			ox_grow_tags();
+		t = (OXTAG*)calloc(1, sizeof(OXTAG));
+		t->value = strdup(key);
+		b = &ttab[ox_strhash(key) & (ntbucket - 1)];
+		t->hnext = *b;
+		*b = t;
+		ntag++;
+	}
+	for(i = 0; i < f->ntag; i++)						// 같은 값을 가진 다른 태그 속성
+		if(f->tag[i] == t) return;
+	if(t->n == t->cap) {
+		t->cap = (t->cap == 0)? 4 : t->cap * 2;
+		t->file = (OXFILE**)realloc(t->file, sizeof(OXFILE*) * t->cap);
+	}
+	f->tag = (OXTAG**)realloc(f->tag, sizeof(OXTAG*) * (f->ntag + 1));
+	f->pos = (size_t*)realloc(f->pos, sizeof(size_t) * (f->ntag + 1));
+	f->tag[f->ntag] = t;
+	f->pos[f->ntag++] = t->n;
+	t->file[t->n++] = f;
+}
+
+/* 파일을 태그 값 하나에서 뺀다, 배열의 마지막 파일을 빈 자리로 옮긴다 */
+static void ox_unpost(OXFILE *f, uint32_t i)
+{
+	OXTAG *t = f->tag[i], **b;
+	OXFILE *last;
+	size_t pos = f->pos[i];
+	uint32_t j;
+
+	last = t->file[--t->n];
+	if(last != f) {
+		t->file[pos] = last;
+		for(j = 0; j < last->ntag; j++)
+			if(last->tag[j] == t) last->pos[j] = pos;
+	}
+	f->tag[i] = f->tag[f->ntag - 1];
+	f->pos[i] = f->pos[f->ntag - 1];
+	f->ntag--;
+	if(t->n > 0)
+		return;
+	for(b = &ttab[ox_strhash(t->value) & (ntbucket - 1)]; *b != t; b = &(*b)->hnext);
+	*b = t->hnext;
+	ntag--;
+	free(t->value);
+	free(t->file);
+	free(t);
+}
+
+static void ox_addlink(OXFILE *f, ONODE *node)
+{
+	if(f->nlink == f->cap) {
+		f->cap = (f->cap == 0)? 1 : f->cap * 2;
+		f->link = (ONODE**)realloc(f->link, sizeof(ONODE*) * f->cap);
+	}
+	f->link[f->nlink++] = node;
+}
+
+static OXFILE* ox_newfile(OSTAT *stat)
+{
+	OXFILE *f, **b;
+
+	if(nfile >= nfbucket)
+		ox_grow_files();
+	f = (OXFILE*)calloc(1, sizeof(OXFILE));
+	f->stat = stat;
+	b = ox_fbucket(stat->of_id);
+	f->hnext = *b;
+	*b = f;
+	nfile++;
+	return f;
+}
+
+static void ox_freefile(OXFILE *f)
+{
+	OXFILE **b;
+
+	while(f->ntag > 0)
+		ox_unpost(f, f->ntag - 1);
+	for(b = ox_fbucket(f->stat->of_id); *b != f; b = &(*b)->hnext);
+	*b = f->hnext;
+	nfile--;
+	free(f->link);
+	free(f->tag);
+	free(f->pos);
+	free(f);
+}
+
+/* 처음 태그를 붙인 하드 링크 파일의 다른 링크를 찾는다 (드물기 때문에 트리를 돈다) */
+static void ox_findlinks(ONODE *node, OXFILE *f, ONODE *except)
+{
+	ONODE *cur;
+
+	if(node->of_stat == f->stat && node != except)
+		ox_addlink(f, node);
+	for(cur = node->subhead; cur != NULL; cur = cur->nextnode)
+		ox_findlinks(cur, f, except);
+}
+
+static int ox_tagged(OSTAT *stat)
+{
+	char *rec = NULL;
+	const char *name, *value;
+	size_t nlen, vlen, plen = sizeof(OFS_XATTR_TAG) - 1;
+
+	while(ox_next(stat, &rec, &name, &nlen, &value, &vlen))
+		if(nlen > plen && memcmp(name, OFS_XATTR_TAG, plen) == 0 && ox_tagvalue(value, vlen))
+			return 1;
+	return 0;
+}
+
+/* 파일의 태그 값을 속성에 맞게 다시 넣는다, WALK면 다른 하드 링크를 찾는다 */
+static void ox_retag(ONODE *node, int walk)
+{
+	OSTAT *st = node->of_stat;
+	OXFILE *f = ox_file(st);
+	char *rec = NULL;
+	const char *name, *value;
+	size_t nlen, vlen, plen = sizeof(OFS_XATTR_TAG) - 1;
+
+	if(!S_ISREG(st->of_mode) && !S_ISDIR(st->of_mode))
+		return;
+	if(!ox_tagged(st)) {
+		if(f != NULL)
+			ox_freefile(f);
+		return;
+	}
+	if(f == NULL) {
+		f = ox_newfile(st);
+		ox_addlink(f, node);
+		if(walk && !S_ISDIR(st->of_mode) && st->of_nlink > 1)
+			ox_findlinks(oxroot, f, node);
+	}
+	while(f->ntag > 0)
+		ox_unpost(f, f->ntag - 1);
+	while(ox_next(st, &rec, &name, &nlen, &value, &vlen))
+		if(nlen > plen && memcmp(name, OFS_XATTR_TAG, plen) == 0 && ox_tagvalue(value, vlen))
+			ox_post(f, value, vlen);
+}
+
+static int ox_istag(const char *name)
+{
+	return strncmp(name, OFS_XATTR_TAG, sizeof(OFS_XATTR_TAG) - 1) == 0;
+}
+
+int ofs_xattr_set(ONODE *node, const char *name, const char *value, size_t size, int flags)
+{
+	const char *old;
+	size_t oldlen, nlen = strlen(name);
+	char *rec;
+	int ret;
+
+	if(nlen == 0 || nlen > OFS_XATTR_NAME_MAX)
+		return -ERANGE;
+	if(size > OFS_XATTR_SIZE_MAX)
+		return -E2BIG;
+	rec = ox_find(node->of_stat, name, &old, &oldlen);
+	if((flags & XATTR_CREATE) && rec != NULL)
+		return -EEXIST;
+	if((flags & XATTR_REPLACE) && rec == NULL)
+		return -ENODATA;
+	if((ret = ox_rebuild(node->of_stat, rec, name, value, size)) != 0)
+		return ret;
+	if(enabled && ox_istag(name))
+		ox_retag(node, 1);
+	return 0;
+}
+
+int ofs_xattr_remove(ONODE *node, const char *name)
+{
+	const char *value;
+	size_t vlen;
+	char *rec;
+	int ret;
+
+	if((rec = ox_find(node->of_stat, name, &value, &vlen)) == NULL)
+		return -ENODATA;
+	if((ret = ox_rebuild(node->of_stat, rec, NULL, NULL, 0)) != 0)
+		return ret;
+	if(enabled && ox_istag(name))
+		ox_retag(node, 1);
+	return 0;
+}
+
+static void ox_walk(ONODE *node)
+{
+	ONODE *cur;
+	OXFILE *f;
+
+	if(node->of_stat->of_xattr != NULL) {
+		if((f = ox_file(node->of_stat)) != NULL)			// 이미 넣은 파일의 하드 링크
+			ox_addlink(f, node);
+		else
+			ox_retag(node, 0);
+	}
+	for(cur = node->subhead; cur != NULL; cur = cur->nextnode)
+		ox_walk(cur);
+}
+
+void ofs_xattr_build(ONODE *root)
+{
+	enabled = 1;
+	oxroot = root;
+	ox_walk(root);
+}
+
+int ofs_xattr_tags_enabled(void)
+{
+	return enabled;
+}
+
+void ofs_xattr_link(ONODE *node)
+{
+	OXFILE *f;
+
+	if(enabled && (f = ox_file(node->of_stat)) != NULL)
+		ox_addlink(f, node);
+}
+
+void ofs_xattr_drop(ONODE *node, int last)
+{
+	OSTAT *st = node->of_stat;
+	OXFILE *f;
+	uint32_t i;
+
+	if(enabled && st->of_xattr != NULL && (f = ox_file(st)) != NULL) {
+		for(i = 0; i < f->nlink && f->link[i] != node; i++);
+		if(i < f->nlink)
+			f->link[i] = f->link[--f->nlink];
+		if(last || f->nlink == 0)
+			ox_freefile(f);
+	}
+	if(last) {
+		free(st->of_xattr);
+		st->of_xattr = NULL;
+	}
+}
+
+void ofs_xattr_tags(int (*fn)(const char*, void*), void *arg)
+{
+	OXTAG *t;
+	size_t i;
+
+	for(i = 0; i < ntbucket; i++)
+		for(t = ttab[i]; t != NULL; t = t->hnext)
+			if(fn(t->value, arg) != 0) return;
+}
+
+void ofs_xattr_tagged(const char *value, int (*fn)(ONODE**, uint32_t, void*), void *arg)
+{
+	OXTAG *t;
+	size_t i;
+
+	if((t = ox_tag(value)) == NULL)
+		return;
+	for(i = 0; i < t->n; i++)
+		if(fn(t->file[i]->link, t->file[i]->nlink, arg) != 0) return;
+}
+
+ONODE** ofs_xattr_tagfind(const char *value, ino_t id, uint32_t *nlink)
+{
+	OXTAG *t;
+	OXFILE *f;
+	uint32_t i;
+
+	if(ftab == NULL || (t = ox_tag(value)) == NULL)
+		return NULL;
+	for(f = *ox_fbucket(id); f != NULL; f = f->hnext) {
+		if(f->stat->of_id != id)
+			continue;
+		for(i = 0; i < f->ntag; i++) {
+			if(f->tag[i] == t) {
+				*nlink = f->nlink;
+				return f->link;
+			}
+		}
+	}
+	return NULL;
+}
@@ -0,0 +1,116 @@
+﻿#ifndef __XATTR_H
+#define __XATTR_H
+#include <sys/types.h>
+#include <stdint.h>
+#include "node.h"
+
+#define OFS_XATTR_TAG		"user.tag."		// 이 이름으로 시작하는 속성의 값으로 태그 색인을 만든다
+#define OFS_XATTR_NAME_MAX	255
+#define OFS_XATTR_SIZE_MAX	65536
+
+/*######################################
+ 이름 : ofs_xattr_get
+ 요약 : 확장 속성 값 읽기, SIZE가 0이면 길이만 돌려준다
+ 매개변수 : OSTAT* [STAT], const char* [NAME], char* [BUF], size_t [SIZE]
+ 반환값 : 값의 길이, 없으면 -ENODATA, 버퍼가 작으면 -ERANGE
+ #######################################*/
+int 		ofs_xattr_get		(OSTAT*, const char*, char*, size_t);
+
+/*######################################
+ 이름 : ofs_xattr_list
+ 요약 : 확장 속성 이름 목록 ("이름\0이름\0..."), SIZE가 0이면 길이만 돌려준다
+ 매개변수 : OSTAT* [STAT], char* [BUF], size_t [SIZE]
+ 반환값 : 목록의 길이, 버퍼가 작으면 -ERANGE
+ #######################################*/
+int 		ofs_xattr_list		(OSTAT*, char*, size_t);
+
+/*######################################
+ 이름 : ofs_xattr_set
+ 요약 : 확장 속성 설정 (XATTR_CREATE, XATTR_REPLACE), 태그 속성이면 태그 색인도 고친다
+ 매개변수 : ONODE* [NODE], const char* [NAME], const char* [VALUE], size_t [SIZE], int [FLAGS]
+ 반환값 : 성공시 0, 실패시 음수
+ #######################################*/
+int 		ofs_xattr_set		(ONODE*, const char*, const char*, size_t, int);
+
+/*######################################
+ 이름 : ofs_xattr_remove
+ 요약 : 확장 속성 삭제, 태그 속성이면 태그 색인도 고친다
+ 매개변수 : ONODE* [NODE], const char* [NAME]
+ 반환값 : 성공시 0, 없으면 -ENODATA
+ #######################################*/
+int 		ofs_xattr_remove	(ONODE*, const char*);
+
+/*######################################
+ 이름 : ofs_xattr_size
+ 요약 : 확장 속성이 차지하는 바이트 (사용량 계산, 이미지 저장용)
+ 매개변수 : OSTAT* [STAT]
+ 반환값 : 바이트 수, 없으면 0
+ #######################################*/
+size_t 	ofs_xattr_size		(OSTAT*);
+
+/*######################################
+ 이름 : ofs_xattr_load
+ 요약 : 이미지에서 읽은 확장 속성을 검사하고 노드 정보에 붙인다
+ 매개변수 : OSTAT* [STAT], char* [BLOB], size_t [SIZE]
+ 반환값 : 성공시 0, 형식이 맞지 않으면 -1 (BLOB은 호출자가 해제)
+ #######################################*/
+int 		ofs_xattr_load		(OSTAT*, char*, size_t);
+
+/*######################################
+ 이름 : ofs_xattr_build
+ 요약 : 트리의 태그 속성으로 태그 색인을 만들고 이후의 변경을 반영하기 시작
+ 		이후 모든 함수는 트리 잠금 안에서 호출
+ 매개변수 : ONODE* [ROOT]
+ 반환값 : 없음
+ #######################################*/
+void 		ofs_xattr_build		(ONODE*);
+
+/*######################################
+ 이름 : ofs_xattr_tags_enabled
+ 요약 : 태그 색인 사용 여부
+ 매개변수 : 없음
+ 반환값 : 사용중이면 1, 아니면 0
+ #######################################*/
+int 		ofs_xattr_tags_enabled	(void);
+
+/*######################################
+ 이름 : ofs_xattr_link
+ 요약 : 파일에 새 하드 링크가 생겼을 때 태그 색인에 링크를 더한다
+ 매개변수 : ONODE* [NODE]
+ 반환값 : 없음
+ #######################################*/
+void 		ofs_xattr_link		(ONODE*);
+
+/*######################################
+ 이름 : ofs_xattr_drop
+ 요약 : 트리에서 빠지는 노드를 태그 색인에서 뺀다, LAST면 확장 속성도 해제한다
+ 매개변수 : ONODE* [NODE], int [LAST]
+ 반환값 : 없음
+ #######################################*/
+void 		ofs_xattr_drop		(ONODE*, int);
+
+/*######################################
+ 이름 : ofs_xattr_tags
+ 요약 : 색인된 태그 값마다 FN을 호출, FN이 0이 아니면 멈춘다
+ 매개변수 : int (*)(const char*, void*) [FN], void* [ARG]
+ 반환값 : 없음
+ #######################################*/
+void 		ofs_xattr_tags		(int (*)(const char*, void*), void*);
+
+/*######################################
+ 이름 : ofs_xattr_tagged
+ 요약 : 태그 값이 VALUE인 파일마다 링크 노드 배열로 FN을 호출, FN이 0이 아니면 멈춘다
+ 매개변수 : const char* [VALUE], int (*)(ONODE**, uint32_t, void*) [FN], void* [ARG]
+ 반환값 : 없음
+ #######################################*/
+void 		ofs_xattr_tagged	(const char*, int (*)(ONODE**, uint32_t, void*), void*);
+
+/*######################################
+ 이름 : ofs_xattr_tagfind
+ 요약 : 태그 값이 VALUE인 파일 중 노드 번호가 ID인 파일의 링크 노드 배열
+ 매개변수 : const char* [VALUE], ino_t [ID], uint32_t* [NLINK]
+ 반환값 : 링크 노드 배열, 없으면 NULL
+ #######################################*/
+ONODE** 	ofs_xattr_tagfind	(const char*, ino_t, uint32_t*);
+
+#endif